@@ -42,17 +42,17 @@ void GLTFViewer::Run() {
         if (root) {
             sceneFilter.Cull(root, camera);
         }
-        sceneFilter.Sort(RenderQueue::Geometry,    RenderQueue::GeometryLast, SortingOrder::FrontToback);
+        sceneFilter.Sort(RenderQueue::Geometry,    RenderQueue::GeometryLast, SortingOrder::ByState);
         sceneFilter.Sort(RenderQueue::Transparent, RenderQueue::Transparent,  SortingOrder::BackToFront);
 
         // update skybox
         skyboxFilter.Cull(skybox->scene, camera);
-        skyboxFilter.Sort(RenderQueue::Geometry,    RenderQueue::GeometryLast, SortingOrder::FrontToback);
+        skyboxFilter.Sort(RenderQueue::Geometry,    RenderQueue::GeometryLast, SortingOrder::ByState);
         skyboxFilter.Sort(RenderQueue::Transparent, RenderQueue::Transparent,  SortingOrder::BackToFront);
 
         // add gizmo
         gizmoFilter.Cull(gizmo->scene, camera);
-        gizmoFilter.Sort(RenderQueue::Geometry,    RenderQueue::GeometryLast, SortingOrder::FrontToback);
+        gizmoFilter.Sort(RenderQueue::Geometry,    RenderQueue::GeometryLast, SortingOrder::ByState);
         gizmoFilter.Sort(RenderQueue::Transparent, RenderQueue::Transparent,  SortingOrder::BackToFront);
 
         // rendergraph-based design
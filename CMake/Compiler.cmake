@@ -27,3 +27,12 @@ if(CMAKE_GENERATOR STREQUAL "Ninja")
     # set(CMAKE_CXX_FLAGS_RELEASE "${CMAKE_CXX_FLAGS_RELEASE} /MT")
     # set(CMAKE_CXX_FLAGS_DEBUG "${CMAKE_CXX_FLAGS_DEBUG} /MTd")
 endif()
+
+option(SLIM_ENABLE_AVX "Enable AVX code paths (SSE2 is used otherwise)" OFF)
+if(SLIM_ENABLE_AVX)
+    if(MSVC)
+        add_compile_options(/arch:AVX)
+    else()
+        add_compile_options(-mavx)
+    endif()
+endif()
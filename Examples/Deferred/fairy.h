@@ -235,7 +235,7 @@ public:
         info.commandBuffer->BindVertexBuffer(1, instanceBuffer, 0);
 
         // draw
-        info.commandBuffer->DrawIndexed(indexCount, instanceCount, 0, 0, 0);
+        info.commandBuffer->DrawIndexed(indexCount, instanceCount, sphereGeometry->GetFirstIndex(), sphereGeometry->GetBaseVertex(), 0);
     }
 
     void DrawLight(const RenderInfo& info, Camera* camera, Image* albedo, Image* normal, Image* position) {
@@ -272,7 +272,7 @@ public:
         info.commandBuffer->BindVertexBuffer(1, instanceBuffer, 0);
 
         // draw
-        info.commandBuffer->DrawIndexed(indexCount, instanceCount, 0, 0, 0);
+        info.commandBuffer->DrawIndexed(indexCount, instanceCount, sphereGeometry->GetFirstIndex(), sphereGeometry->GetBaseVertex(), 0);
     }
 
     void DrawFairy(const RenderInfo& info, Camera* camera) {
@@ -303,7 +303,7 @@ public:
         info.commandBuffer->BindVertexBuffer(1, instanceBuffer, 0);
 
         // draw
-        info.commandBuffer->DrawIndexed(indexCount, instanceCount, 0, 0, 0);
+        info.commandBuffer->DrawIndexed(indexCount, instanceCount, sphereGeometry->GetFirstIndex(), sphereGeometry->GetBaseVertex(), 0);
     }
 
     SmartPtr<Device>                device;
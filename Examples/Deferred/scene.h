@@ -62,7 +62,7 @@ public:
         // sceneFilter result + sorting
         auto culling = CPUCulling();
         culling.Cull(model.GetScene(0), camera);
-        culling.Sort(RenderQueue::Geometry,    RenderQueue::GeometryLast, SortingOrder::FrontToback);
+        culling.Sort(RenderQueue::Geometry,    RenderQueue::GeometryLast, SortingOrder::ByState);
         culling.Sort(RenderQueue::Transparent, RenderQueue::Transparent,  SortingOrder::BackToFront);
         // rendering
         MeshRenderer renderer(info);
@@ -82,7 +82,7 @@ void AddGBufferPass(RenderGraph& renderGraph,
 
             mesh->Bind(info.commandBuffer);
             info.commandBuffer->PushConstants(pipeline->Layout(), "Object", &properties);
-            info.commandBuffer->DrawIndexed(mesh->GetIndexCount(), 1, 0, 0, 0);
+            info.commandBuffer->DrawIndexed(mesh->GetIndexCount(), 1, mesh->GetFirstIndex(), mesh->GetBaseVertex(), 0);
         });
 
     });
@@ -14,6 +14,7 @@ int main() {
             .EnableGraphics(true)
             .EnableValidation(true)
             .EnableGLFW(true)
+            .EnablePipelineCache()
     );
 
     // create a slim device
@@ -32,15 +33,23 @@ int main() {
     auto vShader = SlimPtr<spirv::VertexShader>(device, "shaders/matcap.spv");
     auto fShader = SlimPtr<spirv::FragmentShader>(device, "shaders/matcap.spv");
 
+    // only position and normal are used, normals are fetched as snorm16
+    auto layout = gltf::VertexLayout();
+    layout.SetEncoding(gltf::VertexAttribute::Normal,    gltf::VertexEncoding::Snorm16);
+    layout.SetEncoding(gltf::VertexAttribute::Tangent,   gltf::VertexEncoding::None);
+    layout.SetEncoding(gltf::VertexAttribute::TexCoord0, gltf::VertexEncoding::None);
+    layout.SetEncoding(gltf::VertexAttribute::TexCoord1, gltf::VertexEncoding::None);
+    layout.SetEncoding(gltf::VertexAttribute::Color0,    gltf::VertexEncoding::None);
+    layout.SetEncoding(gltf::VertexAttribute::Joints0,   gltf::VertexEncoding::None);
+    layout.SetEncoding(gltf::VertexAttribute::Weights0,  gltf::VertexEncoding::None);
+    layout.CompactIndices();
+
     // create technique
     auto technique = SlimPtr<Technique>();
     technique->AddPass(RenderQueue::Opaque,
         GraphicsPipelineDesc()
             .SetName("textured")
-            .AddVertexBinding(0, sizeof(gltf::Vertex), VK_VERTEX_INPUT_RATE_VERTEX, {
-                { 0, VK_FORMAT_R32G32B32_SFLOAT, static_cast<uint32_t>(offsetof(gltf::Vertex, position)) },
-                { 1, VK_FORMAT_R32G32B32_SFLOAT, static_cast<uint32_t>(offsetof(gltf::Vertex, normal  )) },
-             })
+            .AddVertexBinding(0, layout.GetStride(), VK_VERTEX_INPUT_RATE_VERTEX, layout.GetVertexAttribs())
             .SetVertexShader(vShader)
             .SetFragmentShader(fShader)
             .SetCullMode(VK_CULL_MODE_BACK_BIT)
@@ -65,7 +74,7 @@ int main() {
     // model loading
     auto builder = SlimPtr<scene::Builder>(device);
     auto model = gltf::Model { };
-    model.Load(builder, GetUserAsset("Characters/Suzanne/glTF/Suzanne.gltf"));
+    model.Load(builder, GetUserAsset("Characters/Suzanne/glTF/Suzanne.gltf"), layout);
     model.GetScene(0)->ApplyTransform();
     builder->Build();
 
@@ -104,7 +113,7 @@ int main() {
         // sceneFilter result + sorting
         auto culling = SlimPtr<CPUCulling>();
         culling->Cull(model.GetScene(0), camera);
-        culling->Sort(RenderQueue::Geometry,    RenderQueue::GeometryLast, SortingOrder::FrontToback);
+        culling->Sort(RenderQueue::Geometry,    RenderQueue::GeometryLast, SortingOrder::ByState);
         culling->Sort(RenderQueue::Transparent, RenderQueue::Transparent,  SortingOrder::BackToFront);
 
         ui->Begin();
@@ -112,7 +112,7 @@ int main() {
         // sceneFilter result + sorting
         auto culling = SlimPtr<CPUCulling>();
         culling->Cull(scene, camera);
-        culling->Sort(RenderQueue::Geometry,    RenderQueue::GeometryLast, SortingOrder::FrontToback);
+        culling->Sort(RenderQueue::Geometry,    RenderQueue::GeometryLast, SortingOrder::ByState);
         culling->Sort(RenderQueue::Transparent, RenderQueue::Transparent,  SortingOrder::BackToFront);
 
         // rendergraph-based design
@@ -211,7 +211,7 @@ int main() {
         // sceneFilter result + sorting
         auto culling = SlimPtr<CPUCulling>();
         culling->Cull(root, arcball);
-        culling->Sort(RenderQueue::Geometry,    RenderQueue::GeometryLast, SortingOrder::FrontToback);
+        culling->Sort(RenderQueue::Geometry,    RenderQueue::GeometryLast, SortingOrder::ByState);
         culling->Sort(RenderQueue::Transparent, RenderQueue::Transparent,  SortingOrder::BackToFront);
 
         // rendergraph-based design
@@ -387,7 +387,7 @@ void AddLightVisPass(RenderGraph&           graph,
             }
             mesh->Bind(info.commandBuffer);
             info.commandBuffer->PushConstants(pipeline->Layout(), "LightID", &i);
-            info.commandBuffer->DrawIndexed(mesh->GetIndexCount(), 1, 0, 0, 0);
+            info.commandBuffer->DrawIndexed(mesh->GetIndexCount(), 1, mesh->GetFirstIndex(), mesh->GetBaseVertex(), 0);
         }
     });
 
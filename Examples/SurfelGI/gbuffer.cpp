@@ -95,7 +95,7 @@ void AddGBufferPass(RenderGraph&       graph,
         scene->builder->ForEachInstance([&](scene::Node*, scene::Mesh* mesh, scene::Material*, uint32_t instanceID) {
             mesh->Bind(info.commandBuffer);
             info.commandBuffer->PushConstants(pipeline->Layout(), "InstanceID", &instanceID);
-            info.commandBuffer->DrawIndexed(mesh->GetIndexCount(), 1, 0, 0, 0);
+            info.commandBuffer->DrawIndexed(mesh->GetIndexCount(), 1, mesh->GetFirstIndex(), mesh->GetBaseVertex(), 0);
         });
 
     });
@@ -29,6 +29,7 @@ int main() {
             .EnableBufferDeviceAddress()
             .EnableShaderInt64()
             .EnableRayTracing()
+            .EnablePipelineCache()
     );
 
     // create a slim device
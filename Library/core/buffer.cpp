@@ -4,7 +4,8 @@
 
 using namespace slim;
 
-Buffer::Buffer(Device *device, size_t size, VkBufferUsageFlags bufferUsage, VmaMemoryUsage memoryUsage)
+Buffer::Buffer(Device *device, size_t size, VkBufferUsageFlags bufferUsage, VmaMemoryUsage memoryUsage,
+               VkSharingMode sharingMode)
     : device(device), size(size) {
 
     if (size == 0) throw std::runtime_error("[Buffer] size should not be 0!");
@@ -17,6 +18,23 @@ Buffer::Buffer(Device *device, size_t size, VkBufferUsageFlags bufferUsage, VmaM
                            | VK_BUFFER_USAGE_TRANSFER_SRC_BIT
                            | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 
+    // concurrent sharing needs at least two distinct queue families, otherwise exclusive is equivalent
+    std::vector<uint32_t> queueFamilies;
+    if (sharingMode == VK_SHARING_MODE_CONCURRENT) {
+        QueueFamilyIndices indices = device->GetQueueFamilyIndices();
+        for (const auto& family : { indices.graphics, indices.compute, indices.transfer, indices.dedicatedTransfer }) {
+            if (family.has_value() && std::find(queueFamilies.begin(), queueFamilies.end(), family.value()) == queueFamilies.end()) {
+                queueFamilies.push_back(family.value());
+            }
+        }
+    }
+    if (queueFamilies.size() > 1) {
+        bufferCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bufferCreateInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilies.size());
+        bufferCreateInfo.pQueueFamilyIndices = queueFamilies.data();
+        concurrent = true;
+    }
+
     // allocate memory
     VmaAllocationCreateInfo allocCreateInfo = {};
     allocCreateInfo.usage = memoryUsage;
@@ -67,6 +85,10 @@ void Buffer::Flush() const {
     vmaFlushAllocation(device->GetMemoryAllocator(), allocation, 0, size);
 }
 
+void Buffer::Flush(size_t offset, size_t size) const {
+    vmaFlushAllocation(device->GetMemoryAllocator(), allocation, offset, size);
+}
+
 void Buffer::SetName(const std::string& name) const {
     if (device->IsDebuggerEnabled()) {
         VkDebugMarkerObjectNameInfoEXT nameInfo = {};
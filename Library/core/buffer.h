@@ -2,6 +2,7 @@
 #define SLIM_CORE_BUFFER_H
 
 #include <list>
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <unordered_map>
@@ -63,15 +64,21 @@ namespace slim {
 
     class Buffer : public NotCopyable, public NotMovable, public ReferenceCountable, public TriviallyConvertible<VkBuffer> {
     public:
-        explicit Buffer(Device *device, size_t size, VkBufferUsageFlags bufferUsage, VmaMemoryUsage memoryUsage);
+        // concurrent buffers are shared by all queue families of the device without ownership transfers,
+        // for buffers written on one queue while other parts of them are in use on another
+        explicit Buffer(Device *device, size_t size, VkBufferUsageFlags bufferUsage, VmaMemoryUsage memoryUsage,
+                        VkSharingMode sharingMode = VK_SHARING_MODE_EXCLUSIVE);
         virtual ~Buffer();
 
         void SetData(void *data, size_t size, size_t offset = 0) const;
 
         void Flush() const;
+        void Flush(size_t offset, size_t size) const;
 
         bool HostVisible() const;
 
+        bool Concurrent() const { return concurrent; }
+
         size_t Size() const;
 
         template <typename T>
@@ -93,6 +100,7 @@ namespace slim {
         VmaAllocation     allocation;
         VmaAllocationInfo allocInfo;
         size_t            size;
+        bool              concurrent = false;
     };
 
     template <typename T>
@@ -119,6 +127,114 @@ namespace slim {
         return (size - offset) / sizeof(T);
     }
 
+    // --------------------------------------------------------
+
+    struct BufferAlloc {
+        Buffer* buffer;
+        size_t offset = 0;
+        size_t size = 0;
+
+        BufferAlloc(Buffer* buffer) : buffer(buffer), offset(0), size(buffer->Size()) {
+        }
+
+        BufferAlloc(Buffer* buffer, size_t offset, size_t size) : buffer(buffer), offset(offset), size(size) {
+        }
+    };
+
+    // --------------------------------------------------------
+
+    // BufferAllocator is a frame-scoped linear allocator.
+    // It sub-allocates from a few large persistently mapped chunks by bumping an offset,
+    // and releases everything at once in Reset(). Requests larger than a chunk get a
+    // dedicated buffer, which is dropped on Reset().
+    template <typename Buffer>
+    class BufferAllocator final : public ReferenceCountable {
+    public:
+        constexpr static size_t DEFAULT_CHUNK_SIZE = 4 * 1024 * 1024;
+
+        explicit BufferAllocator(Device *device, size_t alignment, size_t chunkSize = DEFAULT_CHUNK_SIZE);
+        virtual ~BufferAllocator();
+        void Reset();
+        BufferAlloc Request(size_t size);
+
+        size_t GetAlignment() const { return alignment; }
+        size_t GetChunkCount() const { return chunks.size(); }
+        size_t GetAllocatedBytes() const { return allocatedBytes; }
+
+    private:
+        Buffer* AllocateChunk(size_t size);
+
+    private:
+        SmartPtr<Device> device;
+        size_t alignment;
+        size_t chunkSize;
+        size_t chunkIndex = 0;
+        size_t chunkOffset = 0;
+        size_t allocatedBytes = 0;
+        std::vector<SmartPtr<Buffer>> chunks;
+        std::vector<SmartPtr<Buffer>> dedicated;
+    };
+
+    template <typename Buffer>
+    BufferAllocator<Buffer>::BufferAllocator(Device *device, size_t alignment, size_t chunkSize)
+        : device(device), alignment(std::max<size_t>(alignment, 1)), chunkSize(chunkSize) {
+    }
+
+    template <typename Buffer>
+    BufferAllocator<Buffer>::~BufferAllocator() {
+        chunks.clear();
+        dedicated.clear();
+    }
+
+    template <typename Buffer>
+    void BufferAllocator<Buffer>::Reset() {
+        // chunks are kept around and reused by the next frame
+        chunkIndex = 0;
+        chunkOffset = 0;
+        allocatedBytes = 0;
+        dedicated.clear();
+    }
+
+    template <typename Buffer>
+    BufferAlloc BufferAllocator<Buffer>::Request(size_t size) {
+        if (size == 0) throw std::runtime_error("[BufferAllocator] size should not be 0!");
+
+        allocatedBytes += size;
+
+        // oversized request, fallback to a dedicated buffer
+        if (size > chunkSize) {
+            dedicated.push_back(SmartPtr<Buffer>(new Buffer(device, size)));
+            return BufferAlloc(dedicated.back().get(), 0, size);
+        }
+
+        // align offset (alignment is always a power of two in vulkan)
+        size_t offset = (chunkOffset + alignment - 1) & ~(alignment - 1);
+
+        // move to the next chunk if the current one is full
+        if (chunkIndex < chunks.size() && offset + size > chunkSize) {
+            chunkIndex++;
+            offset = 0;
+        }
+
+        // allocate a new chunk when all chunks are used
+        if (chunkIndex == chunks.size()) {
+            AllocateChunk(chunkSize);
+            offset = 0;
+        }
+
+        chunkOffset = offset + size;
+        return BufferAlloc(chunks[chunkIndex].get(), offset, size);
+    }
+
+    template <typename Buffer>
+    Buffer* BufferAllocator<Buffer>::AllocateChunk(size_t size) {
+        Buffer *buffer = new Buffer(device, size);
+        chunks.push_back(SmartPtr<Buffer>(buffer));
+        return buffer;
+    }
+
+    // --------------------------------------------------------
+
     #define BUFFER_TYPE(NAME, BUFFER_USAGE, MEMORY_USAGE)         \
     class NAME final : public Buffer {                            \
     public:                                                       \
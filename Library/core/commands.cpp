@@ -1,3 +1,5 @@
+#include <cstring>
+#include <algorithm>
 #include "core/debug.h"
 #include "core/commands.h"
 #include "core/vkutils.h"
@@ -5,6 +7,15 @@
 
 using namespace slim;
 
+// slot of the bind point in tracked binding states
+static uint32_t BindPointIndex(VkPipelineBindPoint bindPoint) {
+    switch (bindPoint) {
+        case VK_PIPELINE_BIND_POINT_GRAPHICS: return 0;
+        case VK_PIPELINE_BIND_POINT_COMPUTE:  return 1;
+        default:                              return 2;
+    }
+}
+
 CommandBuffer::CommandBuffer(Device *device, VkQueue queue, VkCommandBuffer commandBuffer)
     : device(device), queue(queue) {
     handle = commandBuffer;
@@ -21,6 +32,13 @@ void CommandBuffer::Reset() {
     waitSemaphores.clear();
     signalSemaphores.clear();
     waitStages.clear();
+    waitValues.clear();
+    signalValues.clear();
+    elidedBindCount = 0;
+}
+
+void CommandBuffer::InvalidateBindings() {
+    bound = BindState { };
 }
 
 void CommandBuffer::Begin() {
@@ -40,6 +58,9 @@ void CommandBuffer::Begin() {
     beginInfo.pInheritanceInfo = nullptr;
 
     ErrorCheck(vkBeginCommandBuffer(handle, &beginInfo), "begin command buffer");
+
+    // nothing is bound in a newly begun command buffer
+    InvalidateBindings();
 }
 
 void CommandBuffer::End() {
@@ -53,8 +74,52 @@ void CommandBuffer::End() {
     ErrorCheck(vkEndCommandBuffer(handle), "end command buffer")
 }
 
-void CommandBuffer::BeginRenderPass(const VkRenderPassBeginInfo& beginInfo) const {
-    DeviceDispatch(vkCmdBeginRenderPass(handle, &beginInfo, VK_SUBPASS_CONTENTS_INLINE));
+void CommandBuffer::Begin(RenderPass *renderPass, uint32_t subpass, Framebuffer *framebuffer) {
+    #ifndef NDEBUG
+    // for validation purpose
+    if (started) {
+        throw std::runtime_error("CommandBuffer has already begun when calling Begin()! Need to call End()");
+    }
+    started = true;
+    #endif
+
+    // inherit render pass state from the primary command buffer
+    VkCommandBufferInheritanceInfo inheritanceInfo = {};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.pNext = nullptr;
+    inheritanceInfo.renderPass = *renderPass;
+    inheritanceInfo.subpass = subpass;
+    inheritanceInfo.framebuffer = framebuffer ? static_cast<VkFramebuffer>(*framebuffer) : VK_NULL_HANDLE;
+    inheritanceInfo.occlusionQueryEnable = VK_FALSE;
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.pNext = nullptr;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+    ErrorCheck(vkBeginCommandBuffer(handle, &beginInfo), "begin secondary command buffer");
+
+    // nothing is bound in a newly begun command buffer
+    InvalidateBindings();
+}
+
+void CommandBuffer::BeginRenderPass(const VkRenderPassBeginInfo& beginInfo, VkSubpassContents contents) const {
+    DeviceDispatch(vkCmdBeginRenderPass(handle, &beginInfo, contents));
+}
+
+void CommandBuffer::ExecuteCommands(const std::vector<CommandBuffer*> &commandBuffers) {
+    if (commandBuffers.empty()) return;
+
+    std::vector<VkCommandBuffer> handles;
+    handles.reserve(commandBuffers.size());
+    for (CommandBuffer* commandBuffer : commandBuffers) {
+        handles.push_back(*commandBuffer);
+    }
+    DeviceDispatch(vkCmdExecuteCommands(handle, handles.size(), handles.data()));
+
+    // state bound by secondary command buffers does not carry over
+    InvalidateBindings();
 }
 
 void CommandBuffer::EndRenderPass() const {
@@ -84,13 +149,18 @@ void CommandBuffer::Submit() {
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &handle;
 
+    // timeline semaphore values
+    submitInfo.pNext = PrepareTimelineSubmitInfo();
+
     // ErrorCheck(DeviceDispatch(vkQueueSubmit(queue, 1, &submitInfo, signalFence)), "submit command buffer");
     DeviceDispatch(vkQueueSubmit(queue, 1, &submitInfo, signalFence));
 
     // clean up
     waitSemaphores.clear();
     waitStages.clear();
+    waitValues.clear();
     signalSemaphores.clear();
+    signalValues.clear();
     signalFence = VK_NULL_HANDLE;
 }
 
@@ -100,6 +170,7 @@ void CommandBuffer::Wait(Semaphore *semaphore, VkPipelineStageFlags stages) {
     if (it == waitSemaphores.end()) {
         waitSemaphores.push_back(sema);
         waitStages.push_back(stages);
+        waitValues.push_back(0);
     }
 }
 
@@ -108,6 +179,7 @@ void CommandBuffer::Signal(Semaphore *semaphore) {
     auto it = std::find(signalSemaphores.begin(), signalSemaphores.end(), sema);
     if (it == signalSemaphores.end()) {
         signalSemaphores.push_back(sema);
+        signalValues.push_back(0);
     }
 }
 
@@ -115,6 +187,49 @@ void CommandBuffer::Signal(Fence *fence) {
     signalFence = *fence;
 }
 
+void CommandBuffer::Wait(TimelineSemaphore *semaphore, uint64_t value, VkPipelineStageFlags stages) {
+    VkSemaphore sema = *semaphore;
+    auto it = std::find(waitSemaphores.begin(), waitSemaphores.end(), sema);
+    if (it == waitSemaphores.end()) {
+        waitSemaphores.push_back(sema);
+        waitStages.push_back(stages);
+        waitValues.push_back(value);
+    } else {
+        // waiting for the larger value covers both
+        size_t index = std::distance(waitSemaphores.begin(), it);
+        waitValues[index] = std::max(waitValues[index], value);
+        waitStages[index] |= stages;
+    }
+}
+
+void CommandBuffer::Signal(TimelineSemaphore *semaphore, uint64_t value) {
+    VkSemaphore sema = *semaphore;
+    auto it = std::find(signalSemaphores.begin(), signalSemaphores.end(), sema);
+    if (it == signalSemaphores.end()) {
+        signalSemaphores.push_back(sema);
+        signalValues.push_back(value);
+    } else {
+        size_t index = std::distance(signalSemaphores.begin(), it);
+        signalValues[index] = std::max(signalValues[index], value);
+    }
+}
+
+const void* CommandBuffer::PrepareTimelineSubmitInfo() const {
+    bool timeline = std::any_of(waitValues.begin(), waitValues.end(), [](uint64_t value) { return value != 0; })
+                 || std::any_of(signalValues.begin(), signalValues.end(), [](uint64_t value) { return value != 0; });
+    if (!timeline) {
+        return nullptr;
+    }
+
+    timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineSubmitInfo.pNext = nullptr;
+    timelineSubmitInfo.waitSemaphoreValueCount = waitValues.size();
+    timelineSubmitInfo.pWaitSemaphoreValues = waitValues.data();
+    timelineSubmitInfo.signalSemaphoreValueCount = signalValues.size();
+    timelineSubmitInfo.pSignalSemaphoreValues = signalValues.data();
+    return &timelineSubmitInfo;
+}
+
 VkSubmitInfo CommandBuffer::GetSubmitInfo() const {
     VkSubmitInfo submit = {};
     submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -125,7 +240,7 @@ VkSubmitInfo CommandBuffer::GetSubmitInfo() const {
     submit.waitSemaphoreCount = waitSemaphores.size();
     submit.pWaitSemaphores = waitSemaphores.data();
     submit.pWaitDstStageMask = waitStages.data();
-    submit.pNext = nullptr;
+    submit.pNext = PrepareTimelineSubmitInfo();
     return submit;
 }
 
@@ -166,7 +281,7 @@ void CommandBuffer::CopyDataToImage(void *data, size_t size, Image *image,
     auto staging = stagingBuffers.back().get();
     staging->SetName("StagingCopy");
     staging->SetData(data, size);
-    CopyBufferToImage(staging, 0, 0, extent.height, image, offset, extent, baseLayer, layerCount, mipLevel, aspectMask);
+    CopyBufferToImage(staging, 0, 0, 0, image, offset, extent, baseLayer, layerCount, mipLevel, aspectMask);
 }
 
 void CommandBuffer::CopyBufferToBuffer(Buffer *srcBuffer, size_t srcOffset, Buffer *dstBuffer, size_t dstOffset, size_t size) {
@@ -221,8 +336,10 @@ void CommandBuffer::CopyImageToImage(Image *srcImage, const VkOffset3D &srcOffse
                                      Image *dstImage, const VkOffset3D &dstOffset,
                                      uint32_t dstBaseLayer, uint32_t dstLayerCount,
                                      uint32_t dstMipLevel, VkImageAspectFlags dstAspectMask) {
-    PrepareForTransferSrc(srcImage, srcBaseLayer, srcLayerCount, srcMipLevel, 1);
-    PrepareForTransferDst(dstImage, dstBaseLayer, dstLayerCount, dstMipLevel, 1);
+    BarrierBatch barriers;
+    PrepareForTransferSrc(barriers, srcImage, srcBaseLayer, srcLayerCount, srcMipLevel, 1);
+    PrepareForTransferDst(barriers, dstImage, dstBaseLayer, dstLayerCount, dstMipLevel, 1);
+    barriers.Flush(this);
 
     VkImageCopy copy = {};
     copy.srcOffset = srcOffset;
@@ -270,26 +387,22 @@ void CommandBuffer::GenerateMipmaps(Image *image, VkFilter filter) {
     // no need to generate mipmaps
     if (image->MipLevels() <= 1) return;
 
+    // last mip level of every layer is transited together at the end
+    BarrierBatch lastLevels;
     for (uint32_t layer = 0; layer < image->Layers(); layer++) {
         int32_t mipW = image->Width();
         int32_t mipH = image->Height();
 
+        BarrierBatch barriers;
         for (uint32_t i = 0; i < image->MipLevels() - 1; i++) {
-            // transit mip-level {i} to transfer src
-            PrepareLayoutTransition(this, image,
-                                    image->layouts[layer][i],
-                                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                                    VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                    VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                    layer, 1, i, 1);
-
-            // transit mip-level {i+1} to transfer dst
-            PrepareLayoutTransition(this, image,
-                                    image->layouts[layer][i + 1],
-                                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                    VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                    VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                    layer, 1, i + 1, 1);
+            // transit mip-level {i} to transfer src and mip-level {i+1} to transfer dst
+            barriers.AddImageBarrier(image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                     VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                     layer, 1, i, 1);
+            barriers.AddImageBarrier(image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                     VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                     layer, 1, i + 1, 1);
+            barriers.Flush(this);
 
             // blit image
             int32_t mipWNext = (mipW >> 1) > 0 ? (mipW >> 1) : 1;
@@ -304,22 +417,20 @@ void CommandBuffer::GenerateMipmaps(Image *image, VkFilter filter) {
         }
 
         // transit mip-level mipCount-1 to transfer src
-        uint32_t mip = image->MipLevels() - 1;
-        PrepareLayoutTransition(this, image,
-                                image->layouts[layer][mip],
-                                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                                VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                layer, 1, mip, 1);
+        PrepareForTransferSrc(lastLevels, image, layer, 1, image->MipLevels() - 1, 1);
     }
+    lastLevels.Flush(this);
 }
 
 void CommandBuffer::PrepareForShaderRead(Image *image, uint32_t baseLayer, uint32_t layerCount, uint32_t mipLevel, uint32_t levelCount) {
-    if (layerCount == 0) layerCount = image->createInfo.arrayLayers;
-    if (levelCount == 0) levelCount = image->createInfo.mipLevels;
+    BarrierBatch barriers;
+    PrepareForShaderRead(barriers, image, baseLayer, layerCount, mipLevel, levelCount);
+    barriers.Flush(this);
+}
+
+void CommandBuffer::PrepareForShaderRead(BarrierBatch &barriers, Image *image, uint32_t baseLayer, uint32_t layerCount, uint32_t mipLevel, uint32_t levelCount) {
     // transit dst image layout
-    PrepareLayoutTransition(this, image,
-        image->layouts[baseLayer][mipLevel],
+    barriers.AddImageBarrier(image,
         VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
         VK_PIPELINE_STAGE_TRANSFER_BIT,
         VK_PIPELINE_STAGE_TRANSFER_BIT,
@@ -328,11 +439,14 @@ void CommandBuffer::PrepareForShaderRead(Image *image, uint32_t baseLayer, uint3
 }
 
 void CommandBuffer::PrepareForTransferSrc(Image *image, uint32_t baseLayer, uint32_t layerCount, uint32_t mipLevel, uint32_t levelCount) {
-    if (layerCount == 0) layerCount = image->createInfo.arrayLayers;
-    if (levelCount == 0) levelCount = image->createInfo.mipLevels;
+    BarrierBatch barriers;
+    PrepareForTransferSrc(barriers, image, baseLayer, layerCount, mipLevel, levelCount);
+    barriers.Flush(this);
+}
+
+void CommandBuffer::PrepareForTransferSrc(BarrierBatch &barriers, Image *image, uint32_t baseLayer, uint32_t layerCount, uint32_t mipLevel, uint32_t levelCount) {
     // transit dst image layout
-    PrepareLayoutTransition(this, image,
-        image->layouts[baseLayer][mipLevel],
+    barriers.AddImageBarrier(image,
         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
         VK_PIPELINE_STAGE_TRANSFER_BIT,
         VK_PIPELINE_STAGE_TRANSFER_BIT,
@@ -341,11 +455,14 @@ void CommandBuffer::PrepareForTransferSrc(Image *image, uint32_t baseLayer, uint
 }
 
 void CommandBuffer::PrepareForTransferDst(Image *image, uint32_t baseLayer, uint32_t layerCount, uint32_t mipLevel, uint32_t levelCount) {
-    if (layerCount == 0) layerCount = image->createInfo.arrayLayers;
-    if (levelCount == 0) levelCount = image->createInfo.mipLevels;
+    BarrierBatch barriers;
+    PrepareForTransferDst(barriers, image, baseLayer, layerCount, mipLevel, levelCount);
+    barriers.Flush(this);
+}
+
+void CommandBuffer::PrepareForTransferDst(BarrierBatch &barriers, Image *image, uint32_t baseLayer, uint32_t layerCount, uint32_t mipLevel, uint32_t levelCount) {
     // transit dst image layout
-    PrepareLayoutTransition(this, image,
-        image->layouts[baseLayer][mipLevel],
+    barriers.AddImageBarrier(image,
         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
         VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
         VK_PIPELINE_STAGE_TRANSFER_BIT,
@@ -354,11 +471,14 @@ void CommandBuffer::PrepareForTransferDst(Image *image, uint32_t baseLayer, uint
 }
 
 void CommandBuffer::PrepareForPresentSrc(Image *image, uint32_t baseLayer, uint32_t layerCount, uint32_t mipLevel, uint32_t levelCount) {
-    if (layerCount == 0) layerCount = image->createInfo.arrayLayers;
-    if (levelCount == 0) levelCount = image->createInfo.mipLevels;
+    BarrierBatch barriers;
+    PrepareForPresentSrc(barriers, image, baseLayer, layerCount, mipLevel, levelCount);
+    barriers.Flush(this);
+}
+
+void CommandBuffer::PrepareForPresentSrc(BarrierBatch &barriers, Image *image, uint32_t baseLayer, uint32_t layerCount, uint32_t mipLevel, uint32_t levelCount) {
     // transit dst image layout
-    PrepareLayoutTransition(this, image,
-        image->layouts[baseLayer][mipLevel],
+    barriers.AddImageBarrier(image,
         VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
@@ -378,8 +498,33 @@ void CommandBuffer::DrawIndexed(uint32_t indexCount, uint32_t instanceCount, uin
     DeviceDispatch(vkCmdDrawIndexed(handle, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance));
 }
 
+void CommandBuffer::DrawIndirect(Buffer *buffer, size_t offset, uint32_t drawCount, uint32_t stride) {
+    DeviceDispatch(vkCmdDrawIndirect(handle, *buffer, offset, drawCount, stride));
+}
+
+void CommandBuffer::DrawIndexedIndirect(Buffer *buffer, size_t offset, uint32_t drawCount, uint32_t stride) {
+    DeviceDispatch(vkCmdDrawIndexedIndirect(handle, *buffer, offset, drawCount, stride));
+}
+
+void CommandBuffer::DrawIndirectCount(Buffer *buffer, size_t offset, Buffer *countBuffer, size_t countOffset,
+                                      uint32_t maxDrawCount, uint32_t stride) {
+    DeviceDispatch(vkCmdDrawIndirectCountKHR(handle, *buffer, offset, *countBuffer, countOffset, maxDrawCount, stride));
+}
+
+void CommandBuffer::DrawIndexedIndirectCount(Buffer *buffer, size_t offset, Buffer *countBuffer, size_t countOffset,
+                                             uint32_t maxDrawCount, uint32_t stride) {
+    DeviceDispatch(vkCmdDrawIndexedIndirectCountKHR(handle, *buffer, offset, *countBuffer, countOffset, maxDrawCount, stride));
+}
+
 void CommandBuffer::BindPipeline(Pipeline *pipeline) {
-    DeviceDispatch(vkCmdBindPipeline(handle, pipeline->Type(), *pipeline));
+    VkPipeline vkPipeline = *pipeline;
+    VkPipeline& current = bound.pipelines[BindPointIndex(pipeline->Type())];
+    if (current == vkPipeline) {
+        elidedBindCount++;
+        return;
+    }
+    current = vkPipeline;
+    DeviceDispatch(vkCmdBindPipeline(handle, pipeline->Type(), vkPipeline));
 }
 
 void CommandBuffer::BindDescriptor(Descriptor *descriptor, VkPipelineBindPoint bindPoint) {
@@ -387,10 +532,31 @@ void CommandBuffer::BindDescriptor(Descriptor *descriptor, VkPipelineBindPoint b
 
     VkPipelineLayout layout = *descriptor->pipelineLayout;
 
+    // binding with another pipeline layout might disturb previously bound sets
+    uint32_t index = BindPointIndex(bindPoint);
+    auto& boundSets = bound.descriptorSets[index];
+    if (bound.descriptorLayouts[index] != layout) {
+        bound.descriptorLayouts[index] = layout;
+        boundSets.clear();
+    }
+
     // bind descriptor set individually (need to optimize it later)
     // TODO: batch descriptor sets binding if possible
     for (uint32_t i = 0; i < descriptor->descriptorSets.size(); i++) {
         if (descriptor->descriptorSets[i] != VK_NULL_HANDLE) {
+            if (boundSets.size() <= i) {
+                boundSets.resize(i + 1);
+            }
+
+            // same set with the same dynamic offsets is already bound
+            BoundDescriptorSet& boundSet = boundSets[i];
+            if (boundSet.set == descriptor->descriptorSets[i] && boundSet.dynamicOffsets == descriptor->dynamicOffsets[i]) {
+                elidedBindCount++;
+                continue;
+            }
+            boundSet.set = descriptor->descriptorSets[i];
+            boundSet.dynamicOffsets = descriptor->dynamicOffsets[i];
+
             uint32_t dynamicOffsetCount = descriptor->dynamicOffsets[i].size();
             uint32_t* dynamicOffsetData = descriptor->dynamicOffsets[i].data();
             DeviceDispatch(vkCmdBindDescriptorSets(handle, bindPoint, layout, i, 1, &descriptor->descriptorSets[i], dynamicOffsetCount, dynamicOffsetData));
@@ -399,23 +565,52 @@ void CommandBuffer::BindDescriptor(Descriptor *descriptor, VkPipelineBindPoint b
 }
 
 void CommandBuffer::BindIndexBuffer(IndexBuffer *buffer, size_t offset) {
-    DeviceDispatch(vkCmdBindIndexBuffer(handle, *buffer, offset, buffer->indexType));
+    BindIndexBuffer(buffer, offset, buffer->indexType);
 }
 
 void CommandBuffer::BindIndexBuffer(Buffer *buffer, size_t offset, VkIndexType indexType) {
-    DeviceDispatch(vkCmdBindIndexBuffer(handle, *buffer, offset, indexType));
+    VkBuffer iBuffer = *buffer;
+    if (bound.indexBuffer == iBuffer && bound.indexOffset == offset && bound.indexType == indexType) {
+        elidedBindCount++;
+        return;
+    }
+    bound.indexBuffer = iBuffer;
+    bound.indexOffset = offset;
+    bound.indexType = indexType;
+    DeviceDispatch(vkCmdBindIndexBuffer(handle, iBuffer, offset, indexType));
 }
 
 void CommandBuffer::BindVertexBuffer(uint32_t binding, Buffer *buffer, uint64_t offset) {
     VkBuffer vBuffer = *buffer;
-    DeviceDispatch(vkCmdBindVertexBuffers(handle, binding, 1, &vBuffer, &offset));
+    BindVertexBuffers(binding, 1, &vBuffer, &offset);
 }
 
 void CommandBuffer::BindVertexBuffers(uint32_t binding, const std::vector<Buffer*> &buffers, const std::vector<uint64_t> &offsets) {
     std::vector<VkBuffer> vBuffers;
     for (auto buffer : buffers)
         vBuffers.push_back(*buffer);
-    DeviceDispatch(vkCmdBindVertexBuffers(handle, binding, vBuffers.size(), vBuffers.data(), offsets.data()));
+    BindVertexBuffers(binding, vBuffers.size(), vBuffers.data(), offsets.data());
+}
+
+void CommandBuffer::BindVertexBuffers(uint32_t binding, uint32_t count, const VkBuffer *buffers, const VkDeviceSize *offsets) {
+    if (bound.vertexBuffers.size() < binding + count) {
+        bound.vertexBuffers.resize(binding + count, VK_NULL_HANDLE);
+        bound.vertexOffsets.resize(binding + count, 0);
+    }
+
+    // skip when all bindings in range are unchanged
+    bool redundant = true;
+    for (uint32_t i = 0; i < count; i++) {
+        redundant &= bound.vertexBuffers[binding + i] == buffers[i] && bound.vertexOffsets[binding + i] == offsets[i];
+        bound.vertexBuffers[binding + i] = buffers[i];
+        bound.vertexOffsets[binding + i] = offsets[i];
+    }
+    if (redundant) {
+        elidedBindCount++;
+        return;
+    }
+
+    DeviceDispatch(vkCmdBindVertexBuffers(handle, binding, count, buffers, offsets));
 }
 
 void CommandBuffer::PushConstants(PipelineLayout *layout, const std::string &name, const void *value) {
@@ -424,12 +619,36 @@ void CommandBuffer::PushConstants(PipelineLayout *layout, const std::string &nam
 }
 
 void CommandBuffer::PushConstants(PipelineLayout *layout, size_t offset, const void *value, size_t size, VkShaderStageFlags stages) {
-    DeviceDispatch(vkCmdPushConstants(handle, *layout, stages, offset, size, value));
+    VkPipelineLayout vkLayout = *layout;
+    auto& pushed = bound.pushConstants;
+    if (bound.pushConstantLayout != vkLayout) {
+        bound.pushConstantLayout = vkLayout;
+        pushed.clear();
+    }
+
+    // skip when identical data was pushed to the same range
+    for (const BoundPushConstant& push : pushed) {
+        if (push.stages == stages && push.offset == offset && push.data.size() == size
+            && std::memcmp(push.data.data(), value, size) == 0) {
+            elidedBindCount++;
+            return;
+        }
+    }
+
+    // any overlapping range is now (at least partially) overwritten
+    pushed.erase(std::remove_if(pushed.begin(), pushed.end(), [&](const BoundPushConstant& push) {
+        return push.offset < offset + size && offset < push.offset + push.data.size();
+    }), pushed.end());
+
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(value);
+    pushed.push_back(BoundPushConstant { stages, static_cast<uint32_t>(offset), std::vector<uint8_t>(bytes, bytes + size) });
+
+    DeviceDispatch(vkCmdPushConstants(handle, vkLayout, stages, offset, size, value));
 }
 
-CommandPool::CommandPool(Device *device, uint32_t queueFamilyIndex) : device(device) {
+CommandPool::CommandPool(Device *device, uint32_t queueFamilyIndex, uint32_t queueIndex) : device(device) {
     // get device queue
-    vkGetDeviceQueue(*device, queueFamilyIndex, 0, &queue);
+    vkGetDeviceQueue(*device, queueFamilyIndex, queueIndex, &queue);
 
     // create command pool
     VkCommandPoolCreateInfo createInfo = {};
@@ -473,6 +692,13 @@ CommandBuffer* CommandPool::Request(VkCommandBufferLevel level) {
     return commandBuffer;
 }
 
+uint32_t CommandPool::GetElidedBindCount() const {
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < activePrimaryCommandBuffers; i++) count += primaryCommandBuffers[i]->GetElidedBindCount();
+    for (uint32_t i = 0; i < activeSecondaryCommandBuffers; i++) count += secondaryCommandBuffers[i]->GetElidedBindCount();
+    return count;
+}
+
 CommandBuffer* CommandPool::RequestPrimaryCommandBuffer() {
     if (activePrimaryCommandBuffers < primaryCommandBuffers.size()) {
         return primaryCommandBuffers[activePrimaryCommandBuffers++].get();
@@ -10,6 +10,7 @@
 #include "core/vkutils.h"
 #include "core/pipeline.h"
 #include "core/descriptor.h"
+#include "core/framebuffer.h"
 #include "core/acceleration.h"
 #include "core/synchronization.h"
 #include "utility/interface.h"
@@ -34,13 +35,21 @@ namespace slim {
         void Begin();
         void End();
 
-        void BeginRenderPass(const VkRenderPassBeginInfo& beginInfo) const;
+        // secondary command buffer continuing the given subpass of a render pass
+        void Begin(RenderPass *renderPass, uint32_t subpass, Framebuffer *framebuffer = nullptr);
+
+        void BeginRenderPass(const VkRenderPassBeginInfo& beginInfo, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE) const;
         void EndRenderPass() const;
 
+        // run recorded secondary command buffers, bindings are undefined afterwards
+        void ExecuteCommands(const std::vector<CommandBuffer*> &commandBuffers);
+
         void Submit();
         void Wait(Semaphore *semaphore, VkPipelineStageFlags stages);
         void Signal(Semaphore *semaphore);
         void Signal(Fence *fence);
+        void Wait(TimelineSemaphore *semaphore, uint64_t value, VkPipelineStageFlags stages);
+        void Signal(TimelineSemaphore *semaphore, uint64_t value);
 
         void NextSubpass(VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
 
@@ -49,6 +58,16 @@ namespace slim {
         void Draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance);
         void DrawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, uint32_t vertexOffset, uint32_t firstInstance);
 
+        // indirect draws, drawCount > 1 requires multiDrawIndirect (ContextDesc::EnableMultiDraw)
+        void DrawIndirect(Buffer *buffer, size_t offset, uint32_t drawCount, uint32_t stride = sizeof(VkDrawIndirectCommand));
+        void DrawIndexedIndirect(Buffer *buffer, size_t offset, uint32_t drawCount, uint32_t stride = sizeof(VkDrawIndexedIndirectCommand));
+
+        // draw count is read from countBuffer, requires ContextDesc::EnableDrawIndirectCount
+        void DrawIndirectCount(Buffer *buffer, size_t offset, Buffer *countBuffer, size_t countOffset,
+                               uint32_t maxDrawCount, uint32_t stride = sizeof(VkDrawIndirectCommand));
+        void DrawIndexedIndirectCount(Buffer *buffer, size_t offset, Buffer *countBuffer, size_t countOffset,
+                                      uint32_t maxDrawCount, uint32_t stride = sizeof(VkDrawIndexedIndirectCommand));
+
         void BindPipeline(Pipeline *pipeline);
         void BindDescriptor(Descriptor *descriptor, VkPipelineBindPoint bindPoint);
         void BindDescriptor(Descriptor *descriptor, const std::vector<uint32_t> &dynamicOffset, VkPipelineBindPoint bindPoint);
@@ -56,6 +75,7 @@ namespace slim {
         void BindIndexBuffer(Buffer *buffer, size_t offset, VkIndexType indexType);
         void BindVertexBuffer(uint32_t binding, Buffer *buffer, uint64_t offset);
         void BindVertexBuffers(uint32_t binding, const std::vector<Buffer*> &buffers, const std::vector<uint64_t> &offsets);
+        void BindVertexBuffers(uint32_t binding, uint32_t count, const VkBuffer *buffers, const VkDeviceSize *offsets);
 
         void PushConstants(PipelineLayout *layout, const std::string &name, const void *value);
         void PushConstants(PipelineLayout *layout, size_t offset, const void *value, size_t size, VkShaderStageFlags stages);
@@ -116,14 +136,27 @@ namespace slim {
         void PrepareForTransferSrc(Image *image, uint32_t baseLayer = 0, uint32_t layerCount = 0, uint32_t mipLevel = 0, uint32_t levelCount = 0);
         void PrepareForTransferDst(Image *image, uint32_t baseLayer = 0, uint32_t layerCount = 0, uint32_t mipLevel = 0, uint32_t levelCount = 0);
         void PrepareForPresentSrc(Image *image, uint32_t baseLayer = 0, uint32_t layerCount = 0, uint32_t mipLevel = 0, uint32_t levelCount = 0);
+
+        // add the same layout transitions to a batch, so transitions due together are recorded with one barrier
+        void PrepareForShaderRead(BarrierBatch &barriers, Image *image, uint32_t baseLayer = 0, uint32_t layerCount = 0, uint32_t mipLevel = 0, uint32_t levelCount = 0);
+        void PrepareForTransferSrc(BarrierBatch &barriers, Image *image, uint32_t baseLayer = 0, uint32_t layerCount = 0, uint32_t mipLevel = 0, uint32_t levelCount = 0);
+        void PrepareForTransferDst(BarrierBatch &barriers, Image *image, uint32_t baseLayer = 0, uint32_t layerCount = 0, uint32_t mipLevel = 0, uint32_t levelCount = 0);
+        void PrepareForPresentSrc(BarrierBatch &barriers, Image *image, uint32_t baseLayer = 0, uint32_t layerCount = 0, uint32_t mipLevel = 0, uint32_t levelCount = 0);
         void PrepareForBuffer(Buffer* buffer, VkPipelineStageFlags srcStages, VkPipelineStageFlags dstStages);
 
+        // forget tracked bindings, needed after recording bindings without this wrapper
+        void InvalidateBindings();
+
+        // number of binding commands skipped because the same state was already bound
+        uint32_t GetElidedBindCount() const { return elidedBindCount; }
+
         Device* GetDevice() const { return device; }
 
         VkSubmitInfo GetSubmitInfo() const;
 
     private:
         void Reset();
+        const void* PrepareTimelineSubmitInfo() const;
 
     private:
         SmartPtr<Device> device;
@@ -135,6 +168,39 @@ namespace slim {
         std::vector<VkSemaphore> signalSemaphores;
         std::vector<VkPipelineStageFlags> waitStages;
 
+        // timeline semaphore values, parallel to wait/signal semaphores (ignored for binary semaphores)
+        std::vector<uint64_t> waitValues;
+        std::vector<uint64_t> signalValues;
+        mutable VkTimelineSemaphoreSubmitInfo timelineSubmitInfo = {};
+
+        // bound states, used to skip redundant binding commands (indexed by bind point)
+        struct BoundDescriptorSet {
+            VkDescriptorSet       set = VK_NULL_HANDLE;
+            std::vector<uint32_t> dynamicOffsets;
+        };
+
+        struct BoundPushConstant {
+            VkShaderStageFlags    stages;
+            uint32_t              offset;
+            std::vector<uint8_t>  data;
+        };
+
+        struct BindState {
+            VkPipeline                      pipelines[3] = { };
+            VkPipelineLayout                descriptorLayouts[3] = { };
+            std::vector<BoundDescriptorSet> descriptorSets[3];
+            std::vector<VkBuffer>           vertexBuffers;
+            std::vector<VkDeviceSize>       vertexOffsets;
+            VkBuffer                        indexBuffer = VK_NULL_HANDLE;
+            VkDeviceSize                    indexOffset = 0;
+            VkIndexType                     indexType = VK_INDEX_TYPE_UINT32;
+            VkPipelineLayout                pushConstantLayout = VK_NULL_HANDLE;
+            std::vector<BoundPushConstant>  pushConstants;
+        };
+
+        BindState bound;
+        uint32_t elidedBindCount = 0;
+
         #ifndef NDEBUG
         // for validation purpose
         bool started = false;
@@ -165,12 +231,15 @@ namespace slim {
 
     class CommandPool final : public NotCopyable, public NotMovable, public ReferenceCountable, public TriviallyConvertible<VkCommandPool> {
     public:
-        CommandPool(Device *device, uint32_t queueFamilyIndex);
+        CommandPool(Device *device, uint32_t queueFamilyIndex, uint32_t queueIndex = 0);
         virtual ~CommandPool();
 
         void Reset();
         CommandBuffer* Request(VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 
+        // elided binds across all command buffers requested since the last reset
+        uint32_t GetElidedBindCount() const;
+
     private:
         CommandBuffer* RequestPrimaryCommandBuffer();
         CommandBuffer* RequestSecondaryCommandBuffer();
@@ -219,6 +219,37 @@ ContextDesc& ContextDesc::EnableShaderFloat64() {
 
 ContextDesc& ContextDesc::EnableMultiDraw() {
     features->features.multiDrawIndirect = VK_TRUE;
+    // indirect draws identify their instances with firstInstance
+    features->features.drawIndirectFirstInstance = VK_TRUE;
+    return *this;
+}
+
+ContextDesc& ContextDesc::EnableDrawIndirectCount() {
+    // the KHR entry points are used, so the extension is needed in both cases
+    deviceExtensions.insert(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    #ifdef SLIM_USE_VK_FEATURES
+    vk12features->drawIndirectCount = VK_TRUE;
+    #endif
+    return *this;
+}
+
+ContextDesc& ContextDesc::EnableTimelineSemaphore() {
+    #ifdef SLIM_USE_VK_FEATURES
+    vk12features->timelineSemaphore = VK_TRUE;
+    #else
+    if (!deviceFeatures.timelineSemaphore.get()) {
+        deviceFeatures.timelineSemaphore.reset(new VkPhysicalDeviceTimelineSemaphoreFeatures { });
+        deviceFeatures.timelineSemaphore->sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+        deviceFeatures.timelineSemaphore->timelineSemaphore = VK_TRUE;
+        deviceFeatures.timelineSemaphore->pNext = nullptr;
+        AddToFeatures(features.get(), deviceFeatures.timelineSemaphore.get());
+    }
+    #endif
+    return *this;
+}
+
+ContextDesc& ContextDesc::EnablePipelineCache(const std::string& path) {
+    pipelineCachePath = path;
     return *this;
 }
 
@@ -296,6 +327,18 @@ bool ContextDesc::IsBufferDeviceAddressEnabled() const {
     #endif
 }
 
+bool ContextDesc::IsDrawIndirectCountEnabled() const {
+    return deviceExtensions.find(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) != deviceExtensions.end();
+}
+
+bool ContextDesc::IsTimelineSemaphoreEnabled() const {
+    #ifdef SLIM_USE_VK_FEATURES
+    return vk12features->timelineSemaphore;
+    #else
+    return deviceFeatures.timelineSemaphore.get() != nullptr;
+    #endif
+}
+
 Context::Context(const ContextDesc& desc) : desc(desc) {
     // initialize glfw
     if (desc.present) {
@@ -520,6 +563,38 @@ void Context::InitPhysicalDevice(const ContextDesc &desc) {
         std::cerr << "[ERROR] FAILED TO FIND A SUITABLE GPU" << std::endl;
         throw std::runtime_error("Failed to find a suitable GPU!");
     }
+
+    // cache device limits (alignments, timestamp period, etc)
+    vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
+
+    // timeline semaphore is core but optional before vulkan 1.2, it is enabled where supported,
+    // the chain of the desc is shared with its copies, so the feature is chained in front of it instead
+    timelineSemaphore = desc.IsTimelineSemaphoreEnabled();
+    #ifndef SLIM_USE_VK_FEATURES
+    if (!timelineSemaphore && physicalDeviceProperties.apiVersion >= VK_API_VERSION_1_2) {
+        VkPhysicalDeviceTimelineSemaphoreFeatures supported = {};
+        supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+
+        VkPhysicalDeviceFeatures2 features = {};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &supported;
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+        if (supported.timelineSemaphore) {
+            timelineSemaphore = true;
+            timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+            timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+            timelineSemaphoreFeatures.pNext = this->desc.features.get();
+        }
+    }
+    #endif
+}
+
+const void* Context::GetDeviceFeatures() const {
+    if (timelineSemaphoreFeatures.timelineSemaphore) {
+        return &timelineSemaphoreFeatures;
+    }
+    return desc.features.get();
 }
 
 VkPhysicalDeviceRayTracingPipelinePropertiesKHR Context::GetRayTracingPipelineProperties() {
@@ -45,6 +45,11 @@ namespace slim {
         ContextDesc& EnableRayQuery();
         ContextDesc& EnableBufferDeviceAddress();
         ContextDesc& EnableMultiDraw();
+        ContextDesc& EnableDrawIndirectCount();
+        ContextDesc& EnableTimelineSemaphore();
+
+        // persist driver pipeline cache to disk between runs
+        ContextDesc& EnablePipelineCache(const std::string& path = "pipeline.cache");
 
         // allow finer-grain tuning by users
         VkPhysicalDeviceFeatures&         GetVulkan10Features() { return features->features; }
@@ -52,6 +57,8 @@ namespace slim {
         VkPhysicalDeviceVulkan12Features& GetVulkan12Features() { return *vk12features;      }
 
         bool IsBufferDeviceAddressEnabled() const;
+        bool IsDrawIndirectCountEnabled() const;
+        bool IsTimelineSemaphoreEnabled() const;
 
     private:
         void PrepareForGlfw();
@@ -65,6 +72,7 @@ namespace slim {
         bool compute = false;
         bool present = false;
         bool verbose = false;
+        std::string pipelineCachePath = "";
 
         // physical device features
         std::shared_ptr<VkPhysicalDeviceFeatures2> features = {};
@@ -79,6 +87,7 @@ namespace slim {
             std::shared_ptr<VkPhysicalDeviceRayTracingPipelineFeaturesKHR> rayTracingPipeline;
             std::shared_ptr<VkPhysicalDeviceRayQueryFeaturesKHR> rayQuery;
             std::shared_ptr<VkPhysicalDeviceHostQueryResetFeatures> hostQueryReset;
+            std::shared_ptr<VkPhysicalDeviceTimelineSemaphoreFeatures> timelineSemaphore;
         } deviceFeatures;
         struct {
             std::shared_ptr<VkPhysicalDeviceSubgroupProperties> subgroup;
@@ -103,6 +112,14 @@ namespace slim {
         VkSurfaceKHR GetSurface() const { return surface; }
         const ContextDesc& GetDescription() const { return desc; }
 
+        const VkPhysicalDeviceProperties& GetPhysicalDeviceProperties() const { return physicalDeviceProperties; }
+
+        // timeline semaphores are enabled when requested, or when the physical device supports them
+        bool IsTimelineSemaphoreEnabled() const { return timelineSemaphore; }
+
+        // head of the feature chain passed to device creation
+        const void* GetDeviceFeatures() const;
+
         VkPhysicalDeviceRayTracingPipelinePropertiesKHR
             GetRayTracingPipelineProperties();
 
@@ -118,6 +135,11 @@ namespace slim {
         VkDebugUtilsMessengerEXT debugMessenger = VK_NULL_HANDLE;
         VkSurfaceKHR             surface        = VK_NULL_HANDLE;
         VkPhysicalDevice         physicalDevice = VK_NULL_HANDLE;
+        VkPhysicalDeviceProperties physicalDeviceProperties = {};
+
+        // timeline semaphore feature enabled by support, chained in front of the requested features
+        bool                     timelineSemaphore = false;
+        VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures = {};
 
         std::vector<const char*> instanceExtensions;
         std::vector<const char*> deviceExtensions;
@@ -145,6 +145,14 @@ void Descriptor::SetTextures(const std::string &name, const std::vector<Image*>
     }
 }
 
+void Descriptor::SetTexture(const std::string &name, Image *image, Sampler *sampler, uint32_t mipLevel) {
+    VkDescriptorImageInfo imageInfo = {};
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfo.imageView = image->AsMipLevel(mipLevel);
+    imageInfo.sampler = *sampler;
+    SetImage(name, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, imageInfo);
+}
+
 void Descriptor::SetSampledImage(const std::string &name, Image *image) {
     SetSampledImages(name, { image });
 }
@@ -225,6 +233,14 @@ void Descriptor::SetStorageImages(const std::string &name, const std::vector<Ima
     }
 }
 
+void Descriptor::SetStorageImage(const std::string &name, Image *image, uint32_t mipLevel) {
+    VkDescriptorImageInfo imageInfo = {};
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    imageInfo.imageView = image->AsMipLevel(mipLevel);
+    imageInfo.sampler = nullptr;
+    SetImage(name, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, imageInfo);
+}
+
 void Descriptor::SetSampler(const std::string &name, Sampler *sampler) {
     SetSamplers(name, { sampler });
 }
@@ -322,6 +338,10 @@ void Descriptor::SetDynamicUniformBuffer(const std::string &name, const BufferAl
     SetBuffer(name, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, { alloc });
 }
 
+void Descriptor::SetDynamicUniformBuffer(const std::string &name, const BufferAlloc& alloc, size_t elemSize) {
+    SetBuffer(name, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, { BufferAlloc(alloc.buffer, alloc.offset, elemSize) });
+}
+
 void Descriptor::SetStorageBuffer(const std::string &name, Buffer* buffer) {
     SetBuffer(name, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, { BufferAlloc(buffer) });
 }
@@ -341,14 +361,19 @@ void Descriptor::SetBuffer(const std::string &name, VkDescriptorType descriptorT
     auto& infos = bufferInfos.back();
     infos.reserve(bufferAllocs.size());
 
-    // flush buffer
+    bool dynamic = descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC
+                || descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+
+    // flush buffer (only the sub-allocated range)
     for (const auto& alloc : bufferAllocs) {
-        alloc.buffer->Flush();
         VkDescriptorBufferInfo info = {};
         info.buffer = *alloc.buffer;
         info.offset = alloc.offset;
         info.range = alloc.size == 0 ? alloc.buffer->Size() : alloc.size;
         infos.push_back(info);
+
+        // dynamic offsets could index beyond the bound range
+        alloc.buffer->Flush(info.offset, dynamic ? alloc.buffer->Size() - info.offset : info.range);
     }
 
     VkWriteDescriptorSet update = {};
@@ -372,6 +397,32 @@ void Descriptor::SetBuffer(const std::string &name, VkDescriptorType descriptorT
     }
 }
 
+void Descriptor::SetImage(const std::string &name, VkDescriptorType descriptorType, const VkDescriptorImageInfo &imageInfo) {
+    auto [set, binding, flags] = FindDescriptorSet(name);
+
+    imageInfos.push_back(std::vector<VkDescriptorImageInfo> { imageInfo });
+    auto& infos = imageInfos.back();
+
+    VkWriteDescriptorSet update = {};
+    update.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    update.pNext = nullptr;
+    update.descriptorType = descriptorType;
+    update.dstSet = VK_NULL_HANDLE;
+    update.dstBinding = binding;
+    update.dstArrayElement = 0;
+    update.descriptorCount = infos.size();
+    update.pImageInfo = infos.data();
+    update.pBufferInfo = nullptr;
+    update.pTexelBufferView = nullptr;
+
+    writes.push_back(update);
+    writeDescriptorSets.push_back(set);
+
+    if ((flags & VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT) != 0U) {
+        variableDescriptorCounts[set] = std::max(1u, variableDescriptorCounts[set]);
+    }
+}
+
 void Descriptor::SetDynamicOffset(const std::string &name, uint32_t offset) {
     auto [set, binding, _] = FindDescriptorSet(name);
     SetDynamicOffset(set, binding, offset);
@@ -504,4 +555,3 @@ VkDescriptorSet DescriptorPool::Request(VkDescriptorSetLayout layout, uint32_t v
     poolSetCounts[poolIndex]++;
     return descriptorSet;
 }
-
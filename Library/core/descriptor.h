@@ -30,6 +30,7 @@ namespace slim {
         // NOTE: size is for each individual uniform element in the buffer
         void SetDynamicUniformBuffer(const std::string& name, Buffer* buffer, size_t elemSize);
         void SetDynamicUniformBuffer(const std::string& name, const BufferAlloc& bufferAlloc);
+        void SetDynamicUniformBuffer(const std::string& name, const BufferAlloc& bufferAlloc, size_t elemSize);
 
         // binding a storage buffer, with offset and size for the target buffer
         void SetStorageBuffer(const std::string& name, Buffer* buffer);
@@ -39,6 +40,7 @@ namespace slim {
         // binding a combined image + sampler
         void SetTexture(const std::string& name, Image* image, Sampler* sampler);
         void SetTextures(const std::string& name, const std::vector<Image*>& images, const std::vector<Sampler*>& samplers);
+        void SetTexture(const std::string& name, Image* image, Sampler* sampler, uint32_t mipLevel);  // single mip level
 
         // binding an input attachment
         void SetInputAttachment(const std::string& name, Image* image);
@@ -50,6 +52,7 @@ namespace slim {
         // binding image uniform
         void SetStorageImage(const std::string& name, Image* image);
         void SetStorageImages(const std::string& name, const std::vector<Image*>& images);
+        void SetStorageImage(const std::string& name, Image* image, uint32_t mipLevel);                // single mip level
 
         // binding sampler uniform
         void SetSampler(const std::string& name, Sampler* sampler);
@@ -64,10 +67,14 @@ namespace slim {
 
         void SetDynamicOffset(const std::string &name, uint32_t offset);
         void SetDynamicOffset(uint32_t set, uint32_t binding, uint32_t offset);
-    private:
+
+        // write pending bindings, done automatically on bind,
+        // call it up front when the descriptor is bound from several threads
         void Update();
+    private:
         std::tuple<uint32_t, uint32_t, VkDescriptorBindingFlags> FindDescriptorSet(const std::string &name);
         void SetBuffer(const std::string &name, VkDescriptorType descriptorType, const std::vector<BufferAlloc> &bufferAlloc);
+        void SetImage(const std::string &name, VkDescriptorType descriptorType, const VkDescriptorImageInfo &imageInfo);
     private:
         SmartPtr<DescriptorPool> pool;
         SmartPtr<PipelineLayout> pipelineLayout;
@@ -1,7 +1,12 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include "core/device.h"
 #include "core/debug.h"
 #include "core/commands.h"
 #include "core/buffer.h"
+#include "core/upload.h"
 #include "core/acceleration.h"
 #include "core/renderframe.h"
 
@@ -10,11 +15,22 @@ using namespace slim;
 Device::Device(Context *context) : context(context) {
     InitLogicalDevice();
     InitMemoryAllocator();
+    InitPipelineCache();
 }
 
 Device::~Device() {
+    // queued jobs may still record or upload
+    jobSystem.reset(nullptr);
+
     WaitIdle();
 
+    // persist and clean up pipeline cache
+    if (pipelineCache) {
+        SavePipelineCache();
+        deviceTable.vkDestroyPipelineCache(handle, pipelineCache, nullptr);
+        pipelineCache = VK_NULL_HANDLE;
+    }
+
     // clean up memory allocator
     if (allocator) {
         vmaDestroyAllocator(allocator);
@@ -95,16 +111,30 @@ void Device::InitLogicalDevice() {
     if (queueFamilyIndices.compute.has_value()) uniqueQueueFamilies.insert(queueFamilyIndices.compute.value());
     if (queueFamilyIndices.graphics.has_value()) uniqueQueueFamilies.insert(queueFamilyIndices.graphics.value());
     if (queueFamilyIndices.present.has_value()) uniqueQueueFamilies.insert(queueFamilyIndices.present.value());
+    if (queueFamilyIndices.transfer.has_value()) uniqueQueueFamilies.insert(queueFamilyIndices.transfer.value());
+    if (queueFamilyIndices.dedicatedTransfer.has_value()) uniqueQueueFamilies.insert(queueFamilyIndices.dedicatedTransfer.value());
+
+    // when compute shares the graphics family, a second queue from that family is used for compute,
+    // so that compute work could overlap graphics work without queue family ownership transfers
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+    if (queueFamilyIndices.compute.has_value() && queueFamilyIndices.compute == queueFamilyIndices.graphics) {
+        if (queueFamilies[queueFamilyIndices.compute.value()].queueCount > 1) {
+            computeQueueIndex = 1;
+        }
+    }
 
     // prepare queue infos
-    float queuePriority = 1.0f;
+    float queuePriorities[] = { 1.0f, 1.0f };
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     for (uint32_t index : uniqueQueueFamilies) {
         VkDeviceQueueCreateInfo queueCreateInfo = {};
         queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
         queueCreateInfo.queueFamilyIndex = index;
-        queueCreateInfo.queueCount = 1;
-        queueCreateInfo.pQueuePriorities = &queuePriority;
+        queueCreateInfo.queueCount = (queueFamilyIndices.compute == index) ? computeQueueIndex + 1 : 1;
+        queueCreateInfo.pQueuePriorities = queuePriorities;
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
@@ -116,7 +146,7 @@ void Device::InitLogicalDevice() {
     createInfo.pEnabledFeatures = nullptr;
     createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
     createInfo.ppEnabledExtensionNames = deviceExtensions.data();
-    createInfo.pNext = desc.features.get();
+    createInfo.pNext = context->GetDeviceFeatures();
 
     // enable validation if needed
     if (desc.validation) {
@@ -132,7 +162,7 @@ void Device::InitLogicalDevice() {
 
     // retrieve compute queue if necessary
     if (queueFamilyIndices.compute.has_value()) {
-        vkGetDeviceQueue(handle, queueFamilyIndices.compute.value(), 0, &computeQueue);
+        vkGetDeviceQueue(handle, queueFamilyIndices.compute.value(), computeQueueIndex, &computeQueue);
     }
 
     // retrieve graphics queue if necessary
@@ -202,6 +232,74 @@ void Device::InitMemoryAllocator() {
     ErrorCheck(vmaCreateAllocator(&allocatorInfo, &allocator), "create vma allocator");
 }
 
+void Device::InitPipelineCache() {
+    const std::string& path = context->GetDescription().pipelineCachePath;
+    const VkPhysicalDeviceProperties& properties = context->GetPhysicalDeviceProperties();
+
+    // load cache data from previous runs
+    std::vector<uint8_t> data;
+    if (!path.empty()) {
+        std::ifstream file(path, std::ios::in | std::ios::binary | std::ios::ate);
+        if (file.good()) {
+            data.resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0, std::ios::beg);
+            file.read(reinterpret_cast<char*>(data.data()), data.size());
+        }
+    }
+
+    // discard cache data produced by a different driver or device
+    if (!data.empty()) {
+        VkPipelineCacheHeaderVersionOne header = {};
+        bool valid = data.size() >= sizeof(header);
+        if (valid) {
+            memcpy(&header, data.data(), sizeof(header));
+            valid = header.headerSize >= sizeof(header)
+                 && header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+                 && header.vendorID == properties.vendorID
+                 && header.deviceID == properties.deviceID
+                 && memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+        }
+        if (!valid) {
+            if (context->GetDescription().verbose) {
+                std::cout << "[Device] discard incompatible pipeline cache: " << path << std::endl;
+            }
+            data.clear();
+        }
+    }
+
+    VkPipelineCacheCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    createInfo.initialDataSize = data.size();
+    createInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+    ErrorCheck(deviceTable.vkCreatePipelineCache(handle, &createInfo, nullptr, &pipelineCache), "create pipeline cache");
+}
+
+void Device::SavePipelineCache() const {
+    const std::string& path = context->GetDescription().pipelineCachePath;
+    if (path.empty() || !pipelineCache) {
+        return;
+    }
+
+    size_t size = 0;
+    ErrorCheck(deviceTable.vkGetPipelineCacheData(handle, pipelineCache, &size, nullptr), "query pipeline cache size");
+    std::vector<uint8_t> data(size);
+    ErrorCheck(deviceTable.vkGetPipelineCacheData(handle, pipelineCache, &size, data.data()), "get pipeline cache data");
+
+    // write to a temporary file first, so an interrupted save never leaves a truncated cache behind
+    std::string temp = path + ".tmp";
+    {
+        std::ofstream file(temp, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!file.good()) {
+            std::cerr << "[Device] failed to save pipeline cache: " << path << std::endl;
+            return;
+        }
+        file.write(reinterpret_cast<const char*>(data.data()), size);
+    }
+    std::remove(path.c_str());
+    std::rename(temp.c_str(), path.c_str());
+}
+
 void Device::WaitIdle() const {
     ErrorCheck(deviceTable.vkDeviceWaitIdle(handle), "device wait idle");
 }
@@ -234,6 +332,49 @@ QueueFamilyIndices Device::GetQueueFamilyIndices() const {
     return queueFamilyIndices;
 }
 
+bool Device::SupportsAsyncCompute() const {
+    return computeQueue != graphicsQueue && queueFamilyIndices.compute == queueFamilyIndices.graphics;
+}
+
+JobSystem* Device::GetJobSystem() const {
+    std::call_once(jobSystemOnce, [this]() {
+        jobSystem = SlimPtr<JobSystem>();
+    });
+    return jobSystem;
+}
+
+void Device::AcquireUploads(CommandBuffer *commandBuffer, VkQueueFlagBits queue) const {
+    uint32_t queueFamily = 0;
+    switch (queue) {
+        case VK_QUEUE_COMPUTE_BIT:
+            queueFamily = queueFamilyIndices.compute.value();
+            break;
+        case VK_QUEUE_GRAPHICS_BIT:
+            queueFamily = queueFamilyIndices.graphics.value();
+            break;
+        case VK_QUEUE_TRANSFER_BIT:
+            queueFamily = queueFamilyIndices.transfer.value();
+            break;
+        default:
+            throw std::runtime_error("invalid queue for acquiring uploads");
+    }
+
+    std::lock_guard<std::mutex> lock(uploadMutex);
+    for (UploadManager *uploader : uploadManagers) {
+        uploader->AcquirePending(commandBuffer, queueFamily);
+    }
+}
+
+void Device::RegisterUploadManager(UploadManager *uploader) {
+    std::lock_guard<std::mutex> lock(uploadMutex);
+    uploadManagers.push_back(uploader);
+}
+
+void Device::UnregisterUploadManager(UploadManager *uploader) {
+    std::lock_guard<std::mutex> lock(uploadMutex);
+    uploadManagers.erase(std::remove(uploadManagers.begin(), uploadManagers.end(), uploader), uploadManagers.end());
+}
+
 VkDeviceAddress Device::GetDeviceAddress(Buffer* buffer) const {
     VkBufferDeviceAddressInfo info = {};
     info.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
@@ -252,6 +393,7 @@ void Device::Execute(std::function<void(CommandBuffer*)> callback, VkQueueFlagBi
     RenderFrame frame(this);
     auto commandBuffer = frame.RequestCommandBuffer(queue);
     commandBuffer->Begin();
+    AcquireUploads(commandBuffer, queue);
     callback(commandBuffer);
     commandBuffer->End();
     commandBuffer->Submit();
@@ -263,6 +405,7 @@ void Device::Execute(std::function<void(RenderFrame*, CommandBuffer*)> callback,
     auto commandBuffer = frame.RequestCommandBuffer(queue);
     auto renderFrame = SlimPtr<RenderFrame>(this);
     commandBuffer->Begin();
+    AcquireUploads(commandBuffer, queue);
     callback(renderFrame.get(), commandBuffer);
     commandBuffer->End();
     commandBuffer->Submit();
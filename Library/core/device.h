@@ -1,11 +1,13 @@
 #ifndef SLIM_CORE_DEVICE_H
 #define SLIM_CORE_DEVICE_H
 
+#include <mutex>
 #include <string>
 #include <vector>
 #include <iostream>
 #include <functional>
 
+#include "core/jobs.h"
 #include "core/vulkan.h"
 #include "core/vkutils.h"
 #include "core/context.h"
@@ -20,6 +22,7 @@ namespace slim {
     class Sampler;
     class CommandBuffer;
     class RenderFrame;
+    class UploadManager;
     namespace accel {
         class AccelStruct;
     };
@@ -33,6 +36,7 @@ namespace slim {
      * 6. swapchain creation (optional, if WindowDesc is provided)
      **/
     class Device final : public NotCopyable, public NotMovable, public ReferenceCountable, public TriviallyConvertible<VkDevice> {
+        friend class UploadManager;
     public:
         explicit Device(Context *context);
         virtual ~Device();
@@ -42,7 +46,10 @@ namespace slim {
 
         Context*           GetContext() const;
         VmaAllocator       GetMemoryAllocator() const;
+        VkPipelineCache    GetPipelineCache() const { return pipelineCache; }
+        void               SavePipelineCache() const;
         QueueFamilyIndices GetQueueFamilyIndices() const;
+        bool               SupportsAsyncCompute() const;
         void               Execute(std::function<void(CommandBuffer*)> callback,
                                    VkQueueFlagBits queue = VK_QUEUE_TRANSFER_BIT);
         void               Execute(std::function<void(RenderFrame *, CommandBuffer*)> callback,
@@ -50,10 +57,19 @@ namespace slim {
 
         bool               IsDebuggerEnabled() const { return debugExtPresent; }
         VkQueue            GetComputeQueue() const { return computeQueue; }
+        uint32_t           GetComputeQueueIndex() const { return computeQueueIndex; }
         VkQueue            GetGraphicsQueue() const { return graphicsQueue; }
         VkQueue            GetPresentQueue() const { return presentQueue; }
         VkQueue            GetTransferQueue() const { return transferQueue; }
 
+        // worker pool shared by CPU work of this device, created on first use,
+        // RenderFrame::RequestThreadCommandPool() is indexed by JobSystem::GetThreadIndex()
+        JobSystem*         GetJobSystem() const;
+
+        // make the command buffer wait for uploads submitted by upload managers of this device,
+        // uploaded resources are acquired when the command buffer runs on the graphics queue
+        void               AcquireUploads(CommandBuffer *commandBuffer, VkQueueFlagBits queue = VK_QUEUE_GRAPHICS_BIT) const;
+
         VkDeviceAddress    GetDeviceAddress(Buffer* buffer) const;
         VkDeviceAddress    GetDeviceAddress(accel::AccelStruct* as) const;
 
@@ -64,12 +80,17 @@ namespace slim {
     private:
         void InitLogicalDevice();
         void InitMemoryAllocator();
+        void InitPipelineCache();
+
+        void RegisterUploadManager(UploadManager *uploader);
+        void UnregisterUploadManager(UploadManager *uploader);
 
     private:
         SmartPtr<Context> context;
         bool debugExtPresent = false;
 
         VmaAllocator               allocator      = VK_NULL_HANDLE;
+        VkPipelineCache            pipelineCache  = VK_NULL_HANDLE;
 
         // device queues
         QueueFamilyIndices         queueFamilyIndices;
@@ -77,6 +98,15 @@ namespace slim {
         VkQueue                    computeQueue          = VK_NULL_HANDLE;
         VkQueue                    presentQueue          = VK_NULL_HANDLE;
         VkQueue                    transferQueue         = VK_NULL_HANDLE;
+        uint32_t                   computeQueueIndex     = 0;
+
+        // cpu workers
+        mutable std::once_flag     jobSystemOnce;
+        mutable SmartPtr<JobSystem> jobSystem;
+
+        // live upload managers, their submitted uploads are acquired by frames
+        mutable std::mutex          uploadMutex;
+        std::vector<UploadManager*> uploadManagers;
     };
 
 } // end of namespace slim
@@ -2,6 +2,8 @@
 #define SLIM_CORE_HASHER_H
 
 #include <memory>
+#include <string>
+#include <type_traits>
 
 namespace slim {
 
@@ -19,6 +21,33 @@ namespace slim {
         return seed;
     }
 
+    // StructuralKey appends the bytes of plain values and strings into one string, so that structures
+    // keyed by hash can also be compared exactly (a hash collision must not alias two different keys)
+    class StructuralKey {
+    public:
+        template <class Arg>
+        void Add(const Arg &v) {
+            static_assert(std::is_trivially_copyable<Arg>::value, "only plain values are added by bytes");
+            key.append(reinterpret_cast<const char*>(&v), sizeof(Arg));
+        }
+
+        void Add(const std::string &v) {
+            Add(v.size());
+            key.append(v);
+        }
+
+        template <class Arg0, class ...Arg1>
+        void Add(const Arg0 &v, const Arg1&...rest) {
+            Add(v);
+            Add(rest...);
+        }
+
+        const std::string& Get() const { return key; }
+
+    private:
+        std::string key;
+    };
+
     struct PairHash {
         template <class T1, class T2>
         std::size_t operator()(const std::pair<T1, T2> &p) const {
@@ -1,3 +1,5 @@
+#include <map>
+#include <algorithm>
 #include "core/debug.h"
 #include "core/image.h"
 #include "core/renderpass.h"
@@ -59,29 +61,7 @@ Image::Image(Device* device,
              VkSharingMode sharingMode)
     : device(device), allocator(device->GetMemoryAllocator()) {
 
-    VkImageType imageType = VK_IMAGE_TYPE_1D;
-    if (extent.height > 1) imageType = VK_IMAGE_TYPE_2D;
-    if (extent.depth  > 1) imageType = VK_IMAGE_TYPE_3D;
-
-    createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    createInfo.pNext = nullptr;
-    createInfo.imageType = imageType;
-    createInfo.format = format;
-    createInfo.extent = extent;
-    createInfo.mipLevels = mipLevels;
-    createInfo.arrayLayers = arrayLayers;
-    createInfo.samples = samples;
-    createInfo.tiling = tiling;
-    createInfo.usage = imageUsage | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-    createInfo.sharingMode = sharingMode;
-    createInfo.queueFamilyIndexCount = 0;
-    createInfo.pQueueFamilyIndices = nullptr;
-    createInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    createInfo.flags = 0;
-
-    if (imageType == VK_IMAGE_TYPE_2D && arrayLayers == 6) {
-        createInfo.flags |= VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
-    }
+    createInfo = MakeCreateInfo(format, extent, mipLevels, arrayLayers, samples, imageUsage, tiling, sharingMode);
 
     VmaAllocationCreateInfo allocCreateInfo = {};
     allocCreateInfo.usage = memoryUsage;
@@ -142,6 +122,22 @@ Image::Image(Device* device,
             layout.push_back(VK_IMAGE_LAYOUT_UNDEFINED);
 }
 
+Image::Image(Device* device,
+             const VkImageCreateInfo& createInfo,
+             VmaAllocation allocation,
+             VkDeviceSize offset)
+    : device(device), allocation(allocation), createInfo(createInfo), aliased(true) {
+
+    ErrorCheck(DeviceDispatch(vkCreateImage(*device, &createInfo, nullptr, &handle)), "create aliased image");
+    ErrorCheck(vmaBindImageMemory2(device->GetMemoryAllocator(), allocation, offset, handle, nullptr), "bind aliased image memory");
+
+    // initialize image layout for each slice
+    layouts.resize(createInfo.arrayLayers);
+    for (auto &layout : layouts)
+        for (uint32_t i = 0; i < createInfo.mipLevels; i++)
+            layout.push_back(VK_IMAGE_LAYOUT_UNDEFINED);
+}
+
 Image::~Image() {
     #define DESTROY_VIEW(view)                                      \
     if (view) {                                                     \
@@ -154,14 +150,56 @@ Image::~Image() {
     DESTROY_VIEW(stencilView);
     DESTROY_VIEW(depthStencilView);
     #undef DESTROY_VIEW
+    for (VkImageView view : mipViews) {
+        if (view) vkDestroyImageView(*device, view, nullptr);
+    }
+    mipViews.clear();
 
     if (allocator) {
         vmaDestroyImage(allocator, handle, allocation);
         allocator = VK_NULL_HANDLE;
+    } else if (aliased) {
+        // memory is owned by the aliasing heap
+        DeviceDispatch(vkDestroyImage(*device, handle, nullptr));
     }
     handle = VK_NULL_HANDLE;
 }
 
+VkImageCreateInfo Image::MakeCreateInfo(VkFormat format,
+                                        VkExtent3D extent,
+                                        uint32_t mipLevels,
+                                        uint32_t arrayLayers,
+                                        VkSampleCountFlagBits samples,
+                                        VkImageUsageFlags imageUsage,
+                                        VkImageTiling tiling,
+                                        VkSharingMode sharingMode) {
+    VkImageType imageType = VK_IMAGE_TYPE_1D;
+    if (extent.height > 1) imageType = VK_IMAGE_TYPE_2D;
+    if (extent.depth  > 1) imageType = VK_IMAGE_TYPE_3D;
+
+    VkImageCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    createInfo.pNext = nullptr;
+    createInfo.imageType = imageType;
+    createInfo.format = format;
+    createInfo.extent = extent;
+    createInfo.mipLevels = mipLevels;
+    createInfo.arrayLayers = arrayLayers;
+    createInfo.samples = samples;
+    createInfo.tiling = tiling;
+    createInfo.usage = imageUsage | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    createInfo.sharingMode = sharingMode;
+    createInfo.queueFamilyIndexCount = 0;
+    createInfo.pQueueFamilyIndices = nullptr;
+    createInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    createInfo.flags = 0;
+
+    if (imageType == VK_IMAGE_TYPE_2D && arrayLayers == 6) {
+        createInfo.flags |= VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
+    }
+    return createInfo;
+}
+
 void Image::SetName(const std::string& name) const {
     if (device->IsDebuggerEnabled()) {
         VkDebugMarkerObjectNameInfoEXT nameInfo = {};
@@ -290,3 +328,169 @@ VkImageView Image::AsAutomaticView() const {
         return AsTexture();
     }
 }
+
+VkImageView Image::AsMipLevel(uint32_t mipLevel) const {
+    if (mipViews.empty()) {
+        mipViews.resize(createInfo.mipLevels, VK_NULL_HANDLE);
+    }
+    if (!mipViews[mipLevel]) {
+        VkImageViewCreateInfo viewCreateInfo = {};
+        viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewCreateInfo.image = handle;
+        viewCreateInfo.format = createInfo.format;
+        viewCreateInfo.viewType = InferImageViewType(createInfo);
+        viewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+        viewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+        viewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+        viewCreateInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+        viewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewCreateInfo.subresourceRange.baseArrayLayer = 0;
+        viewCreateInfo.subresourceRange.layerCount = createInfo.arrayLayers;
+        viewCreateInfo.subresourceRange.baseMipLevel = mipLevel;
+        viewCreateInfo.subresourceRange.levelCount = 1;
+        ErrorCheck(DeviceDispatch(vkCreateImageView(*device, &viewCreateInfo, nullptr, &mipViews[mipLevel])), "create mip level view");
+    }
+    return mipViews[mipLevel];
+}
+
+AliasedImages::~AliasedImages() {
+    // destroy images before releasing the memory they are bound to
+    images.clear();
+    VmaAllocator allocator = device->GetMemoryAllocator();
+    for (VmaAllocation heap : heaps) {
+        vmaFreeMemory(allocator, heap);
+    }
+}
+
+AliasingImagePool::AliasingImagePool(Device* device) : device(device) {
+}
+
+void AliasingImagePool::Clear() {
+    for (auto &kv : cache) {
+        retired.push_back(kv.second);
+    }
+    cache.clear();
+}
+
+AliasedImages* AliasingImagePool::Request(const std::vector<TransientImageDesc>& descs) {
+    // placements are keyed by the exact descs, fields are added one by one to skip struct padding
+    StructuralKey key;
+    for (const auto& desc : descs) {
+        key.Add(desc.format, desc.extent.width, desc.extent.height,
+                desc.mipLevels, desc.arrayLayers, desc.samples, desc.imageUsage,
+                desc.firstUse, desc.lastUse);
+    }
+
+    auto it = cache.find(key.Get());
+    if (it != cache.end()) {
+        return it->second;
+    }
+
+    auto result = SlimPtr<AliasedImages>(device);
+    Place(descs, *result);
+    cache.insert(std::make_pair(key.Get(), result));
+    return result;
+}
+
+void AliasingImagePool::Place(const std::vector<TransientImageDesc>& descs, AliasedImages& result) {
+    const size_t count = descs.size();
+    VmaAllocator allocator = device->GetMemoryAllocator();
+
+    auto overlapLifetime = [&](size_t i, size_t j) {
+        return !(descs[i].lastUse < descs[j].firstUse || descs[j].lastUse < descs[i].firstUse);
+    };
+
+    // query memory requirements with temporary images
+    std::vector<VkImageCreateInfo> createInfos(count);
+    std::vector<VkMemoryRequirements> requirements(count);
+    for (size_t i = 0; i < count; i++) {
+        const TransientImageDesc& desc = descs[i];
+        createInfos[i] = Image::MakeCreateInfo(desc.format,
+                                               VkExtent3D { desc.extent.width, desc.extent.height, 1 },
+                                               desc.mipLevels, desc.arrayLayers,
+                                               desc.samples, desc.imageUsage);
+        VkImage image = VK_NULL_HANDLE;
+        ErrorCheck(DeviceDispatch(vkCreateImage(*device, &createInfos[i], nullptr, &image)), "create image");
+        DeviceDispatch(vkGetImageMemoryRequirements(*device, image, &requirements[i]));
+        DeviceDispatch(vkDestroyImage(*device, image, nullptr));
+        result.stats.unaliasedSize += requirements[i].size;
+    }
+
+    // images can only share a heap when they accept the same memory types
+    std::map<uint32_t, std::vector<size_t>> groups;
+    for (size_t i = 0; i < count; i++) {
+        groups[requirements[i].memoryTypeBits].push_back(i);
+    }
+
+    std::vector<VkDeviceSize> offsets(count, 0);
+    result.images.resize(count);
+    result.aliased.resize(count, false);
+
+    for (auto& [memoryTypeBits, indices] : groups) {
+        // greedy by size: place larger images first,
+        // each at the lowest offset not overlapping with any placed image alive at the same time
+        std::stable_sort(indices.begin(), indices.end(), [&](size_t a, size_t b) {
+            return requirements[a].size > requirements[b].size;
+        });
+
+        VkDeviceSize heapSize = 0;
+        VkDeviceSize heapAlignment = 1;
+        std::vector<size_t> placed;
+        for (size_t i : indices) {
+            std::vector<size_t> conflicts;
+            for (size_t j : placed) {
+                if (overlapLifetime(i, j)) conflicts.push_back(j);
+            }
+            std::sort(conflicts.begin(), conflicts.end(), [&](size_t a, size_t b) {
+                return offsets[a] < offsets[b];
+            });
+
+            VkDeviceSize alignment = requirements[i].alignment;
+            VkDeviceSize offset = 0;
+            for (size_t j : conflicts) {
+                if (offset + requirements[i].size <= offsets[j]) break;
+                VkDeviceSize end = offsets[j] + requirements[j].size;
+                offset = std::max(offset, (end + alignment - 1) / alignment * alignment);
+            }
+
+            offsets[i] = offset;
+            placed.push_back(i);
+            heapSize = std::max(heapSize, offset + requirements[i].size);
+            heapAlignment = std::max(heapAlignment, alignment);
+        }
+
+        // images reusing memory of an image from earlier passes need a barrier before first use
+        for (size_t i : indices) {
+            for (size_t j : indices) {
+                if (descs[j].lastUse >= descs[i].firstUse) continue;
+                bool overlapMemory = offsets[i] < offsets[j] + requirements[j].size
+                                  && offsets[j] < offsets[i] + requirements[i].size;
+                if (overlapMemory) {
+                    result.aliased[i] = true;
+                    break;
+                }
+            }
+        }
+
+        VkMemoryRequirements heapRequirements = {};
+        heapRequirements.size = heapSize;
+        heapRequirements.alignment = heapAlignment;
+        heapRequirements.memoryTypeBits = memoryTypeBits;
+
+        VmaAllocationCreateInfo allocCreateInfo = {};
+        allocCreateInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+        VmaAllocation heap = VK_NULL_HANDLE;
+        ErrorCheck(vmaAllocateMemory(allocator, &heapRequirements, &allocCreateInfo, &heap, nullptr), "allocate aliasing heap");
+        result.heaps.push_back(heap);
+
+        for (size_t i : indices) {
+            result.images[i] = SlimPtr<GPUImage>(device, createInfos[i], heap, offsets[i]);
+        }
+
+        result.stats.aliasedSize += heapSize;
+        result.stats.heapCount++;
+    }
+
+    result.stats.imageCount = count;
+}
@@ -133,6 +133,7 @@ namespace slim {
 
     class Image : public NotCopyable, public NotMovable, public ReferenceCountable, public TriviallyConvertible<VkImage> {
         friend class CommandBuffer;
+        friend class UploadManager;
     public:
         explicit Image(Device* device,
                        VkFormat format,
@@ -172,8 +173,23 @@ namespace slim {
                        VkSampleCountFlagBits samples,
                        VkImage image);
 
+        // image placed at an offset of an existing allocation (memory aliasing), memory is owned by the caller
+        explicit Image(Device* device,
+                       const VkImageCreateInfo& createInfo,
+                       VmaAllocation allocation,
+                       VkDeviceSize offset);
+
         virtual ~Image();
 
+        static VkImageCreateInfo MakeCreateInfo(VkFormat format,
+                                                VkExtent3D extent,
+                                                uint32_t mipLevels,
+                                                uint32_t arrayLayers,
+                                                VkSampleCountFlagBits samples,
+                                                VkImageUsageFlags imageUsage,
+                                                VkImageTiling tiling = VK_IMAGE_TILING_OPTIMAL,
+                                                VkSharingMode sharingMode = VK_SHARING_MODE_EXCLUSIVE);
+
         VkExtent3D GetExtent() const { return createInfo.extent; }
 
         uint32_t Layers() const { return createInfo.arrayLayers; }
@@ -197,6 +213,9 @@ namespace slim {
         VkImageView AsDepthStencilBuffer() const;
         VkImageView AsAutomaticView() const;
 
+        // color view of a single mip level, e.g. to write one level of a mip chain as a storage image
+        VkImageView AsMipLevel(uint32_t mipLevel) const;
+
         void SetName(const std::string& name) const;
 
         // NOTE: not intended for manual update
@@ -208,6 +227,7 @@ namespace slim {
         VmaAllocation     allocation;
         VmaAllocationInfo allocInfo;
         VkImageCreateInfo createInfo = {};
+        bool              aliased = false;
 
         // common view types
         mutable VkImageView textureView      = VK_NULL_HANDLE;
@@ -215,6 +235,7 @@ namespace slim {
         mutable VkImageView depthView        = VK_NULL_HANDLE;
         mutable VkImageView stencilView      = VK_NULL_HANDLE;
         mutable VkImageView depthStencilView = VK_NULL_HANDLE;
+        mutable std::vector<VkImageView> mipViews = {};
     };
 
     class ImageUsageBuilder {
@@ -276,11 +297,76 @@ namespace slim {
             : Image(device, format, extent, mipLevels, arrayLayers, samples, image) {
             // do nothing
         }
+
+        ImageBase(Device* device,
+                  const VkImageCreateInfo& createInfo,
+                  VmaAllocation allocation,
+                  VkDeviceSize offset)
+            : Image(device, createInfo, allocation, offset) {
+            // do nothing
+        }
     };
 
     using GPUImage = ImageBase<VMA_MEMORY_USAGE_GPU_ONLY>;
     using CPUImage = ImageBase<VMA_MEMORY_USAGE_CPU_ONLY, VK_IMAGE_TILING_LINEAR>;  // A known limitation on MoltenVK, HOST_COHEERENT image memory is not supported.
 
+    // --------------------------------------------------------
+
+    // TransientImageDesc describes a transient image and the range of passes using it
+    struct TransientImageDesc {
+        VkFormat              format;
+        VkExtent2D            extent;
+        uint32_t              mipLevels;
+        uint32_t              arrayLayers;
+        VkSampleCountFlagBits samples;
+        VkImageUsageFlags     imageUsage;
+        uint32_t              firstUse;
+        uint32_t              lastUse;
+    };
+
+    struct TransientMemoryStats {
+        VkDeviceSize aliasedSize   = 0;     // memory used when images with disjoint lifetimes share memory
+        VkDeviceSize unaliasedSize = 0;     // memory used when every image has its own memory
+        uint32_t     imageCount    = 0;
+        uint32_t     heapCount     = 0;
+    };
+
+    // AliasedImages owns the shared memory its images are bound to, the memory is freed together
+    // with the images once the last reference is gone (e.g. compiled render graphs using them)
+    struct AliasedImages final : public NotCopyable, public NotMovable, public ReferenceCountable {
+        explicit AliasedImages(Device* device) : device(device) { }
+        virtual ~AliasedImages();
+
+        SmartPtr<Device>                device;
+        std::vector<SmartPtr<GPUImage>> images;     // one image for each requested desc
+        std::vector<bool>               aliased;    // image reuses memory of an image used by earlier passes
+        std::vector<VmaAllocation>      heaps;
+        TransientMemoryStats            stats;
+    };
+
+    // AliasingImagePool places transient images with disjoint lifetimes into shared device memory.
+    // Placements are cached by the requested descs, so a graph repeating every frame is placed once.
+    class AliasingImagePool final : public NotCopyable, public NotMovable, public ReferenceCountable {
+    public:
+        explicit AliasingImagePool(Device* device);
+        virtual ~AliasingImagePool() = default;
+        AliasedImages* Request(const std::vector<TransientImageDesc>& descs);
+        size_t Size() const { return cache.size(); }
+
+        // drop the cached placements, commands recorded since the last Reset() may still use them,
+        // so they are kept until the next Reset() and freed after that once nothing else references them
+        void Clear();
+
+        // release placements dropped by Clear(), once commands using them have completed
+        void Reset() { retired.clear(); }
+    private:
+        void Place(const std::vector<TransientImageDesc>& descs, AliasedImages& result);
+    private:
+        SmartPtr<Device> device;
+        std::unordered_map<std::string, SmartPtr<AliasedImages>> cache;
+        std::vector<SmartPtr<AliasedImages>> retired;
+    };
+
 } // end of namespace slim
 
 #endif // end of SLIM_CORE_IMAGE_H
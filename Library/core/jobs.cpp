@@ -0,0 +1,165 @@
+#include "core/jobs.h"
+
+using namespace slim;
+
+namespace {
+
+    // the system a worker belongs to, and its index in that system
+    thread_local const JobSystem* currentSystem = nullptr;
+    thread_local uint32_t currentThread = 0;
+
+} // end of anonymous namespace
+
+JobSystem::JobSystem(uint32_t workers) {
+    // queue 0 is shared by all threads outside of the pool
+    for (uint32_t i = 0; i <= workers; i++) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (uint32_t i = 1; i <= workers; i++) {
+        this->workers.emplace_back(&JobSystem::WorkerMain, this, i);
+    }
+}
+
+JobSystem::~JobSystem() {
+    // workers finish the queued jobs before they exit
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+uint32_t JobSystem::GetDefaultWorkerCount() {
+    uint32_t threads = std::thread::hardware_concurrency();
+    return threads > 1 ? threads - 1 : 0;
+}
+
+uint32_t JobSystem::GetThreadIndex() const {
+    return currentSystem == this ? currentThread : 0;
+}
+
+void JobSystem::Run(JobCounter& counter, std::function<void()> func) {
+    counter.count.fetch_add(1);
+    Enqueue(Job { std::move(func), &counter });
+}
+
+void JobSystem::Run(JobCounter& counter, JobCounter& dependency, std::function<void()> func) {
+    counter.count.fetch_add(1);
+    {
+        // the last job of the dependency releases waiting jobs under the same lock
+        std::lock_guard<std::mutex> lock(dependency.mutex);
+        if (!dependency.IsDone()) {
+            dependency.waiting.push_back(Job { std::move(func), &counter });
+            return;
+        }
+    }
+    Enqueue(Job { std::move(func), &counter });
+}
+
+void JobSystem::Wait(JobCounter& counter) {
+    uint32_t thread = GetThreadIndex();
+    while (!counter.IsDone()) {
+        Job job;
+        if (Dequeue(thread, job)) {
+            Execute(job);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+    // the last job may still hold the lock, after which it no longer touches the counter
+    std::exception_ptr error = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(counter.mutex);
+        std::swap(error, counter.error);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void JobSystem::Enqueue(Job job) {
+    Queue& queue = *queues[GetThreadIndex()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(std::move(job));
+    }
+    queued.fetch_add(1);
+
+    // taking the lock orders the wake up after a sleeping worker checked for jobs
+    { std::lock_guard<std::mutex> lock(sleepMutex); }
+    wake.notify_one();
+}
+
+bool JobSystem::Dequeue(uint32_t thread, Job& job) {
+    // newest job of this thread first, it is the most likely to be in cache
+    {
+        Queue& queue = *queues[thread];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.jobs.empty()) {
+            job = std::move(queue.jobs.back());
+            queue.jobs.pop_back();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+
+    // then the oldest job of another thread, which tends to be the largest piece of work left
+    uint32_t count = GetThreadCount();
+    for (uint32_t i = 1; i < count; i++) {
+        Queue& queue = *queues[(thread + i) % count];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.jobs.empty()) {
+            job = std::move(queue.jobs.front());
+            queue.jobs.pop_front();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::Execute(Job& job) {
+    JobCounter& counter = *job.counter;
+    std::exception_ptr error = nullptr;
+    try {
+        job.func();
+    } catch (...) {
+        error = std::current_exception();
+    }
+    job.func = nullptr;
+
+    std::vector<Job> released;
+    {
+        std::lock_guard<std::mutex> lock(counter.mutex);
+        if (error && !counter.error) {
+            counter.error = error;
+        }
+        if (counter.count.fetch_sub(1) == 1) {
+            released.swap(counter.waiting);
+        }
+    }
+    for (Job& dependent : released) {
+        Enqueue(std::move(dependent));
+    }
+}
+
+void JobSystem::WorkerMain(uint32_t thread) {
+    currentSystem = this;
+    currentThread = thread;
+    while (true) {
+        Job job;
+        if (Dequeue(thread, job)) {
+            Execute(job);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this]() { return stopping || queued.load() > 0; });
+        if (stopping && queued.load() == 0) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,132 @@
+#ifndef SLIM_CORE_JOBS_H
+#define SLIM_CORE_JOBS_H
+
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+
+#include "utility/interface.h"
+
+namespace slim {
+
+    class JobCounter;
+
+    // a job and the counter it finishes
+    struct Job {
+        std::function<void()> func;
+        JobCounter*           counter = nullptr;
+    };
+
+    // JobCounter counts the unfinished jobs run against it. Jobs can be held back until another counter
+    // reaches zero, which is how dependencies are expressed. A counter must outlive its jobs,
+    // JobSystem::Wait() returns once the last job is done with it.
+    class JobCounter final : public NotCopyable, public NotMovable {
+        friend class JobSystem;
+    public:
+        explicit JobCounter() = default;
+        bool IsDone() const { return count.load(std::memory_order_acquire) == 0; }
+
+    private:
+        std::atomic<uint32_t> count = 0;
+        std::mutex            mutex;
+        std::vector<Job>      waiting = {};     // jobs depending on this counter
+        std::exception_ptr    error = nullptr;  // first exception thrown by a job
+    };
+
+    // JobSystem runs jobs on a fixed pool of worker threads. Every thread has its own deque, it takes
+    // its newest job first and steals the oldest jobs of other threads when it runs out.
+    // Threads outside of the pool share one deque, and help with jobs while they wait for a counter.
+    class JobSystem final : public NotCopyable, public NotMovable, public ReferenceCountable {
+    public:
+        // workers in addition to the waiting thread, by default one less than the hardware threads
+        explicit JobSystem(uint32_t workers = GetDefaultWorkerCount());
+        virtual ~JobSystem();
+
+        static uint32_t GetDefaultWorkerCount();
+
+        // workers and the waiting thread, per-thread resources are indexed by GetThreadIndex()
+        uint32_t GetThreadCount() const { return static_cast<uint32_t>(queues.size()); }
+
+        // 1 to GetThreadCount() - 1 on workers of this system, 0 on any other thread,
+        // so per-thread resources of index 0 must only be used by one waiting thread
+        uint32_t GetThreadIndex() const;
+
+        // run a job, counter is incremented now and decremented when the job is done
+        void Run(JobCounter& counter, std::function<void()> func);
+
+        // run a job once dependency reaches zero
+        void Run(JobCounter& counter, JobCounter& dependency, std::function<void()> func);
+
+        // run other jobs until counter reaches zero, rethrows the first exception of its jobs
+        void Wait(JobCounter& counter);
+
+        // call func(begin, end) for ranges of at most grain indices covering [first, last),
+        // the calling thread takes part, a grain of 0 gives each thread a few ranges
+        template <typename Func>
+        void ParallelFor(uint32_t first, uint32_t last, uint32_t grain, Func&& func);
+
+    private:
+        struct Queue {
+            std::mutex      mutex;
+            std::deque<Job> jobs;
+        };
+
+        void Enqueue(Job job);
+        bool Dequeue(uint32_t thread, Job& job);
+        void Execute(Job& job);
+        void WorkerMain(uint32_t thread);
+
+    private:
+        std::vector<std::unique_ptr<Queue>> queues = {};
+        std::vector<std::thread>            workers = {};
+
+        // queued jobs, workers sleep while there are none
+        std::atomic<uint32_t>               queued = 0;
+        std::mutex                          sleepMutex;
+        std::condition_variable             wake;
+        bool                                stopping = false;
+    };
+
+    template <typename Func>
+    void JobSystem::ParallelFor(uint32_t first, uint32_t last, uint32_t grain, Func&& func) {
+        if (first >= last) {
+            return;
+        }
+        uint32_t count = last - first;
+        if (grain == 0) {
+            grain = std::max(count / (GetThreadCount() * 4), 1u);
+        }
+
+        // ranges after the first one are queued, the first one is taken by the calling thread
+        JobCounter counter;
+        uint32_t split = first + std::min(grain, count);
+        for (uint32_t begin = split; begin < last; ) {
+            uint32_t end = begin + std::min(grain, last - begin);
+            Run(counter, [&func, begin, end]() { func(begin, end); });
+            begin = end;
+        }
+
+        // queued ranges reference func and counter, so they are waited for even when the first range throws
+        std::exception_ptr error = nullptr;
+        try {
+            func(first, split);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        Wait(counter);
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+} // end of namespace slim
+
+#endif // end of SLIM_CORE_JOBS_H
@@ -1,4 +1,6 @@
+#include <cstring>
 #include "core/debug.h"
+#include "core/hasher.h"
 #include "core/vkutils.h"
 #include "core/commands.h"
 #include "core/descriptor.h"
@@ -234,11 +236,13 @@ ComputePipelineDesc::ComputePipelineDesc(const std::string &name) : PipelineDesc
 
 ComputePipelineDesc& ComputePipelineDesc::SetPipelineLayout(const PipelineLayoutDesc &layoutDesc) {
     pipelineLayoutDesc = layoutDesc;
+    Invalidate();
     return *this;
 }
 
 ComputePipelineDesc& ComputePipelineDesc::SetComputeShader(Shader* shader) {
     computeShader = shader;
+    Invalidate();
     return *this;
 }
 
@@ -333,40 +337,47 @@ void GraphicsPipelineDesc::InitDepthStencilState() {
 GraphicsPipelineDesc& GraphicsPipelineDesc::SetPrimitive(VkPrimitiveTopology primitive, bool dynamic) {
     inputAssemblyStateCreateInfo.topology = primitive;
     if (dynamic) dynamicStates.push_back(VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT);
+    Invalidate();
     return *this;
 }
 
 GraphicsPipelineDesc& GraphicsPipelineDesc::SetCullMode(VkCullModeFlags cullMode, bool dynamic) {
     rasterizationStateCreateInfo.cullMode = cullMode;
     if (dynamic) dynamicStates.push_back(VK_DYNAMIC_STATE_CULL_MODE_EXT);
+    Invalidate();
     return *this;
 }
 
 GraphicsPipelineDesc& GraphicsPipelineDesc::SetFrontFace(VkFrontFace frontFace, bool dynamic) {
     rasterizationStateCreateInfo.frontFace = frontFace;
     if (dynamic) dynamicStates.push_back(VK_DYNAMIC_STATE_FRONT_FACE_EXT);
+    Invalidate();
     return *this;
 }
 
 GraphicsPipelineDesc& GraphicsPipelineDesc::SetPolygonMode(VkPolygonMode polygonMode) {
     rasterizationStateCreateInfo.polygonMode = polygonMode;
+    Invalidate();
     return *this;
 }
 
 GraphicsPipelineDesc& GraphicsPipelineDesc::SetLineWidth(float lineWidth, bool dynamic) {
     rasterizationStateCreateInfo.lineWidth = lineWidth;
     if (dynamic) dynamicStates.push_back(VK_DYNAMIC_STATE_LINE_WIDTH);
+    Invalidate();
     return *this;
 }
 
 GraphicsPipelineDesc& GraphicsPipelineDesc::SetSampleCount(VkSampleCountFlagBits samples) {
     multisampleStateCreateInfo.rasterizationSamples = samples;
+    Invalidate();
     return *this;
 }
 
 GraphicsPipelineDesc& GraphicsPipelineDesc::SetRasterizationDiscard(bool enable, bool dynamic) {
     rasterizationStateCreateInfo.rasterizerDiscardEnable = enable;
     if (dynamic) dynamicStates.push_back(VK_DYNAMIC_STATE_RASTERIZER_DISCARD_ENABLE_EXT);
+    Invalidate();
     return *this;
 }
 
@@ -374,16 +385,19 @@ GraphicsPipelineDesc& GraphicsPipelineDesc::SetDepthTest(VkCompareOp compare, bo
     depthStencilStateCreateInfo.depthTestEnable = true;
     depthStencilStateCreateInfo.depthWriteEnable = writeEnabled;
     depthStencilStateCreateInfo.depthCompareOp = compare;
+    Invalidate();
     return *this;
 }
 
 GraphicsPipelineDesc& GraphicsPipelineDesc::SetDepthWrite(bool value) {
     depthStencilStateCreateInfo.depthWriteEnable = value;
+    Invalidate();
     return *this;
 }
 
 GraphicsPipelineDesc& GraphicsPipelineDesc::SetDepthClamp(bool enable) {
     rasterizationStateCreateInfo.depthClampEnable = enable;
+    Invalidate();
     return *this;
 }
 
@@ -395,6 +409,7 @@ GraphicsPipelineDesc& GraphicsPipelineDesc::SetDepthBias(float depthBiasConstant
     rasterizationStateCreateInfo.depthBiasSlopeFactor = depthBiasSlopeFactor;
     rasterizationStateCreateInfo.depthBiasClamp = depthBiasClamp;
     if (dynamic) dynamicStates.push_back(VK_DYNAMIC_STATE_DEPTH_BIAS);
+    Invalidate();
     return *this;
 }
 
@@ -402,6 +417,7 @@ GraphicsPipelineDesc& GraphicsPipelineDesc::SetStencilTest(const VkStencilOpStat
     depthStencilStateCreateInfo.stencilTestEnable = VK_TRUE;
     depthStencilStateCreateInfo.front = front;
     depthStencilStateCreateInfo.back = back;
+    Invalidate();
     return *this;
 }
 
@@ -410,6 +426,7 @@ GraphicsPipelineDesc& GraphicsPipelineDesc::SetBlendState(uint32_t index, const
         colorBlendAttachments.resize(index + 1);
     }
     colorBlendAttachments[index] = blendState;
+    Invalidate();
     return *this;
 }
 
@@ -422,6 +439,7 @@ GraphicsPipelineDesc& GraphicsPipelineDesc::SetDefaultBlendState(uint32_t index)
                                                 | VK_COLOR_COMPONENT_G_BIT
                                                 | VK_COLOR_COMPONENT_B_BIT
                                                 | VK_COLOR_COMPONENT_A_BIT;
+    Invalidate();
     return *this;
 }
 
@@ -437,26 +455,34 @@ GraphicsPipelineDesc& GraphicsPipelineDesc::AddVertexBinding(uint32_t binding, u
         });
     }
 
+    Invalidate();
     return *this;
 }
 
 GraphicsPipelineDesc& GraphicsPipelineDesc::SetVertexShader(Shader* shader) {
     vertexShader = shader;
+    Invalidate();
     return *this;
 }
 
 GraphicsPipelineDesc& GraphicsPipelineDesc::SetFragmentShader(Shader* shader) {
     fragmentShader = shader;
+    Invalidate();
     return *this;
 }
 
 GraphicsPipelineDesc& GraphicsPipelineDesc::SetPipelineLayout(const PipelineLayoutDesc &layoutDesc) {
     pipelineLayoutDesc = layoutDesc;
+    Invalidate();
     return *this;
 }
 
 GraphicsPipelineDesc& GraphicsPipelineDesc::SetRenderPass(RenderPass *rp) {
-    renderPass.reset(rp);
+    // set again on every technique bind, only a different render pass changes the key
+    if (renderPass.get() != rp) {
+        renderPass.reset(rp);
+        Invalidate();
+    }
     return *this;
 }
 
@@ -475,12 +501,12 @@ GraphicsPipelineDesc& GraphicsPipelineDesc::SetViewport(const VkViewport &viewpo
 GraphicsPipelineDesc& GraphicsPipelineDesc::SetViewportScissors(const std::vector<VkViewport> &viewports,
                                                                 const std::vector<VkRect2D> &scissors,
                                                                 bool dynamic) {
-    this->viewports.clear();
-    this->scissors.clear();
+    std::vector<VkViewport> flipped;
+    std::vector<VkRect2D> rects;
 
     // viewports (doing a manual flip)
     for (const auto &viewport : viewports) {
-        this->viewports.push_back(VkViewport {
+        flipped.push_back(VkViewport {
             static_cast<float>(viewport.x),
             static_cast<float>(viewport.height - viewport.y),
             static_cast<float>(viewport.width),
@@ -491,20 +517,31 @@ GraphicsPipelineDesc& GraphicsPipelineDesc::SetViewportScissors(const std::vecto
 
     // scissors
     for (const auto &scissor : scissors) {
-        this->scissors.push_back(scissor);
+        rects.push_back(scissor);
     }
 
     // adding a default scissor
-    if (this->scissors.size() == 0) {
+    if (rects.size() == 0) {
         const auto &viewport = viewports.back();
-        this->scissors.push_back(VkRect2D {
+        rects.push_back(VkRect2D {
             { static_cast<int32_t>(viewport.x), static_cast<int32_t>(viewport.y) },
             { static_cast<uint32_t>(viewport.width), static_cast<uint32_t>(viewport.height) }
         });
     }
 
+    // set again on every technique bind, only a different viewport changes the key
+    bool changed = flipped.size() != this->viewports.size() || rects.size() != this->scissors.size()
+                || std::memcmp(flipped.data(), this->viewports.data(), flipped.size() * sizeof(VkViewport)) != 0
+                || std::memcmp(rects.data(), this->scissors.data(), rects.size() * sizeof(VkRect2D)) != 0;
+    if (changed) {
+        this->viewports = std::move(flipped);
+        this->scissors = std::move(rects);
+        Invalidate();
+    }
+
     if (dynamic) {
         dynamicStates.push_back(VK_DYNAMIC_STATE_VIEWPORT);
+        Invalidate();
     }
 
     return *this;
@@ -526,6 +563,7 @@ RayTracingPipelineDesc::RayTracingPipelineDesc() : PipelineDesc(VK_PIPELINE_BIND
 
 RayTracingPipelineDesc& RayTracingPipelineDesc::SetPipelineLayout(const PipelineLayoutDesc &layoutDesc) {
     pipelineLayoutDesc = layoutDesc;
+    Invalidate();
     return *this;
 }
 
@@ -547,6 +585,7 @@ RayTracingPipelineDesc& RayTracingPipelineDesc::SetRayGenShader(Shader* shader)
     group.generalShader = FindShader(shader);
     group.intersectionShader = VK_SHADER_UNUSED_KHR;
     rayGenCreateInfos.push_back(group);
+    Invalidate();
     return *this;
 }
 
@@ -559,6 +598,7 @@ RayTracingPipelineDesc& RayTracingPipelineDesc::SetMissShader(Shader* shader) {
     group.generalShader = FindShader(shader);
     group.intersectionShader = VK_SHADER_UNUSED_KHR;
     missCreateInfos.push_back(group);
+    Invalidate();
     return *this;
 }
 
@@ -571,6 +611,7 @@ RayTracingPipelineDesc& RayTracingPipelineDesc::SetAnyHitShader(Shader* shader)
     group.generalShader = VK_SHADER_UNUSED_KHR;
     group.intersectionShader = VK_SHADER_UNUSED_KHR;
     hitCreateInfos.push_back(group);
+    Invalidate();
     return *this;
 }
 
@@ -583,6 +624,7 @@ RayTracingPipelineDesc& RayTracingPipelineDesc::SetClosestHitShader(Shader* shad
     group.generalShader = VK_SHADER_UNUSED_KHR;
     group.intersectionShader = VK_SHADER_UNUSED_KHR;
     hitCreateInfos.push_back(group);
+    Invalidate();
     return *this;
 }
 
@@ -595,6 +637,7 @@ RayTracingPipelineDesc& RayTracingPipelineDesc::SetAnyHitShader(Shader* aHitShad
     group.generalShader = VK_SHADER_UNUSED_KHR;
     group.intersectionShader = FindShader(isectShader);
     hitCreateInfos.push_back(group);
+    Invalidate();
     return *this;
 }
 
@@ -607,11 +650,13 @@ RayTracingPipelineDesc& RayTracingPipelineDesc::SetClosestHitShader(Shader* cHit
     group.generalShader = VK_SHADER_UNUSED_KHR;
     group.intersectionShader = FindShader(isectShader);
     hitCreateInfos.push_back(group);
+    Invalidate();
     return *this;
 }
 
 RayTracingPipelineDesc& RayTracingPipelineDesc::SetMaxRayRecursionDepth(int depth) {
     handle.maxPipelineRayRecursionDepth = depth;
+    Invalidate();
     return *this;
 }
 
@@ -682,7 +727,7 @@ Pipeline::Pipeline(Device *device, GraphicsPipelineDesc &desc, uint32_t subpass)
 
     // creation
     ErrorCheck(DeviceDispatch(
-        vkCreateGraphicsPipelines(*device, VK_NULL_HANDLE, 1, &desc.handle, nullptr, &handle)),
+        vkCreateGraphicsPipelines(*device, device->GetPipelineCache(), 1, &desc.handle, nullptr, &handle)),
         "create graphics pipeline");
 }
 
@@ -703,7 +748,7 @@ Pipeline::Pipeline(Device *device, ComputePipelineDesc &desc) : device(device),
 
     // creation
     ErrorCheck(DeviceDispatch(
-        vkCreateComputePipelines(*device, VK_NULL_HANDLE, 1, &desc.handle, nullptr, &handle)),
+        vkCreateComputePipelines(*device, device->GetPipelineCache(), 1, &desc.handle, nullptr, &handle)),
         "create compute pipeline");
 }
 
@@ -742,7 +787,7 @@ Pipeline::Pipeline(Device *device, RayTracingPipelineDesc &desc) : device(device
 
     // creation
     ErrorCheck(DeviceDispatch(
-        vkCreateRayTracingPipelinesKHR(*device, VK_NULL_HANDLE, VK_NULL_HANDLE, 1, &desc.handle, nullptr, &handle)),
+        vkCreateRayTracingPipelinesKHR(*device, VK_NULL_HANDLE, device->GetPipelineCache(), 1, &desc.handle, nullptr, &handle)),
         "create ray tracing pipeline");
 
     // sbt creation
@@ -800,3 +845,233 @@ void Pipeline::SetName(const std::string& name) const {
         ErrorCheck(DeviceDispatch(vkDebugMarkerSetObjectNameEXT(*device, &nameInfo)), "set query pool name");
     }
 }
+
+//  ____  _            _ _              ____             _
+// |  _ \(_)_ __   ___| (_)_ __   ___  |  _ \ ___   ___ | |
+// | |_) | | '_ \ / _ \ | | '_ \ / _ \ | |_) / _ \ / _ \| |
+// |  __/| | |_) |  __/ | | | | |  __/ |  __/ (_) | (_) | |
+// |_|   |_| .__/ \___|_|_|_| |_|\___| |_|   \___/ \___/|_|
+//         |_|
+
+PipelinePool::PipelinePool(Device *device) : device(device) {
+}
+
+Pipeline* PipelinePool::Request(const ComputePipelineDesc &desc) {
+    const PipelineKey& key = GetKey(desc);
+    auto it = pipelines.find(key);
+    if (it == pipelines.end()) {
+        it = pipelines.insert(std::make_pair(key, SlimPtr<Pipeline>(device, desc))).first;
+    }
+    return it->second;
+}
+
+Pipeline* PipelinePool::Request(const GraphicsPipelineDesc &desc, uint32_t subpass) {
+    const PipelineKey& key = GetKey(desc, subpass);
+    auto it = pipelines.find(key);
+    if (it == pipelines.end()) {
+        it = pipelines.insert(std::make_pair(key, SlimPtr<Pipeline>(device, desc, subpass))).first;
+    }
+    return it->second;
+}
+
+Pipeline* PipelinePool::Request(const RayTracingPipelineDesc &desc) {
+    const PipelineKey& key = GetKey(desc);
+    auto it = pipelines.find(key);
+    if (it == pipelines.end()) {
+        it = pipelines.insert(std::make_pair(key, SlimPtr<Pipeline>(device, desc))).first;
+    }
+    return it->second;
+}
+
+// --------------------------------------------------------------------------------------------------
+// Structural keys of pipeline descs. Only state that ends up in the pipeline is added,
+// create info pointers are excluded because they are only patched up at pipeline creation,
+// and so is the name, which only labels the pipeline.
+// Shaders are added by hash, render passes by their compatibility key.
+
+bool PipelineKey::operator==(const PipelineKey &other) const {
+    if (hash != other.hash || state != other.state || shaders.size() != other.shaders.size()) {
+        return false;
+    }
+    // equal states have equal shader hashes, the code is only compared for distinct shader objects
+    for (size_t i = 0; i < shaders.size(); i++) {
+        const Shader* a = shaders[i];
+        const Shader* b = other.shaders[i];
+        if (a != b && (a->GetStage() != b->GetStage() || a->GetEntry() != b->GetEntry() || a->GetCode() != b->GetCode())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void AddShader(StructuralKey& key, PipelineKey& result, Shader* shader) {
+    key.Add(shader != nullptr);
+    if (shader) {
+        key.Add(shader->GetHash());
+        result.shaders.push_back(shader);
+    }
+}
+
+static void AddStencilOp(StructuralKey& key, const VkStencilOpState& op) {
+    key.Add(op.failOp, op.passOp, op.depthFailOp, op.compareOp,
+            op.compareMask, op.writeMask, op.reference);
+}
+
+static void AddPipelineLayout(StructuralKey& key, const std::multimap<uint32_t, std::vector<DescriptorSetLayoutBinding>>& bindings,
+                              const std::vector<std::string>& pushConstantNames,
+                              const std::vector<VkPushConstantRange>& pushConstantRange) {
+    key.Add(bindings.size());
+    for (const auto &kv : bindings) {
+        key.Add(kv.first, kv.second.size());
+        for (const auto &binding : kv.second) {
+            key.Add(binding.name, binding.set, binding.binding, binding.descriptorType,
+                    binding.descriptorCount, binding.stageFlags, binding.bindingFlags);
+        }
+    }
+    key.Add(pushConstantRange.size());
+    for (uint32_t i = 0; i < pushConstantRange.size(); i++) {
+        const auto &range = pushConstantRange[i];
+        key.Add(pushConstantNames[i], range.stageFlags, range.offset, range.size);
+    }
+}
+
+static void Finish(StructuralKey& key, PipelineKey& result) {
+    result.state = key.Get();
+    result.hash = std::hash<std::string>{}(result.state);
+}
+
+const PipelineKey& PipelinePool::GetKey(const ComputePipelineDesc &desc) {
+    if (desc.keyValid) {
+        return desc.key;
+    }
+
+    PipelineKey result;
+    StructuralKey key;
+    key.Add(desc.bindPoint);
+    AddPipelineLayout(key, desc.pipelineLayoutDesc.bindings, desc.pipelineLayoutDesc.pushConstantNames, desc.pipelineLayoutDesc.pushConstantRange);
+    AddShader(key, result, desc.computeShader.get());
+    Finish(key, result);
+
+    desc.key = std::move(result);
+    desc.keyValid = true;
+    return desc.key;
+}
+
+const PipelineKey& PipelinePool::GetKey(const GraphicsPipelineDesc &desc, uint32_t subpass) {
+    if (desc.keyValid && desc.keySubpass == subpass) {
+        return desc.key;
+    }
+
+    PipelineKey result;
+    StructuralKey key;
+    key.Add(desc.bindPoint, subpass);
+    AddPipelineLayout(key, desc.pipelineLayoutDesc.bindings, desc.pipelineLayoutDesc.pushConstantNames, desc.pipelineLayoutDesc.pushConstantRange);
+
+    // shaders
+    AddShader(key, result, desc.vertexShader.get());
+    AddShader(key, result, desc.fragmentShader.get());
+
+    // render pass compatibility
+    key.Add(desc.renderPass ? desc.renderPass->GetCompatibilityKey() : std::string());
+
+    // vertex input
+    key.Add(desc.inputBindings.size());
+    for (const auto& binding : desc.inputBindings) {
+        key.Add(binding.binding, binding.stride, binding.inputRate);
+    }
+    key.Add(desc.vertexAttributes.size());
+    for (const auto& attrib : desc.vertexAttributes) {
+        key.Add(attrib.location, attrib.binding, attrib.format, attrib.offset);
+    }
+
+    // input assembly
+    const auto& ia = desc.inputAssemblyStateCreateInfo;
+    key.Add(ia.topology, ia.primitiveRestartEnable);
+
+    // rasterization
+    const auto& rs = desc.rasterizationStateCreateInfo;
+    key.Add(rs.depthClampEnable, rs.rasterizerDiscardEnable, rs.polygonMode, rs.cullMode, rs.frontFace);
+    key.Add(rs.depthBiasEnable, rs.depthBiasConstantFactor, rs.depthBiasClamp, rs.depthBiasSlopeFactor, rs.lineWidth);
+
+    // multisample
+    const auto& ms = desc.multisampleStateCreateInfo;
+    key.Add(ms.rasterizationSamples, ms.sampleShadingEnable, ms.minSampleShading,
+            ms.alphaToCoverageEnable, ms.alphaToOneEnable);
+
+    // depth stencil
+    const auto& ds = desc.depthStencilStateCreateInfo;
+    key.Add(ds.depthTestEnable, ds.depthWriteEnable, ds.depthCompareOp, ds.depthBoundsTestEnable,
+            ds.stencilTestEnable, ds.minDepthBounds, ds.maxDepthBounds);
+    AddStencilOp(key, ds.front);
+    AddStencilOp(key, ds.back);
+
+    // color blend
+    const auto& cb = desc.colorBlendStateCreateInfo;
+    key.Add(cb.logicOpEnable, cb.logicOp);
+    key.Add(cb.blendConstants[0], cb.blendConstants[1], cb.blendConstants[2], cb.blendConstants[3]);
+    key.Add(desc.colorBlendAttachments.size());
+    for (const auto& blend : desc.colorBlendAttachments) {
+        key.Add(blend.blendEnable, blend.srcColorBlendFactor, blend.dstColorBlendFactor, blend.colorBlendOp,
+                blend.srcAlphaBlendFactor, blend.dstAlphaBlendFactor, blend.alphaBlendOp, blend.colorWriteMask);
+    }
+
+    // viewports, scissors & dynamic states
+    key.Add(desc.viewports.size());
+    for (const auto& viewport : desc.viewports) {
+        key.Add(viewport.x, viewport.y, viewport.width, viewport.height, viewport.minDepth, viewport.maxDepth);
+    }
+    key.Add(desc.scissors.size());
+    for (const auto& scissor : desc.scissors) {
+        key.Add(scissor.offset.x, scissor.offset.y, scissor.extent.width, scissor.extent.height);
+    }
+    key.Add(desc.dynamicStates.size());
+    for (VkDynamicState state : desc.dynamicStates) {
+        key.Add(state);
+    }
+    Finish(key, result);
+
+    desc.key = std::move(result);
+    desc.keyValid = true;
+    desc.keySubpass = subpass;
+    return desc.key;
+}
+
+const PipelineKey& PipelinePool::GetKey(const RayTracingPipelineDesc &desc) {
+    if (desc.keyValid) {
+        return desc.key;
+    }
+
+    PipelineKey result;
+    StructuralKey key;
+    key.Add(desc.bindPoint);
+    AddPipelineLayout(key, desc.pipelineLayoutDesc.bindings, desc.pipelineLayoutDesc.pushConstantNames, desc.pipelineLayoutDesc.pushConstantRange);
+    key.Add(desc.handle.maxPipelineRayRecursionDepth);
+    key.Add(desc.shaders.size());
+    for (const auto& shader : desc.shaders) {
+        AddShader(key, result, shader.get());
+    }
+    for (const auto* groups : { &desc.rayGenCreateInfos, &desc.missCreateInfos, &desc.hitCreateInfos, &desc.callableCreateInfos }) {
+        key.Add(groups->size());
+        for (const auto& group : *groups) {
+            key.Add(group.type, group.generalShader, group.closestHitShader,
+                    group.anyHitShader, group.intersectionShader);
+        }
+    }
+    Finish(key, result);
+
+    desc.key = std::move(result);
+    desc.keyValid = true;
+    return desc.key;
+}
+
+size_t std::hash<ComputePipelineDesc>::operator()(const ComputePipelineDesc& desc) const {
+    return PipelinePool::GetKey(desc).hash;
+}
+
+size_t std::hash<GraphicsPipelineDesc>::operator()(const GraphicsPipelineDesc& desc) const {
+    return PipelinePool::GetKey(desc).hash;
+}
+
+size_t std::hash<RayTracingPipelineDesc>::operator()(const RayTracingPipelineDesc& desc) const {
+    return PipelinePool::GetKey(desc).hash;
+}
@@ -18,6 +18,7 @@
 namespace slim {
 
     class Pipeline;
+    class PipelinePool;
     class Descriptor;
     class DescriptorPool;
     class RenderFrame;
@@ -28,18 +29,6 @@ namespace slim {
         uint32_t offset;
     };
 
-    struct BufferAlloc {
-        Buffer* buffer;
-        size_t offset = 0;
-        size_t size = 0;
-
-        BufferAlloc(Buffer* buffer) : buffer(buffer), offset(0), size(buffer->Size()) {
-        }
-
-        BufferAlloc(Buffer* buffer, size_t offset, size_t size) : buffer(buffer), offset(offset), size(size) {
-        }
-    };
-
     //  ____  _            _ _            _                            _   ____
     // |  _ \(_)_ __   ___| (_)_ __   ___| |    __ _ _   _  ___  _   _| |_|  _ \  ___  ___  ___
     // | |_) | | '_ \ / _ \ | | '_ \ / _ \ |   / _` | | | |/ _ \| | | | __| | | |/ _ \/ __|/ __|
@@ -74,6 +63,7 @@ namespace slim {
 
     class PipelineLayoutDesc final {
         friend class PipelineLayout;
+        friend class PipelinePool;
         friend class std::hash<PipelineLayoutDesc>;
     public:
 
@@ -137,6 +127,22 @@ namespace slim {
     // |_|   |_| .__/ \___|_|_|_| |_|\___| |____/ \___||___/\___|
     //         |_|
 
+    // PipelineKey holds all state that ends up in a pipeline. Shaders are added to the state by their hash
+    // (computed when they are loaded) and kept by reference, their code is only compared when two equal states
+    // hold different shader objects.
+    struct PipelineKey {
+        std::string state;
+        std::vector<SmartPtr<Shader>> shaders;
+        size_t hash = 0;
+
+        bool operator==(const PipelineKey &other) const;
+        bool operator!=(const PipelineKey &other) const { return !(*this == other); }
+
+        struct Hash {
+            size_t operator()(const PipelineKey &key) const { return key.hash; }
+        };
+    };
+
     class PipelineDesc {
     public:
         PipelineDesc(VkPipelineBindPoint bindPoint);
@@ -149,10 +155,18 @@ namespace slim {
         const std::string& GetName() const { return name; }
 
     protected:
+        // every setter that changes pipeline state drops the cached key
+        void Invalidate() { keyValid = false; }
+
         std::string name = "";
         VkPipelineBindPoint bindPoint;
         SmartPtr<PipelineLayout> pipelineLayout;
         PipelineLayoutDesc pipelineLayoutDesc;
+
+        // built by PipelinePool::GetKey
+        mutable PipelineKey key;
+        mutable bool keyValid = false;
+        mutable uint32_t keySubpass = 0;
     };
 
     //   ____                            _
@@ -167,6 +181,8 @@ namespace slim {
     // When pipeline is initialized, nothing should be changeable (except for dynamic states).
     class ComputePipelineDesc final : public PipelineDesc, public TriviallyConvertible<VkComputePipelineCreateInfo> {
         friend class Pipeline;
+        friend class PipelinePool;
+        friend class std::hash<ComputePipelineDesc>;
     public:
         explicit ComputePipelineDesc();
         explicit ComputePipelineDesc(const std::string &name);
@@ -192,6 +208,8 @@ namespace slim {
     // When pipeline is initialized, nothing should be changeable (except for dynamic states).
     class GraphicsPipelineDesc final : public PipelineDesc, public TriviallyConvertible<VkGraphicsPipelineCreateInfo> {
         friend class Pipeline;
+        friend class PipelinePool;
+        friend class std::hash<GraphicsPipelineDesc>;
     public:
         explicit GraphicsPipelineDesc();
         explicit GraphicsPipelineDesc(const std::string &name);
@@ -263,6 +281,8 @@ namespace slim {
 
     class RayTracingPipelineDesc final : public PipelineDesc, public TriviallyConvertible<VkRayTracingPipelineCreateInfoKHR> {
         friend class Pipeline;
+        friend class PipelinePool;
+        friend class std::hash<RayTracingPipelineDesc>;
     public:
         explicit RayTracingPipelineDesc();
         explicit RayTracingPipelineDesc(const std::string &name);
@@ -328,6 +348,39 @@ namespace slim {
         VkStridedDeviceAddressRegionKHR callable;
     };
 
+    //  ____  _            _ _              ____             _
+    // |  _ \(_)_ __   ___| (_)_ __   ___  |  _ \ ___   ___ | |
+    // | |_) | | '_ \ / _ \ | | '_ \ / _ \ | |_) / _ \ / _ \| |
+    // |  __/| | |_) |  __/ | | | | |  __/ |  __/ (_) | (_) | |
+    // |_|   |_| .__/ \___|_|_|_| |_|\___| |_|   \___/ \___/|_|
+    //         |_|
+
+    // PipelinePool caches pipelines by the structural key of their descs,
+    // so that descs with the same name but different states never collide,
+    // and render frames sharing a pool never create the same pipeline twice.
+    class PipelinePool final : public NotCopyable, public NotMovable, public ReferenceCountable {
+    public:
+        explicit PipelinePool(Device *device);
+        virtual ~PipelinePool() = default;
+
+        Pipeline* Request(const ComputePipelineDesc &desc);
+        Pipeline* Request(const GraphicsPipelineDesc &desc, uint32_t subpass = 0);
+        Pipeline* Request(const RayTracingPipelineDesc &desc);
+
+        void   Clear() { pipelines.clear(); }
+        size_t Size() const { return pipelines.size(); }
+
+        // all state that ends up in the pipeline, descs with equal keys create the same pipeline,
+        // the key is built once and cached on the desc until one of its setters changes it
+        static const PipelineKey& GetKey(const ComputePipelineDesc &desc);
+        static const PipelineKey& GetKey(const GraphicsPipelineDesc &desc, uint32_t subpass = 0);
+        static const PipelineKey& GetKey(const RayTracingPipelineDesc &desc);
+
+    private:
+        SmartPtr<Device> device;
+        std::unordered_map<PipelineKey, SmartPtr<Pipeline>, PipelineKey::Hash> pipelines;
+    };
+
 } // end of namespace slim
 
 namespace std {
@@ -354,6 +407,9 @@ namespace std {
                 for (const auto &binding : kv.second)
                     hash = HashCombine(hash, binding);
             }
+            for (const auto &range : builder.pushConstantRange) {
+                hash = slim::HashCombine(hash, range.stageFlags, range.offset, range.size);
+            }
             return hash;
         }
     };
@@ -364,5 +420,21 @@ namespace std {
             return layout.hashValue;
         }
     };
+
+    // structural hashes of pipeline descs, see pipeline.cpp
+    template <>
+    struct hash<slim::ComputePipelineDesc> {
+        size_t operator()(const slim::ComputePipelineDesc& desc) const;
+    };
+
+    template <>
+    struct hash<slim::GraphicsPipelineDesc> {
+        size_t operator()(const slim::GraphicsPipelineDesc& desc) const;
+    };
+
+    template <>
+    struct hash<slim::RayTracingPipelineDesc> {
+        size_t operator()(const slim::RayTracingPipelineDesc& desc) const;
+    };
 }
 #endif // end of SLIM_CORE_PIPELINE_H
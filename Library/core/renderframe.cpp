@@ -2,6 +2,7 @@
 #include "core/window.h"
 #include "core/renderframe.h"
 #include "core/vkutils.h"
+#include "utility/rendergraph.h"
 
 using namespace slim;
 
@@ -10,7 +11,7 @@ RenderFrame::RenderFrame(Device* device, uint32_t maxSetsPerPool) : device(devic
 
     // initialize command pools
     if (queueFamilyIndices.compute.has_value())
-        computeCommandPools = SlimPtr<CommandPool>(device, queueFamilyIndices.compute.value());
+        computeCommandPools = SlimPtr<CommandPool>(device, queueFamilyIndices.compute.value(), device->GetComputeQueueIndex());
 
     if (queueFamilyIndices.graphics.has_value())
         graphicsCommandPools = SlimPtr<CommandPool>(device, queueFamilyIndices.graphics.value());
@@ -21,8 +22,11 @@ RenderFrame::RenderFrame(Device* device, uint32_t maxSetsPerPool) : device(devic
     // initialize pools for resource allocation
     cpuImagePool = SlimPtr<ImagePool<CPUImage>>(device);
     gpuImagePool = SlimPtr<ImagePool<GPUImage>>(device);
-    uniformBufferPool = SlimPtr<BufferPool<UniformBuffer>>(device);
+    aliasingImagePool = SlimPtr<AliasingImagePool>(device);
+    uniformBufferAllocator = SlimPtr<BufferAllocator<UniformBuffer>>(device,
+        device->GetContext()->GetPhysicalDeviceProperties().limits.minUniformBufferOffsetAlignment);
     descriptorPool = SlimPtr<DescriptorPool>(device, maxSetsPerPool);
+    pipelinePool = SlimPtr<PipelinePool>(device);
 
     // initialize synchronization objects
     imageAvailableSemaphore = SlimPtr<Semaphore>(device);
@@ -54,17 +58,29 @@ void RenderFrame::Reset() {
     if (computeCommandPools.get())  computeCommandPools->Reset();
     if (graphicsCommandPools.get()) graphicsCommandPools->Reset();
     if (transferCommandPools.get()) transferCommandPools->Reset();
-
-    uniformBufferPool->Reset();
+    for (auto& commandPool : threadCommandPools) commandPool->Reset();
+
+    uniformBufferAllocator->Reset();
+    aliasingImagePool->Reset();
+    retiredFramebuffers.clear();
+    retiredRenderGraphs.clear();
+    retiredBuffers.clear();
+    retiredImages.clear();
+    descriptors.clear();
     descriptorPool->Reset();
     activeSemahoreCount = 0;
     semaphorePool.clear();
 }
 
 void RenderFrame::Invalidate() {
+    compiledRenderGraphs.clear();
     framebuffers.clear();
     renderPasses.clear();
-    pipelines.clear();
+    aliasingImagePool->Clear();
+
+    // pipelines are keyed by structural hash and created from the device pipeline cache,
+    // dropping them here is cheap and avoids piling up pipelines baked with stale extents
+    pipelinePool->Clear();
 }
 
 void RenderFrame::SetBackBuffer(GPUImage *backBuffer) {
@@ -109,38 +125,21 @@ void RenderFrame::Present(CommandBuffer *commandBuffer) {
 }
 
 void RenderFrame::Draw(CommandBuffer *commandBuffer) {
-    commandBuffer->Signal(renderFinishesSemaphore);
+    // nothing waits on an offscreen frame, Reset() waits for this fence instead
+    commandBuffer->Signal(GetGraphicsFinishFence());
     commandBuffer->Submit();
 }
 
 Pipeline* RenderFrame::RequestPipeline(const ComputePipelineDesc &desc) {
-    const std::string &name = desc.GetName();
-    auto it = pipelines.find(name);
-    if (it == pipelines.end()) {
-        pipelines.insert(std::make_pair(name, SlimPtr<Pipeline>(device, desc)));
-        it = pipelines.find(name);
-    }
-    return it->second;
+    return pipelinePool->Request(desc);
 }
 
 Pipeline* RenderFrame::RequestPipeline(const GraphicsPipelineDesc &desc, uint32_t subpass) {
-    const std::string &name = desc.GetName();
-    auto it = pipelines.find(name);
-    if (it == pipelines.end()) {
-        pipelines.insert(std::make_pair(name, SlimPtr<Pipeline>(device, desc, subpass)));
-        it = pipelines.find(name);
-    }
-    return it->second;
+    return pipelinePool->Request(desc, subpass);
 }
 
 Pipeline* RenderFrame::RequestPipeline(const RayTracingPipelineDesc &desc) {
-    const std::string &name = desc.GetName();
-    auto it = pipelines.find(name);
-    if (it == pipelines.end()) {
-        pipelines.insert(std::make_pair(name, SlimPtr<Pipeline>(device, desc)));
-        it = pipelines.find(name);
-    }
-    return it->second;
+    return pipelinePool->Request(desc);
 }
 
 RenderPass* RenderFrame::RequestRenderPass(const RenderPassDesc &desc) {
@@ -176,12 +175,58 @@ CommandBuffer* RenderFrame::RequestCommandBuffer(VkQueueFlagBits queue, VkComman
     }
 }
 
+CommandPool* RenderFrame::RequestThreadCommandPool(uint32_t thread) {
+    while (threadCommandPools.size() <= thread) {
+        threadCommandPools.push_back(SlimPtr<CommandPool>(device, queueFamilyIndices.graphics.value()));
+    }
+    return threadCommandPools[thread];
+}
+
 Transient<GPUImage> RenderFrame::RequestGPUImage(VkFormat format, VkExtent2D extent, uint32_t mipLevels, uint32_t arrayLayers, VkSampleCountFlagBits samples, VkImageUsageFlags imageUsage) {
     return gpuImagePool->Request(format, extent, mipLevels, arrayLayers, samples, imageUsage);
 }
 
-UniformBuffer* RenderFrame::RequestUniformBuffer(size_t size) {
-    return uniformBufferPool->Request(size);
+AliasedImages* RenderFrame::RequestAliasedImages(const std::vector<TransientImageDesc>& descs) {
+    // graphs usually repeat every frame, too many distinct layouts means they are changing,
+    // compiled graphs and framebuffers are dropped together with the images because they reference them,
+    // all of them are kept alive until Reset() because commands recorded in this frame may use them
+    if (aliasingImagePool->Size() >= MAX_ALIASED_IMAGE_LAYOUTS) {
+        for (auto& kv : compiledRenderGraphs) retiredRenderGraphs.push_back(kv.second);
+        for (auto& kv : framebuffers) retiredFramebuffers.push_back(kv.second);
+        compiledRenderGraphs.clear();
+        framebuffers.clear();
+        aliasingImagePool->Clear();
+    }
+    return aliasingImagePool->Request(descs);
+}
+
+CompiledRenderGraph* RenderFrame::FindCompiledRenderGraph(const std::string& key) const {
+    auto it = compiledRenderGraphs.find(key);
+    if (it == compiledRenderGraphs.end()) {
+        return nullptr;
+    }
+    return it->second;
+}
+
+void RenderFrame::AddCompiledRenderGraph(const std::string& key, CompiledRenderGraph* graph) {
+    // evicted graphs are kept alive until Reset(), commands recorded in this frame may use them
+    if (compiledRenderGraphs.size() >= MAX_COMPILED_RENDER_GRAPHS) {
+        for (auto& kv : compiledRenderGraphs) retiredRenderGraphs.push_back(kv.second);
+        compiledRenderGraphs.clear();
+    }
+    compiledRenderGraphs.insert(std::make_pair(key, SmartPtr<CompiledRenderGraph>(graph)));
+}
+
+void RenderFrame::RetireBuffer(Buffer* buffer) {
+    if (buffer) retiredBuffers.push_back(buffer);
+}
+
+void RenderFrame::RetireImage(Image* image) {
+    if (image) retiredImages.push_back(image);
+}
+
+BufferAlloc RenderFrame::RequestUniformBuffer(size_t size) {
+    return uniformBufferAllocator->Request(size);
 }
 
 Semaphore* RenderFrame::RequestSemaphore() {
@@ -193,6 +238,35 @@ Semaphore* RenderFrame::RequestSemaphore() {
     return semaphorePool[activeSemahoreCount++];
 }
 
+Descriptor* RenderFrame::RequestDescriptor(PipelineLayout *layout, const std::vector<BufferAlloc> &resources,
+                                           bool &created, uint32_t slot) {
+    StructuralKey key;
+    key.Add(layout, slot, resources.size());
+    for (const BufferAlloc &resource : resources) {
+        key.Add(resource.buffer, resource.offset, resource.size);
+    }
+
+    auto it = descriptors.find(key.Get());
+    if (it != descriptors.end()) {
+        created = false;
+        return it->second;
+    }
+
+    created = true;
+    auto descriptor = SlimPtr<Descriptor>(descriptorPool, layout);
+    descriptors.insert(std::make_pair(key.Get(), descriptor));
+    return descriptor;
+}
+
+uint32_t RenderFrame::GetElidedBindCount() const {
+    uint32_t count = 0;
+    if (computeCommandPools.get())  count += computeCommandPools->GetElidedBindCount();
+    if (graphicsCommandPools.get()) count += graphicsCommandPools->GetElidedBindCount();
+    if (transferCommandPools.get()) count += transferCommandPools->GetElidedBindCount();
+    for (const auto& commandPool : threadCommandPools) count += commandPool->GetElidedBindCount();
+    return count;
+}
+
 Fence* RenderFrame::GetComputeFinishFence() {
     if (!computeFinishFence) {
         computeFinishFence = SlimPtr<Fence>(device);
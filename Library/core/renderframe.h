@@ -20,8 +20,11 @@
 namespace slim {
 
     class Window;
+    class CompiledRenderGraph;
 
     constexpr static uint32_t MAX_SETS_PER_POOL = 256;
+    constexpr static uint32_t MAX_ALIASED_IMAGE_LAYOUTS = 8;
+    constexpr static uint32_t MAX_COMPILED_RENDER_GRAPHS = 8;
 
     // RenderFrame is responsible for storing frame-scoped data for rendering purpose.
     class RenderFrame final : public NotCopyable, public NotMovable, public ReferenceCountable {
@@ -44,16 +47,34 @@ namespace slim {
         RenderPass*              RequestRenderPass(const RenderPassDesc &renderPassDesc);
         Framebuffer*             RequestFramebuffer(const FramebufferDesc &framebufferDesc);
         CommandBuffer*           RequestCommandBuffer(VkQueueFlagBits queue, VkCommandBufferLevel = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
+        // graphics command pool owned by one recording thread, request pools from the main thread
+        // before recording starts, each pool must only be used by a single thread at a time,
+        // jobs of Device::GetJobSystem() can index pools by JobSystem::GetThreadIndex()
+        CommandPool*             RequestThreadCommandPool(uint32_t thread);
         Transient<GPUImage>      RequestGPUImage(VkFormat format, VkExtent2D extent, uint32_t mipLevels, uint32_t arrayLayers, VkSampleCountFlagBits samples, VkImageUsageFlags imageUsage);
+        AliasedImages*           RequestAliasedImages(const std::vector<TransientImageDesc>& descs);
+        CompiledRenderGraph*     FindCompiledRenderGraph(const std::string& key) const;
+        void                     AddCompiledRenderGraph(const std::string& key, CompiledRenderGraph* graph);
+
+        // keep resources replaced while commands of this frame may still use them alive until Reset()
+        void                     RetireBuffer(Buffer* buffer);
+        void                     RetireImage(Image* image);
         Semaphore*               RequestSemaphore();
 
-        UniformBuffer*           RequestUniformBuffer(size_t size);
+        // descriptor cached by (layout, bound buffer ranges, slot) until Reset(), descriptors of different slots
+        // are never shared (e.g. one per recording thread), created is set when the descriptor is new
+        // and its bindings still need to be written
+        Descriptor*              RequestDescriptor(PipelineLayout *layout, const std::vector<BufferAlloc> &resources,
+                                                   bool &created, uint32_t slot = 0);
+
+        BufferAlloc              RequestUniformBuffer(size_t size);
 
         template <typename T>
-        UniformBuffer*           RequestUniformBuffer(const T &value);
+        BufferAlloc              RequestUniformBuffer(const T &value);
 
         template <typename T>
-        UniformBuffer*           RequestUniformBuffer(const std::vector<T> &value);
+        BufferAlloc              RequestUniformBuffer(const std::vector<T> &value);
 
         void                     Reset();
         void                     Invalidate();
@@ -62,6 +83,7 @@ namespace slim {
         void                     SetBackBuffer(GPUImage *backBuffer);
         Fence*                   GetGraphicsFinishFence();
         Fence*                   GetComputeFinishFence();
+        uint32_t                 GetElidedBindCount() const;
 
         bool                     Presentable() const { return swapchain != VK_NULL_HANDLE; }
 
@@ -75,19 +97,29 @@ namespace slim {
         SmartPtr<CommandPool>    computeCommandPools;
         SmartPtr<CommandPool>    graphicsCommandPools;
         SmartPtr<CommandPool>    transferCommandPools;
+        std::vector<SmartPtr<CommandPool>> threadCommandPools;
 
         // pools
-        SmartPtr<ImagePool<CPUImage>>       cpuImagePool;
-        SmartPtr<ImagePool<GPUImage>>       gpuImagePool;
-        SmartPtr<BufferPool<UniformBuffer>> uniformBufferPool;
-        SmartPtr<DescriptorPool>            descriptorPool;
-        std::vector<SmartPtr<Semaphore>>    semaphorePool;
-        uint32_t                            activeSemahoreCount = 0;
+        SmartPtr<ImagePool<CPUImage>>            cpuImagePool;
+        SmartPtr<ImagePool<GPUImage>>            gpuImagePool;
+        SmartPtr<AliasingImagePool>              aliasingImagePool;
+        SmartPtr<BufferAllocator<UniformBuffer>> uniformBufferAllocator;
+        SmartPtr<DescriptorPool>                 descriptorPool;
+        SmartPtr<PipelinePool>                   pipelinePool;
+        std::vector<SmartPtr<Semaphore>>         semaphorePool;
+        uint32_t                                 activeSemahoreCount = 0;
 
         // mappings
-        std::unordered_map<std::string, SmartPtr<Pipeline>> pipelines;
         std::unordered_map<std::string, SmartPtr<RenderPass>> renderPasses;
         std::unordered_map<std::size_t, SmartPtr<Framebuffer>> framebuffers;
+        std::unordered_map<std::string, SmartPtr<CompiledRenderGraph>> compiledRenderGraphs;
+        std::unordered_map<std::string, SmartPtr<Descriptor>> descriptors;
+
+        // dropped while commands of this frame may still use them, released on Reset()
+        std::vector<SmartPtr<Framebuffer>>         retiredFramebuffers;
+        std::vector<SmartPtr<CompiledRenderGraph>> retiredRenderGraphs;
+        std::vector<SmartPtr<Buffer>>              retiredBuffers;
+        std::vector<SmartPtr<Image>>               retiredImages;
 
         // synchronization between graphics queue and present queue
         SmartPtr<Semaphore>   imageAvailableSemaphore;
@@ -103,16 +135,16 @@ namespace slim {
     };
 
     template <typename T>
-    UniformBuffer* RenderFrame::RequestUniformBuffer(const T &value) {
-        UniformBuffer* uniform = uniformBufferPool->Request(sizeof(T));
-        uniform->SetData(value);
+    BufferAlloc RenderFrame::RequestUniformBuffer(const T &value) {
+        BufferAlloc uniform = uniformBufferAllocator->Request(sizeof(T));
+        uniform.buffer->SetData(const_cast<T*>(&value), sizeof(T), uniform.offset);
         return uniform;
     }
 
     template <typename T>
-    UniformBuffer* RenderFrame::RequestUniformBuffer(const std::vector<T> &value) {
-        UniformBuffer* uniform = uniformBufferPool->Request(sizeof(T) * value.size());
-        uniform->SetData(value);
+    BufferAlloc RenderFrame::RequestUniformBuffer(const std::vector<T> &value) {
+        BufferAlloc uniform = uniformBufferAllocator->Request(sizeof(T) * value.size());
+        uniform.buffer->SetData(const_cast<T*>(value.data()), sizeof(T) * value.size(), uniform.offset);
         return uniform;
     }
 
@@ -269,6 +269,8 @@ RenderPass::RenderPass(Device *device, const RenderPassDesc &desc)
     renderPassInfo.pDependencies = dependencies.data();
 
     ErrorCheck(DeviceDispatch(vkCreateRenderPass(*device, &renderPassInfo, nullptr, &handle)), "create render pass");
+
+    ComputeCompatibilityKey(desc);
 }
 
 RenderPass::~RenderPass() {
@@ -278,6 +280,32 @@ RenderPass::~RenderPass() {
     }
 }
 
+void RenderPass::ComputeCompatibilityKey(const RenderPassDesc& desc) {
+    // compatibility only depends on attachment formats, sample counts and subpass references,
+    // load/store ops and image layouts are ignored (see "Render Pass Compatibility" in vulkan spec)
+    StructuralKey key;
+    auto addReferences = [&key](const std::vector<VkAttachmentReference>& references) {
+        key.Add(references.size());
+        for (const VkAttachmentReference& reference : references) {
+            key.Add(reference.attachment);
+        }
+    };
+
+    key.Add(desc.attachments.size());
+    for (const VkAttachmentDescription& attachment : desc.attachments) {
+        key.Add(attachment.format, attachment.samples);
+    }
+    key.Add(desc.subpasses.size());
+    for (const SubpassDesc& subpass : desc.subpasses) {
+        addReferences(subpass.colorAttachments);
+        addReferences(subpass.depthStencilAttachments);
+        addReferences(subpass.resolveAttachments);
+        addReferences(subpass.inputAttachments);
+    }
+    compatibilityKey = key.Get();
+    compatibilityHash = std::hash<std::string>{}(compatibilityKey);
+}
+
 void RenderPass::ResolveSingleSubpassDependencies(const RenderPassDesc& desc, std::vector<VkSubpassDependency>& dependencies) {
     dependencies.push_back(VkSubpassDependency { });
 
@@ -99,12 +99,19 @@ namespace slim {
         RenderPass(Device *device, const RenderPassDesc &desc);
         virtual ~RenderPass();
 
+        // render passes with equal keys are compatible, pipelines can be shared between them
+        const std::string& GetCompatibilityKey() const { return compatibilityKey; }
+        size_t GetCompatibilityHash() const { return compatibilityHash; }
+
     private:
+        void ComputeCompatibilityKey(const RenderPassDesc& desc);
         void ResolveSingleSubpassDependencies(const RenderPassDesc& desc, std::vector<VkSubpassDependency>& dependencies);
         void ResolveMultiSubpassDependencies(const RenderPassDesc& desc, std::vector<VkSubpassDependency>& dependencies);
 
     private:
         SmartPtr<Device> device;
+        std::string compatibilityKey = "";
+        size_t compatibilityHash = 0;
     };
 
 } // end of namespace slim
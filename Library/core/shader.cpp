@@ -1,6 +1,7 @@
 #include <fstream>
 #include "core/debug.h"
 #include "core/shader.h"
+#include "core/hasher.h"
 #include "core/vkutils.h"
 
 using namespace slim;
@@ -56,6 +57,10 @@ Shader::Shader(Device *device, ShaderType type, VkShaderStageFlagBits stage,
     info.module = handle;
     info.pName = this->entry.c_str();
     info.stage = stage;
+
+    // shader modules might be recreated with the same handle, hash the code instead
+    this->code.assign(reinterpret_cast<const char*>(code.data()), code.size());
+    hashValue = HashCombine(std::hash<std::string>{}(this->code), stage, this->entry);
 }
 
 Shader::~Shader() {
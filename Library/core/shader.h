@@ -22,11 +22,21 @@ namespace slim {
         virtual ~Shader();
         VkPipelineShaderStageCreateInfo GetInfo() const;
 
+        // hash of spirv code, stage and entry, stable across runs
+        size_t GetHash() const { return hashValue; }
+
+        // spirv code, compared along with stage and entry when pipelines are shared
+        const std::string& GetCode() const { return code; }
+        VkShaderStageFlagBits GetStage() const { return info.stage; }
+        const std::string& GetEntry() const { return entry; }
+
         void SetName(const std::string& name) const;
     private:
         Device* device = nullptr;
         std::string entry = "main";
         VkPipelineShaderStageCreateInfo info = {};
+        std::string code = "";
+        size_t hashValue = 0;
     };
 
     #define SHADER_VARIANT(NAME, TYPE, STAGE)                                                                                     \
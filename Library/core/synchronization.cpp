@@ -1,6 +1,10 @@
+#include <algorithm>
 #include "core/debug.h"
 #include "core/window.h"
 #include "core/vkutils.h"
+#include "core/image.h"
+#include "core/buffer.h"
+#include "core/commands.h"
 
 using namespace slim;
 
@@ -19,6 +23,64 @@ Semaphore::~Semaphore() {
     }
 }
 
+TimelineSemaphore::TimelineSemaphore(Device *device, uint64_t initialValue) : device(device) {
+    VkSemaphoreTypeCreateInfo typeCreateInfo = {};
+    typeCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeCreateInfo.initialValue = initialValue;
+    typeCreateInfo.pNext = nullptr;
+
+    VkSemaphoreCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    createInfo.flags = 0;
+    createInfo.pNext = &typeCreateInfo;
+    ErrorCheck(DeviceDispatch(vkCreateSemaphore(*device, &createInfo, nullptr, &handle)), "create timeline semaphore");
+}
+
+TimelineSemaphore::~TimelineSemaphore() {
+    if (handle) {
+        DeviceDispatch(vkDestroySemaphore(*device, handle, nullptr));
+        handle = nullptr;
+    }
+}
+
+uint64_t TimelineSemaphore::GetValue() const {
+    uint64_t value = 0;
+    ErrorCheck(DeviceDispatch(vkGetSemaphoreCounterValue(*device, handle, &value)), "get semaphore counter value");
+    return value;
+}
+
+void TimelineSemaphore::Signal(uint64_t value) const {
+    VkSemaphoreSignalInfo signalInfo = {};
+    signalInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO;
+    signalInfo.semaphore = handle;
+    signalInfo.value = value;
+    ErrorCheck(DeviceDispatch(vkSignalSemaphore(*device, &signalInfo)), "signal timeline semaphore");
+}
+
+bool TimelineSemaphore::Wait(uint64_t value, uint64_t timeout) const {
+    VkSemaphoreWaitInfo waitInfo = {};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &handle;
+    waitInfo.pValues = &value;
+    VkResult result = DeviceDispatch(vkWaitSemaphores(*device, &waitInfo, timeout));
+    if (result == VK_TIMEOUT) return false;
+    ErrorCheck(result, "wait for timeline semaphore");
+    return true;
+}
+
+void TimelineSemaphore::SetName(const std::string& name) const {
+    if (device->IsDebuggerEnabled()) {
+        VkDebugMarkerObjectNameInfoEXT nameInfo = {};
+        nameInfo.sType = VK_STRUCTURE_TYPE_DEBUG_MARKER_OBJECT_NAME_INFO_EXT;
+        nameInfo.objectType = VK_DEBUG_REPORT_OBJECT_TYPE_SEMAPHORE_EXT;
+        nameInfo.object = (uint64_t) handle;
+        nameInfo.pObjectName = name.c_str();
+        ErrorCheck(DeviceDispatch(vkDebugMarkerSetObjectNameEXT(*device, &nameInfo)), "set semaphore name");
+    }
+}
+
 Fence::Fence(Device *device, bool signaled) : device(device)  {
     VkFenceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
@@ -53,6 +115,10 @@ void Fence::Wait(uint64_t timeout) const {
     ErrorCheck(DeviceDispatch(vkWaitForFences(*device, 1, &handle, VK_TRUE, timeout)), "wait for fence");
 }
 
+bool Fence::IsSignaled() const {
+    return DeviceDispatch(vkGetFenceStatus(*device, handle)) == VK_SUCCESS;
+}
+
 Event::Event(Device *device, bool deviceOnly) : device(device)  {
     VkEventCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_EVENT_CREATE_INFO;
@@ -78,3 +144,113 @@ void Event::SetName(const std::string& name) const {
         ErrorCheck(DeviceDispatch(vkDebugMarkerSetObjectNameEXT(*device, &nameInfo)), "set event name");
     }
 }
+
+void BarrierBatch::AddImageBarrier(Image *image, VkImageLayout dstLayout,
+                                   VkPipelineStageFlags srcStages, VkPipelineStageFlags dstStages,
+                                   uint32_t baseLayer, uint32_t layerCount,
+                                   uint32_t mipLevel, uint32_t levelCount) {
+    if (layerCount == 0) layerCount = image->Layers();
+    if (levelCount == 0) levelCount = image->MipLevels();
+
+    VkImageLayout srcLayout = image->layouts[baseLayer][mipLevel];
+    if (srcLayout == dstLayout) return;
+
+    VkImageMemoryBarrier barrier = LayoutTransitionBarrier(image, srcLayout, dstLayout, baseLayer, layerCount, mipLevel, levelCount);
+
+    // a second transition of the same subresources in this batch continues the first one
+    auto it = std::find_if(imageBarriers.begin(), imageBarriers.end(), [&](const VkImageMemoryBarrier &other) {
+        return other.image == barrier.image
+            && other.subresourceRange.baseArrayLayer == baseLayer
+            && other.subresourceRange.layerCount == layerCount
+            && other.subresourceRange.baseMipLevel == mipLevel
+            && other.subresourceRange.levelCount == levelCount;
+    });
+    if (it != imageBarriers.end()) {
+        it->newLayout = dstLayout;
+        it->dstAccessMask |= barrier.dstAccessMask;
+    } else {
+        imageBarriers.push_back(barrier);
+    }
+
+    srcStageMask |= srcStages;
+    dstStageMask |= dstStages;
+
+    for (uint32_t i = baseLayer; i < baseLayer + layerCount; i++)
+        for (uint32_t j = mipLevel; j < mipLevel + levelCount; j++)
+            image->layouts[i][j] = dstLayout;
+}
+
+void BarrierBatch::AddBufferBarrier(Buffer *buffer,
+                                    VkAccessFlags srcAccess, VkAccessFlags dstAccess,
+                                    VkPipelineStageFlags srcStages, VkPipelineStageFlags dstStages,
+                                    VkDeviceSize offset, VkDeviceSize size) {
+    if (size == VK_WHOLE_SIZE) size = buffer->Size() - offset;
+
+    // barriers on the same buffer are merged into one covering both ranges
+    VkBuffer handle = *buffer;
+    auto it = std::find_if(bufferBarriers.begin(), bufferBarriers.end(), [&](const VkBufferMemoryBarrier &other) {
+        return other.buffer == handle;
+    });
+    if (it != bufferBarriers.end()) {
+        VkDeviceSize end = std::max(it->offset + it->size, offset + size);
+        it->offset = std::min(it->offset, offset);
+        it->size = end - it->offset;
+        it->srcAccessMask |= srcAccess;
+        it->dstAccessMask |= dstAccess;
+    } else {
+        VkBufferMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.pNext = nullptr;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = handle;
+        barrier.offset = offset;
+        barrier.size = size;
+        bufferBarriers.push_back(barrier);
+    }
+
+    srcStageMask |= srcStages;
+    dstStageMask |= dstStages;
+}
+
+void BarrierBatch::AddMemoryBarrier(VkAccessFlags srcAccess, VkAccessFlags dstAccess,
+                                    VkPipelineStageFlags srcStages, VkPipelineStageFlags dstStages) {
+    memoryBarrier.srcAccessMask |= srcAccess;
+    memoryBarrier.dstAccessMask |= dstAccess;
+    srcStageMask |= srcStages;
+    dstStageMask |= dstStages;
+}
+
+bool BarrierBatch::Empty() const {
+    return imageBarriers.empty() && bufferBarriers.empty()
+        && memoryBarrier.srcAccessMask == 0 && memoryBarrier.dstAccessMask == 0
+        && srcStageMask == 0 && dstStageMask == 0;
+}
+
+void BarrierBatch::Flush(CommandBuffer *commandBuffer) {
+    if (Empty()) return;
+
+    // execution-only dependencies still need valid stages on both sides
+    VkPipelineStageFlags srcStages = srcStageMask ? srcStageMask : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    VkPipelineStageFlags dstStages = dstStageMask ? dstStageMask : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    bool memory = memoryBarrier.srcAccessMask != 0 || memoryBarrier.dstAccessMask != 0;
+
+    Device *device = commandBuffer->GetDevice();
+    DeviceDispatch(vkCmdPipelineBarrier(
+        *commandBuffer,
+        srcStages, dstStages,
+        0,
+        memory ? 1 : 0, memory ? &memoryBarrier : nullptr,       // memory barriers
+        bufferBarriers.size(), bufferBarriers.data(),            // buffer memory barriers
+        imageBarriers.size(), imageBarriers.data()               // image memory barriers
+    ));
+
+    srcStageMask = 0;
+    dstStageMask = 0;
+    memoryBarrier.srcAccessMask = 0;
+    memoryBarrier.dstAccessMask = 0;
+    bufferBarriers.clear();
+    imageBarriers.clear();
+}
@@ -10,6 +10,10 @@
 
 namespace slim {
 
+    class Image;
+    class Buffer;
+    class CommandBuffer;
+
     // semaphores are a synchronization primitive that can be used to insert a dependency between
     // queue operations and the host.
     class Semaphore final : public NotCopyable, public NotMovable, public ReferenceCountable, public TriviallyConvertible<VkSemaphore> {
@@ -21,6 +25,20 @@ namespace slim {
         SmartPtr<Device> device = nullptr;
     };
 
+    // timeline semaphores carry a monotonically increasing 64-bit payload, queue operations and the host
+    // can wait for or signal a specific value, and the same value can be waited on any number of times.
+    class TimelineSemaphore final : public NotCopyable, public NotMovable, public ReferenceCountable, public TriviallyConvertible<VkSemaphore> {
+    public:
+        explicit TimelineSemaphore(Device *device, uint64_t initialValue = 0);
+        virtual ~TimelineSemaphore();
+        uint64_t GetValue() const;
+        void Signal(uint64_t value) const;
+        bool Wait(uint64_t value, uint64_t timeout = UINT64_MAX) const;
+        void SetName(const std::string& name) const;
+    private:
+        SmartPtr<Device> device = nullptr;
+    };
+
     // fences are a synchronization primitive that can be used to insert a dependency from a queue to the host
     class Fence final : public NotCopyable, public NotMovable, public ReferenceCountable, public TriviallyConvertible<VkFence> {
     public:
@@ -28,6 +46,7 @@ namespace slim {
         virtual ~Fence();
         void Reset() const;
         void Wait(uint64_t timeout = UINT64_MAX) const;
+        bool IsSignaled() const;
         void SetName(const std::string& name) const;
     private:
         SmartPtr<Device> device = nullptr;
@@ -44,6 +63,40 @@ namespace slim {
         SmartPtr<Device> device = nullptr;
     };
 
+    // barrier batches collect memory, buffer and image barriers that become due at the same point,
+    // so that they are recorded with a single vkCmdPipelineBarrier using the union of their stages.
+    // Barriers on the same buffer or the same image subresources are merged into one.
+    class BarrierBatch final {
+    public:
+        // layout transition from the image's current layout, skipped when the layout does not change
+        void AddImageBarrier(Image *image, VkImageLayout dstLayout,
+                             VkPipelineStageFlags srcStages, VkPipelineStageFlags dstStages,
+                             uint32_t baseLayer = 0, uint32_t layerCount = 0,
+                             uint32_t mipLevel = 0, uint32_t levelCount = 0);
+
+        void AddBufferBarrier(Buffer *buffer,
+                              VkAccessFlags srcAccess, VkAccessFlags dstAccess,
+                              VkPipelineStageFlags srcStages, VkPipelineStageFlags dstStages,
+                              VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+
+        void AddMemoryBarrier(VkAccessFlags srcAccess, VkAccessFlags dstAccess,
+                              VkPipelineStageFlags srcStages, VkPipelineStageFlags dstStages);
+
+        // record all pending barriers and clear the batch
+        void Flush(CommandBuffer *commandBuffer);
+
+        bool   Empty() const;
+        size_t GetImageBarrierCount() const { return imageBarriers.size(); }
+        size_t GetBufferBarrierCount() const { return bufferBarriers.size(); }
+
+    private:
+        VkPipelineStageFlags srcStageMask = 0;
+        VkPipelineStageFlags dstStageMask = 0;
+        VkMemoryBarrier memoryBarrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER, nullptr, 0, 0 };
+        std::vector<VkBufferMemoryBarrier> bufferBarriers;
+        std::vector<VkImageMemoryBarrier> imageBarriers;
+    };
+
 } // end of namespace slim
 
 #endif // end of SLIM_CORE_SYNCHRONIZATION_H
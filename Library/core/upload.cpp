@@ -0,0 +1,460 @@
+#include <cstring>
+#include <algorithm>
+#include <unordered_set>
+#include "core/debug.h"
+#include "core/upload.h"
+#include "core/vkutils.h"
+
+using namespace slim;
+
+UploadManager::UploadManager(Device *device, size_t ringSize) : device(device) {
+    QueueFamilyIndices indices = device->GetQueueFamilyIndices();
+
+    // graphics family is where uploaded resources are consumed
+    graphicsFamily = indices.graphics.has_value() ? indices.graphics.value() : indices.compute.value();
+
+    // prefer a dedicated transfer family (DMA engine), so uploads overlap with rendering
+    if (indices.dedicatedTransfer.has_value()) {
+        queueFamily = indices.dedicatedTransfer.value();
+    } else if (indices.transfer.has_value()) {
+        queueFamily = indices.transfer.value();
+    } else {
+        queueFamily = graphicsFamily;
+    }
+
+    // without timeline semaphores, each batch signals a fence
+    if (device->GetContext()->IsTimelineSemaphoreEnabled()) {
+        semaphore = SlimPtr<TimelineSemaphore>(device, 0);
+        semaphore->SetName("UploadManager::Timeline");
+    }
+
+    ring = SlimPtr<StagingBuffer>(device, ringSize);
+    ring->SetName("UploadManager::Ring");
+
+    graphicsCommandPool = SlimPtr<CommandPool>(device, graphicsFamily);
+
+    device->RegisterUploadManager(this);
+}
+
+UploadManager::~UploadManager() {
+    device->UnregisterUploadManager(this);
+    if (pendingCopies > 0) {
+        Submit();
+    }
+    Wait(UploadTicket { timelineValue });
+    Retire(false);
+}
+
+void UploadManager::Upload(Buffer *buffer, size_t offset, const void *data, size_t size) {
+    if (size == 0) return;
+
+    // host visible buffers do not need staging
+    if (buffer->HostVisible()) {
+        buffer->SetData(const_cast<void*>(data), size, offset);
+        return;
+    }
+
+    Buffer *staging = nullptr;
+    size_t stagingOffset = Allocate(size, 4, &staging);
+    std::memcpy(staging->GetData<uint8_t>(stagingOffset), data, size);
+    staging->Flush(stagingOffset, size);
+
+    // merge with previous copy when both source and destination match
+    if (bufferCopies.empty() || bufferCopies.back().src != staging || bufferCopies.back().dst != buffer) {
+        bufferCopies.push_back(BufferCopies { staging, buffer, {} });
+        current.buffers.push_back(buffer);
+    }
+
+    // coalesce regions contiguous in both source and destination
+    std::vector<VkBufferCopy> &regions = bufferCopies.back().regions;
+    if (!regions.empty()
+        && regions.back().srcOffset + regions.back().size == stagingOffset
+        && regions.back().dstOffset + regions.back().size == offset) {
+        regions.back().size += size;
+    } else {
+        regions.push_back(VkBufferCopy { stagingOffset, offset, size });
+    }
+
+    pendingCopies++;
+}
+
+void UploadManager::Upload(Image *image, const void *data, size_t size,
+                           uint32_t baseLayer, uint32_t layerCount, uint32_t mipLevel,
+                           VkImageAspectFlags aspectMask) {
+    if (size == 0) return;
+
+    // 16 bytes covers texel size of every uncompressed and block compressed format
+    Buffer *staging = nullptr;
+    size_t stagingOffset = Allocate(size, 16, &staging);
+    std::memcpy(staging->GetData<uint8_t>(stagingOffset), data, size);
+    staging->Flush(stagingOffset, size);
+
+    VkExtent3D extent = image->GetExtent();
+
+    VkBufferImageCopy region = {};
+    region.bufferOffset = stagingOffset;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = aspectMask;
+    region.imageSubresource.mipLevel = mipLevel;
+    region.imageSubresource.baseArrayLayer = baseLayer;
+    region.imageSubresource.layerCount = layerCount;
+    region.imageOffset = VkOffset3D { 0, 0, 0 };
+    region.imageExtent = VkExtent3D {
+        std::max(1u, extent.width >> mipLevel),
+        std::max(1u, extent.height >> mipLevel),
+        std::max(1u, extent.depth >> mipLevel),
+    };
+
+    imageCopies.push_back(ImageCopy { staging, image, region });
+    current.images.push_back(image);
+    pendingCopies++;
+}
+
+UploadTicket UploadManager::Submit() {
+    if (pendingCopies == 0) {
+        return UploadTicket { timelineValue };
+    }
+
+    // recycle command pools from completed batches
+    Retire(false);
+
+    SmartPtr<CommandPool> commandPool;
+    if (commandPools.empty()) {
+        commandPool = SlimPtr<CommandPool>(device, queueFamily);
+    } else {
+        commandPool = commandPools.back();
+        commandPools.pop_back();
+    }
+
+    const bool release = RequiresOwnershipTransfer();
+    const uint64_t value = ++timelineValue;
+
+    CommandBuffer *commandBuffer = commandPool->Request();
+    commandBuffer->Begin();
+
+    // transit image subresources into transfer dst layout, batched into one barrier
+    std::vector<VkImageMemoryBarrier> imageBarriers;
+    for (const ImageCopy &copy : imageCopies) {
+        const VkImageSubresourceLayers &subresource = copy.region.imageSubresource;
+        for (uint32_t layer = subresource.baseArrayLayer; layer < subresource.baseArrayLayer + subresource.layerCount; layer++) {
+            VkImageLayout &layout = copy.dst->layouts[layer][subresource.mipLevel];
+            if (layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) continue;
+
+            VkImageMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.oldLayout = layout;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = *copy.dst;
+            barrier.subresourceRange = VkImageSubresourceRange { subresource.aspectMask, subresource.mipLevel, 1, layer, 1 };
+            imageBarriers.push_back(barrier);
+
+            layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        }
+    }
+    if (!imageBarriers.empty()) {
+        DeviceDispatch(vkCmdPipelineBarrier(
+            *commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0,
+            0, nullptr,
+            0, nullptr,
+            imageBarriers.size(), imageBarriers.data()));
+    }
+
+    // buffer copies, one command per (staging, destination) pair
+    for (const BufferCopies &copies : bufferCopies) {
+        DeviceDispatch(vkCmdCopyBuffer(*commandBuffer, *copies.src, *copies.dst, copies.regions.size(), copies.regions.data()));
+    }
+
+    // image copies, consecutive regions for the same (staging, destination) pair are recorded together
+    std::vector<VkBufferImageCopy> regions;
+    for (size_t i = 0; i < imageCopies.size(); i++) {
+        regions.push_back(imageCopies[i].region);
+        bool last = i + 1 == imageCopies.size()
+                 || imageCopies[i + 1].src != imageCopies[i].src
+                 || imageCopies[i + 1].dst != imageCopies[i].dst;
+        if (last) {
+            DeviceDispatch(vkCmdCopyBufferToImage(*commandBuffer, *imageCopies[i].src, *imageCopies[i].dst,
+                                                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, regions.size(), regions.data()));
+            regions.clear();
+        }
+    }
+
+    // make copies visible to consumers, or release ownership to graphics family
+    Acquisition acquisition = {};
+    acquisition.value = value;
+
+    std::vector<VkMemoryBarrier> memoryBarriers;
+    std::vector<VkBufferMemoryBarrier> bufferBarriers;
+    imageBarriers.clear();
+
+    if (!bufferCopies.empty() && !release) {
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        memoryBarriers.push_back(barrier);
+    }
+
+    if (release) {
+        std::unordered_set<Buffer*> released;
+        for (const BufferCopies &copies : bufferCopies) {
+            // concurrent buffers have no owner, the semaphore alone orders the copies before their use
+            if (copies.dst->Concurrent()) continue;
+            if (!released.insert(copies.dst).second) continue;
+
+            VkBufferMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = 0;
+            barrier.srcQueueFamilyIndex = queueFamily;
+            barrier.dstQueueFamilyIndex = graphicsFamily;
+            barrier.buffer = *copies.dst;
+            barrier.offset = 0;
+            barrier.size = VK_WHOLE_SIZE;
+            bufferBarriers.push_back(barrier);
+
+            // matching acquire on graphics queue
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+            acquisition.bufferBarriers.push_back(barrier);
+        }
+    }
+
+    for (const ImageCopy &copy : imageCopies) {
+        const VkImageSubresourceLayers &subresource = copy.region.imageSubresource;
+        for (uint32_t layer = subresource.baseArrayLayer; layer < subresource.baseArrayLayer + subresource.layerCount; layer++) {
+            VkImageLayout &layout = copy.dst->layouts[layer][subresource.mipLevel];
+            if (layout != VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) continue;
+
+            VkImageMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = release ? 0 : VK_ACCESS_SHADER_READ_BIT;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barrier.srcQueueFamilyIndex = release ? queueFamily : VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = release ? graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = *copy.dst;
+            barrier.subresourceRange = VkImageSubresourceRange { subresource.aspectMask, subresource.mipLevel, 1, layer, 1 };
+            imageBarriers.push_back(barrier);
+
+            // matching acquire on graphics queue, layout transition is specified identically
+            if (release) {
+                barrier.srcAccessMask = 0;
+                barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                acquisition.imageBarriers.push_back(barrier);
+            }
+
+            layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        }
+    }
+
+    if (!memoryBarriers.empty() || !bufferBarriers.empty() || !imageBarriers.empty()) {
+        DeviceDispatch(vkCmdPipelineBarrier(
+            *commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            release ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            0,
+            memoryBarriers.size(), memoryBarriers.data(),
+            bufferBarriers.size(), bufferBarriers.data(),
+            imageBarriers.size(), imageBarriers.data()));
+    }
+
+    commandBuffer->End();
+    if (semaphore) {
+        commandBuffer->Signal(semaphore, value);
+    } else {
+        if (fences.empty()) {
+            current.fence = SlimPtr<Fence>(device);
+        } else {
+            current.fence = fences.back();
+            fences.pop_back();
+        }
+        commandBuffer->Signal(current.fence);
+    }
+    commandBuffer->Submit();
+
+    // keep staging memory and resources alive until the batch completes
+    current.value = value;
+    current.ringEnd = ringHead;
+    current.commandPool = commandPool;
+    inflight.push_back(std::move(current));
+    current = Batch {};
+
+    if (release) {
+        acquisitions.push_back(std::move(acquisition));
+    }
+
+    bufferCopies.clear();
+    imageCopies.clear();
+    pendingCopies = 0;
+
+    return UploadTicket { value };
+}
+
+void UploadManager::Acquire(CommandBuffer *commandBuffer, const UploadTicket &ticket, VkPipelineStageFlags stages) {
+    if (ticket.value == 0) return;
+
+    // without timeline semaphore, the host waits for the batches before their acquisition is submitted
+    if (!semaphore) {
+        Wait(ticket);
+    }
+
+    while (!acquisitions.empty() && acquisitions.front().value <= ticket.value) {
+        Record(commandBuffer, acquisitions.front());
+        acquisitions.pop_front();
+    }
+    acquiredValue = std::max(acquiredValue, ticket.value);
+
+    if (semaphore) {
+        commandBuffer->Wait(semaphore, ticket.value, stages);
+    }
+}
+
+void UploadManager::AcquirePending(CommandBuffer *commandBuffer, uint32_t queueFamily, VkPipelineStageFlags stages) {
+    if (acquiredValue >= timelineValue) return;
+
+    // ownership is only transferred to the graphics family
+    if (queueFamily == graphicsFamily) {
+        Acquire(commandBuffer, UploadTicket { timelineValue }, stages);
+    } else if (semaphore) {
+        commandBuffer->Wait(semaphore, timelineValue, stages);
+    } else {
+        Wait(UploadTicket { timelineValue });
+    }
+}
+
+void UploadManager::Record(CommandBuffer *commandBuffer, Acquisition &acquisition) {
+    if (acquisition.bufferBarriers.empty() && acquisition.imageBarriers.empty()) return;
+
+    // src stage of an acquire operation is ignored, it is ordered by the semaphore wait instead
+    DeviceDispatch(vkCmdPipelineBarrier(
+        *commandBuffer,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        0,
+        0, nullptr,
+        acquisition.bufferBarriers.size(), acquisition.bufferBarriers.data(),
+        acquisition.imageBarriers.size(), acquisition.imageBarriers.data()));
+}
+
+void UploadManager::Flush() {
+    UploadTicket ticket = Submit();
+
+    // finish ownership transfer on graphics queue
+    if (!acquisitions.empty()) {
+        graphicsCommandPool->Reset();
+        CommandBuffer *commandBuffer = graphicsCommandPool->Request();
+        commandBuffer->Begin();
+        Acquire(commandBuffer, ticket);
+        commandBuffer->End();
+        if (semaphore) {
+            ticket.value = ++timelineValue;
+            commandBuffer->Signal(semaphore, ticket.value);
+            commandBuffer->Submit();
+        } else {
+            if (!graphicsFence) {
+                graphicsFence = SlimPtr<Fence>(device);
+            }
+            commandBuffer->Signal(graphicsFence);
+            commandBuffer->Submit();
+            graphicsFence->Wait();
+            graphicsFence->Reset();
+        }
+    }
+
+    Wait(ticket);
+    acquiredValue = timelineValue;
+    Retire(false);
+}
+
+bool UploadManager::IsComplete(const UploadTicket &ticket) const {
+    return GetCompletedValue() >= ticket.value;
+}
+
+void UploadManager::Wait(const UploadTicket &ticket) const {
+    if (semaphore) {
+        semaphore->Wait(ticket.value);
+        return;
+    }
+    for (const Batch &batch : inflight) {
+        if (batch.value > ticket.value) break;
+        batch.fence->Wait();
+    }
+}
+
+uint64_t UploadManager::GetCompletedValue() const {
+    if (semaphore) {
+        return semaphore->GetValue();
+    }
+
+    // the first batch whose fence is not signaled bounds the completed value
+    for (const Batch &batch : inflight) {
+        if (!batch.fence->IsSignaled()) return batch.value - 1;
+    }
+    return timelineValue;
+}
+
+size_t UploadManager::Allocate(size_t size, size_t alignment, Buffer **buffer) {
+    const uint64_t capacity = ring->Size();
+
+    // large uploads get a dedicated staging buffer instead of draining the ring
+    if (size > capacity / 2) {
+        auto staging = SlimPtr<StagingBuffer>(device, size);
+        current.stagingBuffers.push_back(staging.get());
+        *buffer = staging;
+        return 0;
+    }
+
+    while (true) {
+        uint64_t offset = ringHead % capacity;
+        uint64_t start = (offset + alignment - 1) / alignment * alignment;
+
+        // allocation does not fit before the end, continue from the beginning of next lap
+        if (start + size > capacity) {
+            start = capacity;
+        }
+
+        uint64_t required = (start - offset) + size;
+        if (capacity - (ringHead - ringTail) >= required) {
+            ringHead += required;
+            *buffer = ring;
+            return start % capacity;
+        }
+
+        if (!inflight.empty()) {
+            // wait for the oldest batch to free its staging memory
+            Retire(true);
+        } else {
+            // current batch occupies the ring by itself, submit it to make room
+            Submit();
+        }
+    }
+}
+
+void UploadManager::Retire(bool wait) {
+    if (inflight.empty()) return;
+
+    uint64_t completed = GetCompletedValue();
+    if (wait && completed < inflight.front().value) {
+        Wait(UploadTicket { inflight.front().value });
+        completed = inflight.front().value;
+    }
+
+    while (!inflight.empty() && inflight.front().value <= completed) {
+        Batch &batch = inflight.front();
+        ringTail = batch.ringEnd;
+        batch.commandPool->Reset();
+        commandPools.push_back(batch.commandPool);
+        if (batch.fence) {
+            batch.fence->Reset();
+            fences.push_back(batch.fence);
+        }
+        inflight.pop_front();
+    }
+}
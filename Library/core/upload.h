@@ -0,0 +1,150 @@
+#ifndef SLIM_CORE_UPLOAD_H
+#define SLIM_CORE_UPLOAD_H
+
+#include <deque>
+#include <vector>
+
+#include "core/vulkan.h"
+#include "core/image.h"
+#include "core/buffer.h"
+#include "core/device.h"
+#include "core/commands.h"
+#include "core/synchronization.h"
+#include "utility/interface.h"
+
+namespace slim {
+
+    // UploadTicket identifies a submitted upload batch,
+    // it is the value the upload manager's timeline semaphore reaches when the batch completes
+    // (batches signal fences instead where timeline semaphores are not enabled).
+    struct UploadTicket {
+        uint64_t value = 0;
+    };
+
+    /**
+     * UploadManager streams data to device local buffers and images on the transfer queue.
+     * 1. data is copied into a persistently mapped staging ring buffer
+     * 2. copies are recorded into one command buffer per batch, copies to the same buffer are merged
+     * 3. each batch signals a timeline semaphore, returned to the caller as an UploadTicket,
+     *    devices without timeline semaphore support signal a fence per batch, and waits happen on the host
+     * 4. when the transfer queue family differs from the graphics one, resources are released at the
+     *    end of the batch and must be acquired on the graphics queue with Acquire() before use.
+     *    A release transfers the whole buffer, so exclusive buffers must not be in use on the graphics queue
+     *    while they are uploaded to, buffers updated in place while in use should be created concurrent.
+     * 5. batches not acquired explicitly are acquired by the next command buffer passed to
+     *    Device::AcquireUploads(), render graphs and Device::Execute() do this for every submission,
+     *    so uploads are expected to be submitted from the thread recording frames.
+     *
+     * Uploaded images end up in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL.
+     **/
+    class UploadManager final : public NotCopyable, public NotMovable, public ReferenceCountable {
+    public:
+        constexpr static size_t DEFAULT_RING_SIZE = 32 * 1024 * 1024;
+
+        explicit UploadManager(Device *device, size_t ringSize = DEFAULT_RING_SIZE);
+        virtual ~UploadManager();
+
+        // queue copies into the current batch
+        void Upload(Buffer *buffer, size_t offset, const void *data, size_t size);
+        void Upload(Image *image, const void *data, size_t size,
+                    uint32_t baseLayer = 0, uint32_t layerCount = 1, uint32_t mipLevel = 0,
+                    VkImageAspectFlags aspectMask = VK_IMAGE_ASPECT_COLOR_BIT);
+
+        template <typename T>
+        void Upload(Buffer *buffer, const std::vector<T> &data, size_t offset = 0);
+
+        // submit the current batch to the transfer queue without waiting
+        UploadTicket Submit();
+
+        // record queue family ownership acquisition for all batches up to ticket,
+        // and make the command buffer (on graphics queue) wait for the ticket
+        void Acquire(CommandBuffer *commandBuffer, const UploadTicket &ticket,
+                     VkPipelineStageFlags stages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+
+        // acquire every batch submitted so far, command buffers of other queue families only wait for them
+        void AcquirePending(CommandBuffer *commandBuffer, uint32_t queueFamily,
+                            VkPipelineStageFlags stages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+
+        // submit, acquire on graphics queue and block until everything is done
+        void Flush();
+
+        bool IsComplete(const UploadTicket &ticket) const;
+        void Wait(const UploadTicket &ticket) const;
+
+        // nullptr when timeline semaphores are not enabled
+        TimelineSemaphore* GetSemaphore() const { return semaphore; }
+        uint32_t           GetQueueFamily() const { return queueFamily; }
+        bool               RequiresOwnershipTransfer() const { return queueFamily != graphicsFamily; }
+        size_t             GetPendingCopies() const { return pendingCopies; }
+
+    private:
+        struct BufferCopies {
+            Buffer* src;
+            Buffer* dst;
+            std::vector<VkBufferCopy> regions;
+        };
+
+        struct ImageCopy {
+            Buffer* src;
+            Image* dst;
+            VkBufferImageCopy region;
+        };
+
+        // in-flight batch, staging memory and resources are kept alive until it completes
+        struct Batch {
+            uint64_t value;
+            uint64_t ringEnd;
+            SmartPtr<CommandPool> commandPool;
+            SmartPtr<Fence> fence;
+            std::vector<SmartPtr<Buffer>> stagingBuffers;
+            std::vector<SmartPtr<Buffer>> buffers;
+            std::vector<SmartPtr<Image>> images;
+        };
+
+        // barriers that need to be recorded on the graphics queue to finish ownership transfer
+        struct Acquisition {
+            uint64_t value;
+            std::vector<VkBufferMemoryBarrier> bufferBarriers;
+            std::vector<VkImageMemoryBarrier> imageBarriers;
+        };
+
+        size_t Allocate(size_t size, size_t alignment, Buffer **buffer);
+        void   Retire(bool wait);
+        uint64_t GetCompletedValue() const;
+        void   Record(CommandBuffer *commandBuffer, Acquisition &acquisition);
+
+    private:
+        SmartPtr<Device>            device;
+        SmartPtr<TimelineSemaphore> semaphore;
+        uint64_t                    timelineValue = 0;
+        uint64_t                    acquiredValue = 0;
+        uint32_t                    queueFamily = 0;
+        uint32_t                    graphicsFamily = 0;
+
+        // staging ring, positions grow monotonically and wrap around by modulo
+        SmartPtr<StagingBuffer>     ring;
+        uint64_t                    ringHead = 0;
+        uint64_t                    ringTail = 0;
+
+        // current batch
+        size_t                      pendingCopies = 0;
+        std::vector<BufferCopies>   bufferCopies;
+        std::vector<ImageCopy>      imageCopies;
+        Batch                       current = {};
+
+        std::deque<Batch>           inflight;
+        std::deque<Acquisition>     acquisitions;
+        std::vector<SmartPtr<CommandPool>> commandPools;
+        std::vector<SmartPtr<Fence>> fences;
+        SmartPtr<CommandPool>       graphicsCommandPool;
+        SmartPtr<Fence>             graphicsFence;
+    };
+
+    template <typename T>
+    void UploadManager::Upload(Buffer *buffer, const std::vector<T> &data, size_t offset) {
+        Upload(buffer, offset, data.data(), data.size() * sizeof(T));
+    }
+
+} // end of namespace slim
+
+#endif // end of SLIM_CORE_UPLOAD_H
@@ -223,6 +223,15 @@ namespace slim {
             i++;
         }
 
+        // look for a transfer-only queue family, copies on it can run in parallel with graphics/compute
+        for (uint32_t index = 0; index < queueFamilyCount; index++) {
+            VkQueueFlags flags = queueFamilies[index].queueFlags;
+            if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+                indices.dedicatedTransfer = index;
+                break;
+            }
+        }
+
         return indices;
     }
 
@@ -351,17 +360,11 @@ namespace slim {
         );
     }
 
-    void PrepareLayoutTransition(CommandBuffer* cmdbuffer,
-                                 Image *image,
-                                 VkImageLayout srcLayout,
-                                 VkImageLayout dstLayout,
-                                 VkPipelineStageFlags srcStageMask,
-                                 VkPipelineStageFlags dstStageMask,
-                                 uint32_t baseLayer, uint32_t layerCount,
-                                 uint32_t mipLevel, uint32_t mipCount) {
-        // no need to transition
-        if (srcLayout == dstLayout) return;
-
+    VkImageMemoryBarrier LayoutTransitionBarrier(Image *image,
+                                                 VkImageLayout srcLayout,
+                                                 VkImageLayout dstLayout,
+                                                 uint32_t baseLayer, uint32_t layerCount,
+                                                 uint32_t mipLevel, uint32_t mipCount) {
         VkAccessFlags srcAccessMask = 0;
         VkAccessFlags dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
 
@@ -440,10 +443,36 @@ namespace slim {
                 throw std::runtime_error("unimplemented image dst layout transition");
         }
 
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout           = srcLayout;
+        barrier.newLayout           = dstLayout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image               = *image;
+        barrier.subresourceRange    = subresourceRange;
+        barrier.srcAccessMask       = srcAccessMask;
+        barrier.dstAccessMask       = dstAccessMask;
+        return barrier;
+    }
+
+    void PrepareLayoutTransition(CommandBuffer* cmdbuffer,
+                                 Image *image,
+                                 VkImageLayout srcLayout,
+                                 VkImageLayout dstLayout,
+                                 VkPipelineStageFlags srcStageMask,
+                                 VkPipelineStageFlags dstStageMask,
+                                 uint32_t baseLayer, uint32_t layerCount,
+                                 uint32_t mipLevel, uint32_t mipCount) {
+        // no need to transition
+        if (srcLayout == dstLayout) return;
+
+        VkImageMemoryBarrier barrier = LayoutTransitionBarrier(image, srcLayout, dstLayout, baseLayer, layerCount, mipLevel, mipCount);
+
         LayoutTransition(cmdbuffer, image,
-                         subresourceRange,
+                         barrier.subresourceRange,
                          srcLayout, dstLayout,
-                         srcAccessMask, dstAccessMask,
+                         barrier.srcAccessMask, barrier.dstAccessMask,
                          srcStageMask, dstStageMask);
 
         for (uint32_t i = baseLayer; i < baseLayer + layerCount; i++)
@@ -27,6 +27,7 @@ namespace slim {
         std::optional<uint32_t> compute;
         std::optional<uint32_t> present;
         std::optional<uint32_t> transfer;
+        std::optional<uint32_t> dedicatedTransfer; // transfer-only family (DMA engine) if the device has one
     };
 
     struct SwapchainSupportDetails {
@@ -63,6 +64,13 @@ namespace slim {
                           VkPipelineStageFlags srcStageMask,
                           VkPipelineStageFlags dstStageMask);
 
+    // access masks and aspects for an image layout transition, without recording it
+    VkImageMemoryBarrier LayoutTransitionBarrier(Image *image,
+                                                 VkImageLayout srcLayout,
+                                                 VkImageLayout dstLayout,
+                                                 uint32_t baseLayer, uint32_t layerCount,
+                                                 uint32_t mipLevel, uint32_t mipCount);
+
     void PrepareLayoutTransition(CommandBuffer* cmdbuffer,
                                  Image *image,
                                  VkImageLayout srcLayout,
@@ -175,9 +175,13 @@ void Window::InitSwapchain() {
 
 void Window::InitRenderFrames() {
     maxFramesInFlight = desc.maxFramesInFlight;
+
+    // all frames share the same pipelines, so each pipeline is only created once
+    auto pipelinePool = SlimPtr<PipelinePool>(device);
     for (uint32_t i = 0; i < desc.maxFramesInFlight; i++) {
         inflightFences.push_back(SlimPtr<Fence>(device));
         renderFrames.push_back(SlimPtr<RenderFrame>(device, desc.maxSetsPerPool));
+        renderFrames.back()->pipelinePool = pipelinePool;
     }
 }
 
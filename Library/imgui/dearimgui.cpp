@@ -172,6 +172,9 @@ void DearImGui::Draw(CommandBuffer *commandBuffer) const {
     ImGui::Render();
     ImGui::RenderPlatformWindowsDefault();
     ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), *commandBuffer);
+
+    // imgui binds its own pipeline and buffers
+    commandBuffer->InvalidateBindings();
 }
 
 void DearImGui::EnableDocking() {
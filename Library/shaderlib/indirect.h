@@ -0,0 +1,161 @@
+#ifndef SLIM_SHADER_LIB_INDIRECT_H
+#define SLIM_SHADER_LIB_INDIRECT_H
+
+#include "glsl.hpp"
+
+// number of uints per indirect command, VkDrawIndexedIndirectCommand is the larger one
+#define INDIRECT_COMMAND_SIZE 5
+
+// culling phases, matches OcclusionCulling::Phase plus one
+#define OCCLUSION_NONE  0
+#define OCCLUSION_EARLY 1   // draw what was visible in the previous frame
+#define OCCLUSION_LATE  2   // test against the depth pyramid, draw what became visible, update visibility
+
+// per instance data, matches scene::InstanceData
+struct InstanceData {
+    mat4 model;
+    vec4 boundsMin;     // local space bounds, w is unused
+    vec4 boundsMax;     // local space bounds, w is unused
+    uint batch;
+    uint count;         // index count for indexed draws, vertex count otherwise
+    uint first;         // first index for indexed draws, first vertex otherwise
+    int  vertexOffset;
+};
+
+// instances sharing mesh and material, matches scene::DrawBatch
+struct DrawBatch {
+    uint first;         // first instance, also the first draw command of this batch
+    uint count;
+    uint indexed;
+    uint firstCluster;  // first cluster, also the first draw command of this batch when culling meshlets
+};
+
+// meshlet of a mesh, matches scene::MeshletData
+struct MeshletData {
+    vec4 sphere;        // local space bounding sphere, a negative radius is never culled
+    vec4 cone;          // local space normal cone axis and cutoff, a cutoff of 1 is never culled
+    uint first;         // first index for indexed draws, first vertex otherwise
+    uint count;         // index count for indexed draws, vertex count otherwise
+    int  vertexOffset;
+    uint padding;
+};
+
+// meshlet of an instance, matches scene::ClusterData
+struct ClusterData {
+    uint instance;
+    uint meshlet;
+};
+
+// culling parameters, matches GPUCulling::CullingData
+struct CullingData {
+    vec4 planes[6];
+    uint instanceCount;
+    uint compact;       // 1: visible instances are compacted, 0: culled instances get instanceCount = 0
+    uint clusterCount;
+    uint padding;
+    vec4 eye;           // world space camera position, w is 1 when normal cones are used
+    mat4 viewProj;      // occlusion: projects world space bounds onto the depth pyramid
+    vec2 pyramidSize;   // occlusion: size of level 0 of the depth pyramid
+    uint pyramidLevels; // occlusion: levels of the depth pyramid
+    uint phase;         // OCCLUSION_NONE, OCCLUSION_EARLY or OCCLUSION_LATE
+};
+
+// one reduction step of the depth pyramid, matches OcclusionCulling::ReductionData
+struct DepthPyramidData {
+    uvec2 srcSize;      // size of the depth buffer or of the previous level
+    uvec2 dstSize;      // size of the level being written
+};
+
+// test local bounds against inward pointing frustum planes, invalid bounds are never culled
+SLIM_ATTR bool is_visible(vec4 planes[6], mat4 model, vec3 boundsMin, vec3 boundsMax) {
+    if (any(greaterThan(boundsMin, boundsMax))) {
+        return true;
+    }
+
+    // world space box of the transformed local box
+    vec3 center = vec3(model * vec4((boundsMin + boundsMax) * 0.5f, 1.0f));
+    vec3 extent = (boundsMax - boundsMin) * 0.5f;
+    mat3 m = mat3(model);
+    extent = abs(m[0]) * extent.x + abs(m[1]) * extent.y + abs(m[2]) * extent.z;
+
+    for (int i = 0; i < 6; i++) {
+        float s = dot(vec3(planes[i]), center) + planes[i].w;
+        float r = dot(abs(vec3(planes[i])), extent);
+        if (s + r < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// test a meshlet against inward pointing frustum planes, and its normal cone against the camera position,
+// cones are only used under rotation and uniform scale, which keep normal directions and winding
+SLIM_ATTR bool is_meshlet_visible(vec4 planes[6], vec4 eye, mat4 model, vec4 sphere, vec4 cone) {
+    if (sphere.w < 0.0f) {
+        return true;
+    }
+
+    mat3 m = mat3(model);
+    vec3 scales = vec3(length(m[0]), length(m[1]), length(m[2]));
+    float scale = max(scales.x, max(scales.y, scales.z));
+    vec3 center = vec3(model * vec4(vec3(sphere), 1.0f));
+    float radius = sphere.w * scale;
+
+    for (int i = 0; i < 6; i++) {
+        if (dot(vec3(planes[i]), center) + planes[i].w < -radius) {
+            return false;
+        }
+    }
+
+    float minScale = min(scales.x, min(scales.y, scales.z));
+    bool cones = eye.w != 0.0f && cone.w < 1.0f && scale > 0.0f && scale - minScale <= 1e-3f * scale && determinant(m) > 0.0f;
+    if (cones) {
+        vec3 axis = m * vec3(cone) / scale;
+        vec3 direction = center - vec3(eye);
+        if (dot(direction, axis) >= cone.w * length(direction) + radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// project local bounds to a screen space rectangle (min xy, max xy in [0, 1] texture coordinates)
+// and their nearest depth, false when the bounds reach in front of the near plane, those are never occluded
+SLIM_ATTR bool project_bounds(mat4 viewProj, mat4 model, vec3 boundsMin, vec3 boundsMax, out vec4 rect, out float depth) {
+    mat4 m = viewProj * model;
+    rect = vec4(1.0f, 1.0f, -1.0f, -1.0f);
+    depth = 1.0f;
+    for (int i = 0; i < 8; i++) {
+        vec3 corner = vec3((i & 1) != 0 ? boundsMax.x : boundsMin.x,
+                           (i & 2) != 0 ? boundsMax.y : boundsMin.y,
+                           (i & 4) != 0 ? boundsMax.z : boundsMin.z);
+        vec4 clip = m * vec4(corner, 1.0f);
+        if (clip.w <= 0.0f || clip.z < 0.0f) {
+            return false;
+        }
+        vec3 ndc = vec3(clip) / clip.w;
+        rect = vec4(min(vec2(rect), vec2(ndc)), max(vec2(rect.z, rect.w), vec2(ndc)));
+        depth = min(depth, ndc.z);
+    }
+    rect = clamp(rect * 0.5f + 0.5f, vec4(0.0f), vec4(1.0f));
+    return true;
+}
+
+#ifndef __cplusplus
+// test a projected rectangle and its nearest depth against a depth pyramid keeping the farthest depth,
+// the level is chosen such that the rectangle covers at most 2x2 of its texels
+bool is_occluded(sampler2D pyramid, vec2 pyramidSize, uint pyramidLevels, vec4 rect, float depth) {
+    vec2 size = (rect.zw - rect.xy) * pyramidSize;
+    float level = ceil(log2(max(max(size.x, size.y), 1.0f)));
+    int lod = int(min(level, float(pyramidLevels - 1)));
+
+    ivec2 extent = textureSize(pyramid, lod);
+    ivec2 first = clamp(ivec2(rect.xy * vec2(extent)), ivec2(0), extent - 1);
+    ivec2 last = clamp(ivec2(rect.zw * vec2(extent)), ivec2(0), extent - 1);
+    float farthest = max(max(texelFetch(pyramid, first, lod).r, texelFetch(pyramid, ivec2(last.x, first.y), lod).r),
+                         max(texelFetch(pyramid, ivec2(first.x, last.y), lod).r, texelFetch(pyramid, last, lod).r));
+    return depth > farthest;
+}
+#endif
+
+#endif // SLIM_SHADER_LIB_INDIRECT_H
@@ -33,4 +33,16 @@ SLIM_ATTR uint pack_snorm4(vec4 value) {
     return packSnorm4x8(value);
 }
 
+// value: unit vector, octahedral mapping to [-1, 1]^2
+// https://knarkowicz.wordpress.com/2014/04/16/octahedron-normal-vector-encoding/
+SLIM_ATTR vec2 oct_encode(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 p = vec2(n.x, n.y);
+    if (n.z < 0.0f) {
+        vec2 s = vec2(p.x >= 0.0f ? 1.0f : -1.0f, p.y >= 0.0f ? 1.0f : -1.0f);
+        p = (vec2(1.0f) - abs(vec2(p.y, p.x))) * s;
+    }
+    return p;
+}
+
 #endif // SLIM_SHADER_LIB_PACK_H
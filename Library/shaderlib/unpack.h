@@ -27,4 +27,13 @@ SLIM_ATTR vec4 unpack_snorm4(uint value) {
     return unpackSnorm4x8(value);
 }
 
+// value: [-1, 1]^2 from oct_encode, e.g. a gltf::VertexEncoding::Octahedral vertex attribute
+SLIM_ATTR vec3 oct_decode(vec2 p) {
+    vec3 n = vec3(p.x, p.y, 1.0f - abs(p.x) - abs(p.y));
+    float t = max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return normalize(n);
+}
+
 #endif // SLIM_SHADER_LIB_UNPACK_H
@@ -8,10 +8,12 @@
 
 // core
 #include "core/vulkan.h"
+#include "core/jobs.h"
 #include "core/context.h"
 #include "core/device.h"
 #include "core/buffer.h"
 #include "core/commands.h"
+#include "core/upload.h"
 #include "core/image.h"
 #include "core/pipeline.h"
 #include "core/renderpass.h"
@@ -24,16 +26,25 @@
 // utility
 #include "utility/stb.h"
 #include "utility/mesh.h"
+#include "utility/arena.h"
+#include "utility/meshopt.h"
+#include "utility/simplify.h"
+#include "utility/meshlet.h"
 #include "utility/color.h"
 #include "utility/assets.h"
+#include "utility/ktx2.h"
 #include "utility/texture.h"
 #include "utility/camera.h"
 #include "utility/transform.h"
+#include "utility/hierarchy.h"
 #include "utility/scenegraph.h"
 #include "utility/rendergraph.h"
 #include "utility/filesystem.h"
 #include "utility/material.h"
 #include "utility/culling.h"
+#include "utility/occlusion.h"
+#include "utility/frustum.h"
+#include "utility/bvh.h"
 #include "utility/meshrenderer.h"
 #include "utility/geometry.h"
 #include "utility/rtbuilder.h"
@@ -41,6 +52,7 @@
 #include "utility/flycam.h"
 #include "utility/time.h"
 #include "utility/gltf.h"
+#include "utility/mappedfile.h"
 #include "utility/bundle.h"
 
 // third party
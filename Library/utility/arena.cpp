@@ -0,0 +1,110 @@
+#include <iterator>
+#include <algorithm>
+#include "utility/arena.h"
+
+using namespace slim;
+using namespace slim::scene;
+
+GeometryArena::GeometryArena(Device* device, VkBufferUsageFlags bufferUsage, VmaMemoryUsage memoryUsage,
+                             const std::string& name, uint64_t chunkSize)
+    : device(device), bufferUsage(bufferUsage), memoryUsage(memoryUsage), name(name), chunkSize(chunkSize) {
+}
+
+GeometryArena::~GeometryArena() {
+    chunks.clear();
+}
+
+GeometryAllocation GeometryArena::Allocate(uint64_t size, uint64_t alignment) {
+    if (size == 0) throw std::runtime_error("[GeometryArena] size should not be 0!");
+    alignment = std::max<uint64_t>(alignment, 1);
+
+    // first fit in existing chunks
+    GeometryAllocation allocation = {};
+    for (uint32_t i = 0; i < chunks.size(); i++) {
+        if (Allocate(i, size, alignment, allocation)) {
+            return allocation;
+        }
+    }
+
+    // grow by one chunk, oversized requests get a chunk of their own
+    Chunk chunk;
+    uint64_t capacity = std::max(size, chunkSize);
+    // later builds upload into chunks already used for drawing, on the transfer queue,
+    // a concurrent chunk keeps meshes placed earlier defined without transferring ownership back and forth
+    chunk.buffer = SlimPtr<Buffer>(device, capacity, bufferUsage, memoryUsage, VK_SHARING_MODE_CONCURRENT);
+    chunk.buffer->SetName(name + " " + std::to_string(chunks.size()));
+    chunk.freeList.insert(std::make_pair(0, capacity));
+    chunks.push_back(chunk);
+
+    Allocate(static_cast<uint32_t>(chunks.size() - 1), size, alignment, allocation);
+    return allocation;
+}
+
+bool GeometryArena::Allocate(uint32_t index, uint64_t size, uint64_t alignment, GeometryAllocation& allocation) {
+    Chunk& chunk = chunks[index];
+    for (auto it = chunk.freeList.begin(); it != chunk.freeList.end(); ++it) {
+        uint64_t blockOffset = it->first;
+        uint64_t blockSize = it->second;
+        uint64_t offset = (blockOffset + alignment - 1) / alignment * alignment;
+        if (offset + size > blockOffset + blockSize) {
+            continue;
+        }
+
+        // split the free block, keeping the padding in front and the remainder behind
+        chunk.freeList.erase(it);
+        if (offset > blockOffset) {
+            chunk.freeList.insert(std::make_pair(blockOffset, offset - blockOffset));
+        }
+        if (offset + size < blockOffset + blockSize) {
+            chunk.freeList.insert(std::make_pair(offset + size, blockOffset + blockSize - offset - size));
+        }
+
+        allocation.buffer = chunk.buffer;
+        allocation.chunk = index;
+        allocation.offset = offset;
+        allocation.size = size;
+        allocatedBytes += size;
+        return true;
+    }
+    return false;
+}
+
+void GeometryArena::Free(const GeometryAllocation& allocation) {
+    if (!allocation.Valid()) return;
+
+    #ifndef NDEBUG
+    if (allocation.chunk >= chunks.size() || chunks[allocation.chunk].buffer.get() != allocation.buffer) {
+        throw std::runtime_error("[GeometryArena] allocation does not belong to this arena!");
+    }
+    #endif
+
+    auto& freeList = chunks[allocation.chunk].freeList;
+    uint64_t offset = allocation.offset;
+    uint64_t size = allocation.size;
+
+    // merge with the following free block
+    auto next = freeList.lower_bound(offset);
+    if (next != freeList.end() && next->first == offset + size) {
+        size += next->second;
+        next = freeList.erase(next);
+    }
+
+    // merge with the preceding free block
+    if (next != freeList.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+            prev->second += size;
+            allocatedBytes -= allocation.size;
+            return;
+        }
+    }
+
+    freeList.insert(std::make_pair(offset, size));
+    allocatedBytes -= allocation.size;
+}
+
+void GeometryArena::Reset() {
+    // all chunks are released, meshes still holding a chunk keep it alive until they are done
+    chunks.clear();
+    allocatedBytes = 0;
+}
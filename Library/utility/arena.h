@@ -0,0 +1,64 @@
+#ifndef SLIM_UTILITY_ARENA_H
+#define SLIM_UTILITY_ARENA_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include "core/buffer.h"
+#include "utility/interface.h"
+
+namespace slim::scene {
+
+    // a sub-allocation of a geometry arena chunk
+    struct GeometryAllocation {
+        Buffer*  buffer = nullptr;
+        uint32_t chunk  = 0;
+        uint64_t offset = 0;
+        uint64_t size   = 0;
+
+        bool Valid() const { return buffer != nullptr; }
+    };
+
+    // GeometryArena is a free-list allocator over a few large device buffers.
+    // Meshes are sub-allocated into shared chunks instead of owning a buffer each,
+    // so draws of different meshes can keep the same vertex and index buffers bound.
+    // Freed ranges are coalesced with their neighbours and reused by later allocations.
+    // Requests larger than a chunk get a chunk of their own.
+    class GeometryArena final : public NotCopyable, public NotMovable, public ReferenceCountable {
+    public:
+        constexpr static uint64_t DEFAULT_CHUNK_SIZE = 64 * 1024 * 1024;
+
+        explicit GeometryArena(Device* device, VkBufferUsageFlags bufferUsage, VmaMemoryUsage memoryUsage,
+                               const std::string& name, uint64_t chunkSize = DEFAULT_CHUNK_SIZE);
+        virtual ~GeometryArena();
+
+        // alignment does not have to be a power of two, vertex data is aligned to its stride
+        GeometryAllocation Allocate(uint64_t size, uint64_t alignment);
+        void Free(const GeometryAllocation& allocation);
+        void Reset();
+
+        size_t   GetChunkCount()     const { return chunks.size();  }
+        Buffer*  GetChunk(uint32_t i) const { return chunks[i].buffer; }
+        uint64_t GetAllocatedBytes() const { return allocatedBytes; }
+
+    private:
+        bool Allocate(uint32_t chunk, uint64_t size, uint64_t alignment, GeometryAllocation& allocation);
+
+    private:
+        struct Chunk {
+            SmartPtr<Buffer> buffer;
+            std::map<uint64_t, uint64_t> freeList;  // offset -> size, ordered for coalescing
+        };
+
+        SmartPtr<Device> device;
+        VkBufferUsageFlags bufferUsage;
+        VmaMemoryUsage memoryUsage;
+        std::string name;
+        uint64_t chunkSize;
+        uint64_t allocatedBytes = 0;
+        std::vector<Chunk> chunks;
+    };
+
+} // end of namespace slim::scene
+
+#endif // SLIM_UTILITY_ARENA_H
@@ -39,7 +39,12 @@ BoundingBox& BoundingBox::operator=(const BoundingBox &box) {
     return *this;
 }
 
-BoundingBox operator*(const glm::mat4& transform, const BoundingBox& box) {
+BoundingBox slim::operator*(const glm::mat4& transform, const BoundingBox& box) {
+    // empty box stays empty
+    if (!box.IsValid()) {
+        return box;
+    }
+
     const glm::vec3& min = box.Min();
     const glm::vec3& max = box.Max();
 
@@ -48,9 +53,9 @@ BoundingBox operator*(const glm::mat4& transform, const BoundingBox& box) {
     glm::vec4 p2 = transform * glm::vec4(max.x, min.y, min.z, 1.0);
     glm::vec4 p3 = transform * glm::vec4(min.x, max.y, min.z, 1.0);
     glm::vec4 p4 = transform * glm::vec4(min.x, min.y, max.z, 1.0);
-    glm::vec4 p5 = transform * glm::vec4(min.x, min.y, min.z, 1.0);
-    glm::vec4 p6 = transform * glm::vec4(min.x, max.y, min.z, 1.0);
-    glm::vec4 p7 = transform * glm::vec4(min.x, min.y, max.z, 1.0);
+    glm::vec4 p5 = transform * glm::vec4(max.x, max.y, min.z, 1.0);
+    glm::vec4 p6 = transform * glm::vec4(max.x, min.y, max.z, 1.0);
+    glm::vec4 p7 = transform * glm::vec4(min.x, max.y, max.z, 1.0);
 
     #define VMAX(C) std::max(std::max(std::max(p0.C, p1.C), std::max(p2.C, p3.C)), std::max(std::max(p4.C, p5.C), std::max(p6.C, p7.C)))
     #define VMIN(C) std::min(std::min(std::min(p0.C, p1.C), std::min(p2.C, p3.C)), std::min(std::min(p4.C, p5.C), std::min(p6.C, p7.C)))
@@ -12,6 +12,7 @@ namespace slim {
     public:
         explicit BoundingBox() = default;
         explicit BoundingBox(const glm::vec3 &min, const glm::vec3 &max);
+        BoundingBox(const BoundingBox &box) = default;
         virtual ~BoundingBox() = default;
 
         BoundingBox operator+(const BoundingBox &box);
@@ -21,6 +22,9 @@ namespace slim {
         const glm::vec3& Min() const { return min; }
         const glm::vec3& Max() const { return max; }
 
+        // a default constructed box is empty (min > max)
+        bool IsValid() const { return min.x <= max.x && min.y <= max.y && min.z <= max.z; }
+
     private:
         glm::vec3 min = glm::vec3(+INF, +INF, +INF);
         glm::vec3 max = glm::vec3(-INF, -INF, -INF);
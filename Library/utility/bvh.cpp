@@ -0,0 +1,491 @@
+#include <cmath>
+#include <cstring>
+#include "utility/bvh.h"
+#include "utility/scenegraph.h"
+
+#if defined(__AVX__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+using namespace slim;
+
+namespace {
+
+    // relative cost of visiting a node, a primitive test costs 1
+    constexpr float TRAVERSAL_COST = 1.0f;
+
+    float SurfaceArea(const glm::vec3& min, const glm::vec3& max) {
+        glm::vec3 d = glm::max(max - min, glm::vec3(0.0f));
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    void Grow(glm::vec3& min, glm::vec3& max, const BoundingBox& box) {
+        min = glm::min(min, box.Min());
+        max = glm::max(max, box.Max());
+    }
+
+    glm::vec3 ReadPosition(const uint8_t* positions, size_t stride, uint32_t vertex) {
+        glm::vec3 position;
+        std::memcpy(&position, positions + vertex * stride, sizeof(glm::vec3));
+        return position;
+    }
+
+} // end of anonymous namespace
+
+void BVH::Build(const std::vector<BoundingBox>& boxes, bool wide, uint32_t maxLeafSize) {
+    nodes.clear();
+    wideNodes.clear();
+    primitives.clear();
+    maxLeafSize = std::max(maxLeafSize, 1u);
+
+    // primitives are partitioned as copies, so that every range is read sequentially
+    struct Reference {
+        glm::vec3 min;
+        uint32_t  primitive;
+        glm::vec3 max;
+        glm::vec3 center;
+    };
+    std::vector<Reference> references;
+    references.reserve(boxes.size());
+    for (uint32_t i = 0; i < boxes.size(); i++) {
+        if (!boxes[i].IsValid()) continue;
+        references.push_back(Reference { boxes[i].Min(), i, boxes[i].Max(), (boxes[i].Min() + boxes[i].Max()) * 0.5f });
+    }
+    if (references.empty()) {
+        return;
+    }
+    nodes.reserve(references.size() * 2);
+
+    // ranges are split depth-first, so that the left child is created right after its parent,
+    // and the right child tells its parent where it ended up
+    struct Task {
+        uint32_t begin, end;
+        uint32_t parent;
+        uint32_t depth;
+    };
+    std::vector<Task> tasks = { Task { 0, static_cast<uint32_t>(references.size()), INVALID_INDEX, 0 } };
+    while (!tasks.empty()) {
+        Task task = tasks.back();
+        tasks.pop_back();
+
+        uint32_t index = static_cast<uint32_t>(nodes.size());
+        if (task.parent != INVALID_INDEX && task.parent + 1 != index) {
+            nodes[task.parent].first = index;
+        }
+
+        Node node = { glm::vec3(+INF), task.begin, glm::vec3(-INF), task.end - task.begin };
+        glm::vec3 centerMin = glm::vec3(+INF), centerMax = glm::vec3(-INF);
+        for (uint32_t i = task.begin; i < task.end; i++) {
+            node.min = glm::min(node.min, references[i].min);
+            node.max = glm::max(node.max, references[i].max);
+            centerMin = glm::min(centerMin, references[i].center);
+            centerMax = glm::max(centerMax, references[i].center);
+        }
+        nodes.push_back(node);
+
+        uint32_t count = task.end - task.begin;
+        if (count == 1) {
+            continue;
+        }
+
+        // binned SAH over all three axes, small ranges need fewer bins
+        uint32_t bins = std::min(count, BIN_COUNT);
+        float bestCost = INF;
+        uint32_t bestAxis = 0, bestBin = 0;
+        glm::vec3 extent = centerMax - centerMin;
+        if (task.depth < MAX_SAH_DEPTH) {
+            for (uint32_t axis = 0; axis < 3; axis++) {
+                if (!(extent[axis] > 0.0f)) continue;
+                float scale = bins / extent[axis];
+
+                glm::vec3 binMin[BIN_COUNT], binMax[BIN_COUNT];
+                uint32_t binCount[BIN_COUNT] = {};
+                for (uint32_t b = 0; b < bins; b++) {
+                    binMin[b] = glm::vec3(+INF);
+                    binMax[b] = glm::vec3(-INF);
+                }
+                for (uint32_t i = task.begin; i < task.end; i++) {
+                    const Reference& reference = references[i];
+                    uint32_t b = std::min(static_cast<uint32_t>((reference.center[axis] - centerMin[axis]) * scale), bins - 1);
+                    binMin[b] = glm::min(binMin[b], reference.min);
+                    binMax[b] = glm::max(binMax[b], reference.max);
+                    binCount[b]++;
+                }
+
+                // sweep from the right, then evaluate every split from the left
+                float rightArea[BIN_COUNT];
+                uint32_t rightCount[BIN_COUNT];
+                glm::vec3 sweepMin = glm::vec3(+INF), sweepMax = glm::vec3(-INF);
+                uint32_t sweepCount = 0;
+                for (uint32_t b = bins - 1; b > 0; b--) {
+                    sweepMin = glm::min(sweepMin, binMin[b]);
+                    sweepMax = glm::max(sweepMax, binMax[b]);
+                    sweepCount += binCount[b];
+                    rightArea[b] = SurfaceArea(sweepMin, sweepMax);
+                    rightCount[b] = sweepCount;
+                }
+                sweepMin = glm::vec3(+INF);
+                sweepMax = glm::vec3(-INF);
+                sweepCount = 0;
+                for (uint32_t b = 0; b < bins - 1; b++) {
+                    sweepMin = glm::min(sweepMin, binMin[b]);
+                    sweepMax = glm::max(sweepMax, binMax[b]);
+                    sweepCount += binCount[b];
+                    if (sweepCount == 0 || rightCount[b + 1] == 0) continue;
+                    float cost = SurfaceArea(sweepMin, sweepMax) * sweepCount + rightArea[b + 1] * rightCount[b + 1];
+                    if (cost < bestCost) {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestBin = b + 1;
+                    }
+                }
+            }
+        }
+
+        // stop when testing all primitives is cheaper than splitting
+        float area = SurfaceArea(node.min, node.max);
+        float splitCost = TRAVERSAL_COST + (area > 0.0f ? bestCost / area : 0.0f);
+        if (count <= maxLeafSize && (bestCost == INF || splitCost >= static_cast<float>(count))) {
+            continue;
+        }
+
+        uint32_t middle;
+        if (bestCost != INF) {
+            float scale = bins / extent[bestAxis];
+            float origin = centerMin[bestAxis];
+            auto it = std::partition(references.begin() + task.begin, references.begin() + task.end, [&](const Reference& reference) {
+                return std::min(static_cast<uint32_t>((reference.center[bestAxis] - origin) * scale), bins - 1) < bestBin;
+            });
+            middle = static_cast<uint32_t>(it - references.begin());
+        } else {
+            // coincident centers, or too deep for SAH, split in the middle along the widest axis
+            middle = task.begin + count / 2;
+            uint32_t axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+            std::nth_element(references.begin() + task.begin, references.begin() + middle, references.begin() + task.end,
+                             [&](const Reference& a, const Reference& b) { return a.center[axis] < b.center[axis]; });
+        }
+
+        nodes[index].count = 0;
+        tasks.push_back(Task { middle, task.end, index, task.depth + 1 });
+        tasks.push_back(Task { task.begin, middle, index, task.depth + 1 });
+    }
+
+    primitives.resize(references.size());
+    for (size_t i = 0; i < references.size(); i++) {
+        primitives[i] = references[i].primitive;
+    }
+
+    if (wide) {
+        Collapse();
+    }
+}
+
+void BVH::Refit(const std::vector<BoundingBox>& boxes) {
+    if (nodes.empty()) {
+        return;
+    }
+    // children always come after their parents
+    for (uint32_t i = static_cast<uint32_t>(nodes.size()); i-- > 0; ) {
+        RefitNode(i, boxes);
+    }
+    if (!wideNodes.empty()) {
+        Collapse();
+    }
+}
+
+void BVH::RefitNode(uint32_t index, const std::vector<BoundingBox>& boxes) {
+    Node& node = nodes[index];
+    node.min = glm::vec3(+INF);
+    node.max = glm::vec3(-INF);
+    if (node.count > 0) {
+        for (uint32_t i = node.first; i < node.first + node.count; i++) {
+            Grow(node.min, node.max, boxes[primitives[i]]);
+        }
+    } else {
+        const Node& left = nodes[index + 1];
+        const Node& right = nodes[node.first];
+        node.min = glm::min(left.min, right.min);
+        node.max = glm::max(left.max, right.max);
+    }
+}
+
+BoundingBox BVH::GetBounds() const {
+    return nodes.empty() ? BoundingBox() : BoundingBox(nodes[0].min, nodes[0].max);
+}
+
+void BVH::Collapse() {
+    wideNodes.clear();
+    wideNodes.reserve(nodes.size() / 2 + 1);
+
+    // every wide node opens the largest inner nodes of a binary subtree until it has four children
+    std::vector<std::pair<uint32_t, uint32_t>> tasks = { std::make_pair(0u, 0u) };
+    wideNodes.push_back(WideNode {});
+    while (!tasks.empty()) {
+        auto [binary, wide] = tasks.back();
+        tasks.pop_back();
+
+        uint32_t children[4] = { binary };
+        uint32_t count = 1;
+        if (nodes[binary].count == 0) {
+            children[0] = binary + 1;
+            children[1] = nodes[binary].first;
+            count = 2;
+        }
+        while (count < 4) {
+            int32_t largest = -1;
+            float largestArea = -1.0f;
+            for (uint32_t k = 0; k < count; k++) {
+                const Node& child = nodes[children[k]];
+                float area = SurfaceArea(child.min, child.max);
+                if (child.count == 0 && area > largestArea) {
+                    largest = static_cast<int32_t>(k);
+                    largestArea = area;
+                }
+            }
+            if (largest < 0) break;
+            uint32_t opened = children[largest];
+            children[largest] = opened + 1;
+            children[count++] = nodes[opened].first;
+        }
+
+        WideNode node = {};
+        for (uint32_t k = 0; k < 4; k++) {
+            if (k >= count) {
+                node.minX[k] = node.minY[k] = node.minZ[k] = +INF;
+                node.maxX[k] = node.maxY[k] = node.maxZ[k] = -INF;
+                node.child[k] = INVALID_INDEX;
+                node.count[k] = 0;
+                continue;
+            }
+            const Node& child = nodes[children[k]];
+            node.minX[k] = child.min.x; node.minY[k] = child.min.y; node.minZ[k] = child.min.z;
+            node.maxX[k] = child.max.x; node.maxY[k] = child.max.y; node.maxZ[k] = child.max.z;
+            if (child.count > 0) {
+                node.child[k] = child.first;
+                node.count[k] = child.count;
+            } else {
+                node.child[k] = static_cast<uint32_t>(wideNodes.size());
+                node.count[k] = 0;
+                wideNodes.push_back(WideNode {});
+                tasks.push_back(std::make_pair(children[k], node.child[k]));
+            }
+        }
+        wideNodes[wide] = node;
+    }
+}
+
+uint32_t BVH::Intersect(const WideNode& node, const Ray& ray, const glm::vec3& invDirection, float tmax, float distances[4]) const {
+    uint32_t mask = 0;
+
+    #if defined(__SSE2__) || defined(_M_X64)
+    // slab test of four children at once
+    __m128 ox = _mm_set1_ps(ray.origin.x), oy = _mm_set1_ps(ray.origin.y), oz = _mm_set1_ps(ray.origin.z);
+    __m128 ix = _mm_set1_ps(invDirection.x), iy = _mm_set1_ps(invDirection.y), iz = _mm_set1_ps(invDirection.z);
+    __m128 x0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minX), ox), ix);
+    __m128 x1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxX), ox), ix);
+    __m128 y0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minY), oy), iy);
+    __m128 y1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxY), oy), iy);
+    __m128 z0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minZ), oz), iz);
+    __m128 z1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxZ), oz), iz);
+    __m128 enter = _mm_max_ps(_mm_max_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)),
+                              _mm_max_ps(_mm_min_ps(z0, z1), _mm_set1_ps(ray.tmin)));
+    __m128 exit = _mm_min_ps(_mm_min_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)),
+                             _mm_min_ps(_mm_max_ps(z0, z1), _mm_set1_ps(tmax)));
+    mask = static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(enter, exit)));
+    _mm_storeu_ps(distances, enter);
+    #else
+    for (uint32_t k = 0; k < 4; k++) {
+        Ray clipped = ray;
+        clipped.tmax = tmax;
+        glm::vec3 min = glm::vec3(node.minX[k], node.minY[k], node.minZ[k]);
+        glm::vec3 max = glm::vec3(node.maxX[k], node.maxY[k], node.maxZ[k]);
+        distances[k] = Intersect(clipped, invDirection, min, max);
+        mask |= distances[k] != INF ? 1u << k : 0u;
+    }
+    #endif
+
+    // empty slots
+    for (uint32_t k = 0; k < 4; k++) {
+        if (node.child[k] == INVALID_INDEX) mask &= ~(1u << k);
+    }
+    return mask;
+}
+
+BVH::Planes BVH::Classify(const Frustum& frustum, const glm::vec3& min, const glm::vec3& max) {
+    glm::vec3 c = (max + min) * 0.5f;
+    glm::vec3 e = (max - min) * 0.5f;
+    Planes result = Planes::Inside;
+    for (uint32_t p = 0; p < 6; p++) {
+        const glm::vec4& plane = frustum.GetPlane(static_cast<Frustum::Plane>(p));
+        float s = (plane.x * c.x + plane.y * c.y) + (plane.z * c.z + plane.w);
+        float r = (std::abs(plane.x) * e.x + std::abs(plane.y) * e.y) + std::abs(plane.z) * e.z;
+        if (s + r < 0.0f) return Planes::Outside;
+        if (s - r < 0.0f) result = Planes::Intersecting;
+    }
+    return result;
+}
+
+scene::MeshBVH::MeshBVH(Mesh* mesh, bool wide) {
+    if (mesh->GetIndexCount() == 0 || mesh->GetVertexCount() == 0 || mesh->GetVertexStride() < sizeof(glm::vec3)) {
+        return;
+    }
+
+    const uint8_t* positions = mesh->GetVertexData<uint8_t>(0);
+    size_t stride = mesh->GetVertexStride();
+    MeshLod lod = mesh->GetLod(0);
+    vertices.reserve(lod.indexCount);
+    for (uint32_t i = lod.firstIndex; i + 3 <= lod.firstIndex + lod.indexCount; i += 3) {
+        for (uint32_t k = 0; k < 3; k++) {
+            uint32_t vertex = mesh->GetIndexType() == VK_INDEX_TYPE_UINT16
+                            ? mesh->GetIndexData<uint16_t>()[i + k]
+                            : mesh->GetIndexData<uint32_t>()[i + k];
+            vertices.push_back(ReadPosition(positions, stride, vertex));
+        }
+    }
+
+    std::vector<BoundingBox> boxes;
+    boxes.reserve(vertices.size() / 3);
+    for (size_t i = 0; i < vertices.size(); i += 3) {
+        glm::vec3 min = glm::min(vertices[i], glm::min(vertices[i + 1], vertices[i + 2]));
+        glm::vec3 max = glm::max(vertices[i], glm::max(vertices[i + 1], vertices[i + 2]));
+        boxes.push_back(BoundingBox(min, max));
+    }
+    bvh.Build(boxes, wide);
+}
+
+float scene::MeshBVH::Intersect(const Ray& ray, uint32_t triangle) const {
+    // Moller-Trumbore, without back face culling
+    const glm::vec3& v0 = vertices[triangle * 3 + 0];
+    glm::vec3 e1 = vertices[triangle * 3 + 1] - v0;
+    glm::vec3 e2 = vertices[triangle * 3 + 2] - v0;
+    glm::vec3 p = glm::cross(ray.direction, e2);
+    float det = glm::dot(e1, p);
+    if (det == 0.0f) {
+        return INF;
+    }
+    float invDet = 1.0f / det;
+    glm::vec3 s = ray.origin - v0;
+    float u = glm::dot(s, p) * invDet;
+    if (u < 0.0f || u > 1.0f) {
+        return INF;
+    }
+    glm::vec3 q = glm::cross(s, e1);
+    float v = glm::dot(ray.direction, q) * invDet;
+    if (v < 0.0f || u + v > 1.0f) {
+        return INF;
+    }
+    float t = glm::dot(e2, q) * invDet;
+    return t >= ray.tmin && t <= ray.tmax ? t : INF;
+}
+
+uint32_t scene::MeshBVH::Raycast(const Ray& ray, float& distance) const {
+    return bvh.Raycast(ray, distance, [&](uint32_t triangle, float tmax) {
+        Ray clipped = ray;
+        clipped.tmax = tmax;
+        return Intersect(clipped, triangle);
+    });
+}
+
+bool scene::MeshBVH::Occluded(const Ray& ray) const {
+    return bvh.Occluded(ray, [&](uint32_t triangle, float tmax) {
+        Ray clipped = ray;
+        clipped.tmax = tmax;
+        return Intersect(clipped, triangle) != INF;
+    });
+}
+
+void scene::SceneBVH::Build(Node* root) {
+    entries.clear();
+    bounds.clear();
+    root->ForEach([&](Node* node) {
+        for (const auto& [mesh, material] : *node) {
+            BoundingBox box = mesh->GetBoundingBox(node->GetTransform());
+            if (!box.IsValid()) continue;
+            entries.push_back(Entry { node, mesh, material });
+            bounds.push_back(box);
+        }
+        return true;
+    });
+    bvh.Build(bounds, wide);
+}
+
+void scene::SceneBVH::Refit() {
+    for (size_t i = 0; i < entries.size(); i++) {
+        bounds[i] = entries[i].mesh->GetBoundingBox(entries[i].node->GetTransform());
+    }
+    bvh.Refit(bounds);
+}
+
+scene::MeshBVH* scene::SceneBVH::RequestMeshBVH(Mesh* mesh) {
+    auto it = meshes.find(mesh);
+    if (it == meshes.end()) {
+        it = meshes.insert(std::make_pair(mesh, SlimPtr<MeshBVH>(mesh, wide))).first;
+    }
+    return it->second->Empty() ? nullptr : it->second.get();
+}
+
+float scene::SceneBVH::Intersect(const Ray& ray, uint32_t entry, bool exact, float tmax, uint32_t& triangle) {
+    Ray clipped = ray;
+    clipped.tmax = tmax;
+    const BoundingBox& box = bounds[entry];
+    float enter = BVH::Intersect(clipped, 1.0f / ray.direction, box.Min(), box.Max());
+    triangle = BVH::INVALID_INDEX;
+
+    MeshBVH* meshBVH = exact && enter != INF ? RequestMeshBVH(entries[entry].mesh) : nullptr;
+    if (!meshBVH) {
+        return enter;
+    }
+
+    // the local ray keeps the parameterization of the world ray, so distances stay comparable
+    const glm::mat4& worldToLocal = entries[entry].node->GetTransform().WorldToLocal();
+    Ray local = clipped;
+    local.origin = glm::vec3(worldToLocal * glm::vec4(ray.origin, 1.0f));
+    local.direction = glm::vec3(worldToLocal * glm::vec4(ray.direction, 0.0f));
+    float distance = INF;
+    triangle = meshBVH->Raycast(local, distance);
+    return triangle != BVH::INVALID_INDEX ? distance : INF;
+}
+
+bool scene::SceneBVH::Raycast(const Ray& ray, Hit& hit, bool exact) {
+    uint32_t nearestTriangle = BVH::INVALID_INDEX;
+    float distance = INF;
+    uint32_t entry = bvh.Raycast(ray, distance, [&](uint32_t index, float tmax) {
+        uint32_t triangle;
+        float t = Intersect(ray, index, exact, tmax, triangle);
+        if (t < tmax) nearestTriangle = triangle;
+        return t;
+    });
+    if (entry == BVH::INVALID_INDEX) {
+        return false;
+    }
+    hit.entry = entries[entry];
+    hit.distance = distance;
+    hit.triangle = nearestTriangle;
+    return true;
+}
+
+bool scene::SceneBVH::Occluded(const Ray& ray, bool exact) {
+    return bvh.Occluded(ray, [&](uint32_t index, float tmax) {
+        uint32_t triangle;
+        return Intersect(ray, index, exact, tmax, triangle) != INF;
+    });
+}
+
+void scene::SceneBVH::Query(const BoundingBox& box, std::vector<Entry>& results) const {
+    results.clear();
+    bvh.Query(box, [&](uint32_t index) {
+        const BoundingBox& bound = bounds[index];
+        if (glm::all(glm::lessThanEqual(bound.Min(), box.Max())) && glm::all(glm::greaterThanEqual(bound.Max(), box.Min()))) {
+            results.push_back(entries[index]);
+        }
+    });
+}
+
+void scene::SceneBVH::Query(const Frustum& frustum, std::vector<Entry>& results) const {
+    results.clear();
+    bvh.Query(frustum, [&](uint32_t index) {
+        if (frustum.Intersect(bounds[index])) {
+            results.push_back(entries[index]);
+        }
+    });
+}
@@ -0,0 +1,357 @@
+#ifndef SLIM_UTILITY_BVH_H
+#define SLIM_UTILITY_BVH_H
+
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <unordered_map>
+#include <glm/glm.hpp>
+
+#include "utility/mesh.h"
+#include "utility/frustum.h"
+#include "utility/interface.h"
+#include "utility/boundingbox.h"
+
+namespace slim {
+
+    namespace scene {
+        class Node;
+        class Material;
+    }
+
+    // ray for CPU queries, hits are only reported for distances in [tmin, tmax] along direction,
+    // direction does not need to be normalized, distances are in multiples of it
+    struct Ray {
+        glm::vec3 origin    = glm::vec3(0.0f);
+        glm::vec3 direction = glm::vec3(0.0f, 0.0f, -1.0f);
+        float     tmin      = 0.0f;
+        float     tmax      = INF;
+    };
+
+    // BVH is a bounding volume hierarchy over boxes, built with binned SAH.
+    // Nodes are stored flat in depth-first order, the left child of an inner node directly follows it,
+    // and the primitives of every leaf are a contiguous range of GetPrimitives().
+    // A wide BVH additionally collapses the nodes into 4-wide nodes, whose children are tested against rays
+    // together with SIMD. Boxes that are not valid are never hit.
+    class BVH final {
+    public:
+        constexpr static uint32_t INVALID_INDEX = ~0u;
+        constexpr static uint32_t MAX_LEAF_SIZE = 4;
+        constexpr static uint32_t BIN_COUNT = 16;
+
+        // inner nodes have a count of 0 and the index of their right child in first
+        struct Node {
+            glm::vec3 min;
+            uint32_t  first;
+            glm::vec3 max;
+            uint32_t  count;
+        };
+
+        // children in structure-of-arrays layout, empty slots have an invalid child
+        struct WideNode {
+            float    minX[4], minY[4], minZ[4];
+            float    maxX[4], maxY[4], maxZ[4];
+            uint32_t child[4];      // wide node index, or first primitive for leaves
+            uint32_t count[4];      // primitives of a leaf, 0 for inner children
+        };
+
+        void Build(const std::vector<BoundingBox>& boxes, bool wide = false, uint32_t maxLeafSize = MAX_LEAF_SIZE);
+
+        // boxes moved but are still the same primitives, bounds are recomputed bottom-up in linear time,
+        // the tree is not restructured so queries slow down when boxes move far, rebuild then
+        void Refit(const std::vector<BoundingBox>& boxes);
+
+        bool Empty() const { return nodes.empty(); }
+        BoundingBox GetBounds() const;
+
+        const std::vector<Node>&     GetNodes()      const { return nodes;      }
+        const std::vector<WideNode>& GetWideNodes()  const { return wideNodes;  }
+        const std::vector<uint32_t>& GetPrimitives() const { return primitives; }
+
+        // nearest hit, intersect(primitive, tmax) returns the distance of a hit, a distance of tmax or beyond is
+        // a miss, primitives are visited roughly front to back, returns the nearest primitive and its distance
+        template <typename Func>
+        uint32_t Raycast(const Ray& ray, float& distance, Func&& intersect) const;
+
+        // any hit, occluded(primitive, tmax) returns true when the primitive blocks the ray before tmax
+        template <typename Func>
+        bool Occluded(const Ray& ray, Func&& occluded) const;
+
+        // visit(primitive) for the primitives of every leaf overlapping the box,
+        // the BVH does not keep the boxes of primitives, test them when it matters
+        template <typename Func>
+        void Query(const BoundingBox& box, Func&& visit) const;
+
+        // visit(primitive) for the primitives of every leaf that is not fully outside
+        template <typename Func>
+        void Query(const Frustum& frustum, Func&& visit) const;
+
+        // distance along the ray where it enters a box, or INF
+        static float Intersect(const Ray& ray, const glm::vec3& invDirection, const glm::vec3& min, const glm::vec3& max);
+
+    private:
+        // depth beyond which ranges are split in the middle, which bounds the traversal stacks
+        constexpr static uint32_t MAX_SAH_DEPTH = 64;
+        constexpr static uint32_t STACK_SIZE = 128;
+        constexpr static uint32_t WIDE_STACK_SIZE = 3 * STACK_SIZE;
+
+        enum class Planes { Outside, Intersecting, Inside };
+
+        void Collapse();
+        void RefitNode(uint32_t index, const std::vector<BoundingBox>& boxes);
+
+        // distances where the ray enters the children, returns a bit mask of the children that are hit
+        uint32_t Intersect(const WideNode& node, const Ray& ray, const glm::vec3& invDirection, float tmax, float distances[4]) const;
+
+        static Planes Classify(const Frustum& frustum, const glm::vec3& min, const glm::vec3& max);
+
+        template <typename Func>
+        uint32_t Traverse(const Ray& ray, bool anyHit, float& distance, Func&& intersect) const;
+
+    private:
+        std::vector<Node>     nodes      = {};
+        std::vector<WideNode> wideNodes  = {};
+        std::vector<uint32_t> primitives = {};
+    };
+
+} // end of namespace slim
+
+namespace slim::scene {
+
+    // MeshBVH is a triangle BVH over level 0 of a mesh for exact ray queries in the local space of the mesh.
+    // Positions are expected as float3 at offset 0 of the first vertex stream, the CPU copy of the mesh data
+    // must still be there when it is built.
+    class MeshBVH final : public NotCopyable, public NotMovable, public ReferenceCountable {
+    public:
+        explicit MeshBVH(Mesh* mesh, bool wide = true);
+        virtual ~MeshBVH() = default;
+
+        bool Empty() const { return bvh.Empty(); }
+        uint32_t GetTriangleCount() const { return static_cast<uint32_t>(vertices.size() / 3); }
+
+        // nearest triangle hit from both sides, returns its index in level 0 or BVH::INVALID_INDEX
+        uint32_t Raycast(const Ray& ray, float& distance) const;
+        bool Occluded(const Ray& ray) const;
+
+        // distance along the ray to a triangle of level 0, INF when it is missed
+        float Intersect(const Ray& ray, uint32_t triangle) const;
+
+    private:
+        BVH bvh;
+        std::vector<glm::vec3> vertices = {};     // three per triangle
+    };
+
+    // SceneBVH keeps a BVH over the world bounds of every drawable below a node, for picking and spatial lookups
+    // without walking the scene. World transforms are read as they are, apply them first. Refit() follows
+    // transform changes, Build() again after the hierarchy or the drawables changed.
+    // Drawables without valid bounds are left out.
+    class SceneBVH final : public NotCopyable, public NotMovable, public ReferenceCountable {
+    public:
+        struct Entry {
+            Node*     node     = nullptr;
+            Mesh*     mesh     = nullptr;
+            Material* material = nullptr;
+        };
+
+        struct Hit {
+            Entry    entry    = {};
+            float    distance = INF;
+            uint32_t triangle = BVH::INVALID_INDEX;  // level 0 triangle for exact hits
+        };
+
+        explicit SceneBVH(bool wide = true) : wide(wide) { }
+        virtual ~SceneBVH() = default;
+
+        void Build(Node* root);
+        void Refit();
+
+        size_t GetEntryCount() const { return entries.size(); }
+        const Entry& GetEntry(uint32_t index) const { return entries[index]; }
+        const BVH& GetBVH() const { return bvh; }
+
+        // nearest drawable along a world space ray, exact tests triangles against a MeshBVH built
+        // on first use for every mesh, meshes without CPU data are hit at their bounds
+        bool Raycast(const Ray& ray, Hit& hit, bool exact = true);
+        bool Occluded(const Ray& ray, bool exact = true);
+
+        void Query(const BoundingBox& box, std::vector<Entry>& results) const;
+        void Query(const Frustum& frustum, std::vector<Entry>& results) const;
+
+    private:
+        MeshBVH* RequestMeshBVH(Mesh* mesh);
+        float Intersect(const Ray& ray, uint32_t entry, bool exact, float tmax, uint32_t& triangle);
+
+    private:
+        bool wide;
+        BVH bvh;
+        std::vector<Entry> entries = {};
+        std::vector<BoundingBox> bounds = {};
+        std::unordered_map<Mesh*, SmartPtr<MeshBVH>> meshes = {};
+    };
+
+} // end of namespace slim::scene
+
+namespace slim {
+
+    inline float BVH::Intersect(const Ray& ray, const glm::vec3& invDirection, const glm::vec3& min, const glm::vec3& max) {
+        glm::vec3 t0 = (min - ray.origin) * invDirection;
+        glm::vec3 t1 = (max - ray.origin) * invDirection;
+        glm::vec3 tnear = glm::min(t0, t1);
+        glm::vec3 tfar = glm::max(t0, t1);
+        float enter = std::max(std::max(tnear.x, tnear.y), std::max(tnear.z, ray.tmin));
+        float exit = std::min(std::min(tfar.x, tfar.y), std::min(tfar.z, ray.tmax));
+        return enter <= exit ? enter : INF;
+    }
+
+    template <typename Func>
+    uint32_t BVH::Raycast(const Ray& ray, float& distance, Func&& intersect) const {
+        return Traverse(ray, false, distance, intersect);
+    }
+
+    template <typename Func>
+    bool BVH::Occluded(const Ray& ray, Func&& occluded) const {
+        float distance = ray.tmax;
+        return Traverse(ray, true, distance, [&](uint32_t primitive, float tmax) {
+            return occluded(primitive, tmax) ? ray.tmin : INF;
+        }) != INVALID_INDEX;
+    }
+
+    template <typename Func>
+    uint32_t BVH::Traverse(const Ray& ray, bool anyHit, float& distance, Func&& intersect) const {
+        uint32_t nearest = INVALID_INDEX;
+        distance = ray.tmax;
+        if (nodes.empty()) {
+            return nearest;
+        }
+
+        Ray clipped = ray;
+        glm::vec3 invDirection = 1.0f / ray.direction;
+        auto visitLeaf = [&](uint32_t first, uint32_t count) {
+            for (uint32_t i = first; i < first + count; i++) {
+                float t = intersect(primitives[i], clipped.tmax);
+                if (t >= ray.tmin && t < clipped.tmax) {
+                    clipped.tmax = t;
+                    nearest = primitives[i];
+                    if (anyHit) return true;
+                }
+            }
+            return false;
+        };
+
+        if (!wideNodes.empty()) {
+            // children entered nearest last, so that the nearest one is popped first
+            std::pair<uint32_t, float> stack[WIDE_STACK_SIZE];
+            uint32_t size = 0;
+            stack[size++] = std::make_pair(0u, ray.tmin);
+            while (size > 0) {
+                auto [index, enter] = stack[--size];
+                if (enter >= clipped.tmax) continue;
+
+                const WideNode& node = wideNodes[index];
+                float distances[4];
+                uint32_t mask = Intersect(node, clipped, invDirection, clipped.tmax, distances);
+                uint32_t first = size;
+                for (uint32_t k = 0; k < 4; k++) {
+                    if (!(mask & (1u << k))) continue;
+                    if (node.count[k] > 0) {
+                        if (visitLeaf(node.child[k], node.count[k])) {
+                            distance = clipped.tmax;
+                            return nearest;
+                        }
+                        continue;
+                    }
+                    uint32_t slot = size++;
+                    while (slot > first && stack[slot - 1].second < distances[k]) {
+                        stack[slot] = stack[slot - 1];
+                        slot--;
+                    }
+                    stack[slot] = std::make_pair(node.child[k], distances[k]);
+                }
+            }
+        } else {
+            std::pair<uint32_t, float> stack[STACK_SIZE];
+            uint32_t size = 0;
+            float enterRoot = Intersect(clipped, invDirection, nodes[0].min, nodes[0].max);
+            if (enterRoot != INF) {
+                stack[size++] = std::make_pair(0u, enterRoot);
+            }
+            while (size > 0) {
+                auto [index, enter] = stack[--size];
+                if (enter >= clipped.tmax) continue;
+
+                const Node& node = nodes[index];
+                if (node.count > 0) {
+                    if (visitLeaf(node.first, node.count)) break;
+                    continue;
+                }
+                uint32_t left = index + 1, right = node.first;
+                float enterLeft = Intersect(clipped, invDirection, nodes[left].min, nodes[left].max);
+                float enterRight = Intersect(clipped, invDirection, nodes[right].min, nodes[right].max);
+                if (enterLeft > enterRight) {
+                    std::swap(left, right);
+                    std::swap(enterLeft, enterRight);
+                }
+                if (enterRight != INF) stack[size++] = std::make_pair(right, enterRight);
+                if (enterLeft != INF) stack[size++] = std::make_pair(left, enterLeft);
+            }
+        }
+        distance = clipped.tmax;
+        return nearest;
+    }
+
+    template <typename Func>
+    void BVH::Query(const BoundingBox& box, Func&& visit) const {
+        if (nodes.empty() || !box.IsValid()) {
+            return;
+        }
+        uint32_t stack[STACK_SIZE];
+        uint32_t size = 0;
+        stack[size++] = 0;
+        while (size > 0) {
+            const Node& node = nodes[stack[--size]];
+            if (glm::any(glm::greaterThan(node.min, box.Max())) || glm::any(glm::lessThan(node.max, box.Min()))) {
+                continue;
+            }
+            if (node.count > 0) {
+                for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                    visit(primitives[i]);
+                }
+                continue;
+            }
+            stack[size++] = node.first;
+            stack[size++] = static_cast<uint32_t>(&node - nodes.data()) + 1;
+        }
+    }
+
+    template <typename Func>
+    void BVH::Query(const Frustum& frustum, Func&& visit) const {
+        if (nodes.empty()) {
+            return;
+        }
+        // subtrees fully inside are visited without further tests
+        std::pair<uint32_t, bool> stack[STACK_SIZE];
+        uint32_t size = 0;
+        stack[size++] = std::make_pair(0u, false);
+        while (size > 0) {
+            auto [index, inside] = stack[--size];
+            const Node& node = nodes[index];
+            if (!inside) {
+                Planes planes = Classify(frustum, node.min, node.max);
+                if (planes == Planes::Outside) continue;
+                inside = planes == Planes::Inside;
+            }
+            if (node.count > 0) {
+                for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                    visit(primitives[i]);
+                }
+                continue;
+            }
+            stack[size++] = std::make_pair(node.first, inside);
+            stack[size++] = std::make_pair(index + 1, inside);
+        }
+    }
+
+} // end of namespace slim
+
+#endif // SLIM_UTILITY_BVH_H
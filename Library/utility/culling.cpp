@@ -1,3 +1,6 @@
+#include <cmath>
+#include <limits>
+#include <iterator>
 #include "culling.h"
 
 using namespace slim;
@@ -12,6 +15,45 @@ namespace slim {
         return d1.distanceToCamera > d2.distanceToCamera;
     }
 
+    bool SortDrawableByKey(const Drawable& d1, const Drawable& d2) {
+        return d1.sortKey < d2.sortKey;
+    }
+
+}
+
+static uint32_t DenseId(std::unordered_map<const void*, uint32_t>& ids, const void* object) {
+    auto it = ids.find(object);
+    if (it == ids.end()) {
+        it = ids.insert(std::make_pair(object, static_cast<uint32_t>(ids.size()))).first;
+    }
+    return it->second;
+}
+
+// 64-bit sort key, from the most significant bits:
+// by state:      queue (16) | pipeline (12) | material (12) | mesh (12) | depth (12)
+// front to back: queue (16) | depth (24)    | pipeline (8)  | material (8) | mesh (8)
+// back to front: queue (16) | ~depth (24)   | pipeline (8)  | material (8) | mesh (8)
+// ids exceeding their bits wrap around, which only weakens state grouping.
+static uint64_t MakeSortKey(SortingOrder sorting, RenderQueue queue,
+                            uint32_t pipeline, uint32_t material, uint32_t mesh, float depth) {
+    auto bits = [](uint64_t value, uint32_t count) {
+        return value & ((uint64_t(1) << count) - 1);
+    };
+    auto quantize = [](float value, uint32_t count) {
+        return static_cast<uint64_t>(std::clamp(value, 0.0f, 1.0f) * static_cast<float>((1u << count) - 1));
+    };
+
+    uint64_t key = static_cast<uint64_t>(queue) << 48;
+    switch (sorting) {
+        case SortingOrder::ByState:
+            return key | bits(pipeline, 12) << 36 | bits(material, 12) << 24 | bits(mesh, 12) << 12 | quantize(depth, 12);
+        case SortingOrder::FrontToback:
+            return key | quantize(depth, 24) << 24 | bits(pipeline, 8) << 16 | bits(material, 8) << 8 | bits(mesh, 8);
+        case SortingOrder::BackToFront:
+            return key | quantize(1.0f - depth, 24) << 24 | bits(pipeline, 8) << 16 | bits(material, 8) << 8 | bits(mesh, 8);
+        default:
+            return key;
+    }
 }
 
 void CPUCulling::Clear() {
@@ -19,87 +61,266 @@ void CPUCulling::Clear() {
 }
 
 void CPUCulling::Cull(scene::Node* scene, Camera* camera) {
-    scene->ForEach([&](scene::Node* scene) {
-        return CullSceneNode(scene, camera);
-    });
-}
+    Frustum frustum(camera->GetProjection() * camera->GetView());
+    cullCount++;
+
+    // camera position from view matrix (not every camera updates its position)
+    glm::vec3 eye = glm::vec3(glm::inverse(camera->GetView())[3]);
 
-bool CPUCulling::CullSceneNode(scene::Node* scene, Camera*) {
+    // linearize visible hierarchy, and compute world space bounds for all drawables
+    nodes.clear();
+    drawableBounds.clear();
+    std::vector<std::pair<scene::Node*, int32_t>> stack = { std::make_pair(scene, -1) };
+    while (!stack.empty()) {
+        auto [node, parent] = stack.back();
+        stack.pop_back();
+
+        // when user configures this object to be invisible,
+        // children objects are not visible either
+        if (!node->IsVisible()) {
+            continue;
+        }
 
-    // when user configures this object to be invisible
-    if (!scene->IsVisible()) {
-        return false;
+        int32_t index = static_cast<int32_t>(nodes.size());
+        nodes.push_back(CullingNode { node, parent, static_cast<uint32_t>(drawableBounds.size()), BoundingBox() });
+        for (const auto& [mesh, material] : *node) {
+            BoundingBox box = mesh->GetBoundingBox(node->GetTransform());
+            drawableBounds.push_back(box);
+            // drawables without valid bounds are never culled, neither are their ancestors
+            nodes.back().bounds += box.IsValid() ? box : BoundingBox(glm::vec3(-INF), glm::vec3(+INF));
+        }
+
+        for (scene::Node* child : node->GetChildren()) {
+            stack.push_back(std::make_pair(child, index));
+        }
     }
 
-    // TODO: perform camera-based frustum culling
-    bool visible = true;
-    float distance = 0.0f;
+    // propagate subtree bounds bottom-up
+    for (size_t i = nodes.size(); i-- > 0;) {
+        if (nodes[i].parent >= 0) {
+            nodes[nodes[i].parent].bounds += nodes[i].bounds;
+        }
+    }
 
-    if (!visible) {
-        // children objects are not visible either
-        return false;
-    }
-
-    for (const auto& primitive : *scene) {
-        auto [mesh, material] = primitive;
-
-        // find technique
-        Technique* technique = material->GetTechnique();
-
-        // draw command
-        DrawVariant draw;
-        if (mesh->GetIndexCount() == 0) {
-            DrawCommand drawCommand = {};
-            drawCommand.firstInstance = 0;  // MOTE: if drawIndirectFirstInstasnce is not disabled, this must be 0
-            drawCommand.instanceCount = 1;  // NOTE: we can use scene node to store instancing information
-            drawCommand.firstVertex = 0;
-            drawCommand.vertexCount = mesh->GetVertexCount();
-            draw = drawCommand;
-        } else {
-            DrawIndexed drawCommand = {};
-            drawCommand.firstInstance = 0;  // MOTE: if drawIndirectFirstInstasnce is not disabled, this must be 0
-            drawCommand.instanceCount = 1;  // NOTE: we can use scene node to store instancing information
-            drawCommand.firstIndex = 0;
-            drawCommand.indexCount = mesh->GetIndexCount();
-            drawCommand.vertexOffset = 0;
-            draw = drawCommand;
-        }
-
-        // find queue for each pass
-        for (auto &pass : *technique) {
-            // queue
-            auto queueIt = objects.find(pass.queue);
-            if (queueIt == objects.end()) {
-                objects.insert(std::make_pair(pass.queue, std::vector<Drawable>()));
-                queueIt = objects.find(pass.queue);
+    // hierarchical culling, a subtree is rejected when its bounds are fully outside
+    nodeBoxes.Clear();
+    nodeBoxes.Reserve(nodes.size());
+    for (const CullingNode& node : nodes) {
+        nodeBoxes.Add(node.bounds);
+    }
+    frustum.Intersect(nodeBoxes, nodeVisibility);
+    for (size_t i = 0; i < nodes.size(); i++) {
+        if (nodes[i].parent >= 0 && !nodeVisibility[nodes[i].parent]) {
+            nodeVisibility[i] = 0;
+        }
+    }
+
+    // per-drawable culling for the surviving nodes
+    drawableBoxes.Clear();
+    drawableBoxes.Reserve(drawableBounds.size());
+    for (size_t i = 0; i < nodes.size(); i++) {
+        if (!nodeVisibility[i]) continue;
+        for (uint32_t k = 0; k < nodes[i].node->NumDraws(); k++) {
+            drawableBoxes.Add(drawableBounds[nodes[i].firstDrawable + k]);
+        }
+    }
+    frustum.Intersect(drawableBoxes, drawableVisibility);
+
+    uint32_t index = 0;
+    for (size_t i = 0; i < nodes.size(); i++) {
+        if (!nodeVisibility[i]) continue;
+        uint32_t k = 0;
+        bool occluded = !occludedNodes.empty() && occludedNodes.count(nodes[i].node) > 0;
+        for (const auto& [mesh, material] : *nodes[i].node) {
+            if (drawableVisibility[index] && !occluded) {
+                float distance = glm::distance(eye, drawableBoxes.GetCenter(index));
+                uint32_t lod = 0;
+                if (mesh->GetLodCount() > 1) {
+                    LodState& state = lodLevels[nodes[i].node];
+                    state.levels.resize(nodes[i].node->NumDraws(), 0);
+                    state.cull = cullCount;
+                    lod = SelectLod(mesh, drawableBounds[nodes[i].firstDrawable + k], eye, camera->GetProjection(), state.levels[k]);
+                    state.levels[k] = static_cast<uint8_t>(lod);
+                }
+                if (lod == 0 && !mesh->GetMeshlets().empty()) {
+                    CullMeshlets(nodes[i].node, mesh, material, distance, frustum, eye);
+                } else {
+                    scene::MeshLod range = mesh->GetLod(lod);
+                    AddDrawable(nodes[i].node, mesh, material, distance, lod, range.firstIndex, range.indexCount);
+                }
             }
-            // drawable
-            queueIt->second.push_back(Drawable {
-                scene,
-                mesh, material, draw,
-                pass.queue,
-                distance
-            });
+            index++;
+            k++;
         }
     }
-    return true;
+
+    // levels of nodes not drawn this time start over when they show up again
+    for (auto it = lodLevels.begin(); it != lodLevels.end();) {
+        it = it->second.cull == cullCount ? std::next(it) : lodLevels.erase(it);
+    }
+}
+
+void CPUCulling::SetLodThreshold(float threshold, float hysteresis) {
+    lodThreshold = threshold;
+    lodHysteresis = hysteresis;
+}
+
+uint32_t CPUCulling::SelectLod(const scene::Mesh* mesh, const BoundingBox& bounds,
+                               const glm::vec3& eye, const glm::mat4& proj, uint32_t previous) const {
+    uint32_t count = mesh->GetLodCount();
+    if (count == 1 || lodThreshold <= 0.0f || !bounds.IsValid()) {
+        return 0;
+    }
+
+    // errors are relative to the mesh radius, world space bounds carry the scale of the node
+    glm::vec3 center = (bounds.Min() + bounds.Max()) * 0.5f;
+    float radius = glm::length(bounds.Max() - bounds.Min()) * 0.5f;
+
+    // bounding sphere size as a fraction of the viewport height, for perspective projections
+    // at the distance of the closest point of the sphere, cameras inside of it get the full mesh
+    float scale = radius * std::abs(proj[1][1]) * 0.5f;
+    if (proj[2][3] != 0.0f) {
+        float distance = glm::distance(eye, center) - radius;
+        if (distance <= 0.0f) {
+            return 0;
+        }
+        scale /= distance;
+    }
+
+    // errors grow with the level, so the coarsest acceptable level is found from the front
+    auto coarsest = [&](float limit) {
+        uint32_t level = 0;
+        while (level + 1 < count && mesh->GetLod(level + 1).error * scale <= limit) {
+            level++;
+        }
+        return level;
+    };
+
+    uint32_t current = std::min(previous, count - 1);
+    if (mesh->GetLod(current).error * scale > lodThreshold * (1.0f + lodHysteresis)) {
+        return coarsest(lodThreshold);
+    }
+    return std::max(current, coarsest(lodThreshold * (1.0f - lodHysteresis)));
+}
+
+void CPUCulling::CullMeshlets(scene::Node* node, scene::Mesh* mesh, scene::Material* material,
+                              float distance, const Frustum& frustum, const glm::vec3& eye) {
+    const glm::mat4& model = node->GetTransform().LocalToWorld();
+    glm::vec3 scales = glm::vec3(glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2])));
+    float scale = std::max(scales.x, std::max(scales.y, scales.z));
+
+    // normals keep their directions under rotation and uniform scale only, mirroring flips the winding
+    float minScale = std::min(scales.x, std::min(scales.y, scales.z));
+    bool cones = coneCulling && scale > 0.0f && scale - minScale <= 1e-3f * scale && glm::determinant(glm::mat3(model)) > 0.0f;
+    glm::mat3 rotation = glm::mat3(model) / std::max(scale, std::numeric_limits<float>::min());
+
+    uint32_t firstIndex = 0;
+    uint32_t indexCount = 0;
+    for (const scene::Meshlet& meshlet : mesh->GetMeshlets()) {
+        glm::vec3 center = glm::vec3(model * glm::vec4(glm::vec3(meshlet.sphere), 1.0f));
+        float radius = meshlet.sphere.w * scale;
+        bool visible = frustum.Intersect(center, radius);
+        if (visible && cones && meshlet.cone.w < 1.0f) {
+            glm::vec3 axis = rotation * glm::vec3(meshlet.cone);
+            glm::vec3 direction = center - eye;
+            visible = glm::dot(direction, axis) < meshlet.cone.w * glm::length(direction) + radius;
+        }
+        if (!visible) {
+            continue;
+        }
+
+        if (indexCount > 0 && firstIndex + indexCount == meshlet.firstIndex) {
+            indexCount += meshlet.indexCount;
+            continue;
+        }
+        if (indexCount > 0) {
+            AddDrawable(node, mesh, material, distance, 0, firstIndex, indexCount);
+        }
+        firstIndex = meshlet.firstIndex;
+        indexCount = meshlet.indexCount;
+    }
+    if (indexCount > 0) {
+        AddDrawable(node, mesh, material, distance, 0, firstIndex, indexCount);
+    }
+}
+
+void CPUCulling::AddDrawable(scene::Node* node, scene::Mesh* mesh, scene::Material* material, float distance,
+                             uint32_t lod, uint32_t firstIndex, uint32_t indexCount) {
+    // find technique
+    Technique* technique = material->GetTechnique();
+
+    // draw command
+    DrawVariant draw;
+    if (mesh->GetIndexCount() == 0) {
+        DrawCommand drawCommand = {};
+        drawCommand.firstInstance = 0;  // MOTE: if drawIndirectFirstInstasnce is not disabled, this must be 0
+        drawCommand.instanceCount = 1;  // NOTE: we can use scene node to store instancing information
+        drawCommand.firstVertex = static_cast<uint32_t>(mesh->GetBaseVertex());
+        drawCommand.vertexCount = mesh->GetVertexCount();
+        draw = drawCommand;
+    } else {
+        DrawIndexed drawCommand = {};
+        drawCommand.firstInstance = 0;  // MOTE: if drawIndirectFirstInstasnce is not disabled, this must be 0
+        drawCommand.instanceCount = 1;  // NOTE: we can use scene node to store instancing information
+        drawCommand.firstIndex = mesh->GetFirstIndex() + firstIndex;
+        drawCommand.indexCount = indexCount;
+        drawCommand.vertexOffset = mesh->GetBaseVertex();
+        draw = drawCommand;
+    }
+
+    // find queue for each pass
+    for (auto &pass : *technique) {
+        // queue
+        auto queueIt = objects.find(pass.queue);
+        if (queueIt == objects.end()) {
+            objects.insert(std::make_pair(pass.queue, std::vector<Drawable>()));
+            queueIt = objects.find(pass.queue);
+        }
+        // drawable
+        queueIt->second.push_back(Drawable {
+            node,
+            mesh, material, draw,
+            pass.queue,
+            distance,
+            0,
+            lod
+        });
+    }
 }
 
 void CPUCulling::Sort(uint32_t firstQueue, uint32_t lastQueue, SortingOrder sorting) {
+    if (sorting == SortingOrder::Unordered) {
+        return;
+    }
+
     for (auto& kv : objects) {
         RenderQueue queue = kv.first;
-        if (queue >= firstQueue && queue <= lastQueue) {
-            switch (sorting) {
-                case SortingOrder::FrontToback:
-                    std::sort(kv.second.begin(), kv.second.end(), SortDrawableAscending);
-                    break;
-                case SortingOrder::BackToFront:
-                    std::sort(kv.second.begin(), kv.second.end(), SortDrawableDescending);
-                    break;
-                default:
-                    break;
-            }
+        if (queue < firstQueue || queue > lastQueue || kv.second.empty()) {
+            continue;
+        }
+
+        // depth is quantized relative to the distance range of this queue
+        float minDistance = std::numeric_limits<float>::max();
+        float maxDistance = std::numeric_limits<float>::lowest();
+        for (const Drawable& drawable : kv.second) {
+            minDistance = std::min(minDistance, drawable.distanceToCamera);
+            maxDistance = std::max(maxDistance, drawable.distanceToCamera);
         }
+        float scale = maxDistance > minDistance ? 1.0f / (maxDistance - minDistance) : 0.0f;
+
+        pipelineIds.clear();
+        materialIds.clear();
+        meshIds.clear();
+        for (Drawable& drawable : kv.second) {
+            // a technique has one pipeline per queue, so technique identifies the pipeline here
+            uint32_t pipeline = DenseId(pipelineIds, drawable.material->GetTechnique());
+            uint32_t material = DenseId(materialIds, drawable.material.get());
+            uint32_t mesh = DenseId(meshIds, drawable.mesh.get());
+            float depth = (drawable.distanceToCamera - minDistance) * scale;
+            drawable.sortKey = MakeSortKey(sorting, queue, pipeline, material, mesh, depth);
+        }
+
+        std::sort(kv.second.begin(), kv.second.end(), SortDrawableByKey);
     }
 }
 
@@ -113,3 +334,136 @@ View<Drawable> CPUCulling::GetDrawables(uint32_t firstQueue, uint32_t lastQueue)
     }
     return drawables;
 }
+
+GPUCulling::GPUCulling(scene::Builder* builder, spirv::ComputeShader* shader, bool meshlets, bool occlusion)
+    : device(builder->GetDevice()), builder(builder), meshlets(meshlets), occlusion(occlusion) {
+    compact = device->GetContext()->GetDescription().IsDrawIndirectCountEnabled();
+
+    PipelineLayoutDesc layout = PipelineLayoutDesc()
+        .AddBinding("Instances", SetBinding { 0, 0 }, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+        .AddBinding("Batches",   SetBinding { 0, 1 }, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+        .AddBinding("Commands",  SetBinding { 0, 2 }, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+        .AddBinding("Counts",    SetBinding { 0, 3 }, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+        .AddBinding("Culling",   SetBinding { 0, 4 }, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);
+    if (meshlets) {
+        layout.AddBinding("Meshlets", SetBinding { 0, 5 }, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+              .AddBinding("Clusters", SetBinding { 0, 6 }, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);
+    }
+    if (occlusion) {
+        layout.AddBinding("Visibility",   SetBinding { 0, 7 }, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         VK_SHADER_STAGE_COMPUTE_BIT)
+              .AddBinding("DepthPyramid", SetBinding { 0, 8 }, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT);
+    }
+
+    pipeline = SlimPtr<Pipeline>(
+        device,
+        ComputePipelineDesc()
+            .SetName(meshlets ? "GPUCulling Meshlets" : "GPUCulling")
+            .SetComputeShader(shader)
+            .SetPipelineLayout(layout)
+    );
+}
+
+GPUCulling::~GPUCulling() {
+}
+
+void GPUCulling::Reserve(RenderFrame* renderFrame) {
+    uint32_t commandCount = meshlets ? builder->GetClusterCount() : builder->GetInstanceCount();
+    uint32_t batchCount = static_cast<uint32_t>(builder->GetInstanceBatches().size());
+    if (commandCount == 0) {
+        return;
+    }
+
+    // (re-)allocate output buffers when the scene grows
+    VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+    if (!drawBuffer.get() || drawBuffer->Size() < commandCount * COMMAND_STRIDE) {
+        if (renderFrame) renderFrame->RetireBuffer(drawBuffer);
+        drawBuffer = SlimPtr<Buffer>(device, commandCount * COMMAND_STRIDE, usage, VMA_MEMORY_USAGE_GPU_ONLY);
+        drawBuffer->SetName("GPUCulling Draw Buffer");
+    }
+    if (!countBuffer.get() || countBuffer->Size() < batchCount * sizeof(uint32_t)) {
+        if (renderFrame) renderFrame->RetireBuffer(countBuffer);
+        countBuffer = SlimPtr<Buffer>(device, batchCount * sizeof(uint32_t), usage, VMA_MEMORY_USAGE_GPU_ONLY);
+        countBuffer->SetName("GPUCulling Count Buffer");
+    }
+}
+
+void GPUCulling::Cull(RenderFrame* renderFrame, CommandBuffer* commandBuffer, Camera* camera) {
+    glm::vec3 eye = glm::vec3(glm::inverse(camera->GetView())[3]);
+    Cull(renderFrame, commandBuffer, camera->GetProjection() * camera->GetView(), eye);
+}
+
+void GPUCulling::Cull(RenderFrame* renderFrame, CommandBuffer* commandBuffer, const glm::mat4& viewProj) {
+    Cull(renderFrame, commandBuffer, viewProj, glm::vec4(0.0f));
+}
+
+void GPUCulling::Cull(RenderFrame* renderFrame, CommandBuffer* commandBuffer, const glm::mat4& viewProj, const glm::vec3& eye) {
+    Cull(renderFrame, commandBuffer, viewProj, glm::vec4(eye, coneCulling ? 1.0f : 0.0f));
+}
+
+void GPUCulling::Cull(RenderFrame* renderFrame, CommandBuffer* commandBuffer, const glm::mat4& viewProj, const glm::vec4& eye) {
+    uint32_t instanceCount = builder->GetInstanceCount();
+    uint32_t clusterCount = builder->GetClusterCount();
+    uint32_t batchCount = static_cast<uint32_t>(builder->GetInstanceBatches().size());
+    uint32_t commandCount = meshlets ? clusterCount : instanceCount;
+    if (commandCount == 0) {
+        return;
+    }
+    if (occlusion && !depthPyramid) {
+        throw std::runtime_error("[GPUCulling] occlusion inputs are bound by OcclusionCulling, cull through it instead");
+    }
+    Reserve(renderFrame);
+
+    // output buffers are shared by all frames in flight,
+    // indirect draws of earlier frames must be done reading them before they are overwritten
+    commandBuffer->PrepareForBuffer(drawBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    if (compact) {
+        commandBuffer->PrepareForBuffer(countBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                                        VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    }
+
+    // reset draw counts
+    if (compact) {
+        std::vector<uint32_t> zeros(batchCount, 0);
+        commandBuffer->CopyDataToBuffer(zeros, countBuffer);
+        commandBuffer->PrepareForBuffer(countBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    }
+
+    Frustum frustum(viewProj);
+    CullingData data = {};
+    for (uint32_t i = 0; i < 6; i++) {
+        data.planes[i] = frustum.GetPlane(static_cast<Frustum::Plane>(i));
+    }
+    data.instanceCount = instanceCount;
+    data.compact = compact ? 1 : 0;
+    data.clusterCount = clusterCount;
+    data.eye = eye;
+    if (occlusion) {
+        data.viewProj = viewProj;
+        data.pyramidSize = glm::vec2(depthPyramid->Width(), depthPyramid->Height());
+        data.pyramidLevels = depthPyramid->MipLevels();
+        data.phase = phase;
+    }
+
+    auto descriptor = SlimPtr<Descriptor>(renderFrame->GetDescriptorPool(), pipeline->Layout());
+    descriptor->SetStorageBuffer("Instances", builder->GetInstanceBuffer());
+    descriptor->SetStorageBuffer("Batches", builder->GetBatchBuffer());
+    descriptor->SetStorageBuffer("Commands", drawBuffer);
+    descriptor->SetStorageBuffer("Counts", countBuffer);
+    descriptor->SetUniformBuffer("Culling", renderFrame->RequestUniformBuffer(data));
+    if (meshlets) {
+        descriptor->SetStorageBuffer("Meshlets", builder->GetMeshletBuffer());
+        descriptor->SetStorageBuffer("Clusters", builder->GetClusterBuffer());
+    }
+    if (occlusion) {
+        descriptor->SetStorageBuffer("Visibility", visibilityBuffer);
+        descriptor->SetTexture("DepthPyramid", depthPyramid, pyramidSampler);
+    }
+
+    commandBuffer->BindPipeline(pipeline);
+    commandBuffer->BindDescriptor(descriptor, VK_PIPELINE_BIND_POINT_COMPUTE);
+    commandBuffer->Dispatch((commandCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+
+    // make commands and counts visible to indirect draws
+    commandBuffer->PrepareForBuffer(drawBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+    commandBuffer->PrepareForBuffer(countBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+}
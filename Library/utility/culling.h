@@ -4,9 +4,13 @@
 #include <map>
 #include <vector>
 #include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "utility/view.h"
 #include "utility/mesh.h"
+#include "utility/camera.h"
+#include "utility/frustum.h"
 #include "utility/material.h"
 #include "utility/technique.h"
 #include "utility/interface.h"
@@ -26,27 +30,178 @@ namespace slim {
         DrawVariant               drawCommand;
         RenderQueue               queue;
         float                     distanceToCamera;
+        uint64_t                  sortKey = 0;
+        uint32_t                  lod = 0;
     };
 
     // helper functions for sorting
     bool SortDrawableAscending(const Drawable& d1, const Drawable& d2);
     bool SortDrawableDescending(const Drawable& d1, const Drawable& d2);
+    bool SortDrawableByKey(const Drawable& d1, const Drawable& d2);
 
     using RenderQueueMap = std::map<RenderQueue, std::vector<Drawable>>;
 
     class CPUCulling : public NotCopyable, public NotMovable, public ReferenceCountable {
     public:
+        constexpr static float LOD_THRESHOLD  = 1.0f / 1080.0f;  // about a pixel at 1080p
+        constexpr static float LOD_HYSTERESIS = 0.25f;
+
         void Clear();
         void Cull(scene::Node* scene, Camera* camera);
         void Sort(uint32_t firstQueue, uint32_t lastQueue, SortingOrder sorting);
 
         View<Drawable> GetDrawables(uint32_t firstQueue, uint32_t lastQueue);
 
+        // meshes with levels of detail are drawn at the coarsest level whose simplification error projects
+        // to at most threshold of the viewport height, a threshold of 0 always draws the full mesh.
+        // Drawables only move to a coarser level below threshold * (1 - hysteresis), and back to a finer one
+        // above threshold * (1 + hysteresis). Levels are remembered across frames, keep CPUCulling around for it.
+        void SetLodThreshold(float threshold, float hysteresis = LOD_HYSTERESIS);
+
+        // level of detail of a mesh with world space bounds, given its level in the previous frame
+        uint32_t SelectLod(const scene::Mesh* mesh, const BoundingBox& bounds,
+                           const glm::vec3& eye, const glm::mat4& proj, uint32_t previous) const;
+
+        // meshes with meshlets are culled meshlet by meshlet at level 0, visible meshlets that are adjacent
+        // in the index data are merged into one drawable. Normal cones additionally cull meshlets facing away
+        // from the camera, which is only correct for materials culling back faces, so it is opt-in.
+        void SetConeCulling(bool enable) { coneCulling = enable; }
+
+        // drawables of these nodes are skipped, their children are not, e.g. nodes read back from
+        // OcclusionCulling::GetOccludedNodes(). Results of an earlier frame let disoccluded objects
+        // appear a frame or two late, pass an empty set to stop.
+        void SetOccludedNodes(std::unordered_set<const scene::Node*> nodes) { occludedNodes = std::move(nodes); }
+
     private:
-        bool CullSceneNode(scene::Node* scene, Camera* camera);
+        void CullMeshlets(scene::Node* node, scene::Mesh* mesh, scene::Material* material,
+                          float distance, const Frustum& frustum, const glm::vec3& eye);
+        void AddDrawable(scene::Node* node, scene::Mesh* mesh, scene::Material* material, float distance,
+                         uint32_t lod, uint32_t firstIndex, uint32_t indexCount);
 
     private:
         RenderQueueMap objects;
+
+        // linearized scene hierarchy, parents always precede their children
+        struct CullingNode {
+            scene::Node* node;
+            int32_t      parent;
+            uint32_t     firstDrawable;
+            BoundingBox  bounds;        // bounds of the whole subtree
+        };
+
+        // scratch data, kept around to avoid re-allocation every frame
+        std::vector<CullingNode> nodes;
+        std::vector<BoundingBox> drawableBounds;
+        BoundingBoxes            nodeBoxes;
+        BoundingBoxes            drawableBoxes;
+        std::vector<uint8_t>     nodeVisibility;
+        std::vector<uint8_t>     drawableVisibility;
+
+        // dense ids for sort keys, assigned in order of first appearance
+        std::unordered_map<const void*, uint32_t> pipelineIds;
+        std::unordered_map<const void*, uint32_t> materialIds;
+        std::unordered_map<const void*, uint32_t> meshIds;
+
+        // level of detail selection, levels of the previous frame per node and drawable,
+        // nodes not drawn in a cull are dropped, so destroyed nodes never hand their levels to new ones
+        struct LodState {
+            std::vector<uint8_t> levels;
+            uint32_t             cull = 0;      // last cull the node was drawn in
+        };
+        float lodThreshold = LOD_THRESHOLD;
+        float lodHysteresis = LOD_HYSTERESIS;
+        std::unordered_map<const scene::Node*, LodState> lodLevels;
+        uint32_t cullCount = 0;
+
+        bool coneCulling = false;
+        std::unordered_set<const scene::Node*> occludedNodes;
+    };
+
+    class OcclusionCulling;
+
+    /**
+     * GPUCulling culls the instances of a built scene (scene::Builder) in a compute shader.
+     * Visible instances of each batch are compacted into an indirect argument buffer,
+     * with one command per instance and firstInstance set to the instance id.
+     *
+     * The compute shader is provided by users, its interface is defined in shaderlib/indirect.h:
+     * "Instances", "Batches", "Commands", "Counts" storage buffers and a "Culling" uniform buffer.
+     * Without ContextDesc::EnableDrawIndirectCount, commands are not compacted, culled instances
+     * are written with instanceCount = 0 instead.
+     *
+     * In meshlet mode the shader runs once per cluster (an instance and one of its meshlets) instead,
+     * with two more storage buffers, "Meshlets" and "Clusters", and one command per visible cluster.
+     *
+     * In occlusion mode the layout has a "Visibility" storage buffer and a "DepthPyramid" texture as well,
+     * both are bound by OcclusionCulling, which owns such a GPUCulling for each of its phases.
+     **/
+    class GPUCulling : public NotCopyable, public NotMovable, public ReferenceCountable {
+        friend class OcclusionCulling;
+    public:
+        constexpr static uint32_t WORKGROUP_SIZE = 64;
+        constexpr static uint32_t COMMAND_STRIDE = sizeof(VkDrawIndexedIndirectCommand);
+
+        explicit GPUCulling(scene::Builder* builder, spirv::ComputeShader* shader, bool meshlets = false, bool occlusion = false);
+        virtual ~GPUCulling();
+
+        // (re-)allocate draw and count buffers for the current scene, Cull() does it on demand,
+        // call it before the buffers are declared to a render graph, replaced buffers are retired to the frame
+        // (frames still in flight may use them), without a frame nothing may use them anymore
+        void Reserve(RenderFrame* renderFrame = nullptr);
+
+        // normal cones are only tested in meshlet mode, and only for culls given a camera position
+        void SetConeCulling(bool enable) { coneCulling = enable; }
+
+        void Cull(RenderFrame* renderFrame, CommandBuffer* commandBuffer, Camera* camera);
+        void Cull(RenderFrame* renderFrame, CommandBuffer* commandBuffer, const glm::mat4& viewProj);
+        void Cull(RenderFrame* renderFrame, CommandBuffer* commandBuffer, const glm::mat4& viewProj, const glm::vec3& eye);
+
+        scene::Builder* GetScene()        const { return builder;     }
+        Buffer*         GetDrawBuffer()   const { return drawBuffer;  }
+        Buffer*         GetCountBuffer()  const { return countBuffer; }
+        bool            IsCompacted()     const { return compact;     }
+        bool            IsMeshlets()      const { return meshlets;    }
+
+        // range of commands written for a batch, one per instance or one per cluster in meshlet mode
+        uint32_t GetFirstCommand(const scene::InstanceBatch& batch) const {
+            return meshlets ? batch.firstCluster : batch.firstInstance;
+        }
+        uint32_t GetMaxCommands(const scene::InstanceBatch& batch) const {
+            return meshlets ? batch.clusterCount : batch.instanceCount;
+        }
+
+    private:
+        void Cull(RenderFrame* renderFrame, CommandBuffer* commandBuffer, const glm::mat4& viewProj, const glm::vec4& eye);
+
+        // culling parameters, matches CullingData in shaderlib/indirect.h
+        struct CullingData {
+            glm::vec4 planes[6];
+            uint32_t  instanceCount;
+            uint32_t  compact;
+            uint32_t  clusterCount;
+            uint32_t  padding;
+            glm::vec4 eye;
+            glm::mat4 viewProj;
+            glm::vec2 pyramidSize;
+            uint32_t  pyramidLevels;
+            uint32_t  phase;
+        };
+
+        SmartPtr<Device>         device;
+        SmartPtr<scene::Builder> builder;
+        SmartPtr<Pipeline>       pipeline;
+        SmartPtr<Buffer>         drawBuffer;
+        SmartPtr<Buffer>         countBuffer;
+        bool                     compact = false;
+        bool                     meshlets = false;
+        bool                     coneCulling = false;
+
+        // occlusion inputs, set by OcclusionCulling before each cull
+        bool                     occlusion = false;
+        uint32_t                 phase = 0;
+        Buffer*                  visibilityBuffer = nullptr;
+        Image*                   depthPyramid = nullptr;
+        Sampler*                 pyramidSampler = nullptr;
     };
 
 } // end of namespace slim
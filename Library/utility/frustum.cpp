@@ -0,0 +1,173 @@
+#include <cmath>
+#include "utility/frustum.h"
+
+#if defined(__AVX__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+using namespace slim;
+
+// extent used for boxes without valid bounds, they should never be culled
+constexpr float UNBOUNDED = 1e30f;
+
+void BoundingBoxes::Clear() {
+    count = 0;
+    cx.clear(); cy.clear(); cz.clear();
+    ex.clear(); ey.clear(); ez.clear();
+}
+
+void BoundingBoxes::Reserve(size_t count) {
+    cx.reserve(count); cy.reserve(count); cz.reserve(count);
+    ex.reserve(count); ey.reserve(count); ez.reserve(count);
+}
+
+void BoundingBoxes::Add(const BoundingBox& box) {
+    glm::vec3 center = (box.Max() + box.Min()) * 0.5f;
+    glm::vec3 extent = (box.Max() - box.Min()) * 0.5f;
+
+    bool finite = std::isfinite(center.x) && std::isfinite(center.y) && std::isfinite(center.z)
+               && std::isfinite(extent.x) && std::isfinite(extent.y) && std::isfinite(extent.z);
+
+    if (!box.IsValid() || !finite) {
+        center = glm::vec3(0.0f);
+        extent = glm::vec3(UNBOUNDED);
+    }
+
+    cx.push_back(center.x); cy.push_back(center.y); cz.push_back(center.z);
+    ex.push_back(extent.x); ey.push_back(extent.y); ez.push_back(extent.z);
+    count++;
+}
+
+Frustum::Frustum(const glm::mat4& m) {
+    // Gribb/Hartmann plane extraction, glm is column-major so row i is (m[0][i], m[1][i], m[2][i], m[3][i]).
+    // NOTE: near plane is row 3 + row 2 whichever depth range the projection uses. With [-1, 1] it is exact,
+    // with [0, 1] (GLM_FORCE_DEPTH_ZERO_TO_ONE) it lies behind the real near plane, which only keeps more boxes.
+    glm::vec4 row0 = glm::vec4(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1 = glm::vec4(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2 = glm::vec4(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3 = glm::vec4(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    planes[Left]   = row3 + row0;
+    planes[Right]  = row3 - row0;
+    planes[Bottom] = row3 + row1;
+    planes[Top]    = row3 - row1;
+    planes[Near]   = row3 + row2;
+    planes[Far]    = row3 - row2;
+
+    for (glm::vec4& plane : planes) {
+        float length = glm::length(glm::vec3(plane));
+        if (length > 0.0f) plane /= length;
+    }
+}
+
+bool Frustum::Intersect(const BoundingBox& box) const {
+    glm::vec3 c = (box.Max() + box.Min()) * 0.5f;
+    glm::vec3 e = (box.Max() - box.Min()) * 0.5f;
+
+    // boxes without valid bounds are never culled
+    if (!box.IsValid() || !std::isfinite(c.x + c.y + c.z + e.x + e.y + e.z)) {
+        return true;
+    }
+
+    for (const glm::vec4& plane : planes) {
+        float s = (plane.x * c.x + plane.y * c.y) + (plane.z * c.z + plane.w);
+        float r = (std::abs(plane.x) * e.x + std::abs(plane.y) * e.y) + std::abs(plane.z) * e.z;
+        if (s + r < 0.0f) return false;
+    }
+    return true;
+}
+
+bool Frustum::Intersect(const glm::vec3& center, float radius) const {
+    for (const glm::vec4& plane : planes) {
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) return false;
+    }
+    return true;
+}
+
+void Frustum::Intersect(const BoundingBoxes& boxes, std::vector<uint8_t>& visible) const {
+    const size_t count = boxes.Size();
+    visible.resize(count);
+
+    const float* cx = boxes.cx.data();
+    const float* cy = boxes.cy.data();
+    const float* cz = boxes.cz.data();
+    const float* ex = boxes.ex.data();
+    const float* ey = boxes.ey.data();
+    const float* ez = boxes.ez.data();
+
+    size_t i = 0;
+
+    #if defined(__AVX__)
+    // 8 boxes per iteration
+    __m256 pnx[6], pny[6], pnz[6], pnw[6], pax[6], pay[6], paz[6];
+    for (uint32_t p = 0; p < 6; p++) {
+        pnx[p] = _mm256_set1_ps(planes[p].x);
+        pny[p] = _mm256_set1_ps(planes[p].y);
+        pnz[p] = _mm256_set1_ps(planes[p].z);
+        pnw[p] = _mm256_set1_ps(planes[p].w);
+        pax[p] = _mm256_set1_ps(std::abs(planes[p].x));
+        pay[p] = _mm256_set1_ps(std::abs(planes[p].y));
+        paz[p] = _mm256_set1_ps(std::abs(planes[p].z));
+    }
+    const __m256 zero = _mm256_setzero_ps();
+    for (; i + 8 <= count; i += 8) {
+        __m256 x = _mm256_loadu_ps(cx + i), y = _mm256_loadu_ps(cy + i), z = _mm256_loadu_ps(cz + i);
+        __m256 u = _mm256_loadu_ps(ex + i), v = _mm256_loadu_ps(ey + i), w = _mm256_loadu_ps(ez + i);
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (uint32_t p = 0; p < 6; p++) {
+            __m256 s = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(pnx[p], x), _mm256_mul_ps(pny[p], y)),
+                                     _mm256_add_ps(_mm256_mul_ps(pnz[p], z), pnw[p]));
+            __m256 r = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(pax[p], u), _mm256_mul_ps(pay[p], v)),
+                                     _mm256_mul_ps(paz[p], w));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(s, r), zero, _CMP_GE_OQ));
+        }
+        int mask = _mm256_movemask_ps(inside);
+        for (uint32_t k = 0; k < 8; k++) {
+            visible[i + k] = static_cast<uint8_t>((mask >> k) & 1);
+        }
+    }
+    #elif defined(__SSE2__) || defined(_M_X64)
+    // 4 boxes per iteration
+    __m128 pnx[6], pny[6], pnz[6], pnw[6], pax[6], pay[6], paz[6];
+    for (uint32_t p = 0; p < 6; p++) {
+        pnx[p] = _mm_set1_ps(planes[p].x);
+        pny[p] = _mm_set1_ps(planes[p].y);
+        pnz[p] = _mm_set1_ps(planes[p].z);
+        pnw[p] = _mm_set1_ps(planes[p].w);
+        pax[p] = _mm_set1_ps(std::abs(planes[p].x));
+        pay[p] = _mm_set1_ps(std::abs(planes[p].y));
+        paz[p] = _mm_set1_ps(std::abs(planes[p].z));
+    }
+    const __m128 zero = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(cx + i), y = _mm_loadu_ps(cy + i), z = _mm_loadu_ps(cz + i);
+        __m128 u = _mm_loadu_ps(ex + i), v = _mm_loadu_ps(ey + i), w = _mm_loadu_ps(ez + i);
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (uint32_t p = 0; p < 6; p++) {
+            __m128 s = _mm_add_ps(_mm_add_ps(_mm_mul_ps(pnx[p], x), _mm_mul_ps(pny[p], y)),
+                                  _mm_add_ps(_mm_mul_ps(pnz[p], z), pnw[p]));
+            __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(pax[p], u), _mm_mul_ps(pay[p], v)),
+                                  _mm_mul_ps(paz[p], w));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(s, r), zero));
+        }
+        int mask = _mm_movemask_ps(inside);
+        for (uint32_t k = 0; k < 4; k++) {
+            visible[i + k] = static_cast<uint8_t>((mask >> k) & 1);
+        }
+    }
+    #endif
+
+    // scalar path for the remaining boxes
+    for (; i < count; i++) {
+        uint8_t inside = 1;
+        for (const glm::vec4& plane : planes) {
+            float s = (plane.x * cx[i] + plane.y * cy[i]) + (plane.z * cz[i] + plane.w);
+            float r = (std::abs(plane.x) * ex[i] + std::abs(plane.y) * ey[i]) + std::abs(plane.z) * ez[i];
+            if (s + r < 0.0f) {
+                inside = 0;
+                break;
+            }
+        }
+        visible[i] = inside;
+    }
+}
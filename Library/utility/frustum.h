@@ -0,0 +1,57 @@
+#ifndef SLIM_UTILITY_FRUSTUM_H
+#define SLIM_UTILITY_FRUSTUM_H
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+#include "utility/boundingbox.h"
+
+namespace slim {
+
+    // BoundingBoxes stores boxes as center + extent in a structure-of-arrays layout,
+    // so that a batch of boxes can be tested against the frustum with SIMD.
+    class BoundingBoxes final {
+        friend class Frustum;
+    public:
+        void Clear();
+        void Reserve(size_t count);
+        void Add(const BoundingBox& box);
+
+        size_t Size() const { return count; }
+        glm::vec3 GetCenter(size_t index) const { return glm::vec3(cx[index], cy[index], cz[index]); }
+        glm::vec3 GetExtent(size_t index) const { return glm::vec3(ex[index], ey[index], ez[index]); }
+
+    private:
+        size_t count = 0;
+        std::vector<float> cx, cy, cz;
+        std::vector<float> ex, ey, ez;
+    };
+
+    // Frustum holds the 6 planes extracted from a view-projection matrix.
+    // Planes point inwards, so points inside the frustum have positive distances.
+    class Frustum final {
+    public:
+        enum Plane { Left, Right, Bottom, Top, Near, Far };
+
+        explicit Frustum() = default;
+        explicit Frustum(const glm::mat4& viewProj);
+
+        // test a single box, returns false only when the box is fully outside
+        bool Intersect(const BoundingBox& box) const;
+
+        // test a single sphere, returns false only when the sphere is fully outside
+        bool Intersect(const glm::vec3& center, float radius) const;
+
+        // test a batch of boxes, visible[i] is 0 when boxes[i] is fully outside
+        void Intersect(const BoundingBoxes& boxes, std::vector<uint8_t>& visible) const;
+
+        const glm::vec4& GetPlane(Plane plane) const { return planes[plane]; }
+
+    private:
+        glm::vec4 planes[6];
+    };
+
+} // end of namespace slim
+
+#endif // end of SLIM_UTILITY_FRUSTUM_H
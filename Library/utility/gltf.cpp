@@ -1,80 +1,272 @@
+#include <cstring>
+#include <algorithm>
+#include <json.hpp>
+#include <glm/gtc/packing.hpp>
 #include "utility/gltf.h"
 #include "utility/texture.h"
 #include "utility/tinygltf.h"
 #include "utility/filesystem.h"
+#include "utility/mappedfile.h"
 
 using namespace slim;
 using namespace slim::gltf;
 
-void ReadVertexPosition(std::vector<Vertex>& vertices, const tinygltf::Model& model, const tinygltf::Accessor& accessor) {
-    if (accessor.count > vertices.size()) {
-        vertices.resize(accessor.count);
+// base address of each glTF buffer,
+// the BIN chunk of a .glb file is not copied into tinygltf::Buffer and points into the mapped file instead
+using BufferTable = std::vector<const uint8_t*>;
+
+// binary glTF container, see https://registry.khronos.org/glTF/specs/2.0/glTF-2.0.html#binary-gltf-layout
+constexpr uint32_t GLB_MAGIC      = 0x46546C67; // "glTF"
+constexpr uint32_t GLB_CHUNK_JSON = 0x4E4F534A; // "JSON"
+constexpr uint32_t GLB_CHUNK_BIN  = 0x004E4942; // "BIN\0"
+
+// smallest valid payload, stands in for data tinygltf should not load
+constexpr const char* GLB_PLACEHOLDER_BUFFER = "data:application/octet-stream;base64,AA==";
+constexpr const char* GLB_PLACEHOLDER_IMAGE  = "data:image/png;base64,AA==";
+
+const char* GetAccessorData(const BufferTable& buffers, const tinygltf::Model& model, const tinygltf::Accessor& accessor) {
+    const auto& bufferView = model.bufferViews[accessor.bufferView];
+    return reinterpret_cast<const char*>(buffers[bufferView.buffer]) + accessor.byteOffset + bufferView.byteOffset;
+}
+
+// image decoding is deferred to LoadImages
+bool SkipImageData(tinygltf::Image*, const int, std::string*, std::string*, int, int, const unsigned char*, int, void*) {
+    return true;
+}
+
+// components of each VertexAttribute, in declaration order
+constexpr uint32_t VERTEX_COMPONENTS[] = { 3, 3, 4, 2, 2, 4, 4, 4 };
+
+static_assert(sizeof(Vertex) == 104, "gltf::Vertex is expected to be tightly packed");
+
+uint32_t GetEncodingSize(VertexEncoding encoding, uint32_t components) {
+    // 16 bit formats with three components are padded to four, those are rarely supported for vertex fetch
+    uint32_t padded = components == 3 ? 4 : components;
+    switch (encoding) {
+        case VertexEncoding::None:       return 0;
+        case VertexEncoding::Float:      return components * sizeof(float);
+        case VertexEncoding::Half:
+        case VertexEncoding::Snorm16:
+        case VertexEncoding::Unorm16:
+        case VertexEncoding::Uint16:     return padded * sizeof(uint16_t);
+        case VertexEncoding::Unorm8:     return 4 * sizeof(uint8_t);
+        case VertexEncoding::Octahedral: return 2 * sizeof(int16_t);
+    }
+    return 0;
+}
+
+glm::vec4 GetAttributeValue(const Vertex& vertex, VertexAttribute attribute) {
+    switch (attribute) {
+        case VertexAttribute::Position:  return glm::vec4(vertex.position, 0.0f);
+        case VertexAttribute::Normal:    return glm::vec4(vertex.normal, 0.0f);
+        case VertexAttribute::Tangent:   return vertex.tangent;
+        case VertexAttribute::TexCoord0: return glm::vec4(vertex.uv0, 0.0f, 0.0f);
+        case VertexAttribute::TexCoord1: return glm::vec4(vertex.uv1, 0.0f, 0.0f);
+        case VertexAttribute::Color0:    return vertex.color0;
+        case VertexAttribute::Joints0:   return vertex.joints0;
+        case VertexAttribute::Weights0:  return vertex.weights0;
+        default:                         return glm::vec4(0.0f);
+    }
+}
+
+// same mapping as oct_encode in shaderlib/pack.h
+glm::vec2 OctEncode(glm::vec3 n) {
+    float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    if (l1 == 0.0f) return glm::vec2(0.0f);
+    n /= l1;
+    glm::vec2 p = glm::vec2(n.x, n.y);
+    if (n.z < 0.0f) {
+        glm::vec2 s = glm::vec2(p.x >= 0.0f ? 1.0f : -1.0f, p.y >= 0.0f ? 1.0f : -1.0f);
+        p = (glm::vec2(1.0f) - glm::abs(glm::vec2(p.y, p.x))) * s;
+    }
+    return p;
+}
+
+VertexLayout::VertexLayout() {
+    encodings.fill(VertexEncoding::Float);
+    Update();
+}
+
+VertexLayout VertexLayout::Compact() {
+    VertexLayout layout;
+    layout.encodings.fill(VertexEncoding::None);
+    layout.SetEncoding(VertexAttribute::Position, VertexEncoding::Float);
+    layout.SetEncoding(VertexAttribute::Normal, VertexEncoding::Octahedral);
+    layout.SetEncoding(VertexAttribute::TexCoord0, VertexEncoding::Half);
+    layout.CompactIndices();
+    return layout;
+}
+
+VertexLayout& VertexLayout::SetEncoding(VertexAttribute attribute, VertexEncoding encoding) {
+    // acceleration structures and culling read float positions at offset 0
+    if (attribute == VertexAttribute::Position && encoding != VertexEncoding::Float) {
+        throw std::runtime_error("[VertexLayout] position must be stored as float");
+    }
+    if (encoding == VertexEncoding::Octahedral && attribute != VertexAttribute::Normal) {
+        throw std::runtime_error("[VertexLayout] octahedral encoding is only supported for normals");
+    }
+    encodings[static_cast<uint32_t>(attribute)] = encoding;
+    Update();
+    return *this;
+}
+
+VertexLayout& VertexLayout::CompactIndices(bool value) {
+    compactIndices = value;
+    return *this;
+}
+
+bool VertexLayout::IsFull() const {
+    for (VertexEncoding encoding : encodings) {
+        if (encoding != VertexEncoding::Float) return false;
+    }
+    return true;
+}
+
+void VertexLayout::Update() {
+    stride = 0;
+    for (uint32_t i = 0; i < encodings.size(); i++) {
+        offsets[i] = stride;
+        stride += GetEncodingSize(encodings[i], VERTEX_COMPONENTS[i]);
+    }
+}
+
+VkFormat VertexLayout::GetFormat(VertexAttribute attribute) const {
+    uint32_t components = VERTEX_COMPONENTS[static_cast<uint32_t>(attribute)];
+    switch (GetEncoding(attribute)) {
+        case VertexEncoding::Float:
+            if (components == 2) return VK_FORMAT_R32G32_SFLOAT;
+            if (components == 3) return VK_FORMAT_R32G32B32_SFLOAT;
+            return VK_FORMAT_R32G32B32A32_SFLOAT;
+        case VertexEncoding::Half:
+            return components == 2 ? VK_FORMAT_R16G16_SFLOAT : VK_FORMAT_R16G16B16A16_SFLOAT;
+        case VertexEncoding::Snorm16:
+            return components == 2 ? VK_FORMAT_R16G16_SNORM : VK_FORMAT_R16G16B16A16_SNORM;
+        case VertexEncoding::Unorm16:
+            return components == 2 ? VK_FORMAT_R16G16_UNORM : VK_FORMAT_R16G16B16A16_UNORM;
+        case VertexEncoding::Uint16:
+            return components == 2 ? VK_FORMAT_R16G16_UINT : VK_FORMAT_R16G16B16A16_UINT;
+        case VertexEncoding::Unorm8:
+            return VK_FORMAT_R8G8B8A8_UNORM;
+        case VertexEncoding::Octahedral:
+            return VK_FORMAT_R16G16_SNORM;
+        default:
+            return VK_FORMAT_UNDEFINED;
+    }
+}
+
+std::vector<VertexAttrib> VertexLayout::GetVertexAttribs() const {
+    std::vector<VertexAttrib> attribs;
+    for (uint32_t i = 0; i < encodings.size(); i++) {
+        auto attribute = static_cast<VertexAttribute>(i);
+        if (!HasAttribute(attribute)) continue;
+        uint32_t location = static_cast<uint32_t>(attribs.size());
+        attribs.push_back(VertexAttrib { location, GetFormat(attribute), GetOffset(attribute) });
+    }
+    return attribs;
+}
+
+void VertexLayout::Encode(const Vertex& vertex, uint8_t* dst) const {
+    for (uint32_t i = 0; i < encodings.size(); i++) {
+        auto attribute = static_cast<VertexAttribute>(i);
+        uint32_t components = VERTEX_COMPONENTS[i];
+        uint32_t padded = components == 3 ? 4 : components;
+        glm::vec4 value = GetAttributeValue(vertex, attribute);
+        uint8_t* out = dst + offsets[i];
+
+        switch (encodings[i]) {
+            case VertexEncoding::None:
+                break;
+            case VertexEncoding::Float:
+                std::memcpy(out, &value, components * sizeof(float));
+                break;
+            case VertexEncoding::Half:
+                for (uint32_t c = 0; c < padded; c++) {
+                    reinterpret_cast<uint16_t*>(out)[c] = glm::packHalf1x16(value[c]);
+                }
+                break;
+            case VertexEncoding::Snorm16:
+                for (uint32_t c = 0; c < padded; c++) {
+                    reinterpret_cast<int16_t*>(out)[c] = static_cast<int16_t>(std::round(glm::clamp(value[c], -1.0f, 1.0f) * 32767.0f));
+                }
+                break;
+            case VertexEncoding::Unorm16:
+                for (uint32_t c = 0; c < padded; c++) {
+                    reinterpret_cast<uint16_t*>(out)[c] = static_cast<uint16_t>(std::round(glm::clamp(value[c], 0.0f, 1.0f) * 65535.0f));
+                }
+                break;
+            case VertexEncoding::Uint16:
+                for (uint32_t c = 0; c < padded; c++) {
+                    reinterpret_cast<uint16_t*>(out)[c] = static_cast<uint16_t>(glm::clamp(value[c], 0.0f, 65535.0f));
+                }
+                break;
+            case VertexEncoding::Unorm8:
+                for (uint32_t c = 0; c < 4; c++) {
+                    out[c] = static_cast<uint8_t>(std::round(glm::clamp(value[c], 0.0f, 1.0f) * 255.0f));
+                }
+                break;
+            case VertexEncoding::Octahedral: {
+                glm::vec2 p = OctEncode(glm::vec3(value));
+                reinterpret_cast<int16_t*>(out)[0] = static_cast<int16_t>(std::round(glm::clamp(p.x, -1.0f, 1.0f) * 32767.0f));
+                reinterpret_cast<int16_t*>(out)[1] = static_cast<int16_t>(std::round(glm::clamp(p.y, -1.0f, 1.0f) * 32767.0f));
+                break;
+            }
+        }
     }
+}
 
+void ReadVertexPosition(Vertex* vertices, const BufferTable& buffers, const tinygltf::Model& model, const tinygltf::Accessor& accessor) {
     // POSITION: VEC3, FLOAT
 
     const auto& bufferView = model.bufferViews[accessor.bufferView];
-    char* data = (char*) model.buffers[bufferView.buffer].data.data() + accessor.byteOffset + bufferView.byteOffset;
+    const char* data = GetAccessorData(buffers, model, accessor);
 
     assert(accessor.type == TINYGLTF_TYPE_VEC3);
     assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
 
     uint32_t stride = std::max(bufferView.byteStride, 3 * sizeof(float));
     for (uint32_t i = 0; i < accessor.count; i++, data += stride) {
-        const float* p = (float*)(data);
+        const float* p = (const float*)(data);
         vertices[i].position = glm::vec3(p[0], p[1], p[2]);
     }
 }
 
-void ReadVertexNormal(std::vector<Vertex>& vertices, const tinygltf::Model& model, const tinygltf::Accessor& accessor) {
-    if (accessor.count > vertices.size()) {
-        vertices.resize(accessor.count);
-    }
-
+void ReadVertexNormal(Vertex* vertices, const BufferTable& buffers, const tinygltf::Model& model, const tinygltf::Accessor& accessor) {
     // NORMAL: VEC3, FLOAT
 
     const auto& bufferView = model.bufferViews[accessor.bufferView];
-    char* data = (char*) model.buffers[bufferView.buffer].data.data() + accessor.byteOffset + bufferView.byteOffset;
+    const char* data = GetAccessorData(buffers, model, accessor);
 
     assert(accessor.type == TINYGLTF_TYPE_VEC3);
     assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
 
     uint32_t stride = std::max(bufferView.byteStride, 3 * sizeof(float));
     for (uint32_t i = 0; i < accessor.count; i++, data += stride) {
-        const float* p = (float*)(data);
+        const float* p = (const float*)(data);
         vertices[i].normal = glm::vec3(p[0], p[1], p[2]);
     }
 }
 
-void ReadVertexTangent(std::vector<Vertex>& vertices, const tinygltf::Model& model, const tinygltf::Accessor& accessor) {
-    if (accessor.count > vertices.size()) {
-        vertices.resize(accessor.count);
-    }
-
+void ReadVertexTangent(Vertex* vertices, const BufferTable& buffers, const tinygltf::Model& model, const tinygltf::Accessor& accessor) {
     // TANGENT: VEC3, FLOAT, where w component is a sign value (-1, or 1 indicating the handedness of the tangent basis)
 
     const auto& bufferView = model.bufferViews[accessor.bufferView];
-    char* data = (char*) model.buffers[bufferView.buffer].data.data() + accessor.byteOffset + bufferView.byteOffset;
+    const char* data = GetAccessorData(buffers, model, accessor);
 
     assert(accessor.type == TINYGLTF_TYPE_VEC4);
     assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
 
-    uint32_t stride = std::max(bufferView.byteStride, 3 * sizeof(float));
+    uint32_t stride = std::max(bufferView.byteStride, 4 * sizeof(float));
     for (uint32_t i = 0; i < accessor.count; i++, data += stride) {
-        const float* p = (float*)(data);
+        const float* p = (const float*)(data);
         vertices[i].tangent = glm::vec4(p[0], p[1], p[2], p[3]);
     }
 }
 
-void ReadVertexTexCoord0(std::vector<Vertex>& vertices, const tinygltf::Model& model, const tinygltf::Accessor& accessor) {
-    if (accessor.count > vertices.size()) {
-        vertices.resize(accessor.count);
-    }
-
+void ReadVertexTexCoord0(Vertex* vertices, const BufferTable& buffers, const tinygltf::Model& model, const tinygltf::Accessor& accessor) {
     // TEXCOORD_0: VEC2, FLOAT/UBYTE/USHORT
 
     const auto& bufferView = model.bufferViews[accessor.bufferView];
-    char* data = (char*) model.buffers[bufferView.buffer].data.data() + accessor.byteOffset + bufferView.byteOffset;
+    const char* data = GetAccessorData(buffers, model, accessor);
 
     assert(accessor.type == TINYGLTF_TYPE_VEC2);
     assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT ||
@@ -84,7 +276,7 @@ void ReadVertexTexCoord0(std::vector<Vertex>& vertices, const tinygltf::Model& m
     if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT) {
         uint32_t stride = std::max(bufferView.byteStride, 2 * sizeof(float));
         for (uint32_t i = 0; i < accessor.count; i++, data += stride) {
-            const float* p = (float*)(data);
+            const float* p = (const float*)(data);
             vertices[i].uv0 = glm::vec2(p[0], p[1]);
         }
     }
@@ -92,7 +284,7 @@ void ReadVertexTexCoord0(std::vector<Vertex>& vertices, const tinygltf::Model& m
     if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
         uint32_t stride = std::max(bufferView.byteStride, 2 * sizeof(unsigned short));
         for (uint32_t i = 0; i < accessor.count; i++, data += stride) {
-            const uint16_t* p = (uint16_t*)(data);
+            const uint16_t* p = (const uint16_t*)(data);
             vertices[i].uv0 = glm::vec2(p[0] / 65536.0, p[1] / 65536.0);
         }
     }
@@ -100,21 +292,17 @@ void ReadVertexTexCoord0(std::vector<Vertex>& vertices, const tinygltf::Model& m
     if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
         uint32_t stride = std::max(bufferView.byteStride, 2 * sizeof(unsigned char));
         for (uint32_t i = 0; i < accessor.count; i++, data += stride) {
-            const uint8_t* p = (uint8_t*)(data);
+            const uint8_t* p = (const uint8_t*)(data);
             vertices[i].uv0 = glm::vec2(p[0] / 256.0, p[1] / 256.0);
         }
     }
 }
 
-void ReadVertexTexCoord1(std::vector<Vertex>& vertices, const tinygltf::Model& model, const tinygltf::Accessor& accessor) {
-    if (accessor.count > vertices.size()) {
-        vertices.resize(accessor.count);
-    }
-
+void ReadVertexTexCoord1(Vertex* vertices, const BufferTable& buffers, const tinygltf::Model& model, const tinygltf::Accessor& accessor) {
     // TEXCOORD_1: VEC2, FLOAT/UBYTE/USHORT
 
     const auto& bufferView = model.bufferViews[accessor.bufferView];
-    char* data = (char*) model.buffers[bufferView.buffer].data.data() + accessor.byteOffset + bufferView.byteOffset;
+    const char* data = GetAccessorData(buffers, model, accessor);
 
     assert(accessor.type == TINYGLTF_TYPE_VEC2);
     assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT ||
@@ -124,7 +312,7 @@ void ReadVertexTexCoord1(std::vector<Vertex>& vertices, const tinygltf::Model& m
     if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT) {
         uint32_t stride = std::max(bufferView.byteStride, 2 * sizeof(float));
         for (uint32_t i = 0; i < accessor.count; i++, data += stride) {
-            const float* p = (float*)(data);
+            const float* p = (const float*)(data);
             vertices[i].uv1 = glm::vec2(p[0], p[1]);
         }
     }
@@ -132,7 +320,7 @@ void ReadVertexTexCoord1(std::vector<Vertex>& vertices, const tinygltf::Model& m
     if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
         uint32_t stride = std::max(bufferView.byteStride, 2 * sizeof(unsigned short));
         for (uint32_t i = 0; i < accessor.count; i++, data += stride) {
-            const uint16_t* p = (uint16_t*)(data);
+            const uint16_t* p = (const uint16_t*)(data);
             vertices[i].uv1 = glm::vec2(p[0] / 65536.0, p[1] / 65536.0);
         }
     }
@@ -140,21 +328,17 @@ void ReadVertexTexCoord1(std::vector<Vertex>& vertices, const tinygltf::Model& m
     if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
         uint32_t stride = std::max(bufferView.byteStride, 2 * sizeof(unsigned char));
         for (uint32_t i = 0; i < accessor.count; i++, data += stride) {
-            const uint8_t* p = (uint8_t*)(data);
+            const uint8_t* p = (const uint8_t*)(data);
             vertices[i].uv1 = glm::vec2(p[0] / 256.0, p[1] / 256.0);
         }
     }
 }
 
-void ReadVertexColor0(std::vector<Vertex>& vertices, const tinygltf::Model& model, const tinygltf::Accessor& accessor) {
-    if (accessor.count > vertices.size()) {
-        vertices.resize(accessor.count);
-    }
-
+void ReadVertexColor0(Vertex* vertices, const BufferTable& buffers, const tinygltf::Model& model, const tinygltf::Accessor& accessor) {
     // COLOR_0: VEC3/VEC4, FLOAT/UBYTE/USHORT
 
     const auto& bufferView = model.bufferViews[accessor.bufferView];
-    char* data = (char*) model.buffers[bufferView.buffer].data.data() + accessor.byteOffset + bufferView.byteOffset;
+    const char* data = GetAccessorData(buffers, model, accessor);
 
     assert(accessor.type == TINYGLTF_TYPE_VEC3 ||
            accessor.type == TINYGLTF_TYPE_VEC4);
@@ -166,7 +350,7 @@ void ReadVertexColor0(std::vector<Vertex>& vertices, const tinygltf::Model& mode
         uint32_t stride = std::max(bufferView.byteStride, 3 * sizeof(float));
         if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT) {
             for (uint32_t i = 0; i < accessor.count; i++, data += stride) {
-                const float* p = (float*)(data);
+                const float* p = (const float*)(data);
                 vertices[i].color0 = glm::vec4(p[0], p[1], p[2], 1.0);
             }
         }
@@ -174,7 +358,7 @@ void ReadVertexColor0(std::vector<Vertex>& vertices, const tinygltf::Model& mode
         if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
             uint32_t stride = std::max(bufferView.byteStride, 3 * sizeof(unsigned short));
             for (uint32_t i = 0; i < accessor.count; i++, data += stride) {
-                const uint16_t* p = (uint16_t*)(data);
+                const uint16_t* p = (const uint16_t*)(data);
                 vertices[i].color0 = glm::vec4(p[0] / 65536.0, p[1] / 65536.0, p[2] / 65536.0, 1.0);
             }
         }
@@ -182,7 +366,7 @@ void ReadVertexColor0(std::vector<Vertex>& vertices, const tinygltf::Model& mode
         if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
             uint32_t stride = std::max(bufferView.byteStride, 3 * sizeof(unsigned char));
             for (uint32_t i = 0; i < accessor.count; i++, data += stride) {
-                const uint8_t* p = (uint8_t*)(data);
+                const uint8_t* p = (const uint8_t*)(data);
                 vertices[i].color0 = glm::vec4(p[0] / 256.0, p[1] / 256.0, p[2] / 256.0, 1.0);
             }
         }
@@ -192,7 +376,7 @@ void ReadVertexColor0(std::vector<Vertex>& vertices, const tinygltf::Model& mode
         if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT) {
             uint32_t stride = std::max(bufferView.byteStride, 4 * sizeof(float));
             for (uint32_t i = 0; i < accessor.count; i++, data += stride) {
-                const float* p = (float*)(data);
+                const float* p = (const float*)(data);
                 vertices[i].color0 = glm::vec4(p[0], p[1], p[2], p[3]);
             }
         }
@@ -200,7 +384,7 @@ void ReadVertexColor0(std::vector<Vertex>& vertices, const tinygltf::Model& mode
         if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
             uint32_t stride = std::max(bufferView.byteStride, 4 * sizeof(unsigned short));
             for (uint32_t i = 0; i < accessor.count; i++, data += stride) {
-                const uint16_t* p = (uint16_t*)(data);
+                const uint16_t* p = (const uint16_t*)(data);
                 vertices[i].color0 = glm::vec4(p[0] / 65536.0, p[1] / 65536.0, p[2] / 65536.0, p[3] / 65536.0);
             }
         }
@@ -208,53 +392,45 @@ void ReadVertexColor0(std::vector<Vertex>& vertices, const tinygltf::Model& mode
         if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
             uint32_t stride = std::max(bufferView.byteStride, 4 * sizeof(unsigned char));
             for (uint32_t i = 0; i < accessor.count; i++, data += stride) {
-                const uint8_t* p = (uint8_t*)(data);
+                const uint8_t* p = (const uint8_t*)(data);
                 vertices[i].color0 = glm::vec4(p[0] / 256.0, p[1] / 256.0, p[2] / 256.0, p[3] / 256.0);
             }
         }
     }
 }
 
-void ReadVertexJoints0(std::vector<Vertex>& vertices, const tinygltf::Model& model, const tinygltf::Accessor& accessor) {
-    if (accessor.count > vertices.size()) {
-        vertices.resize(accessor.count);
-    }
-
-    // JOINTS_0: VEC4, FLOAT/USHORT
+void ReadVertexJoints0(Vertex* vertices, const BufferTable& buffers, const tinygltf::Model& model, const tinygltf::Accessor& accessor) {
+    // JOINTS_0: VEC4, UBYTE/USHORT, joint indices are kept as they are
 
     const auto& bufferView = model.bufferViews[accessor.bufferView];
-    char* data = (char*) model.buffers[bufferView.buffer].data.data() + accessor.byteOffset + bufferView.byteOffset;
+    const char* data = GetAccessorData(buffers, model, accessor);
 
     assert(accessor.type == TINYGLTF_TYPE_VEC4);
-    assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT ||
-           accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT);
+    assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT ||
+           accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE);
 
-    if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT) {
-        uint32_t stride = std::max(bufferView.byteStride, 4 * sizeof(float));
+    if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
+        uint32_t stride = std::max(bufferView.byteStride, 4 * sizeof(unsigned short));
         for (uint32_t i = 0; i < accessor.count; i++, data += stride) {
-            const float* p = (float*)(data);
+            const uint16_t* p = (const uint16_t*)(data);
             vertices[i].joints0 = glm::vec4(p[0], p[1], p[2], p[3]);
         }
     }
 
-    if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
-        uint32_t stride = std::max(bufferView.byteStride, 4 * sizeof(unsigned short));
+    if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
+        uint32_t stride = std::max(bufferView.byteStride, 4 * sizeof(unsigned char));
         for (uint32_t i = 0; i < accessor.count; i++, data += stride) {
-            const uint16_t* p = (uint16_t*)(data);
-            vertices[i].joints0 = glm::vec4(p[0] / 65536.0, p[1] / 65536.0, p[2] / 65536.0, p[3] / 65536.0);
+            const uint8_t* p = (const uint8_t*)(data);
+            vertices[i].joints0 = glm::vec4(p[0], p[1], p[2], p[3]);
         }
     }
 }
 
-void ReadVertexWeights0(std::vector<Vertex>& vertices, const tinygltf::Model& model, const tinygltf::Accessor& accessor) {
-    if (accessor.count > vertices.size()) {
-        vertices.resize(accessor.count);
-    }
-
+void ReadVertexWeights0(Vertex* vertices, const BufferTable& buffers, const tinygltf::Model& model, const tinygltf::Accessor& accessor) {
     // WEIGHTS_0: VEC4, FLOAT/UBYTE/USHORT
 
     const auto& bufferView = model.bufferViews[accessor.bufferView];
-    char* data = (char*) model.buffers[bufferView.buffer].data.data() + accessor.byteOffset + bufferView.byteOffset;
+    const char* data = GetAccessorData(buffers, model, accessor);
 
     assert(accessor.type == TINYGLTF_TYPE_VEC4);
     assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT ||
@@ -264,7 +440,7 @@ void ReadVertexWeights0(std::vector<Vertex>& vertices, const tinygltf::Model& mo
     if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT) {
         uint32_t stride = std::max(bufferView.byteStride, 4 * sizeof(float));
         for (uint32_t i = 0; i < accessor.count; i++, data += stride) {
-            const float* p = (float*)(data);
+            const float* p = (const float*)(data);
             vertices[i].weights0 = glm::vec4(p[0], p[1], p[2], p[3]);
         }
     }
@@ -272,7 +448,7 @@ void ReadVertexWeights0(std::vector<Vertex>& vertices, const tinygltf::Model& mo
     if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
         uint32_t stride = std::max(bufferView.byteStride, 4 * sizeof(unsigned short));
         for (uint32_t i = 0; i < accessor.count; i++, data += stride) {
-            const uint16_t* p = (uint16_t*)(data);
+            const uint16_t* p = (const uint16_t*)(data);
             vertices[i].weights0 = glm::vec4(p[0] / 65536.0, p[1] / 65536.0, p[2] / 65536.0, p[3] / 65536.0);
         }
     }
@@ -280,47 +456,54 @@ void ReadVertexWeights0(std::vector<Vertex>& vertices, const tinygltf::Model& mo
     if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
         uint32_t stride = std::max(bufferView.byteStride, 4 * sizeof(unsigned char));
         for (uint32_t i = 0; i < accessor.count; i++, data += stride) {
-            const uint8_t* p = (uint8_t*)(data);
+            const uint8_t* p = (const uint8_t*)(data);
             vertices[i].weights0 = glm::vec4(p[0] / 256.0, p[1] / 256.0, p[2] / 256.0, p[3] / 256.0);
         }
     }
 }
 
-void ReadIndices(std::vector<uint32_t>& indices, const tinygltf::Model& model, const tinygltf::Accessor& accessor) {
-    if (accessor.count > indices.size()) {
-        indices.resize(accessor.count);
-    }
-
+template <typename IndexType>
+void ReadIndices(IndexType* indices, const BufferTable& buffers, const tinygltf::Model& model, const tinygltf::Accessor& accessor) {
     const auto& bufferView = model.bufferViews[accessor.bufferView];
-    char* data = (char*) model.buffers[bufferView.buffer].data.data() + accessor.byteOffset + bufferView.byteOffset;
+    const char* data = GetAccessorData(buffers, model, accessor);
 
-    assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT ||
+    assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE ||
+           accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT ||
            accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT);
 
+    // callers only pick 16 bit indices when every vertex is addressable by them
+    if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
+        uint32_t stride = bufferView.byteStride ? bufferView.byteStride : sizeof(uint8_t);
+        for (uint32_t i = 0; i < accessor.count; i++, data += stride) {
+            const uint8_t* p = (const uint8_t*)(data);
+            indices[i] = static_cast<IndexType>(p[0]);
+        }
+    }
+
     if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
-        uint32_t stride = bufferView.byteStride ? bufferView.byteOffset : sizeof(uint16_t);
+        uint32_t stride = bufferView.byteStride ? bufferView.byteStride : sizeof(uint16_t);
         for (uint32_t i = 0; i < accessor.count; i++, data += stride) {
-            const uint16_t* p = (uint16_t*)(data);
-            indices[i] = p[0];
+            const uint16_t* p = (const uint16_t*)(data);
+            indices[i] = static_cast<IndexType>(p[0]);
         }
     }
 
     if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT) {
-        uint32_t stride = bufferView.byteStride ? bufferView.byteOffset : sizeof(uint32_t);
+        uint32_t stride = bufferView.byteStride ? bufferView.byteStride : sizeof(uint32_t);
         for (uint32_t i = 0; i < accessor.count; i++, data += stride) {
-            const uint32_t* p = (uint32_t*)(data);
-            indices[i] = p[0];
+            const uint32_t* p = (const uint32_t*)(data);
+            indices[i] = static_cast<IndexType>(p[0]);
         }
     }
 }
 
 // https://stackoverflow.com/Questions/5255806/how-to-calculate-tangent-and-binormal
 // NOTE: This algorithm does not get me entirely correct normal, I need to investigate what's wrong.
-void MakeTangents(std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, bool verbose) {
-    uint32_t nIndices = indices.size();
+template <typename IndexType>
+void MakeTangents(Vertex* vertices, const IndexType* indices, uint32_t nIndices, bool verbose) {
     uint32_t inconsistentUvs = 0;
-    for (uint32_t i : indices) {
-        vertices[i].tangent = glm::vec4(0.0);
+    for (uint32_t l = 0; l < nIndices; l++) {
+        vertices[indices[l]].tangent = glm::vec4(0.0);
     }
     for (uint32_t l = 0; l < nIndices; l++) {
         uint32_t i = indices[l];
@@ -353,7 +536,8 @@ void MakeTangents(std::vector<Vertex>& vertices, const std::vector<uint32_t>& in
         float angle = std::acos(dot(v1, v2) / (length(v1) * length(v2)));
         vertices[i].tangent += glm::vec4(s * angle, 0);
     }
-    for (uint32_t i : indices) {
+    for (uint32_t l = 0; l < nIndices; l++) {
+        uint32_t i = indices[l];
         glm::vec4& t = vertices[i].tangent;
         vertices[i].tangent = glm::vec4(normalize(glm::vec3(t.x, t.y, t.z)), t.w);
     }
@@ -412,13 +596,34 @@ void LoadSamplers(Device* device, Model &result, const tinygltf::Model &model) {
     }
 }
 
-void LoadImages(Device* device, Model &result, const tinygltf::Model& model, const std::string& basedir) {
+void LoadImages(Device* device, Model &result, const tinygltf::Model& model, const std::string& basedir,
+                const BufferTable& buffers, const std::vector<int>& imageViews, bool verbose) {
+    std::vector<TextureLoader::Source> sources(model.images.size());
+    for (uint32_t i = 0; i < model.images.size(); i++) {
+        // images embedded in a .glb file are decoded from the mapped BIN chunk
+        if (i < imageViews.size() && imageViews[i] >= 0) {
+            const auto& bufferView = model.bufferViews[imageViews[i]];
+            sources[i].encoded = buffers[bufferView.buffer] + bufferView.byteOffset;
+            sources[i].size = bufferView.byteLength;
+        } else {
+            sources[i].filename = basedir + "/" + model.images[i].uri;
+        }
+    }
+
+    // decoding runs on worker threads, images are still created in glTF order
+    std::vector<double> decodeTimes;
     device->Execute([&](CommandBuffer* commandBuffer) {
-        for (const auto& image : model.images) {
-            std::string filepath = basedir + "/" + image.uri;
-            result.images.push_back(TextureLoader::Load2D(commandBuffer, filepath));
+        for (GPUImage* image : TextureLoader::Load2D(commandBuffer, sources, VK_FILTER_LINEAR, &decodeTimes)) {
+            result.images.push_back(image);
         }
     });
+
+    if (verbose) {
+        for (uint32_t i = 0; i < model.images.size(); i++) {
+            std::string name = model.images[i].name.empty() ? sources[i].filename : model.images[i].name;
+            std::cout << "[LoadModel] Decoded image " << i << " (" << name << ") in " << decodeTimes[i] << " ms" << std::endl;
+        }
+    }
 }
 
 void LoadMaterials(Model &result, const tinygltf::Model &model, scene::Builder* builder) {
@@ -518,13 +723,33 @@ void LoadMaterials(Model &result, const tinygltf::Model &model, scene::Builder*
     }
 }
 
-void LoadMeshes(Model &result, const tinygltf::Model& model, scene::Builder* builder, bool verbose) {
+void LoadMeshes(Model &result, const tinygltf::Model& model, const BufferTable& buffers, scene::Builder* builder,
+                const VertexLayout& layout, bool verbose) {
+    // compact layouts decode into a reused full precision scratch buffer first, tangents are generated from it
+    bool full = layout.IsFull();
+    std::vector<Vertex> scratch;
+
     for (const auto& mesh : model.meshes) {
         result.meshes.push_back(MeshData { });
         MeshData& gltfmesh = result.meshes.back();
         for (const auto& primitive : mesh.primitives) {
-            std::vector<Vertex> vertices;
-            std::vector<uint32_t> indices;
+            auto position = primitive.attributes.find("POSITION");
+            if (position == primitive.attributes.end()) {
+                throw std::runtime_error("[LoadModel] primitive without POSITION attribute");
+            }
+            size_t vertexCount = model.accessors[position->second].count;
+
+            Primitive prim;
+            prim.mesh = builder->CreateMesh();
+
+            // full precision attributes are decoded straight into the mesh storage, which is what gets uploaded
+            Vertex* vertices = nullptr;
+            if (full) {
+                vertices = prim.mesh->AllocateVertexBuffer<Vertex>(vertexCount, 0);
+            } else {
+                scratch.assign(vertexCount, Vertex { });
+                vertices = scratch.data();
+            }
 
             bool hasTangent = false;
 
@@ -532,67 +757,82 @@ void LoadMeshes(Model &result, const tinygltf::Model& model, scene::Builder* bui
                 const auto& attrib = kv.first;
                 const auto& accessor = model.accessors[kv.second];
 
+                if (accessor.count != vertexCount) {
+                    throw std::runtime_error("[LoadModel] vertex attrib " + attrib + " has inconsistent count");
+                }
+
                 if (attrib == "POSITION") {
                     if (verbose) std::cout << "[LoadModel] Loading vertex attrib: POSITION" << std::endl;
-                    ReadVertexPosition(vertices, model, accessor);
+                    ReadVertexPosition(vertices, buffers, model, accessor);
                 }
 
                 else if (attrib == "NORMAL") {
                     if (verbose) std::cout << "[LoadModel] Loading vertex attrib: NORMAL" << std::endl;
-                    ReadVertexNormal(vertices, model, accessor);
+                    ReadVertexNormal(vertices, buffers, model, accessor);
                 }
 
                 else if (attrib == "TANGENT") {
                     if (verbose) std::cout << "[LoadModel] Loading vertex attrib: TANGENT" << std::endl;
-                    ReadVertexTangent(vertices, model, accessor);
+                    ReadVertexTangent(vertices, buffers, model, accessor);
                     hasTangent = true;
                 }
 
                 else if (attrib == "TEXCOORD_0") {
                     if (verbose) std::cout << "[LoadModel] Loading vertex attrib: TEXCOORD_0" << std::endl;
-                    ReadVertexTexCoord0(vertices, model, accessor);
+                    ReadVertexTexCoord0(vertices, buffers, model, accessor);
                 }
 
                 else if (attrib == "TEXCOORD_1") {
                     if (verbose) std::cout << "[LoadModel] Loading vertex attrib: TEXCOORD_1" << std::endl;
-                    ReadVertexTexCoord1(vertices, model, accessor);
+                    ReadVertexTexCoord1(vertices, buffers, model, accessor);
                 }
 
                 else if (attrib == "COLOR_0") {
                     if (verbose) std::cout << "[LoadModel] Loading vertex attrib: COLOR_0" << std::endl;
-                    ReadVertexColor0(vertices, model, accessor);
+                    ReadVertexColor0(vertices, buffers, model, accessor);
                 }
 
                 else if (attrib == "JOINTS_0") {
                     if (verbose) std::cout << "[LoadModel] Loading vertex attrib: JOINTS_0" << std::endl;
-                    ReadVertexJoints0(vertices, model, accessor);
+                    ReadVertexJoints0(vertices, buffers, model, accessor);
                 }
 
                 else if (attrib == "WEIGHTS_0") {
                     if (verbose) std::cout << "[LoadModel] Loading vertex attrib: WEIGHTS_0" << std::endl;
-                    ReadVertexWeights0(vertices, model, accessor);
+                    ReadVertexWeights0(vertices, buffers, model, accessor);
                 }
 
             } // end of attribute loop
 
+            // tangents are generated while reading indices, when they are missing
             if (primitive.indices >= 0) {
                 if (verbose) std::cout << "[LoadModel] Loading index attrib" << std::endl;
-                ReadIndices(indices, model, model.accessors[primitive.indices]);
+                const auto& accessor = model.accessors[primitive.indices];
+                uint32_t indexCount = accessor.count;
+                if (layout.HasCompactIndices() && vertexCount < 65536) {
+                    uint16_t* indices = prim.mesh->AllocateIndexBuffer<uint16_t>(indexCount);
+                    ReadIndices(indices, buffers, model, accessor);
+                    if (!hasTangent) MakeTangents(vertices, indices, indexCount, verbose);
+                } else {
+                    uint32_t* indices = prim.mesh->AllocateIndexBuffer<uint32_t>(indexCount);
+                    ReadIndices(indices, buffers, model, accessor);
+                    if (!hasTangent) MakeTangents(vertices, indices, indexCount, verbose);
+                }
             }
 
-            // tangent?
-            if (!hasTangent) {
-                MakeTangents(vertices, indices, verbose);
+            // bounding box
+            for (size_t i = 0; i < vertexCount; i++) {
+                prim.boundingBox += BoundingBox(vertices[i].position, vertices[i].position);
             }
-
-            Primitive prim;
-
-            prim.mesh = builder->CreateMesh();
-            prim.mesh->SetVertexBuffer(vertices);
-
-            // index
-            if (!indices.empty()) {
-                prim.mesh->SetIndexBuffer(indices);
+            prim.mesh->SetBoundingBox(prim.boundingBox);
+
+            // pack into the declared layout
+            if (!full) {
+                uint32_t stride = layout.GetStride();
+                uint8_t* data = prim.mesh->AllocateVertexBuffer(vertexCount, stride, 0);
+                for (size_t i = 0; i < vertexCount; i++) {
+                    layout.Encode(vertices[i], data + i * stride);
+                }
             }
 
             // topology
@@ -645,7 +885,6 @@ void LoadNodes(Model &result, const tinygltf::Model &model, scene::Builder* buil
             const auto& mesh = result.meshes[node.mesh];
             for (const auto& primitive : mesh.primitives) {
                 snode->AddDraw(primitive.mesh, primitive.material);
-                snode->AddDraw(primitive.mesh, primitive.material);
             }
         }
 
@@ -673,7 +912,158 @@ void LoadScenes(Model& result, const tinygltf::Model& model, scene::Builder* bui
     }
 }
 
+// offset + length <= size, without overflowing
+bool InRange(uint64_t offset, uint64_t length, uint64_t size) {
+    return offset <= size && length <= size - offset;
+}
+
+// The BIN buffer is declared to tinygltf with a placeholder length, so its range checks never
+// see the real chunk. Every buffer view, accessor and embedded image is checked here instead,
+// before any of them is read from the mapped file.
+bool ValidateBufferRanges(const tinygltf::Model& model, const BufferTable& buffers, int binBuffer, uint32_t binSize,
+                          const std::vector<int>& imageViews, std::string& err) {
+    for (const auto& bufferView : model.bufferViews) {
+        if (bufferView.buffer < 0 || bufferView.buffer >= static_cast<int>(buffers.size())) {
+            err = "GLB buffer view refers to an invalid buffer";
+            return false;
+        }
+        uint64_t bufferSize = bufferView.buffer == binBuffer ? binSize : model.buffers[bufferView.buffer].data.size();
+        if (!InRange(bufferView.byteOffset, bufferView.byteLength, bufferSize)) {
+            err = "GLB buffer view exceeds its buffer";
+            return false;
+        }
+    }
+
+    for (const auto& accessor : model.accessors) {
+        if (accessor.bufferView < 0) continue;
+        if (accessor.bufferView >= static_cast<int>(model.bufferViews.size())) {
+            err = "GLB accessor refers to an invalid buffer view";
+            return false;
+        }
+        int componentSize = tinygltf::GetComponentSizeInBytes(accessor.componentType);
+        int components = tinygltf::GetNumComponentsInType(accessor.type);
+        if (componentSize <= 0 || components <= 0) {
+            err = "GLB accessor has an invalid type";
+            return false;
+        }
+        if (accessor.count == 0) continue;
+
+        // readers step by max(byteStride, element size), the last element is not padded to the stride
+        const auto& bufferView = model.bufferViews[accessor.bufferView];
+        uint64_t elementSize = static_cast<uint64_t>(componentSize) * components;
+        uint64_t stride = std::max<uint64_t>(bufferView.byteStride, elementSize);
+        uint64_t count = accessor.count;
+        if (count - 1 > (UINT64_MAX - elementSize) / stride ||
+            !InRange(accessor.byteOffset, (count - 1) * stride + elementSize, bufferView.byteLength)) {
+            err = "GLB accessor exceeds its buffer view";
+            return false;
+        }
+    }
+
+    for (int view : imageViews) {
+        if (view >= static_cast<int>(model.bufferViews.size())) {
+            err = "GLB image refers to an invalid buffer view";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Parse a .glb file without reading it into memory.
+// tinygltf copies the whole BIN chunk into tinygltf::Buffer when given a binary file,
+// so only the JSON chunk is handed to it, with the BIN buffer and embedded images replaced by
+// placeholders. Accessors and images are then read in place from the mapped BIN chunk.
+bool LoadBinary(tinygltf::TinyGLTF& loader, tinygltf::Model& model, std::string& err, std::string& warn,
+                const MappedFile& file, const std::string& base, BufferTable& buffers, std::vector<int>& imageViews) {
+    const uint8_t* bytes = file.GetData();
+    size_t size = file.GetSize();
+
+    // header: magic, version, length
+    uint32_t header[3] = {};
+    if (size < sizeof(header) + 8) {
+        err = "GLB file is too small";
+        return false;
+    }
+    std::memcpy(header, bytes, sizeof(header));
+    if (header[0] != GLB_MAGIC || header[1] != 2 || header[2] > size) {
+        err = "invalid GLB header";
+        return false;
+    }
+
+    // chunks: length, type, data padded to 4 bytes
+    const uint8_t* json = nullptr;
+    const uint8_t* bin = nullptr;
+    uint32_t jsonSize = 0;
+    uint32_t binSize = 0;
+    for (size_t offset = sizeof(header); offset + 8 <= header[2];) {
+        uint32_t chunk[2] = {};
+        std::memcpy(chunk, bytes + offset, sizeof(chunk));
+        offset += sizeof(chunk);
+        if (offset + chunk[0] > header[2]) {
+            err = "GLB chunk exceeds file length";
+            return false;
+        }
+        if (chunk[1] == GLB_CHUNK_JSON && !json) { json = bytes + offset; jsonSize = chunk[0]; }
+        if (chunk[1] == GLB_CHUNK_BIN  && !bin)  { bin  = bytes + offset; binSize  = chunk[0]; }
+        offset += (chunk[0] + 3) & ~3u;
+    }
+    if (!json) {
+        err = "GLB file has no JSON chunk";
+        return false;
+    }
+
+    nlohmann::json document = nlohmann::json::parse(json, json + jsonSize, nullptr, false);
+    if (document.is_discarded()) {
+        err = "failed to parse GLB JSON chunk";
+        return false;
+    }
+
+    // the buffer without uri refers to the BIN chunk
+    int binBuffer = -1;
+    if (document.contains("buffers")) {
+        auto& items = document["buffers"];
+        for (size_t i = 0; i < items.size(); i++) {
+            if (items[i].contains("uri")) continue;
+            if (!bin || items[i].value("byteLength", uint64_t(0)) > binSize) {
+                err = "GLB buffer exceeds BIN chunk";
+                return false;
+            }
+            items[i]["uri"] = GLB_PLACEHOLDER_BUFFER;
+            items[i]["byteLength"] = 1;
+            binBuffer = static_cast<int>(i);
+        }
+    }
+
+    // embedded images are decoded later from the mapped buffer view
+    if (document.contains("images")) {
+        auto& items = document["images"];
+        imageViews.assign(items.size(), -1);
+        for (size_t i = 0; i < items.size(); i++) {
+            if (!items[i].contains("bufferView")) continue;
+            imageViews[i] = items[i]["bufferView"].get<int>();
+            items[i].erase("bufferView");
+            items[i].erase("mimeType");
+            items[i]["uri"] = GLB_PLACEHOLDER_IMAGE;
+        }
+    }
+
+    std::string text = document.dump();
+    if (!loader.LoadASCIIFromString(&model, &err, &warn, text.c_str(), static_cast<unsigned int>(text.size()), base, tinygltf::REQUIRE_ALL)) {
+        return false;
+    }
+
+    buffers.resize(model.buffers.size());
+    for (size_t i = 0; i < model.buffers.size(); i++) {
+        buffers[i] = static_cast<int>(i) == binBuffer ? bin : model.buffers[i].data.data();
+    }
+    return ValidateBufferRanges(model, buffers, binBuffer, binSize, imageViews, err);
+}
+
 void Model::Load(scene::Builder* builder, const std::string& path, bool verbose) {
+    Load(builder, path, VertexLayout(), verbose);
+}
+
+void Model::Load(scene::Builder* builder, const std::string& path, const VertexLayout& layout, bool verbose) {
     // clearing existing data
     scenes.clear();
     meshes.clear();
@@ -695,7 +1085,27 @@ void Model::Load(scene::Builder* builder, const std::string& path, bool verbose)
     std::string err;
     std::string warn;
     if (verbose) std::cout << "[LoadModel] Loading model: " << name << std::endl;
-    bool ret = loader.LoadASCIIFromFile(&model, &err, &warn, path, tinygltf::REQUIRE_ALL);
+
+    // the mapping has to outlive mesh and image loading, which read from it in place
+    SmartPtr<MappedFile> file;
+    BufferTable buffers;
+    std::vector<int> imageViews;
+
+    // images are decoded by LoadImages on worker threads, tinygltf would otherwise decode all of them serially up front
+    loader.SetImageLoader(SkipImageData, nullptr);
+
+    bool ret = false;
+    std::string extension = filesystem::path(path).extension().u8string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    if (extension == ".glb") {
+        file = SlimPtr<MappedFile>(path);
+        ret = LoadBinary(loader, model, err, warn, *file, base, buffers, imageViews);
+    } else {
+        ret = loader.LoadASCIIFromFile(&model, &err, &warn, path, tinygltf::REQUIRE_ALL);
+        for (const auto& buffer : model.buffers) {
+            buffers.push_back(buffer.data.data());
+        }
+    }
 
     if (!warn.empty()) {
         std::cout << "Warn: " << warn << std::endl;
@@ -718,13 +1128,13 @@ void Model::Load(scene::Builder* builder, const std::string& path, bool verbose)
     LoadSamplers(device, result, model);
 
     if (verbose) std::cout << "[LoadModel] Loading images" << std::endl;
-    LoadImages(device, result, model, base);
+    LoadImages(device, result, model, base, buffers, imageViews, verbose);
 
     if (verbose) std::cout << "[LoadModel] Loading materials" << std::endl;
     LoadMaterials(result, model, builder);
 
     if (verbose) std::cout << "[LoadModel] Loading meshes" << std::endl;
-    LoadMeshes(result, model, builder, verbose);
+    LoadMeshes(result, model, buffers, builder, layout, verbose);
 
     if (verbose) std::cout << "[LoadModel] Loading nodes" << std::endl;
     LoadNodes(result, model, builder);
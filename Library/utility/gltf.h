@@ -1,8 +1,10 @@
 #ifndef SLIM_UTILITY_GLTF_H
 #define SLIM_UTILITY_GLTF_H
 
+#include <array>
 #include <glm/glm.hpp>
 #include "core/commands.h"
+#include "core/pipeline.h"
 #include "utility/mesh.h"
 #include "utility/scenegraph.h"
 #include "utility/boundingbox.h"
@@ -60,6 +62,63 @@ namespace slim::gltf {
         glm::vec4 weights0;
     };
 
+    enum class VertexAttribute : uint32_t {
+        Position, Normal, Tangent, TexCoord0, TexCoord1, Color0, Joints0, Weights0, Count
+    };
+
+    // how a vertex attribute is stored, smaller encodings trade precision for vertex fetch bandwidth
+    enum class VertexEncoding : uint32_t {
+        None,           // not stored
+        Float,          // 32 bit float per component, as in gltf::Vertex
+        Half,           // 16 bit float per component                     (texcoords)
+        Snorm16,        // 16 bit signed normalized per component         (normals, tangents)
+        Unorm16,        // 16 bit unsigned normalized, clamped to [0, 1]  (texcoords, weights)
+        Unorm8,         // 8 bit unsigned normalized, clamped to [0, 1]   (colors, weights)
+        Uint16,         // 16 bit unsigned integer                        (joints)
+        Octahedral,     // 2x snorm16 octahedral map, decode with oct_decode from shaderlib (normals)
+    };
+
+    // VertexLayout declares which attributes a model's vertices store and how.
+    // Present attributes are packed in VertexAttribute order into a single binding,
+    // and get consecutive shader locations starting from 0.
+    // The default layout matches gltf::Vertex, position is always float and at offset 0.
+    class VertexLayout final {
+    public:
+        explicit VertexLayout();
+
+        // position, octahedral normal and half float uv0 with 16 bit indices, 20 bytes per vertex
+        static VertexLayout Compact();
+
+        VertexLayout& SetEncoding(VertexAttribute attribute, VertexEncoding encoding);
+
+        // use 16 bit indices for primitives with less than 65536 vertices
+        VertexLayout& CompactIndices(bool value = true);
+
+        VertexEncoding GetEncoding(VertexAttribute attribute) const { return encodings[static_cast<uint32_t>(attribute)]; }
+        bool HasAttribute(VertexAttribute attribute) const { return GetEncoding(attribute) != VertexEncoding::None; }
+        bool HasCompactIndices() const { return compactIndices; }
+        bool IsFull() const;
+
+        uint32_t GetStride() const { return stride; }
+        uint32_t GetOffset(VertexAttribute attribute) const { return offsets[static_cast<uint32_t>(attribute)]; }
+        VkFormat GetFormat(VertexAttribute attribute) const;
+
+        // attribute descriptions for GraphicsPipelineDesc::AddVertexBinding, together with GetStride
+        std::vector<VertexAttrib> GetVertexAttribs() const;
+
+        // pack a full precision vertex into stride bytes at dst
+        void Encode(const Vertex& vertex, uint8_t* dst) const;
+
+    private:
+        void Update();
+
+    private:
+        std::array<VertexEncoding, static_cast<uint32_t>(VertexAttribute::Count)> encodings;
+        std::array<uint32_t, static_cast<uint32_t>(VertexAttribute::Count)> offsets;
+        uint32_t stride = 0;
+        bool compactIndices = false;
+    };
+
     struct Primitive {
         VkPrimitiveTopology topology;
         BoundingBox         boundingBox;
@@ -85,6 +144,7 @@ namespace slim::gltf {
         std::vector<SmartPtr<GPUImage>>        images;
 
         void Load(scene::Builder* builder, const std::string& path, bool verbose = false);
+        void Load(scene::Builder* builder, const std::string& path, const VertexLayout& layout, bool verbose = false);
 
         scene::Node* GetScene(int index) const;
         scene::Node* GetScene(const std::string& name) const;
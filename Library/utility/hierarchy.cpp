@@ -0,0 +1,155 @@
+#include <algorithm>
+#include "utility/hierarchy.h"
+#include "utility/scenegraph.h"
+
+using namespace slim;
+using namespace slim::scene;
+
+TransformHierarchy::~TransformHierarchy() {
+    Clear();
+}
+
+void TransformHierarchy::Add(Node* node) {
+    node->hierarchy = this;
+    members.push_back(node);
+    valid = false;
+}
+
+void TransformHierarchy::Remove(Node* node) {
+    auto it = std::find(members.begin(), members.end(), node);
+    if (it != members.end()) {
+        members.erase(it);
+    }
+    if (node->hierarchyIndex != INVALID_INDEX) {
+        nodes[node->hierarchyIndex] = nullptr;
+    }
+    node->hierarchy = nullptr;
+    node->hierarchyIndex = INVALID_INDEX;
+    valid = false;
+}
+
+void TransformHierarchy::Clear() {
+    for (Node* node : nodes) {
+        if (!node) continue;
+        node->hierarchy = nullptr;
+        node->hierarchyIndex = INVALID_INDEX;
+    }
+    for (Node* node : members) {
+        node->hierarchy = nullptr;
+        node->hierarchyIndex = INVALID_INDEX;
+    }
+    members.clear();
+    nodes.clear();
+    parents.clear();
+    ends.clear();
+    locals.clear();
+    worlds.clear();
+    dirty.clear();
+    valid = false;
+    anyDirty = false;
+}
+
+void TransformHierarchy::MarkDirty(Node* node) {
+    if (!valid || node->hierarchyIndex == INVALID_INDEX) {
+        return;
+    }
+    locals[node->hierarchyIndex] = node->transform.localXform;
+    dirty[node->hierarchyIndex] = 1;
+    anyDirty = true;
+}
+
+void TransformHierarchy::Update() {
+    Linearize();
+    if (!anyDirty) {
+        return;
+    }
+
+    // a dirty node updates its whole subtree, which is the contiguous range up to its end,
+    // parents of a range are either before it and up to date, or inside it and updated first
+    uint32_t count = static_cast<uint32_t>(nodes.size());
+    for (uint32_t i = 0; i < count; ) {
+        if (!dirty[i]) {
+            i++;
+            continue;
+        }
+        uint32_t end = ends[i];
+        for (uint32_t j = i; j < end; j++) {
+            uint32_t parent = parents[j];
+            worlds[j] = parent == INVALID_INDEX ? locals[j] : worlds[parent] * locals[j];
+            dirty[j] = 0;
+        }
+        for (uint32_t j = i; j < end; j++) {
+            Transform& transform = nodes[j]->transform;
+            transform.localToWorld = worlds[j];
+            transform.inverseDirty = true;
+        }
+        i = end;
+    }
+    anyDirty = false;
+}
+
+void TransformHierarchy::Rebuild() {
+    // nodes moved out of the hierarchy since the last rebuild update themselves again
+    for (Node* node : nodes) {
+        if (!node) continue;
+        node->hierarchy = nullptr;
+        node->hierarchyIndex = INVALID_INDEX;
+    }
+    for (Node* member : members) {
+        member->hierarchy = this;
+    }
+    nodes.clear();
+    parents.clear();
+
+    // roots are members without a member among their ancestors, descendants outside of the members are adopted
+    auto isRoot = [this](Node* node) {
+        for (Node* ancestor = node->parent; ancestor; ancestor = ancestor->parent) {
+            if (ancestor->hierarchy == this) return false;
+        }
+        return true;
+    };
+
+    std::vector<std::pair<Node*, uint32_t>> stack;
+    for (Node* member : members) {
+        if (!isRoot(member)) {
+            continue;
+        }
+        stack.push_back(std::make_pair(member, INVALID_INDEX));
+        while (!stack.empty()) {
+            auto [node, parent] = stack.back();
+            stack.pop_back();
+
+            uint32_t index = static_cast<uint32_t>(nodes.size());
+            node->hierarchy = this;
+            node->hierarchyIndex = index;
+            nodes.push_back(node);
+            parents.push_back(parent);
+
+            // pushed in reverse, so that children keep their order
+            for (Node* child = node->lastChild; child; child = child->prevSibling) {
+                stack.push_back(std::make_pair(child, index));
+            }
+        }
+    }
+
+    // subtrees end where the last of their descendants ends
+    uint32_t count = static_cast<uint32_t>(nodes.size());
+    ends.resize(count);
+    for (uint32_t i = 0; i < count; i++) {
+        ends[i] = i + 1;
+    }
+    for (uint32_t i = count; i-- > 0; ) {
+        if (parents[i] != INVALID_INDEX) {
+            ends[parents[i]] = std::max(ends[parents[i]], ends[i]);
+        }
+    }
+
+    locals.resize(count);
+    worlds.resize(count);
+    for (uint32_t i = 0; i < count; i++) {
+        locals[i] = nodes[i]->transform.localXform;
+    }
+    dirty.assign(count, 1);
+    anyDirty = count > 0;
+    valid = true;
+}
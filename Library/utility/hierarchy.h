@@ -0,0 +1,69 @@
+#ifndef SLIM_UTILITY_HIERARCHY_H
+#define SLIM_UTILITY_HIERARCHY_H
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "utility/interface.h"
+
+namespace slim::scene {
+
+    class Node;
+
+    // TransformHierarchy keeps the transforms of a scene in flat arrays, with nodes in depth-first order,
+    // so that every subtree is a contiguous range and parents always come before their children.
+    // Changing a local transform only marks its node, Update() then recomputes the dirty subtrees,
+    // and a static scene costs nothing per frame. The order is rebuilt when the hierarchy changes.
+    class TransformHierarchy : public NotCopyable, public NotMovable, public ReferenceCountable {
+    public:
+        constexpr static uint32_t INVALID_INDEX = ~0u;
+
+        explicit TransformHierarchy() = default;
+        virtual ~TransformHierarchy();
+
+        // nodes are added by scene::Builder, their children are picked up with them
+        void Add(Node* node);
+        void Remove(Node* node);
+
+        // forget all nodes, they fall back to updating their own subtree
+        void Clear();
+
+        // the hierarchy changed, the order is rebuilt by the next Update()
+        void Invalidate() { valid = false; }
+
+        // the local transform of a node changed
+        void MarkDirty(Node* node);
+
+        // recompute world transforms of dirty subtrees and write them back to their nodes
+        void Update();
+
+        // rebuild the order if the hierarchy changed, without updating transforms
+        void Linearize() { if (!valid) Rebuild(); }
+
+        // depth-first order of all nodes, valid after Update() or Linearize()
+        const std::vector<Node*>&     GetNodes()   const { return nodes;   }
+        const std::vector<uint32_t>&  GetParents() const { return parents; }
+        const std::vector<uint32_t>&  GetEnds()    const { return ends;    }
+        const std::vector<glm::mat4>& GetWorlds()  const { return worlds;  }
+
+    private:
+        void Rebuild();
+
+    private:
+        std::vector<Node*>     members = {};
+
+        // one entry per node in depth-first order, ends[i] is one past the last node of the subtree at i
+        std::vector<Node*>     nodes   = {};
+        std::vector<uint32_t>  parents = {};
+        std::vector<uint32_t>  ends    = {};
+        std::vector<glm::mat4> locals  = {};
+        std::vector<glm::mat4> worlds  = {};
+        std::vector<uint8_t>   dirty   = {};
+
+        bool valid = false;
+        bool anyDirty = false;
+    };
+
+} // end of namespace slim::scene
+
+#endif // SLIM_UTILITY_HIERARCHY_H
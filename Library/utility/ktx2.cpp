@@ -0,0 +1,324 @@
+#include <string>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include "utility/ktx2.h"
+
+using namespace slim;
+
+namespace {
+
+    const uint8_t IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+    constexpr size_t HEADER_SIZE = 80;
+    constexpr size_t LEVEL_INDEX_SIZE = 24;
+
+    struct FormatBlock {
+        uint32_t width;
+        uint32_t height;
+        uint32_t bytes;
+    };
+
+    // texel block of the formats which can be uploaded as they are, { 0, 0, 0 } for others
+    FormatBlock GetFormatBlock(VkFormat format) {
+        switch (format) {
+            case VK_FORMAT_R8_UNORM:
+            case VK_FORMAT_R8_SRGB:
+                return { 1, 1, 1 };
+            case VK_FORMAT_R8G8_UNORM:
+            case VK_FORMAT_R8G8_SRGB:
+            case VK_FORMAT_R16_UNORM:
+            case VK_FORMAT_R16_SFLOAT:
+                return { 1, 1, 2 };
+            case VK_FORMAT_R8G8B8A8_UNORM:
+            case VK_FORMAT_R8G8B8A8_SRGB:
+            case VK_FORMAT_B8G8R8A8_UNORM:
+            case VK_FORMAT_B8G8R8A8_SRGB:
+            case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+            case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+            case VK_FORMAT_E5B9G9R9_UFLOAT_PACK32:
+            case VK_FORMAT_R16G16_UNORM:
+            case VK_FORMAT_R16G16_SFLOAT:
+            case VK_FORMAT_R32_SFLOAT:
+                return { 1, 1, 4 };
+            case VK_FORMAT_R16G16B16A16_UNORM:
+            case VK_FORMAT_R16G16B16A16_SFLOAT:
+            case VK_FORMAT_R32G32_SFLOAT:
+                return { 1, 1, 8 };
+            case VK_FORMAT_R32G32B32A32_SFLOAT:
+                return { 1, 1, 16 };
+
+            case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+            case VK_FORMAT_BC4_UNORM_BLOCK:
+            case VK_FORMAT_BC4_SNORM_BLOCK:
+            case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+            case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+            case VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK:
+            case VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK:
+            case VK_FORMAT_EAC_R11_UNORM_BLOCK:
+            case VK_FORMAT_EAC_R11_SNORM_BLOCK:
+                return { 4, 4, 8 };
+            case VK_FORMAT_BC2_UNORM_BLOCK:
+            case VK_FORMAT_BC2_SRGB_BLOCK:
+            case VK_FORMAT_BC3_UNORM_BLOCK:
+            case VK_FORMAT_BC3_SRGB_BLOCK:
+            case VK_FORMAT_BC5_UNORM_BLOCK:
+            case VK_FORMAT_BC5_SNORM_BLOCK:
+            case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+            case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+            case VK_FORMAT_BC7_UNORM_BLOCK:
+            case VK_FORMAT_BC7_SRGB_BLOCK:
+            case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+            case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+            case VK_FORMAT_EAC_R11G11_UNORM_BLOCK:
+            case VK_FORMAT_EAC_R11G11_SNORM_BLOCK:
+                return { 4, 4, 16 };
+
+            case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:   case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:   return { 4, 4, 16 };
+            case VK_FORMAT_ASTC_5x4_UNORM_BLOCK:   case VK_FORMAT_ASTC_5x4_SRGB_BLOCK:   return { 5, 4, 16 };
+            case VK_FORMAT_ASTC_5x5_UNORM_BLOCK:   case VK_FORMAT_ASTC_5x5_SRGB_BLOCK:   return { 5, 5, 16 };
+            case VK_FORMAT_ASTC_6x5_UNORM_BLOCK:   case VK_FORMAT_ASTC_6x5_SRGB_BLOCK:   return { 6, 5, 16 };
+            case VK_FORMAT_ASTC_6x6_UNORM_BLOCK:   case VK_FORMAT_ASTC_6x6_SRGB_BLOCK:   return { 6, 6, 16 };
+            case VK_FORMAT_ASTC_8x5_UNORM_BLOCK:   case VK_FORMAT_ASTC_8x5_SRGB_BLOCK:   return { 8, 5, 16 };
+            case VK_FORMAT_ASTC_8x6_UNORM_BLOCK:   case VK_FORMAT_ASTC_8x6_SRGB_BLOCK:   return { 8, 6, 16 };
+            case VK_FORMAT_ASTC_8x8_UNORM_BLOCK:   case VK_FORMAT_ASTC_8x8_SRGB_BLOCK:   return { 8, 8, 16 };
+            case VK_FORMAT_ASTC_10x5_UNORM_BLOCK:  case VK_FORMAT_ASTC_10x5_SRGB_BLOCK:  return { 10, 5, 16 };
+            case VK_FORMAT_ASTC_10x6_UNORM_BLOCK:  case VK_FORMAT_ASTC_10x6_SRGB_BLOCK:  return { 10, 6, 16 };
+            case VK_FORMAT_ASTC_10x8_UNORM_BLOCK:  case VK_FORMAT_ASTC_10x8_SRGB_BLOCK:  return { 10, 8, 16 };
+            case VK_FORMAT_ASTC_10x10_UNORM_BLOCK: case VK_FORMAT_ASTC_10x10_SRGB_BLOCK: return { 10, 10, 16 };
+            case VK_FORMAT_ASTC_12x10_UNORM_BLOCK: case VK_FORMAT_ASTC_12x10_SRGB_BLOCK: return { 12, 10, 16 };
+            case VK_FORMAT_ASTC_12x12_UNORM_BLOCK: case VK_FORMAT_ASTC_12x12_SRGB_BLOCK: return { 12, 12, 16 };
+
+            default:
+                return { 0, 0, 0 };
+        }
+    }
+
+    uint32_t ReadU32(const uint8_t* data) {
+        uint32_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    uint64_t ReadU64(const uint8_t* data) {
+        uint64_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    // 4x4 color block shared by BC1, BC2 and BC3, the latter two always use four colors
+    void DecodeColorBlock(const uint8_t* block, bool fourColors, uint8_t texels[16][4]) {
+        uint32_t c0 = block[0] | (block[1] << 8);
+        uint32_t c1 = block[2] | (block[3] << 8);
+        uint32_t selectors = ReadU32(block + 4);
+
+        uint8_t colors[4][4];
+        auto expand = [](uint32_t c, uint8_t* color) {
+            uint32_t r = (c >> 11) & 0x1F;
+            uint32_t g = (c >> 5) & 0x3F;
+            uint32_t b = c & 0x1F;
+            color[0] = static_cast<uint8_t>((r << 3) | (r >> 2));
+            color[1] = static_cast<uint8_t>((g << 2) | (g >> 4));
+            color[2] = static_cast<uint8_t>((b << 3) | (b >> 2));
+            color[3] = 255;
+        };
+        expand(c0, colors[0]);
+        expand(c1, colors[1]);
+        for (uint32_t k = 0; k < 3; k++) {
+            if (fourColors || c0 > c1) {
+                colors[2][k] = static_cast<uint8_t>((2 * colors[0][k] + colors[1][k] + 1) / 3);
+                colors[3][k] = static_cast<uint8_t>((colors[0][k] + 2 * colors[1][k] + 1) / 3);
+            } else {
+                colors[2][k] = static_cast<uint8_t>((colors[0][k] + colors[1][k] + 1) / 2);
+                colors[3][k] = 0;
+            }
+        }
+        colors[2][3] = 255;
+        colors[3][3] = (fourColors || c0 > c1) ? 255 : 0;
+
+        for (uint32_t i = 0; i < 16; i++) {
+            std::memcpy(texels[i], colors[(selectors >> (2 * i)) & 0x3], 4);
+        }
+    }
+
+    // 4x4 block of 8 bit values shared by the alpha of BC3, and by BC4 and BC5
+    void DecodeValueBlock(const uint8_t* block, uint8_t values[16]) {
+        uint32_t v0 = block[0];
+        uint32_t v1 = block[1];
+        uint8_t palette[8] = { static_cast<uint8_t>(v0), static_cast<uint8_t>(v1) };
+        if (v0 > v1) {
+            for (uint32_t k = 1; k < 7; k++) {
+                palette[k + 1] = static_cast<uint8_t>(((7 - k) * v0 + k * v1 + 3) / 7);
+            }
+        } else {
+            for (uint32_t k = 1; k < 5; k++) {
+                palette[k + 1] = static_cast<uint8_t>(((5 - k) * v0 + k * v1 + 2) / 5);
+            }
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+
+        uint64_t selectors = 0;
+        for (uint32_t b = 0; b < 6; b++) {
+            selectors |= static_cast<uint64_t>(block[2 + b]) << (8 * b);
+        }
+        for (uint32_t i = 0; i < 16; i++) {
+            values[i] = palette[(selectors >> (3 * i)) & 0x7];
+        }
+    }
+
+} // end of anonymous namespace
+
+bool KTX2::IsKTX2(const uint8_t* data, size_t size) {
+    return size >= sizeof(IDENTIFIER) && std::memcmp(data, IDENTIFIER, sizeof(IDENTIFIER)) == 0;
+}
+
+KTX2Image KTX2::Parse(const uint8_t* data, size_t size) {
+    if (size < HEADER_SIZE || !IsKTX2(data, size)) {
+        throw std::runtime_error("[KTX2] not a KTX2 container");
+    }
+
+    KTX2Image image = {};
+    image.format = static_cast<VkFormat>(ReadU32(data + 12));
+    image.width = ReadU32(data + 20);
+    image.height = std::max(ReadU32(data + 24), 1u);
+    image.layers = std::max(ReadU32(data + 32), 1u);
+    image.faces = ReadU32(data + 36);
+    uint32_t depth = ReadU32(data + 28);
+    uint32_t levelCount = std::max(ReadU32(data + 40), 1u);
+    uint32_t supercompression = ReadU32(data + 44);
+
+    if (supercompression != 0) {
+        throw std::runtime_error("[KTX2] supercompressed containers are not supported");
+    }
+    if (depth > 1 || image.width == 0 || (image.faces != 1 && image.faces != 6)) {
+        throw std::runtime_error("[KTX2] only 2D, 2D array and cube images are supported");
+    }
+    if (GetLevelSize(image.format, 1, 1) == 0) {
+        throw std::runtime_error("[KTX2] unsupported format: " + std::to_string(image.format));
+    }
+    if (HEADER_SIZE + levelCount * LEVEL_INDEX_SIZE > size) {
+        throw std::runtime_error("[KTX2] truncated level index");
+    }
+
+    // levels are indexed from the full resolution one, their data is usually stored smallest first
+    for (uint32_t level = 0; level < levelCount; level++) {
+        const uint8_t* entry = data + HEADER_SIZE + level * LEVEL_INDEX_SIZE;
+        uint64_t offset = ReadU64(entry + 0);
+        uint64_t length = ReadU64(entry + 8);
+
+        KTX2Level mip = {};
+        mip.width = std::max(image.width >> level, 1u);
+        mip.height = std::max(image.height >> level, 1u);
+        mip.size = GetLevelSize(image.format, mip.width, mip.height) * image.layers * image.faces;
+        if (length != mip.size || offset > size || size - offset < length) {
+            throw std::runtime_error("[KTX2] invalid data of level " + std::to_string(level));
+        }
+        mip.data = data + offset;
+        image.levels.push_back(mip);
+    }
+    return image;
+}
+
+size_t KTX2::GetLevelSize(VkFormat format, uint32_t width, uint32_t height) {
+    FormatBlock block = GetFormatBlock(format);
+    if (block.bytes == 0) {
+        return 0;
+    }
+    size_t blocksX = (width + block.width - 1) / block.width;
+    size_t blocksY = (height + block.height - 1) / block.height;
+    return blocksX * blocksY * block.bytes;
+}
+
+VkFormat KTX2::GetDecodedFormat(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC2_UNORM_BLOCK:
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+            return VK_FORMAT_R8G8B8A8_UNORM;
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        case VK_FORMAT_BC2_SRGB_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+            return VK_FORMAT_R8G8B8A8_SRGB;
+        default:
+            return VK_FORMAT_UNDEFINED;
+    }
+}
+
+void KTX2::Decode(VkFormat format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* rgba) {
+    FormatBlock block = GetFormatBlock(format);
+    if (GetDecodedFormat(format) == VK_FORMAT_UNDEFINED) {
+        throw std::runtime_error("[KTX2] no decoder for format: " + std::to_string(format));
+    }
+
+    uint32_t blocksX = (width + 3) / 4;
+    uint32_t blocksY = (height + 3) / 4;
+    for (uint32_t by = 0; by < blocksY; by++) {
+        for (uint32_t bx = 0; bx < blocksX; bx++) {
+            const uint8_t* src = blocks + (by * blocksX + bx) * block.bytes;
+
+            // unused channels read as 0, alpha as 1, like sampling the compressed format
+            uint8_t texels[16][4];
+            uint8_t values[16];
+            switch (format) {
+                case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+                case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+                    DecodeColorBlock(src, false, texels);
+                    for (auto& texel : texels) texel[3] = 255;
+                    break;
+                case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+                case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+                    DecodeColorBlock(src, false, texels);
+                    break;
+                case VK_FORMAT_BC2_UNORM_BLOCK:
+                case VK_FORMAT_BC2_SRGB_BLOCK:
+                    DecodeColorBlock(src + 8, true, texels);
+                    for (uint32_t i = 0; i < 16; i++) {
+                        uint32_t alpha = (src[i / 2] >> (4 * (i % 2))) & 0xF;
+                        texels[i][3] = static_cast<uint8_t>(alpha * 17);
+                    }
+                    break;
+                case VK_FORMAT_BC3_UNORM_BLOCK:
+                case VK_FORMAT_BC3_SRGB_BLOCK:
+                    DecodeColorBlock(src + 8, true, texels);
+                    DecodeValueBlock(src, values);
+                    for (uint32_t i = 0; i < 16; i++) texels[i][3] = values[i];
+                    break;
+                case VK_FORMAT_BC4_UNORM_BLOCK:
+                    DecodeValueBlock(src, values);
+                    for (uint32_t i = 0; i < 16; i++) {
+                        texels[i][0] = values[i];
+                        texels[i][1] = 0;
+                        texels[i][2] = 0;
+                        texels[i][3] = 255;
+                    }
+                    break;
+                default: // BC5
+                    DecodeValueBlock(src, values);
+                    for (uint32_t i = 0; i < 16; i++) texels[i][0] = values[i];
+                    DecodeValueBlock(src + 8, values);
+                    for (uint32_t i = 0; i < 16; i++) {
+                        texels[i][1] = values[i];
+                        texels[i][2] = 0;
+                        texels[i][3] = 255;
+                    }
+                    break;
+            }
+
+            // blocks at the right and bottom edges may be partially outside of the level
+            for (uint32_t y = 0; y < 4 && by * 4 + y < height; y++) {
+                for (uint32_t x = 0; x < 4 && bx * 4 + x < width; x++) {
+                    size_t texel = (static_cast<size_t>(by * 4 + y) * width + bx * 4 + x) * 4;
+                    std::memcpy(rgba + texel, texels[y * 4 + x], 4);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef SLIM_UTILITY_KTX2_H
+#define SLIM_UTILITY_KTX2_H
+
+#include <vector>
+#include <cstdint>
+#include "core/vulkan.h"
+
+namespace slim {
+
+    // one mip level of a KTX2 image, all layers and faces of the level are stored one after another
+    struct KTX2Level {
+        const uint8_t* data   = nullptr;
+        size_t         size   = 0;
+        uint32_t       width  = 0;
+        uint32_t       height = 0;
+    };
+
+    // a 2D (array or cube) image in a KTX2 container, levels point into the parsed data
+    struct KTX2Image {
+        VkFormat               format = VK_FORMAT_UNDEFINED;
+        uint32_t               width  = 0;
+        uint32_t               height = 0;
+        uint32_t               layers = 1;
+        uint32_t               faces  = 1;
+        std::vector<KTX2Level> levels = {};
+    };
+
+    // KTX2 parses KTX 2.0 containers in place, with their pre-baked mip chains.
+    // Supercompressed (Basis, Zstd, zlib) containers are not supported.
+    // BC1 to BC5 blocks can be decoded on the CPU for devices that cannot sample them.
+    class KTX2 {
+    public:
+        static bool IsKTX2(const uint8_t* data, size_t size);
+
+        static KTX2Image Parse(const uint8_t* data, size_t size);
+
+        // bytes of one layer of a level, 0 for formats that are not supported
+        static size_t GetLevelSize(VkFormat format, uint32_t width, uint32_t height);
+
+        // RGBA8 format a block-compressed format is decoded to, VK_FORMAT_UNDEFINED when there is no CPU decoder
+        static VkFormat GetDecodedFormat(VkFormat format);
+
+        // decode one layer of a level into width * height RGBA8 texels
+        static void Decode(VkFormat format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* rgba);
+    };
+
+} // end of namespace slim
+
+#endif // SLIM_UTILITY_KTX2_H
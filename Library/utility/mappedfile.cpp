@@ -0,0 +1,93 @@
+#include <stdexcept>
+#include "utility/mappedfile.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+using namespace slim;
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path) {
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        file = nullptr;
+        throw std::runtime_error("[MappedFile] failed to open file: " + path);
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        throw std::runtime_error("[MappedFile] failed to query file size: " + path);
+    }
+    size = static_cast<size_t>(fileSize.QuadPart);
+
+    // empty files cannot be mapped, they are valid with a null data pointer
+    if (size == 0) return;
+
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        CloseHandle(file);
+        throw std::runtime_error("[MappedFile] failed to create file mapping: " + path);
+    }
+
+    data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (data == nullptr) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        throw std::runtime_error("[MappedFile] failed to map file: " + path);
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (data) UnmapViewOfFile(data);
+    if (mapping) CloseHandle(mapping);
+    if (file) CloseHandle(file);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("[MappedFile] failed to open file: " + path);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw std::runtime_error("[MappedFile] failed to query file size: " + path);
+    }
+    size = static_cast<size_t>(st.st_size);
+
+    // empty files cannot be mapped, they are valid with a null data pointer
+    if (size == 0) {
+        close(fd);
+        return;
+    }
+
+    void* ptr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // the mapping keeps its own reference to the file
+    if (ptr == MAP_FAILED) {
+        throw std::runtime_error("[MappedFile] failed to map file: " + path);
+    }
+    data = static_cast<const uint8_t*>(ptr);
+
+    // geometry is consumed front to back
+    madvise(ptr, size, MADV_SEQUENTIAL);
+}
+
+MappedFile::~MappedFile() {
+    if (data) munmap(const_cast<uint8_t*>(data), size);
+}
+
+#endif
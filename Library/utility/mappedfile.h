@@ -0,0 +1,32 @@
+#ifndef SLIM_UTILITY_MAPPEDFILE_H
+#define SLIM_UTILITY_MAPPEDFILE_H
+
+#include <string>
+#include <cstdint>
+#include "utility/interface.h"
+
+namespace slim {
+
+    // MappedFile maps a whole file read-only into the address space.
+    // Pages are brought in by the OS on first touch, so large assets can be
+    // parsed in place without reading them into an intermediate buffer first.
+    class MappedFile final : public NotCopyable, public NotMovable, public ReferenceCountable {
+    public:
+        explicit MappedFile(const std::string& path);
+        virtual ~MappedFile();
+
+        const uint8_t* GetData() const { return data; }
+        size_t GetSize() const { return size; }
+
+    private:
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+        #ifdef _WIN32
+        void* file = nullptr;
+        void* mapping = nullptr;
+        #endif
+    };
+
+} // end of namespace slim
+
+#endif // SLIM_UTILITY_MAPPEDFILE_H
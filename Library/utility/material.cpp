@@ -111,6 +111,16 @@ void Material::Bind(uint32_t index,
     commandBuffer->BindDescriptor(descriptors[index], bindPoint);
 }
 
+void Material::Prepare(uint32_t index, RenderFrame *renderFrame, RenderPass *renderPass) const {
+    technique->Prepare(index, renderFrame, renderPass);
+    descriptors[index]->Update();
+}
+
+void Material::Bind(uint32_t index, CommandBuffer *commandBuffer) const {
+    commandBuffer->BindPipeline(technique->GetPipeline(index));
+    commandBuffer->BindDescriptor(descriptors[index], technique->Type(index));
+}
+
 bool Material::HasID() const {
     return materialId >= 0;
 }
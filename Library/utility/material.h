@@ -46,6 +46,14 @@ namespace slim::scene {
                   RenderFrame *renderFrame,
                   RenderPass *renderPass) const;
 
+        // split binding for multithreaded recording: Prepare() resolves the pipeline and writes
+        // the descriptor on the main thread, Bind() only records and is safe to call concurrently
+        void Prepare(uint32_t queueIndex,
+                     RenderFrame *renderFrame,
+                     RenderPass *renderPass) const;
+
+        void Bind(uint32_t queueIndex, CommandBuffer *commandBuffer) const;
+
         template <typename T>
         T& GetData() { return *reinterpret_cast<T*>(data.data()); }
 
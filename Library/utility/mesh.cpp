@@ -25,11 +25,10 @@ void Mesh::Bind(CommandBuffer* commandBuffer) const {
     }
     #endif
 
-    Device* device = commandBuffer->GetDevice();
-
-    // NOTE: ditch additional library wrappings, use raw vulkan directly
-    DeviceDispatch(vkCmdBindVertexBuffers(*commandBuffer, 0, vertexBuffers.size(), vertexBuffers.data(), vertexOffsets.data()));
+    // binding through command buffer, so that redundant binds are skipped
+    commandBuffer->BindVertexBuffers(0, vertexBuffers.size(), vertexBuffers.data(), bindOffsets.data());
     if (indexCount > 0) {
-        DeviceDispatch(vkCmdBindIndexBuffer(*commandBuffer, *indexBuffer, indexOffset, indexType));
+        uint64_t indexSize = indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+        commandBuffer->BindIndexBuffer(indexBuffer, indexOffset - firstIndex * indexSize, indexType);
     }
 }
@@ -5,6 +5,7 @@
 #include "core/buffer.h"
 #include "core/commands.h"
 #include "core/acceleration.h"
+#include "utility/arena.h"
 #include "utility/interface.h"
 #include "utility/transform.h"
 #include "utility/boundingbox.h"
@@ -13,6 +14,9 @@ namespace slim::scene {
 
     class Node;
     class Builder;
+    class MeshOptimizer;
+    class MeshSimplifier;
+    class MeshletBuilder;
 
     using DrawCommand = VkDrawIndirectCommand;
     using DrawIndexed = VkDrawIndexedIndirectCommand;
@@ -22,19 +26,43 @@ namespace slim::scene {
     using VertexOffset = std::vector<uint64_t>;
     using IndexData = std::vector<uint8_t>;
 
+    // level of detail, a range of the index data of a mesh, all levels share the vertices of the mesh
+    struct MeshLod {
+        uint32_t firstIndex;    // relative to the first index of the mesh
+        uint32_t indexCount;
+        float    error;         // simplification error relative to the radius of the mesh bounds
+    };
+
+    // cluster of triangles, a range of the index data of a mesh with bounds for culling
+    struct Meshlet {
+        glm::vec4 sphere;       // local space bounding sphere, center and radius
+        glm::vec4 cone;         // normal cone, axis and cutoff, culled when dot(dir, axis) >= cutoff * |dir| + radius
+        uint32_t  firstIndex;   // relative to the first index of the mesh
+        uint32_t  indexCount;
+        uint32_t  vertexCount;  // unique vertices referenced by the meshlet
+    };
+
     // mesh
     // lowest level building blocks
     class Mesh : public NotCopyable, public NotMovable, public ReferenceCountable {
         friend class Node;
         friend class Builder;
+        friend class MeshOptimizer;
+        friend class MeshSimplifier;
+        friend class MeshletBuilder;
     public:
 
         template <typename VertexType>
         VertexType* AllocateVertexBuffer(size_t vertexCount, size_t binding) {
+            return reinterpret_cast<VertexType*>(AllocateVertexBuffer(vertexCount, sizeof(VertexType), binding));
+        }
+
+        // vertex layout only known at runtime, e.g. a compact gltf::VertexLayout
+        uint8_t* AllocateVertexBuffer(size_t vertexCount, uint32_t stride, size_t binding) {
             if (vertexData.size() <= binding) {
                 vertexData.resize(binding + 1);
             }
-            vertexData[binding].resize(vertexCount * sizeof(VertexType));
+            vertexData[binding].resize(vertexCount * stride);
             #ifndef NDEBUG
             if (this->vertexCount != 0 && this->vertexCount != vertexCount) {
                 throw std::runtime_error("inconsistent vertex count for vertex buffers!");
@@ -43,15 +71,15 @@ namespace slim::scene {
             #endif
             // we assume position is in the first binding with offset 0
             if (binding == 0) {
-                vertexStride = sizeof(VertexType);
+                vertexStride = stride;
             }
             this->vertexCount = vertexCount;
-            return reinterpret_cast<VertexType*>(vertexData[binding].data());
+            return vertexData[binding].data();
         }
 
         template <typename VertexType>
         VertexType* GetVertexData(uint32_t binding) {
-            return vertexData[binding].data();
+            return reinterpret_cast<VertexType*>(vertexData[binding].data());
         }
 
         template <typename VertexType>
@@ -72,12 +100,14 @@ namespace slim::scene {
             #endif
             indexType = sizeof(IndexType) == sizeof(uint32_t) ? VK_INDEX_TYPE_UINT32 : VK_INDEX_TYPE_UINT16;
             this->indexCount = indexCount;
+            lods.clear();
+            meshlets.clear();
             return reinterpret_cast<IndexType*>(indexData.data());
         }
 
         template <typename IndexType>
         IndexType* GetIndexData() {
-            return indexData.data();
+            return reinterpret_cast<IndexType*>(indexData.data());
         }
 
         template <typename IndexType>
@@ -103,6 +133,30 @@ namespace slim::scene {
             return indexCount;
         }
 
+        // levels of detail generated by MeshSimplifier, level 0 is the full mesh
+        uint32_t GetLodCount() const {
+            return lods.empty() ? 1 : static_cast<uint32_t>(lods.size());
+        }
+
+        MeshLod GetLod(uint32_t level) const {
+            return lods.empty() ? MeshLod { 0, static_cast<uint32_t>(indexCount), 0.0f } : lods[level];
+        }
+
+        // clusters of level 0 generated by MeshletBuilder, empty when the mesh is culled as a whole
+        const std::vector<Meshlet>& GetMeshlets() const {
+            return meshlets;
+        }
+
+        // draw parameters relative to the bound buffers,
+        // meshes in a geometry arena share their buffers and are told apart by these
+        uint32_t GetFirstIndex() const {
+            return firstIndex;
+        }
+
+        int32_t GetBaseVertex() const {
+            return baseVertex;
+        }
+
         void SetBoundingBox(const BoundingBox& box) {
             aabb = box;
         }
@@ -143,17 +197,24 @@ namespace slim::scene {
         // index data
         uint64_t indexCount = 0;
         uint64_t indexOffset = 0;
+        uint32_t firstIndex = 0;
         IndexData indexData = {};
         VkIndexType indexType = VK_INDEX_TYPE_UINT32;
         SmartPtr<Buffer> indexBuffer = nullptr;
+        GeometryAllocation indexAllocation = {};
+        std::vector<MeshLod> lods = {};
+        std::vector<Meshlet> meshlets = {};
 
         // vertex data
         uint64_t vertexCount = 0;
         uint32_t vertexStride = 0;
         VertexData vertexData = {};
         VertexOffset vertexOffsets = {};
+        int32_t baseVertex = 0;
         SmartPtr<Buffer> vertexBuffer = nullptr; // for automatic destroy
         std::vector<VkBuffer> vertexBuffers = {};
+        std::vector<VkDeviceSize> bindOffsets = {};
+        GeometryAllocation vertexAllocation = {};
 
         // ray tracing data
         SmartPtr<accel::Geometry> blas = nullptr;
@@ -0,0 +1,230 @@
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include "utility/meshlet.h"
+
+using namespace slim;
+using namespace slim::scene;
+
+namespace {
+
+    constexpr uint32_t INVALID_INDEX = ~0u;
+
+    // cones wider than this are never back facing as a whole
+    constexpr float CONE_MIN_DOT = 0.1f;
+
+    glm::vec3 ReadPosition(const uint8_t* positions, size_t stride, uint32_t vertex) {
+        glm::vec3 position;
+        std::memcpy(&position, positions + vertex * stride, sizeof(glm::vec3));
+        return position;
+    }
+
+} // end of anonymous namespace
+
+uint32_t MeshletBuilder::Build(Mesh* mesh, uint32_t maxVertices, uint32_t maxTriangles) {
+    mesh->meshlets.clear();
+    if (mesh->indexCount == 0 || mesh->indexCount % 3 != 0 || mesh->vertexCount == 0 ||
+        mesh->vertexData.empty() || mesh->vertexData[0].size() / mesh->vertexCount < sizeof(glm::vec3)) {
+        return 0;
+    }
+
+    // only level 0 is clustered, levels of detail after it are left where they are
+    std::vector<uint32_t> indices(mesh->indexCount);
+    if (mesh->indexType == VK_INDEX_TYPE_UINT16) {
+        const uint16_t* src = reinterpret_cast<const uint16_t*>(mesh->indexData.data());
+        std::copy(src, src + mesh->indexCount, indices.begin());
+    } else {
+        std::memcpy(indices.data(), mesh->indexData.data(), indices.size() * sizeof(uint32_t));
+    }
+
+    std::vector<uint32_t> clusters = BuildClusters(indices, mesh->vertexCount, maxVertices, maxTriangles);
+
+    const uint8_t* positions = mesh->vertexData[0].data();
+    size_t stride = mesh->vertexData[0].size() / mesh->vertexCount;
+    uint32_t firstIndex = 0;
+    for (uint32_t indexCount : clusters) {
+        Meshlet meshlet = ComputeBounds(indices.data() + firstIndex, indexCount, positions, stride);
+        meshlet.firstIndex = firstIndex;
+        mesh->meshlets.push_back(meshlet);
+        firstIndex += indexCount;
+    }
+
+    if (mesh->indexType == VK_INDEX_TYPE_UINT16) {
+        uint16_t* dst = reinterpret_cast<uint16_t*>(mesh->indexData.data());
+        for (size_t i = 0; i < indices.size(); i++) {
+            dst[i] = static_cast<uint16_t>(indices[i]);
+        }
+    } else {
+        std::memcpy(mesh->indexData.data(), indices.data(), indices.size() * sizeof(uint32_t));
+    }
+    return static_cast<uint32_t>(mesh->meshlets.size());
+}
+
+std::vector<uint32_t> MeshletBuilder::BuildClusters(std::vector<uint32_t>& indices,
+                                                    size_t vertexCount,
+                                                    uint32_t maxVertices,
+                                                    uint32_t maxTriangles) {
+    std::vector<uint32_t> clusters;
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) {
+        return clusters;
+    }
+    maxVertices = std::max(maxVertices, 3u);
+    maxTriangles = std::max(maxTriangles, 1u);
+
+    // triangles around each vertex
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (uint32_t index : indices) {
+        adjacencyOffsets[index + 1]++;
+    }
+    for (size_t v = 0; v < vertexCount; v++) {
+        adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+    }
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++) {
+        adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    // vertices and candidate triangles are marked with the cluster they were last added to
+    std::vector<uint32_t> vertexMarks(vertexCount, INVALID_INDEX);
+    std::vector<uint32_t> triangleMarks(triangleCount, INVALID_INDEX);
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> order;
+    order.reserve(triangleCount * 3);
+
+    uint32_t cluster = 0;
+    uint32_t clusterVertices = 0;
+    uint32_t clusterTriangles = 0;
+    size_t seed = 0;
+
+    auto newVertices = [&](uint32_t triangle) {
+        const uint32_t* corners = &indices[triangle * 3];
+        uint32_t count = 0;
+        for (uint32_t k = 0; k < 3; k++) {
+            bool repeated = (k > 0 && corners[k] == corners[0]) || (k > 1 && corners[k] == corners[1]);
+            count += !repeated && vertexMarks[corners[k]] != cluster;
+        }
+        return count;
+    };
+
+    for (size_t n = 0; n < triangleCount; n++) {
+        // the neighbour adding the fewest vertices, earlier candidates win ties to keep clusters round
+        uint32_t best = INVALID_INDEX;
+        uint32_t bestScore = 4;
+        size_t kept = 0;
+        for (uint32_t triangle : candidates) {
+            if (emitted[triangle]) continue;
+            candidates[kept++] = triangle;
+            uint32_t score = newVertices(triangle);
+            if (score < bestScore) {
+                best = triangle;
+                bestScore = score;
+            }
+        }
+        candidates.resize(kept);
+
+        // disconnected parts continue in the original triangle order
+        if (best == INVALID_INDEX) {
+            while (emitted[seed]) seed++;
+            best = static_cast<uint32_t>(seed);
+            bestScore = newVertices(best);
+        }
+
+        // a full cluster is closed, the next one grows from where this one stopped
+        if (clusterTriangles == maxTriangles || clusterVertices + bestScore > maxVertices) {
+            clusters.push_back(clusterTriangles * 3);
+            cluster++;
+            clusterVertices = 0;
+            clusterTriangles = 0;
+            candidates.clear();
+        }
+
+        emitted[best] = 1;
+        clusterTriangles++;
+        for (uint32_t k = 0; k < 3; k++) {
+            uint32_t vertex = indices[best * 3 + k];
+            order.push_back(vertex);
+            if (vertexMarks[vertex] == cluster) continue;
+            vertexMarks[vertex] = cluster;
+            clusterVertices++;
+            for (uint32_t a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex + 1]; a++) {
+                uint32_t triangle = adjacency[a];
+                if (!emitted[triangle] && triangleMarks[triangle] != cluster) {
+                    triangleMarks[triangle] = cluster;
+                    candidates.push_back(triangle);
+                }
+            }
+        }
+    }
+    clusters.push_back(clusterTriangles * 3);
+
+    indices = std::move(order);
+    return clusters;
+}
+
+Meshlet MeshletBuilder::ComputeBounds(const uint32_t* indices,
+                                      uint32_t indexCount,
+                                      const uint8_t* positions,
+                                      size_t stride) {
+    Meshlet meshlet = {};
+    meshlet.indexCount = indexCount;
+
+    std::vector<uint32_t> vertices(indices, indices + indexCount);
+    std::sort(vertices.begin(), vertices.end());
+    vertices.erase(std::unique(vertices.begin(), vertices.end()), vertices.end());
+    meshlet.vertexCount = static_cast<uint32_t>(vertices.size());
+    if (vertices.empty()) {
+        meshlet.cone = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        return meshlet;
+    }
+
+    // sphere around the center of the bounding box
+    glm::vec3 minimum = ReadPosition(positions, stride, vertices[0]);
+    glm::vec3 maximum = minimum;
+    for (uint32_t vertex : vertices) {
+        glm::vec3 p = ReadPosition(positions, stride, vertex);
+        minimum = glm::min(minimum, p);
+        maximum = glm::max(maximum, p);
+    }
+    glm::vec3 center = (minimum + maximum) * 0.5f;
+    float radius = 0.0f;
+    for (uint32_t vertex : vertices) {
+        radius = std::max(radius, glm::length(ReadPosition(positions, stride, vertex) - center));
+    }
+    meshlet.sphere = glm::vec4(center, radius);
+
+    // normal cone, the axis is the average face normal and the cutoff the sine of the widest deviation from it
+    auto faceNormal = [&](uint32_t i) {
+        glm::vec3 p0 = ReadPosition(positions, stride, indices[i + 0]);
+        glm::vec3 p1 = ReadPosition(positions, stride, indices[i + 1]);
+        glm::vec3 p2 = ReadPosition(positions, stride, indices[i + 2]);
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float length = glm::length(normal);
+        return length > 0.0f ? normal / length : glm::vec3(0.0f);
+    };
+    glm::vec3 axis = glm::vec3(0.0f);
+    for (uint32_t i = 0; i < indexCount; i += 3) {
+        axis += faceNormal(i);
+    }
+    float length = glm::length(axis);
+    meshlet.cone = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    if (length == 0.0f) {
+        return meshlet;
+    }
+    axis /= length;
+
+    float minDot = 1.0f;
+    for (uint32_t i = 0; i < indexCount; i += 3) {
+        glm::vec3 normal = faceNormal(i);
+        if (normal != glm::vec3(0.0f)) {
+            minDot = std::min(minDot, glm::dot(normal, axis));
+        }
+    }
+    if (minDot > CONE_MIN_DOT) {
+        meshlet.cone = glm::vec4(axis, std::sqrt(1.0f - minDot * minDot));
+    }
+    return meshlet;
+}
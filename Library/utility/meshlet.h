@@ -0,0 +1,39 @@
+#ifndef SLIM_UTILITY_MESHLET_H
+#define SLIM_UTILITY_MESHLET_H
+
+#include <vector>
+#include <cstdint>
+#include "utility/mesh.h"
+
+namespace slim::scene {
+
+    // MeshletBuilder splits indexed triangle meshes into small clusters, which are culled one by one.
+    // Triangles are gathered greedily from the neighbourhood of a cluster, preferring those that add
+    // the fewest vertices, and the index data of level 0 is reordered so that every cluster is one range.
+    // Positions are expected as float3 at offset 0 of the first vertex stream.
+    class MeshletBuilder {
+    public:
+        constexpr static uint32_t MAX_VERTICES = 64;
+        constexpr static uint32_t MAX_TRIANGLES = 124;
+
+        // returns the number of meshlets, meshes without indices get none
+        static uint32_t Build(Mesh* mesh, uint32_t maxVertices = MAX_VERTICES, uint32_t maxTriangles = MAX_TRIANGLES);
+
+        // building blocks, on 32 bit triangle lists
+
+        // reorder triangles into clusters, returns the index count of each cluster in order
+        static std::vector<uint32_t> BuildClusters(std::vector<uint32_t>& indices,
+                                                   size_t vertexCount,
+                                                   uint32_t maxVertices = MAX_VERTICES,
+                                                   uint32_t maxTriangles = MAX_TRIANGLES);
+
+        // bounding sphere and normal cone of a range of triangles
+        static Meshlet ComputeBounds(const uint32_t* indices,
+                                     uint32_t indexCount,
+                                     const uint8_t* positions,
+                                     size_t stride);
+    };
+
+} // end of namespace slim::scene
+
+#endif // SLIM_UTILITY_MESHLET_H
@@ -0,0 +1,411 @@
+#include <cstring>
+#include <numeric>
+#include <algorithm>
+#include <unordered_map>
+#include <glm/glm.hpp>
+#include "utility/meshopt.h"
+
+using namespace slim;
+using namespace slim::scene;
+
+namespace {
+
+    constexpr uint32_t INVALID_INDEX = ~0u;
+
+    // vertices are compared bitwise over all of their streams
+    struct VertexHasher {
+        const std::vector<const uint8_t*>* streams;
+        const std::vector<size_t>* strides;
+
+        size_t operator()(uint32_t vertex) const {
+            // FNV-1a
+            uint64_t hash = 14695981039346656037ull;
+            for (size_t s = 0; s < streams->size(); s++) {
+                const uint8_t* data = (*streams)[s] + vertex * (*strides)[s];
+                for (size_t i = 0; i < (*strides)[s]; i++) {
+                    hash = (hash ^ data[i]) * 1099511628211ull;
+                }
+            }
+            return static_cast<size_t>(hash);
+        }
+    };
+
+    struct VertexEqual {
+        const std::vector<const uint8_t*>* streams;
+        const std::vector<size_t>* strides;
+
+        bool operator()(uint32_t a, uint32_t b) const {
+            for (size_t s = 0; s < streams->size(); s++) {
+                size_t stride = (*strides)[s];
+                if (std::memcmp((*streams)[s] + a * stride, (*streams)[s] + b * stride, stride) != 0) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+
+    glm::vec3 ReadPosition(const uint8_t* positions, size_t stride, uint32_t vertex) {
+        glm::vec3 position;
+        std::memcpy(&position, positions + vertex * stride, sizeof(glm::vec3));
+        return position;
+    }
+
+} // end of anonymous namespace
+
+MeshOptimizerStats& MeshOptimizerStats::operator+=(const MeshOptimizerStats& other) {
+    uint64_t totalTriangles = triangles + other.triangles;
+    uint64_t totalBefore = verticesBefore + other.verticesBefore;
+    uint64_t totalAfter = verticesAfter + other.verticesAfter;
+    if (totalTriangles > 0) {
+        before.acmr = (before.acmr * triangles + other.before.acmr * other.triangles) / totalTriangles;
+        after.acmr = (after.acmr * triangles + other.after.acmr * other.triangles) / totalTriangles;
+    }
+    if (totalBefore > 0) {
+        before.atvr = (before.atvr * verticesBefore + other.before.atvr * other.verticesBefore) / totalBefore;
+    }
+    if (totalAfter > 0) {
+        after.atvr = (after.atvr * verticesAfter + other.after.atvr * other.verticesAfter) / totalAfter;
+    }
+    triangles = totalTriangles;
+    verticesBefore = totalBefore;
+    verticesAfter = totalAfter;
+    return *this;
+}
+
+MeshOptimizerStats MeshOptimizer::Optimize(Mesh* mesh, float overdrawThreshold) {
+    MeshOptimizerStats stats = {};
+    if (mesh->indexCount == 0 || mesh->indexCount % 3 != 0 || mesh->vertexCount == 0) {
+        return stats;
+    }
+
+    // levels of detail and meshlets would not survive the reordering, they are generated afterwards
+    size_t indexSize = mesh->indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+    mesh->indexData.resize(mesh->indexCount * indexSize);
+    mesh->lods.clear();
+    mesh->meshlets.clear();
+
+    // indices are processed as 32 bit and written back in their original type
+    std::vector<uint32_t> indices(mesh->indexCount);
+    if (mesh->indexType == VK_INDEX_TYPE_UINT16) {
+        const uint16_t* src = reinterpret_cast<const uint16_t*>(mesh->indexData.data());
+        std::copy(src, src + mesh->indexCount, indices.begin());
+    } else {
+        std::memcpy(indices.data(), mesh->indexData.data(), indices.size() * sizeof(uint32_t));
+    }
+
+    size_t vertexCount = mesh->vertexCount;
+    std::vector<size_t> strides;
+    std::vector<const uint8_t*> streams;
+    for (const auto& data : mesh->vertexData) {
+        strides.push_back(data.size() / vertexCount);
+        streams.push_back(data.data());
+    }
+
+    stats.triangles = indices.size() / 3;
+    stats.verticesBefore = vertexCount;
+    stats.before = AnalyzeVertexCache(indices, vertexCount);
+
+    // apply a vertex remap to indices and all vertex streams
+    auto remapVertices = [&](const std::vector<uint32_t>& remap, uint32_t count) {
+        for (uint32_t& index : indices) {
+            index = remap[index];
+        }
+        for (size_t s = 0; s < mesh->vertexData.size(); s++) {
+            std::vector<uint8_t> data(count * strides[s]);
+            for (size_t v = 0; v < vertexCount; v++) {
+                if (remap[v] == INVALID_INDEX) continue;
+                std::memcpy(data.data() + remap[v] * strides[s], mesh->vertexData[s].data() + v * strides[s], strides[s]);
+            }
+            mesh->vertexData[s] = std::move(data);
+            streams[s] = mesh->vertexData[s].data();
+        }
+        vertexCount = count;
+    };
+
+    // 1. weld
+    std::vector<uint32_t> remap;
+    uint32_t count = GenerateVertexRemap(remap, indices, vertexCount, streams, strides);
+    remapVertices(remap, count);
+
+    // 2. vertex cache
+    std::vector<uint32_t> clusters;
+    indices = OptimizeVertexCache(indices, vertexCount, CACHE_SIZE, &clusters);
+
+    // 3. overdraw, needs float3 positions at the start of the first stream
+    if (!streams.empty() && strides[0] >= sizeof(glm::vec3)) {
+        indices = OptimizeOverdraw(indices, clusters, streams[0], strides[0], vertexCount, overdrawThreshold);
+    }
+
+    // 4. vertex fetch
+    count = OptimizeVertexFetch(remap, indices, vertexCount);
+    remapVertices(remap, count);
+
+    // write back, the vertex count only goes down so 16 bit indices stay valid
+    mesh->vertexCount = vertexCount;
+    if (mesh->indexType == VK_INDEX_TYPE_UINT16) {
+        uint16_t* dst = reinterpret_cast<uint16_t*>(mesh->indexData.data());
+        for (size_t i = 0; i < indices.size(); i++) {
+            dst[i] = static_cast<uint16_t>(indices[i]);
+        }
+    } else {
+        std::memcpy(mesh->indexData.data(), indices.data(), indices.size() * sizeof(uint32_t));
+    }
+
+    stats.verticesAfter = vertexCount;
+    stats.after = AnalyzeVertexCache(indices, vertexCount);
+    return stats;
+}
+
+uint32_t MeshOptimizer::GenerateVertexRemap(std::vector<uint32_t>& remap,
+                                            const std::vector<uint32_t>& indices,
+                                            size_t vertexCount,
+                                            const std::vector<const uint8_t*>& streams,
+                                            const std::vector<size_t>& strides) {
+    remap.assign(vertexCount, INVALID_INDEX);
+
+    VertexHasher hasher = { &streams, &strides };
+    VertexEqual equal = { &streams, &strides };
+    std::unordered_map<uint32_t, uint32_t, VertexHasher, VertexEqual> unique(vertexCount, hasher, equal);
+
+    // new vertices are numbered in order of first use
+    uint32_t count = 0;
+    for (uint32_t index : indices) {
+        if (remap[index] != INVALID_INDEX) continue;
+        auto [it, inserted] = unique.emplace(index, count);
+        remap[index] = it->second;
+        if (inserted) count++;
+    }
+    return count;
+}
+
+// Sander et al. 2007, Fast Triangle Reordering for Vertex Locality and Reduced Overdraw
+std::vector<uint32_t> MeshOptimizer::OptimizeVertexCache(const std::vector<uint32_t>& indices,
+                                                         size_t vertexCount,
+                                                         uint32_t cacheSize,
+                                                         std::vector<uint32_t>* clusters) {
+    uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+    // triangles adjacent to each vertex
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (uint32_t index : indices) {
+        offsets[index + 1]++;
+    }
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        for (uint32_t c = 0; c < 3; c++) {
+            adjacency[fill[indices[t * 3 + c]]++] = t;
+        }
+    }
+
+    // live triangles per vertex, and the time each vertex entered the cache
+    std::vector<uint32_t> live(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) {
+        live[v] = offsets[v + 1] - offsets[v];
+    }
+    std::vector<uint32_t> stamps(vertexCount, 0);
+    uint32_t time = cacheSize + 1;
+
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    std::vector<uint32_t> deadEnd;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> output;
+    deadEnd.reserve(indices.size());
+    output.reserve(indices.size());
+    if (clusters) clusters->clear();
+
+    // recently used vertices first, then input order
+    uint32_t cursor = 0;
+    auto skipDeadEnd = [&]() -> int64_t {
+        while (!deadEnd.empty()) {
+            uint32_t v = deadEnd.back();
+            deadEnd.pop_back();
+            if (live[v] > 0) return v;
+        }
+        for (; cursor < vertexCount; cursor++) {
+            if (live[cursor] > 0) return cursor;
+        }
+        return -1;
+    };
+
+    int64_t fan = skipDeadEnd();
+    bool hardBoundary = true;
+    while (fan >= 0) {
+        if (hardBoundary && clusters) {
+            clusters->push_back(static_cast<uint32_t>(output.size() / 3));
+        }
+
+        // emit all remaining triangles around the fanning vertex
+        candidates.clear();
+        for (uint32_t a = offsets[fan]; a < offsets[fan + 1]; a++) {
+            uint32_t t = adjacency[a];
+            if (emitted[t]) continue;
+            for (uint32_t c = 0; c < 3; c++) {
+                uint32_t v = indices[t * 3 + c];
+                output.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - stamps[v] > cacheSize) {
+                    stamps[v] = time++;
+                }
+            }
+            emitted[t] = 1;
+        }
+
+        // next fan: the oldest candidate that stays in cache while its remaining triangles are emitted
+        int64_t best = -1;
+        int64_t bestPriority = -1;
+        for (uint32_t v : candidates) {
+            if (live[v] == 0) continue;
+            int64_t priority = 0;
+            if (time - stamps[v] + 2 * live[v] <= cacheSize) {
+                priority = time - stamps[v];
+            }
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                best = v;
+            }
+        }
+
+        hardBoundary = best < 0;
+        fan = hardBoundary ? skipDeadEnd() : best;
+    }
+
+    return output;
+}
+
+std::vector<uint32_t> MeshOptimizer::OptimizeOverdraw(const std::vector<uint32_t>& indices,
+                                                      const std::vector<uint32_t>& clusters,
+                                                      const uint8_t* positions,
+                                                      size_t stride,
+                                                      size_t vertexCount,
+                                                      float threshold,
+                                                      uint32_t cacheSize) {
+    uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+    if (triangleCount == 0) return indices;
+
+    // split hard clusters where they are already as cache efficient as the whole mesh,
+    // the cache is flushed at every split, as clusters are going to be reordered
+    float target = AnalyzeVertexCache(indices, vertexCount, cacheSize).acmr * threshold;
+    std::vector<uint32_t> stamps(vertexCount, 0);
+    uint32_t time = cacheSize + 1;
+
+    std::vector<uint32_t> splits;
+    std::vector<uint32_t> hard = clusters.empty() ? std::vector<uint32_t> { 0 } : clusters;
+    for (size_t c = 0; c < hard.size(); c++) {
+        uint32_t begin = hard[c];
+        uint32_t end = c + 1 < hard.size() ? hard[c + 1] : triangleCount;
+        splits.push_back(begin);
+        time += cacheSize + 1;
+        uint32_t misses = 0;
+        for (uint32_t t = begin; t < end; t++) {
+            for (uint32_t k = 0; k < 3; k++) {
+                uint32_t v = indices[t * 3 + k];
+                if (time - stamps[v] > cacheSize) {
+                    stamps[v] = time++;
+                    misses++;
+                }
+            }
+            if (t + 1 < end && misses <= target * (t - begin + 1)) {
+                splits.push_back(t + 1);
+                time += cacheSize + 1;
+                misses = 0;
+                begin = t + 1;
+            }
+        }
+    }
+
+    // area weighted centroid and normal of each cluster, and of the whole mesh
+    struct Cluster {
+        uint32_t begin;
+        uint32_t end;
+        float    sort;
+    };
+    std::vector<Cluster> sorted(splits.size());
+    std::vector<glm::vec3> centroids(splits.size());
+    std::vector<glm::vec3> normals(splits.size());
+    glm::vec3 meshCentroid = glm::vec3(0.0f);
+    float meshArea = 0.0f;
+    for (size_t c = 0; c < splits.size(); c++) {
+        sorted[c].begin = splits[c];
+        sorted[c].end = c + 1 < splits.size() ? splits[c + 1] : triangleCount;
+
+        glm::vec3 centroid = glm::vec3(0.0f);
+        glm::vec3 normal = glm::vec3(0.0f);
+        float area = 0.0f;
+        for (uint32_t t = sorted[c].begin; t < sorted[c].end; t++) {
+            glm::vec3 p0 = ReadPosition(positions, stride, indices[t * 3 + 0]);
+            glm::vec3 p1 = ReadPosition(positions, stride, indices[t * 3 + 1]);
+            glm::vec3 p2 = ReadPosition(positions, stride, indices[t * 3 + 2]);
+            glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+            float a = glm::length(n);
+            centroid += (p0 + p1 + p2) * (a / 3.0f);
+            normal += n;
+            area += a;
+        }
+        meshCentroid += centroid;
+        meshArea += area;
+        centroids[c] = area > 0.0f ? centroid / area : centroid;
+        normals[c] = normal;
+    }
+    if (meshArea > 0.0f) meshCentroid /= meshArea;
+
+    // clusters on the outside facing outwards occlude the rest, so they go first
+    for (size_t c = 0; c < sorted.size(); c++) {
+        float length = glm::length(normals[c]);
+        sorted[c].sort = length > 0.0f ? glm::dot(centroids[c] - meshCentroid, normals[c] / length) : 0.0f;
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) {
+        return a.sort > b.sort;
+    });
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    for (const Cluster& cluster : sorted) {
+        output.insert(output.end(), indices.begin() + cluster.begin * 3, indices.begin() + cluster.end * 3);
+    }
+    return output;
+}
+
+uint32_t MeshOptimizer::OptimizeVertexFetch(std::vector<uint32_t>& remap,
+                                            const std::vector<uint32_t>& indices,
+                                            size_t vertexCount) {
+    remap.assign(vertexCount, INVALID_INDEX);
+    uint32_t count = 0;
+    for (uint32_t index : indices) {
+        if (remap[index] == INVALID_INDEX) {
+            remap[index] = count++;
+        }
+    }
+    return count;
+}
+
+VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const std::vector<uint32_t>& indices,
+                                                   size_t vertexCount,
+                                                   uint32_t cacheSize) {
+    VertexCacheStats stats = {};
+    if (indices.empty()) return stats;
+
+    std::vector<uint32_t> stamps(vertexCount, 0);
+    std::vector<uint8_t> referenced(vertexCount, 0);
+    uint32_t time = cacheSize + 1;
+    uint32_t misses = 0;
+    uint32_t unique = 0;
+    for (uint32_t index : indices) {
+        if (time - stamps[index] > cacheSize) {
+            stamps[index] = time++;
+            misses++;
+        }
+        if (!referenced[index]) {
+            referenced[index] = 1;
+            unique++;
+        }
+    }
+
+    stats.acmr = static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+    stats.atvr = static_cast<float>(misses) / static_cast<float>(unique);
+    return stats;
+}
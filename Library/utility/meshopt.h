@@ -0,0 +1,79 @@
+#ifndef SLIM_UTILITY_MESHOPT_H
+#define SLIM_UTILITY_MESHOPT_H
+
+#include <vector>
+#include <cstdint>
+#include "utility/mesh.h"
+
+namespace slim::scene {
+
+    // post-transform vertex cache efficiency, simulated with a FIFO cache
+    struct VertexCacheStats {
+        float acmr = 0.0f;  // average cache miss ratio, transformed vertices per triangle, 0.5 at best and 3 at worst
+        float atvr = 0.0f;  // average transformed vertex ratio, transformed vertices per vertex, 1 at best
+    };
+
+    struct MeshOptimizerStats {
+        uint64_t         triangles      = 0;
+        uint64_t         verticesBefore = 0;
+        uint64_t         verticesAfter  = 0;
+        VertexCacheStats before         = {};
+        VertexCacheStats after          = {};
+
+        // accumulate over meshes, ratios are weighted by triangle and vertex counts
+        MeshOptimizerStats& operator+=(const MeshOptimizerStats& other);
+    };
+
+    // MeshOptimizer prepares indexed triangle meshes for rendering, on the CPU before upload:
+    // 1. weld bitwise identical vertices and drop unreferenced ones
+    // 2. reorder triangles for the post-transform vertex cache (Tipsify)
+    // 3. reorder clusters of triangles front to back from the mesh center, to reduce overdraw
+    // 4. reorder vertices in order of first use, for vertex fetch locality
+    // Positions are expected as float3 at offset 0 of the first vertex stream.
+    class MeshOptimizer {
+    public:
+        constexpr static uint32_t CACHE_SIZE = 16;
+        constexpr static float OVERDRAW_THRESHOLD = 1.05f;
+
+        // meshes without indices are left untouched, their draws are not indexed
+        static MeshOptimizerStats Optimize(Mesh* mesh, float overdrawThreshold = OVERDRAW_THRESHOLD);
+
+        // building blocks, on 32 bit triangle lists
+
+        // remap[old] = new for welded vertices, ~0u for unreferenced vertices, returns the new vertex count
+        static uint32_t GenerateVertexRemap(std::vector<uint32_t>& remap,
+                                            const std::vector<uint32_t>& indices,
+                                            size_t vertexCount,
+                                            const std::vector<const uint8_t*>& streams,
+                                            const std::vector<size_t>& strides);
+
+        // triangle order for a cache of cacheSize entries, clusters receives the first triangle of each
+        // run that starts at a dead end, those are where the order can be changed without losing locality
+        static std::vector<uint32_t> OptimizeVertexCache(const std::vector<uint32_t>& indices,
+                                                         size_t vertexCount,
+                                                         uint32_t cacheSize = CACHE_SIZE,
+                                                         std::vector<uint32_t>* clusters = nullptr);
+
+        // clusters are split further while their cache miss ratio stays within threshold of the whole mesh,
+        // then sorted so that clusters facing away from the mesh center are drawn first
+        static std::vector<uint32_t> OptimizeOverdraw(const std::vector<uint32_t>& indices,
+                                                      const std::vector<uint32_t>& clusters,
+                                                      const uint8_t* positions,
+                                                      size_t stride,
+                                                      size_t vertexCount,
+                                                      float threshold = OVERDRAW_THRESHOLD,
+                                                      uint32_t cacheSize = CACHE_SIZE);
+
+        // remap[old] = new in order of first use, ~0u for unreferenced vertices, returns the new vertex count
+        static uint32_t OptimizeVertexFetch(std::vector<uint32_t>& remap,
+                                            const std::vector<uint32_t>& indices,
+                                            size_t vertexCount);
+
+        static VertexCacheStats AnalyzeVertexCache(const std::vector<uint32_t>& indices,
+                                                   size_t vertexCount,
+                                                   uint32_t cacheSize = CACHE_SIZE);
+    };
+
+} // end of namespace slim::scene
+
+#endif // SLIM_UTILITY_MESHOPT_H
@@ -1,10 +1,14 @@
 #include "meshrenderer.h"
+#include <set>
 #include <iostream>
+#include <unordered_set>
+#include <unordered_map>
 #include <glm/gtx/string_cast.hpp>
 
 using namespace slim;
 
 MeshRenderer::MeshRenderer(const RenderInfo &info) : info(info) {
+    maxThreads = info.renderFrame->GetDevice()->GetJobSystem()->GetThreadCount();
 }
 
 MeshRenderer::~MeshRenderer() {
@@ -15,9 +19,7 @@ void MeshRenderer::Draw(Camera *camera, const View<Drawable>& drawables) {
         return;
     }
 
-    RenderPass* renderPass = info.renderPass;
     RenderFrame* renderFrame = info.renderFrame;
-    CommandBuffer* commandBuffer = info.commandBuffer;
 
     CameraData cameraData = {
         camera->GetView(),
@@ -25,14 +27,14 @@ void MeshRenderer::Draw(Camera *camera, const View<Drawable>& drawables) {
     };
 
     std::vector<ModelData> modelData;
-    std::vector<scene::Material*> materials;
+    std::vector<const Drawable*> draws;
 
     // prepare model transforms
     for (const Drawable& drawable : drawables) {
         glm::mat4 M = drawable.node->GetTransform().LocalToWorld();
         glm::mat4 N = glm::transpose(glm::inverse(cameraData.view * M));
         modelData.push_back(ModelData { M, N });
-        materials.push_back(drawable.material);
+        draws.push_back(&drawable);
     }
 
     // nothing to draw
@@ -42,20 +44,63 @@ void MeshRenderer::Draw(Camera *camera, const View<Drawable>& drawables) {
     auto cameraUniform = renderFrame->RequestUniformBuffer(cameraData);
     auto modelUniform = renderFrame->RequestUniformBuffer(modelData);
 
-    // draw
-    uint32_t index = 0;
-    for (const Drawable& drawable : drawables) {
+    if (info.contents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS) {
+        RecordParallel(draws, cameraUniform, modelUniform);
+    } else {
+        ViewDescriptors viewDescriptors;
+        Record(info.commandBuffer, draws, 0, draws.size(), viewDescriptors, cameraUniform, modelUniform, false);
+    }
+}
+
+MeshRenderer::ViewDescriptor MeshRenderer::RequestViewDescriptor(PipelineLayout* layout, uint32_t slot,
+                                                                 const BufferAlloc& cameraUniform, const BufferAlloc& modelUniform) {
+    // per-view descriptors are written once and shared by all drawables,
+    // only the dynamic offset of the model uniform changes between draws
+    bool created = false;
+    Descriptor* descriptor = info.renderFrame->RequestDescriptor(layout, { cameraUniform, modelUniform }, created, slot);
+    if (created) {
+        descriptor->SetUniformBuffer("Camera", cameraUniform);
+        descriptor->SetDynamicUniformBuffer("Model", modelUniform, sizeof(ModelData));
+    }
+    auto [set, binding] = descriptor->GetBinding("Model");
+    return ViewDescriptor { descriptor, set, binding };
+}
+
+void MeshRenderer::Record(CommandBuffer* commandBuffer, const std::vector<const Drawable*>& drawables, size_t first, size_t last,
+                          ViewDescriptors& viewDescriptors, const BufferAlloc& cameraUniform, const BufferAlloc& modelUniform,
+                          bool prepared) {
+    RenderPass* renderPass = info.renderPass;
+    RenderFrame* renderFrame = info.renderFrame;
+
+    scene::Material* boundMaterial = nullptr;
+    uint32_t boundTechniqueIndex = 0;
+    for (size_t index = first; index < last; index++) {
+        const Drawable& drawable = *drawables[index];
         drawable.mesh->Bind(commandBuffer);
 
+        // consecutive drawables sharing a material skip pipeline lookup and material binding
         uint32_t techniqueIndex = drawable.material->QueueIndex(drawable.queue);
-        drawable.material->Bind(techniqueIndex, commandBuffer, renderFrame, renderPass);
+        if (drawable.material.get() != boundMaterial || techniqueIndex != boundTechniqueIndex) {
+            if (prepared) {
+                drawable.material->Bind(techniqueIndex, commandBuffer);
+            } else {
+                drawable.material->Bind(techniqueIndex, commandBuffer, renderFrame, renderPass);
+            }
+            boundMaterial = drawable.material.get();
+            boundTechniqueIndex = techniqueIndex;
+        }
+
+        // find or create the per-view descriptor for this layout
+        PipelineLayout* layout = drawable.material->Layout(techniqueIndex);
+        auto it = viewDescriptors.find(layout);
+        if (it == viewDescriptors.end()) {
+            it = viewDescriptors.insert(std::make_pair(layout, RequestViewDescriptor(layout, 0, cameraUniform, modelUniform))).first;
+        }
 
         // bind
-        auto descriptor = SlimPtr<Descriptor>(renderFrame->GetDescriptorPool(), drawable.material->Layout(techniqueIndex));
-        descriptor->SetUniformBuffer("Camera", cameraUniform);
-        descriptor->SetDynamicUniformBuffer("Model", modelUniform, sizeof(ModelData));
-        descriptor->SetDynamicOffset("Model", index * sizeof(ModelData));
-        commandBuffer->BindDescriptor(descriptor, VK_PIPELINE_BIND_POINT_GRAPHICS);
+        const ViewDescriptor& view = it->second;
+        view.descriptor->SetDynamicOffset(view.set, view.binding, index * sizeof(ModelData));
+        commandBuffer->BindDescriptor(view.descriptor, VK_PIPELINE_BIND_POINT_GRAPHICS);
 
         // draw
         const auto& draw = drawable.drawCommand;
@@ -66,7 +111,129 @@ void MeshRenderer::Draw(Camera *camera, const View<Drawable>& drawables) {
             const auto& command = std::get<VkDrawIndexedIndirectCommand>(draw);
             commandBuffer->DrawIndexed(command.indexCount, command.instanceCount, command.firstIndex, command.vertexOffset, command.firstInstance);
         }
+    }
+}
+
+void MeshRenderer::RecordParallel(const std::vector<const Drawable*>& drawables,
+                                  const BufferAlloc& cameraUniform, const BufferAlloc& modelUniform) {
+    RenderPass* renderPass = info.renderPass;
+    RenderFrame* renderFrame = info.renderFrame;
+
+    size_t count = drawables.size();
+    uint32_t threads = static_cast<uint32_t>((count + MIN_DRAWABLES_PER_THREAD - 1) / MIN_DRAWABLES_PER_THREAD);
+    threads = std::min(std::max(threads, 1u), maxThreads);
+
+    // everything touching shared frame state happens here on the calling thread:
+    // pipelines are resolved, material descriptors are written, and each thread gets its own
+    // view descriptors (dynamic offsets are per descriptor) and secondary command buffer
+    std::set<std::pair<scene::Material*, uint32_t>> materials;
+    std::unordered_set<PipelineLayout*> layouts;
+    for (const Drawable* drawable : drawables) {
+        uint32_t techniqueIndex = drawable->material->QueueIndex(drawable->queue);
+        if (materials.insert(std::make_pair(drawable->material.get(), techniqueIndex)).second) {
+            drawable->material->Prepare(techniqueIndex, renderFrame, renderPass);
+            layouts.insert(drawable->material->Layout(techniqueIndex));
+        }
+    }
+
+    std::vector<ViewDescriptors> viewDescriptors(threads);
+    std::vector<CommandBuffer*> commandBuffers(threads);
+    for (uint32_t t = 0; t < threads; t++) {
+        for (PipelineLayout* layout : layouts) {
+            ViewDescriptor view = RequestViewDescriptor(layout, t, cameraUniform, modelUniform);
+            view.descriptor->Update();
+            viewDescriptors[t].insert(std::make_pair(layout, view));
+        }
+        commandBuffers[t] = renderFrame->RequestThreadCommandPool(t)->Request(VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+    }
+
+    // record contiguous chunks, so draw order is kept when executing the chunks in order,
+    // every chunk has its own command buffer and pool, whichever worker records it
+    JobSystem* jobs = renderFrame->GetDevice()->GetJobSystem();
+    jobs->ParallelFor(0, threads, 1, [&](uint32_t t, uint32_t) {
+        size_t first = count * t / threads;
+        size_t last = count * (t + 1) / threads;
+        CommandBuffer* commandBuffer = commandBuffers[t];
+        commandBuffer->Begin(info.renderPass, info.subpass, info.framebuffer);
+        Record(commandBuffer, drawables, first, last, viewDescriptors[t], cameraUniform, modelUniform, true);
+        commandBuffer->End();
+    });
+
+    info.commandBuffer->ExecuteCommands(commandBuffers);
+}
+
+void MeshRenderer::Draw(Camera *camera, GPUCulling *culling, uint32_t firstQueue, uint32_t lastQueue) {
+    scene::Builder* builder = culling->GetScene();
+    if (builder->GetInstanceCount() == 0) {
+        return;
+    }
+
+    RenderPass* renderPass = info.renderPass;
+    RenderFrame* renderFrame = info.renderFrame;
+    CommandBuffer* commandBuffer = info.commandBuffer;
+
+    // a handful of indirect draws is not worth splitting, a single secondary command buffer is enough
+    bool secondary = info.contents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS;
+    if (secondary) {
+        commandBuffer = renderFrame->RequestCommandBuffer(VK_QUEUE_GRAPHICS_BIT, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+        commandBuffer->Begin(info.renderPass, info.subpass, info.framebuffer);
+    }
+
+    CameraData cameraData = {
+        camera->GetView(),
+        camera->GetProjection()
+    };
+    auto cameraUniform = renderFrame->RequestUniformBuffer(cameraData);
+    std::vector<BufferAlloc> resources = { cameraUniform, BufferAlloc(builder->GetInstanceBuffer()) };
+
+    const auto& batches = builder->GetInstanceBatches();
+    for (uint32_t b = 0; b < batches.size(); b++) {
+        const scene::InstanceBatch& batch = batches[b];
+        uint32_t techniqueIndex = 0;
+        for (const auto& pass : *batch.material->GetTechnique()) {
+            if (pass.queue < firstQueue || pass.queue > lastQueue) {
+                techniqueIndex++;
+                continue;
+            }
+
+            batch.mesh->Bind(commandBuffer);
+            batch.material->Bind(techniqueIndex, commandBuffer, renderFrame, renderPass);
+
+            // per-view descriptor, shared by all batches with the same layout
+            bool created = false;
+            Descriptor* descriptor = renderFrame->RequestDescriptor(batch.material->Layout(techniqueIndex), resources, created);
+            if (created) {
+                descriptor->SetUniformBuffer("Camera", cameraUniform);
+                descriptor->SetStorageBuffer("Instances", builder->GetInstanceBuffer());
+            }
+            commandBuffer->BindDescriptor(descriptor, VK_PIPELINE_BIND_POINT_GRAPHICS);
+
+            // commands of this batch start at its first instance, or at its first cluster in meshlet mode
+            uint32_t maxCommands = culling->GetMaxCommands(batch);
+            size_t offset = culling->GetFirstCommand(batch) * GPUCulling::COMMAND_STRIDE;
+            size_t countOffset = b * sizeof(uint32_t);
+            bool indexed = batch.mesh->GetIndexCount() > 0;
+            if (culling->IsCompacted()) {
+                if (indexed) {
+                    commandBuffer->DrawIndexedIndirectCount(culling->GetDrawBuffer(), offset, culling->GetCountBuffer(), countOffset,
+                                                            maxCommands, GPUCulling::COMMAND_STRIDE);
+                } else {
+                    commandBuffer->DrawIndirectCount(culling->GetDrawBuffer(), offset, culling->GetCountBuffer(), countOffset,
+                                                     maxCommands, GPUCulling::COMMAND_STRIDE);
+                }
+            } else {
+                if (indexed) {
+                    commandBuffer->DrawIndexedIndirect(culling->GetDrawBuffer(), offset, maxCommands, GPUCulling::COMMAND_STRIDE);
+                } else {
+                    commandBuffer->DrawIndirect(culling->GetDrawBuffer(), offset, maxCommands, GPUCulling::COMMAND_STRIDE);
+                }
+            }
+            techniqueIndex++;
+        }
+    }
 
-        index++;
+    if (secondary) {
+        commandBuffer->End();
+        info.commandBuffer->ExecuteCommands({ commandBuffer });
     }
 }
@@ -3,6 +3,8 @@
 
 #include <map>
 #include <vector>
+#include <algorithm>
+#include <unordered_map>
 
 #include "utility/view.h"
 #include "utility/camera.h"
@@ -28,13 +30,48 @@ namespace slim {
             alignas(16) glm::mat4 normal;   // normal matrix is mat3, but using a mat4 is better for alignment issue
         };
 
+        // below this many drawables per thread, recording is not worth splitting further
+        constexpr static uint32_t MIN_DRAWABLES_PER_THREAD = 256;
+
         explicit MeshRenderer(const RenderInfo &info);
         virtual ~MeshRenderer();
 
+        // when the subpass uses secondary command buffers (RenderGraph::Pass::UseSecondaryCommandBuffers),
+        // drawables are split into up to maxThreads chunks recorded by the device JobSystem, each chunk into a
+        // secondary command buffer from its own RenderFrame thread command pool
         void Draw(Camera *camera, const View<Drawable>& drawables);
 
+        // draw instances culled by GPUCulling with one (multi-)draw per batch and technique pass,
+        // shaders read "Instances" (scene::InstanceData) indexed by gl_InstanceIndex instead of "Model",
+        // instances are not depth sorted, this is meant for opaque queues.
+        void Draw(Camera *camera, GPUCulling *culling, uint32_t firstQueue, uint32_t lastQueue);
+
+        void SetMaxThreads(uint32_t threads) { maxThreads = std::max(threads, 1u); }
+
+    private:
+        // per-view descriptor of a pipeline layout, shared by all drawables using that layout
+        struct ViewDescriptor {
+            Descriptor* descriptor;
+            uint32_t set;
+            uint32_t binding;
+        };
+        using ViewDescriptors = std::unordered_map<PipelineLayout*, ViewDescriptor>;
+
+        // view descriptors of different slots are never shared, each recording thread uses its own slot
+        ViewDescriptor RequestViewDescriptor(PipelineLayout* layout, uint32_t slot,
+                                             const BufferAlloc& cameraUniform, const BufferAlloc& modelUniform);
+
+        // record drawables [first, last), prepared materials and view descriptors make it thread-safe
+        void Record(CommandBuffer* commandBuffer, const std::vector<const Drawable*>& drawables, size_t first, size_t last,
+                    ViewDescriptors& viewDescriptors, const BufferAlloc& cameraUniform, const BufferAlloc& modelUniform,
+                    bool prepared);
+
+        void RecordParallel(const std::vector<const Drawable*>& drawables,
+                            const BufferAlloc& cameraUniform, const BufferAlloc& modelUniform);
+
     private:
         RenderInfo info;
+        uint32_t maxThreads;
     }; // end of MeshRenderer
 
 } // end of namespace slim
@@ -0,0 +1,230 @@
+#include <algorithm>
+#include <stdexcept>
+#include "utility/occlusion.h"
+
+using namespace slim;
+
+OcclusionCulling::OcclusionCulling(scene::Builder* builder, spirv::ComputeShader* cullingShader, spirv::ComputeShader* pyramidShader)
+    : device(builder->GetDevice()), builder(builder) {
+    culling[0] = SlimPtr<GPUCulling>(builder, cullingShader, false, true);
+    culling[1] = SlimPtr<GPUCulling>(builder, cullingShader, false, true);
+
+    pyramidPipeline = SlimPtr<Pipeline>(
+        device,
+        ComputePipelineDesc()
+            .SetName("Depth Pyramid")
+            .SetComputeShader(pyramidShader)
+            .SetPipelineLayout(PipelineLayoutDesc()
+                .AddBinding("Source",      SetBinding { 0, 0 }, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+                .AddBinding("Destination", SetBinding { 0, 1 }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,          VK_SHADER_STAGE_COMPUTE_BIT)
+                .AddBinding("Reduction",   SetBinding { 0, 2 }, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,         VK_SHADER_STAGE_COMPUTE_BIT))
+    );
+
+    // texels are fetched, filtering never applies
+    sampler = SlimPtr<Sampler>(device, SamplerDesc()
+        .MagFilter(VK_FILTER_NEAREST)
+        .MinFilter(VK_FILTER_NEAREST)
+        .MipmapMode(VK_SAMPLER_MIPMAP_MODE_NEAREST)
+        .AddressMode(VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE));
+}
+
+OcclusionCulling::~OcclusionCulling() {
+}
+
+VkExtent2D OcclusionCulling::GetPyramidExtent(VkExtent2D depthExtent) {
+    auto previousPowerOfTwo = [](uint32_t value) {
+        uint32_t result = 1;
+        while (result <= value / 2) result *= 2;
+        return result;
+    };
+    return VkExtent2D { previousPowerOfTwo(depthExtent.width), previousPowerOfTwo(depthExtent.height) };
+}
+
+uint32_t OcclusionCulling::GetPyramidLevels(VkExtent2D pyramidExtent) {
+    uint32_t levels = 1;
+    for (uint32_t size = std::max(pyramidExtent.width, pyramidExtent.height); size > 1; size /= 2) {
+        levels++;
+    }
+    return levels;
+}
+
+void OcclusionCulling::Prepare(VkExtent2D depthExtent, RenderFrame* renderFrame) {
+    VkExtent2D extent = GetPyramidExtent(depthExtent);
+    if (!pyramid.get() || pyramid->Width() != extent.width || pyramid->Height() != extent.height) {
+        if (renderFrame) renderFrame->RetireImage(pyramid);
+        pyramid = SlimPtr<GPUImage>(device, PYRAMID_FORMAT, extent, GetPyramidLevels(extent), 1, VK_SAMPLE_COUNT_1_BIT,
+                                    VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+        pyramid->SetName("Depth Pyramid");
+    }
+
+    // one visibility per instance, a rebuilt scene starts over with everything drawn by the late phase
+    uint32_t count = builder->GetInstanceCount();
+    if (count > 0 && count != visibilityCount) {
+        if (renderFrame) {
+            renderFrame->RetireBuffer(visibilityBuffer);
+            renderFrame->RetireBuffer(readbackBuffer);
+        }
+        visibilityBuffer = SlimPtr<Buffer>(device, count * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+        visibilityBuffer->SetName("Occlusion Visibility Buffer");
+        readbackBuffer = SlimPtr<Buffer>(device, count * sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+        readbackBuffer->SetData(std::vector<uint32_t>(count, 1));
+        visibilityCount = count;
+        visibilityReset = true;
+    }
+
+    culling[0]->Reserve(renderFrame);
+    culling[1]->Reserve(renderFrame);
+}
+
+void OcclusionCulling::Cull(RenderFrame* renderFrame, CommandBuffer* commandBuffer, Camera* camera, Phase phase) {
+    Cull(renderFrame, commandBuffer, camera->GetProjection() * camera->GetView(), phase);
+}
+
+void OcclusionCulling::Cull(RenderFrame* renderFrame, CommandBuffer* commandBuffer, const glm::mat4& viewProj, Phase phase) {
+    if (!pyramid.get()) {
+        throw std::runtime_error("[OcclusionCulling] Prepare() must be called before culling");
+    }
+    if (visibilityCount == 0) {
+        return;
+    }
+
+    if (visibilityReset) {
+        std::vector<uint32_t> zeros(visibilityCount, 0);
+        commandBuffer->CopyDataToBuffer(zeros, visibilityBuffer);
+        commandBuffer->PrepareForBuffer(visibilityBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        visibilityReset = false;
+    }
+
+    // the pyramid is only sampled in the late phase, but bound in both,
+    // the transition is skipped when a render graph already did it
+    BarrierBatch barriers;
+    barriers.AddImageBarrier(pyramid, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    barriers.Flush(commandBuffer);
+
+    GPUCulling* target = culling[static_cast<uint32_t>(phase)];
+    target->phase = static_cast<uint32_t>(phase) + 1;
+    target->visibilityBuffer = visibilityBuffer;
+    target->depthPyramid = pyramid;
+    target->pyramidSampler = sampler;
+    target->Cull(renderFrame, commandBuffer, viewProj);
+
+    if (phase == Phase::Late) {
+        // visibility is read by the next early phase, or copied to the host
+        if (readback) {
+            commandBuffer->PrepareForBuffer(visibilityBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+            commandBuffer->CopyBufferToBuffer(visibilityBuffer, 0, readbackBuffer, 0, visibilityCount * sizeof(uint32_t));
+            commandBuffer->PrepareForBuffer(visibilityBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        } else {
+            commandBuffer->PrepareForBuffer(visibilityBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        }
+    }
+}
+
+void OcclusionCulling::BuildPyramid(RenderFrame* renderFrame, CommandBuffer* commandBuffer, Image* depth) {
+    if (!pyramid.get()) {
+        throw std::runtime_error("[OcclusionCulling] Prepare() must be called before building the depth pyramid");
+    }
+
+    // depth is sampled and pyramid levels are written as storage images,
+    // transitions are skipped when a render graph already did them
+    BarrierBatch barriers;
+    barriers.AddImageBarrier(depth, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                             VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    barriers.AddImageBarrier(pyramid, VK_IMAGE_LAYOUT_GENERAL,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    barriers.Flush(commandBuffer);
+
+    commandBuffer->BindPipeline(pyramidPipeline);
+
+    // each level reduces the previous one, the first one reduces the depth buffer
+    glm::uvec2 srcSize = glm::uvec2(depth->Width(), depth->Height());
+    for (uint32_t level = 0; level < pyramid->MipLevels(); level++) {
+        glm::uvec2 dstSize = glm::max(glm::uvec2(pyramid->Width() >> level, pyramid->Height() >> level), glm::uvec2(1));
+        ReductionData data = { srcSize, dstSize };
+
+        auto descriptor = SlimPtr<Descriptor>(renderFrame->GetDescriptorPool(), pyramidPipeline->Layout());
+        if (level == 0) {
+            descriptor->SetTexture("Source", depth, sampler);
+        } else {
+            descriptor->SetTexture("Source", pyramid, sampler, level - 1);
+        }
+        descriptor->SetStorageImage("Destination", pyramid, level);
+        descriptor->SetUniformBuffer("Reduction", renderFrame->RequestUniformBuffer(data));
+
+        commandBuffer->BindDescriptor(descriptor, VK_PIPELINE_BIND_POINT_COMPUTE);
+        commandBuffer->Dispatch((dstSize.x + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, (dstSize.y + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1);
+
+        // this level is sampled by the next one
+        barriers.AddImageBarrier(pyramid, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 0, 1, level, 1);
+        barriers.Flush(commandBuffer);
+        srcSize = dstSize;
+    }
+
+    // a render graph tracks a single layout for the whole pyramid, which was declared as storage
+    barriers.AddImageBarrier(pyramid, VK_IMAGE_LAYOUT_GENERAL,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    barriers.Flush(commandBuffer);
+}
+
+OcclusionCulling::GraphResources OcclusionCulling::CreateResources(RenderGraph& graph) {
+    if (!pyramid.get() || visibilityCount == 0) {
+        throw std::runtime_error("[OcclusionCulling] Prepare() must be called with a built scene before creating graph resources");
+    }
+
+    GraphResources resources = {};
+    resources.pyramid = graph.CreateResource(pyramid);
+    resources.visibility = graph.CreateResource(visibilityBuffer);
+    for (uint32_t i = 0; i < 2; i++) {
+        resources.commands[i] = graph.CreateResource(culling[i]->GetDrawBuffer());
+        resources.counts[i] = graph.CreateResource(culling[i]->GetCountBuffer());
+    }
+    return resources;
+}
+
+RenderGraph::Pass* OcclusionCulling::AddCullingPass(RenderGraph& graph, const GraphResources& resources, Camera* camera, Phase phase) {
+    uint32_t index = static_cast<uint32_t>(phase);
+    auto pass = graph.CreateComputePass(phase == Phase::Early ? "early occlusion culling" : "late occlusion culling");
+    pass->SetTexture(resources.pyramid);
+    pass->SetStorage(resources.visibility, phase == Phase::Early ? RenderGraph::STORAGE_READ_ONLY : RenderGraph::STORAGE_READ_WRITE);
+    pass->SetStorage(resources.commands[index], RenderGraph::STORAGE_WRITE_ONLY);
+    pass->SetStorage(resources.counts[index], RenderGraph::STORAGE_WRITE_ONLY);
+    pass->Execute([=](const RenderInfo& info) {
+        Cull(info.renderFrame, info.commandBuffer, camera, phase);
+    });
+    return pass;
+}
+
+RenderGraph::Pass* OcclusionCulling::AddPyramidPass(RenderGraph& graph, const GraphResources& resources, RenderGraph::Resource* depth) {
+    auto pass = graph.CreateComputePass("depth pyramid");
+    pass->SetTexture(depth);
+    pass->SetStorage(resources.pyramid, RenderGraph::STORAGE_WRITE_ONLY);
+    pass->Execute([=](const RenderInfo& info) {
+        BuildPyramid(info.renderFrame, info.commandBuffer, depth->GetImage());
+    });
+    return pass;
+}
+
+void OcclusionCulling::GetOccludedNodes(std::unordered_set<const scene::Node*>& nodes) const {
+    nodes.clear();
+    if (visibilityCount == 0 || builder->GetInstanceCount() != visibilityCount) {
+        return;
+    }
+
+    // a node with several instances is only occluded when all of them are
+    const uint32_t* visibility = readbackBuffer->GetData<uint32_t>();
+    std::unordered_set<const scene::Node*> visible;
+    for (uint32_t i = 0; i < visibilityCount; i++) {
+        const scene::Node* node = builder->GetInstanceNode(i);
+        if (visibility[i]) {
+            visible.insert(node);
+        } else {
+            nodes.insert(node);
+        }
+    }
+    for (const scene::Node* node : visible) {
+        nodes.erase(node);
+    }
+}
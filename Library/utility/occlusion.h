@@ -0,0 +1,112 @@
+#ifndef SLIM_UTILITY_OCCLUSION_H
+#define SLIM_UTILITY_OCCLUSION_H
+
+#include <unordered_set>
+
+#include "core/sampler.h"
+#include "utility/camera.h"
+#include "utility/culling.h"
+#include "utility/interface.h"
+#include "utility/scenegraph.h"
+#include "utility/rendergraph.h"
+
+namespace slim {
+
+    /**
+     * OcclusionCulling culls the instances of a built scene (scene::Builder) hidden behind other instances,
+     * in two phases every frame, each with its own GPUCulling in occlusion mode:
+     *
+     * 1. early: instances visible in the previous frame are drawn when they are in the frustum,
+     * 2. the depth of the early draws is reduced into a hierarchical depth pyramid (BuildPyramid),
+     * 3. late: instances in the frustum are tested against the pyramid, the visible ones not drawn yet are drawn,
+     *    and the visibility of all instances is kept for the next frame.
+     *
+     * Instances becoming visible are drawn in the late phase of the same frame, so nothing visible is missed.
+     * Depth is expected in [0, 1] with the near plane at 0, the pyramid keeps the farthest depth of each texel.
+     *
+     * Both compute shaders are provided by users, their interfaces are defined in shaderlib/indirect.h:
+     * the culling shader has the GPUCulling interface plus "Visibility" and "DepthPyramid", and tests
+     * CullingData::phase; the pyramid shader reads a "Source" texture and writes a "Destination" r32f storage
+     * image, one level at a time, given the sizes in a "Reduction" uniform buffer.
+     **/
+    class OcclusionCulling : public NotCopyable, public NotMovable, public ReferenceCountable {
+    public:
+        enum class Phase : uint32_t {
+            Early = 0,
+            Late  = 1,
+        };
+
+        constexpr static uint32_t WORKGROUP_SIZE = 8;   // pyramid shader workgroup is 8x8
+        constexpr static VkFormat PYRAMID_FORMAT = VK_FORMAT_R32_SFLOAT;
+
+        explicit OcclusionCulling(scene::Builder* builder, spirv::ComputeShader* cullingShader, spirv::ComputeShader* pyramidShader);
+        virtual ~OcclusionCulling();
+
+        // the pyramid is the previous power of two of the depth buffer in each dimension, halved down to 1x1
+        static VkExtent2D GetPyramidExtent(VkExtent2D depthExtent);
+        static uint32_t   GetPyramidLevels(VkExtent2D pyramidExtent);
+
+        // (re-)create the depth pyramid for a depth buffer size, and the buffers for the current scene,
+        // visibility starts out empty, then everything in the frustum is drawn by the late phase,
+        // replaced resources are retired to the frame like in GPUCulling::Reserve()
+        void Prepare(VkExtent2D depthExtent, RenderFrame* renderFrame = nullptr);
+
+        // record culling of a phase, Prepare() must have been called
+        void Cull(RenderFrame* renderFrame, CommandBuffer* commandBuffer, Camera* camera, Phase phase);
+        void Cull(RenderFrame* renderFrame, CommandBuffer* commandBuffer, const glm::mat4& viewProj, Phase phase);
+
+        // record the reduction of a depth buffer (or any image with depth in its first channel) into the pyramid
+        void BuildPyramid(RenderFrame* renderFrame, CommandBuffer* commandBuffer, Image* depth);
+
+        // render graph resources of one graph, draw passes of a phase read its commands and counts
+        // with SetStorage(resource, RenderGraph::STORAGE_READ_ONLY)
+        struct GraphResources {
+            RenderGraph::Resource* pyramid;
+            RenderGraph::Resource* visibility;
+            RenderGraph::Resource* commands[2];
+            RenderGraph::Resource* counts[2];
+        };
+
+        // declare the retained resources to a graph, after Prepare()
+        GraphResources CreateResources(RenderGraph& graph);
+
+        // compute passes, declared in order: early culling, early draws, pyramid from their depth, late culling, late draws
+        RenderGraph::Pass* AddCullingPass(RenderGraph& graph, const GraphResources& resources, Camera* camera, Phase phase);
+        RenderGraph::Pass* AddPyramidPass(RenderGraph& graph, const GraphResources& resources, RenderGraph::Resource* depth);
+
+        // culling results of a phase, to be drawn with MeshRenderer::Draw(camera, culling)
+        GPUCulling* GetCulling(Phase phase) const { return culling[static_cast<uint32_t>(phase)]; }
+
+        GPUImage*   GetDepthPyramid()     const { return pyramid;          }
+        Buffer*     GetVisibilityBuffer() const { return visibilityBuffer; }
+
+        // copy visibility to the host after each late phase, for CPUCulling::SetOccludedNodes()
+        void SetReadback(bool enable) { readback = enable; }
+
+        // nodes whose instances were all occluded, from the latest late phase that finished on the GPU,
+        // results of frames still in flight may be partially written, which is fine for a hint
+        void GetOccludedNodes(std::unordered_set<const scene::Node*>& nodes) const;
+
+    private:
+        // reduction step, matches DepthPyramidData in shaderlib/indirect.h
+        struct ReductionData {
+            glm::uvec2 srcSize;
+            glm::uvec2 dstSize;
+        };
+
+        SmartPtr<Device>         device;
+        SmartPtr<scene::Builder> builder;
+        SmartPtr<GPUCulling>     culling[2];
+        SmartPtr<Pipeline>       pyramidPipeline;
+        SmartPtr<Sampler>        sampler;
+        SmartPtr<GPUImage>       pyramid;
+        SmartPtr<Buffer>         visibilityBuffer;
+        SmartPtr<Buffer>         readbackBuffer;
+        uint32_t                 visibilityCount = 0;
+        bool                     visibilityReset = false;
+        bool                     readback = false;
+    };
+
+} // end of namespace slim
+
+#endif // SLIM_UTILITY_OCCLUSION_H
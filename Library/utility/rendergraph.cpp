@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <imgui.h>
 #include "core/debug.h"
 #include "core/vkutils.h"
@@ -31,137 +32,85 @@ void RenderGraph::Resource::Deallocate() {
     image.Reset();
 }
 
-void RenderGraph::Resource::ShaderReadBarrier(CommandBuffer* commandBuffer, RenderGraph::Pass* nextPass) {
-    image->layouts[0][0] = currentLayout;
-
-    // prepare layout transition
-    VkImageLayout srcLayout = image->layouts[0][0];
-    VkImageLayout dstLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-    // prepare src stages
-    VkPipelineStageFlags srcStageMask = VK_PIPELINE_STAGE_NONE_KHR;
-    if (!currentPass) {
-        srcStageMask = VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT;
-    } else {
-        if (currentPass->IsCompute()) {
-        srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
-        } else {
-            srcStageMask = IsDepthStencil(format)
-                         ? VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT
-                         : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        }
+// stages in which the last pass could have accessed a resource
+static VkPipelineStageFlags GetSrcStages(RenderGraph::Pass* pass, VkFormat format, VkImageLayout layout) {
+    if (!pass) {
+        // last used by an earlier submission
+        return VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    }
+    if (pass->IsCompute()) {
+        return VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
     }
+    if (layout == VK_IMAGE_LAYOUT_GENERAL || layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+        return VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    }
+    return IsDepthStencil(format)
+         ? VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT
+         : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+}
 
-    // prepare dst stages
-    VkPipelineStageFlags dstStageMask = VK_PIPELINE_STAGE_NONE_KHR;
-    if (nextPass->IsCompute()) {
-        dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
-    } else {
-        dstStageMask = VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT;
+// stages in which the next pass could access a resource through descriptors
+static VkPipelineStageFlags GetDstStages(RenderGraph::Pass* pass) {
+    if (pass->IsCompute()) {
+        return VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
     }
+    return VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+}
+
+void RenderGraph::Resource::ShaderReadBarrier(BarrierBatch& barriers, RenderGraph::Pass* nextPass) {
+    image->layouts[0][0] = currentLayout;
 
     // transit dst image layout
-    PrepareLayoutTransition(commandBuffer,
-        image,
-        srcLayout, dstLayout,
-        srcStageMask, dstStageMask,
-        0, image->Layers(),
-        0, image->MipLevels());
+    barriers.AddImageBarrier(image,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        GetSrcStages(currentPass, format, currentLayout),
+        GetDstStages(nextPass));
 
     // update next pass
     currentPass = nextPass;
     currentLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 }
 
-void RenderGraph::Resource::StorageBarrier(CommandBuffer* commandBuffer, RenderGraph::Pass* nextPass) {
+void RenderGraph::Resource::StorageBarrier(BarrierBatch& barriers, RenderGraph::Pass* nextPass) {
     if (buffer) {
-        StorageBufferBarrier(commandBuffer, nextPass);
+        StorageBufferBarrier(barriers, nextPass);
     } else {
-        StorageImageBarrier(commandBuffer, nextPass);
+        StorageImageBarrier(barriers, nextPass);
     }
 }
 
-void RenderGraph::Resource::StorageImageBarrier(CommandBuffer* commandBuffer, RenderGraph::Pass* nextPass) {
+void RenderGraph::Resource::StorageImageBarrier(BarrierBatch& barriers, RenderGraph::Pass* nextPass) {
     image->layouts[0][0] = currentLayout;
 
-    // prepare layout transition
-    VkImageLayout srcLayout = image->layouts[0][0];
-    VkImageLayout dstLayout = VK_IMAGE_LAYOUT_GENERAL;
-
-    // prepare src stages
-    VkPipelineStageFlags srcStageMask = VK_PIPELINE_STAGE_NONE_KHR;
-    if (!currentPass) {
-        srcStageMask = VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT;
-    } else if (currentPass->IsCompute()) {
-        srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    VkPipelineStageFlags srcStageMask = GetSrcStages(currentPass, format, currentLayout);
+    VkPipelineStageFlags dstStageMask = GetDstStages(nextPass);
+    if (currentLayout == VK_IMAGE_LAYOUT_GENERAL) {
+        // no layout change, but accesses from the last pass still need to be visible
+        barriers.AddMemoryBarrier(VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+                                  srcStageMask, dstStageMask);
     } else {
-        srcStageMask = IsDepthStencil(format)
-                     ? VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT
-                     : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        barriers.AddImageBarrier(image, VK_IMAGE_LAYOUT_GENERAL, srcStageMask, dstStageMask);
     }
 
-    // prepare dst stages
-    VkPipelineStageFlags dstStageMask = VK_PIPELINE_STAGE_NONE_KHR;
-    if (nextPass->IsCompute()) {
-        dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
-    } else {
-        dstStageMask = VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT;
-    }
-
-    // transit dst image layout
-    PrepareLayoutTransition(commandBuffer,
-        image,
-        srcLayout, dstLayout,
-        srcStageMask, dstStageMask,
-        0, image->Layers(),
-        0, image->MipLevels());
-
     // update next pass
     currentPass = nextPass;
     currentLayout = VK_IMAGE_LAYOUT_GENERAL;
 }
 
-void RenderGraph::Resource::StorageBufferBarrier(CommandBuffer* commandBuffer, RenderGraph::Pass* nextPass) {
-    Device* device = commandBuffer->GetDevice();
-
-    // prepare src stages
-    VkPipelineStageFlags srcStageMask = VK_PIPELINE_STAGE_NONE_KHR;
-    if (!currentPass) {
-        srcStageMask = VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT;
-    } else if (currentPass->IsCompute()) {
-        srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
-    } else {
-        srcStageMask = IsDepthStencil(format)
-                     ? VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT
-                     : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+void RenderGraph::Resource::StorageBufferBarrier(BarrierBatch& barriers, RenderGraph::Pass* nextPass) {
+    VkPipelineStageFlags srcStageMask = GetSrcStages(currentPass, format, VK_IMAGE_LAYOUT_GENERAL);
+    VkPipelineStageFlags dstStageMask = GetDstStages(nextPass);
+    if (!nextPass->IsCompute()) {
+        // storage buffers could also be consumed as vertex, index or indirect buffers
+        dstStageMask |= VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
     }
 
-    // prepare dst stages
-    VkPipelineStageFlags dstStageMask = VK_PIPELINE_STAGE_NONE_KHR;
-    if (nextPass->IsCompute()) {
-        dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
-    } else {
-        dstStageMask = VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT;
-    }
-
-    VkBufferMemoryBarrier barrier = {};
-    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
-    barrier.pNext = nullptr;
-    barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
-    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.buffer = *buffer;
-    barrier.offset = 0;
-    barrier.size = buffer->Size();
-    DeviceDispatch(vkCmdPipelineBarrier(
-        *commandBuffer,
-        srcStageMask, dstStageMask,
-        0,
-        0, nullptr,  // memory barriers
-        1, &barrier, // buffer memory barriers
-        0, nullptr   // image memory barriers
-    ));
+    barriers.AddBufferBarrier(buffer,
+        VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+        srcStageMask, dstStageMask);
+
+    // update next pass
+    currentPass = nextPass;
 }
 
 RenderGraph::Subpass::Subpass(RenderGraph::Pass* parent) : parent(parent) {
@@ -387,6 +336,12 @@ void RenderGraph::Pass::Execute(std::function<void(const RenderInfo &renderInfo)
     defaultSubpass->Execute(callback);
 }
 
+void RenderGraph::Pass::UseSecondaryCommandBuffers() {
+    assert(useDefaultSubpass && "call subpass's UseSecondaryCommandBuffers function when not using the default subpass");
+    assert(!compute && "ComputePass does not record into a render pass");
+    defaultSubpass->UseSecondaryCommandBuffers();
+}
+
 void RenderGraph::Pass::Execute(CommandBuffer* commandBuffer) {
     RenderFrame* renderFrame = graph->GetRenderFrame();
 
@@ -400,16 +355,36 @@ void RenderGraph::Pass::Execute(CommandBuffer* commandBuffer) {
         storage->Allocate(renderFrame);
     }
 
+    // transient images sharing memory with images from earlier passes
+    // must wait for those passes before their first use
+    bool aliasing = false;
+    for (auto& attachment : attachments) {
+        aliasing |= attachment.resource->aliased;
+        attachment.resource->aliased = false;
+    }
+    for (auto& storage : storages) {
+        aliasing |= storage->aliased;
+        storage->aliased = false;
+    }
+    BarrierBatch barriers;
+    if (aliasing) {
+        barriers.AddMemoryBarrier(VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+                                  VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+    }
+
     // wait for texture resources
     for (auto& texture : textures) {
-        texture->ShaderReadBarrier(commandBuffer, this);
+        texture->ShaderReadBarrier(barriers, this);
     }
 
     // wait for storage resources
     for (auto& storage : storages) {
-        storage->StorageBarrier(commandBuffer, this);
+        storage->StorageBarrier(barriers, this);
     }
 
+    // all barriers of this pass are recorded at once
+    barriers.Flush(commandBuffer);
+
     commandBuffer->BeginRegion(name);
     if (compute) {
         ExecuteCompute(commandBuffer);
@@ -452,10 +427,79 @@ void RenderGraph::Pass::ExecuteCompute(CommandBuffer* commandBuffer) {
 }
 
 void RenderGraph::Pass::ExecuteGraphics(CommandBuffer* commandBuffer) {
+    RenderFrame* renderFrame = graph->GetRenderFrame();
+    CompiledRenderGraph::Pass& compiledPass = graph->compiledGraph->passes[index];
+
+    // clear values could change every frame
+    std::vector<VkClearValue> clearValues;
+    for (const auto& attachment : attachments) {
+        if (attachment.clearValue.has_value()) {
+            clearValues.push_back(attachment.clearValue.value());
+        } else {
+            clearValues.push_back(ClearValue(1.0, 1.0, 1.0, 1.0));
+        }
+    }
+
+    // render pass and framebuffer are resolved on first execution,
+    // later executions only replay the layout changes
+    std::vector<SmartPtr<Subpass>> renderSubpasses;
+    if (useDefaultSubpass) {
+        renderSubpasses.push_back(defaultSubpass);
+    } else {
+        renderSubpasses = subpasses;
+    }
+    if (compiledPass.resolved) {
+        for (const auto& [resource, layout] : compiledPass.layouts) {
+            graph->resources[resource]->currentLayout = layout;
+        }
+    } else {
+        Resolve(compiledPass, renderSubpasses);
+    }
+
+    RenderPass* renderPass = compiledPass.renderPass;
+    Framebuffer* framebuffer = compiledPass.framebuffer;
+    VkExtent2D extent = compiledPass.extent;
+
+    // update render pass
+    graph->renderPass.reset(renderPass);
+
+    // begin render pass
+    VkRenderPassBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    beginInfo.framebuffer = *framebuffer;
+    beginInfo.renderPass = *renderPass;
+    beginInfo.renderArea.offset = { 0, 0 };
+    beginInfo.renderArea.extent = extent;
+    beginInfo.clearValueCount = clearValues.size();
+    beginInfo.pClearValues = clearValues.data();
+    beginInfo.pNext = nullptr;
+    commandBuffer->BeginRenderPass(beginInfo, renderSubpasses[0]->contents);
+
+    RenderInfo info;
+    info.renderGraph = graph;
+    info.renderFrame = renderFrame;
+    info.renderPass = renderPass;
+    info.commandBuffer = commandBuffer;
+    info.framebuffer = framebuffer;
+
+    // execute draw callback
+    for (uint32_t i = 0; i < renderSubpasses.size(); i++) {
+        info.subpass = i;
+        info.contents = renderSubpasses[i]->contents;
+        renderSubpasses[i]->callback(info);
+        if (i != renderSubpasses.size() - 1) {
+            commandBuffer->NextSubpass(renderSubpasses[i + 1]->contents);
+        }
+    }
+
+    // end render pass
+    commandBuffer->EndRenderPass();
+}
+
+void RenderGraph::Pass::Resolve(CompiledRenderGraph::Pass& compiledPass, const std::vector<SmartPtr<Subpass>>& renderSubpasses) {
     // prepare a render pass
     RenderPassDesc renderPassDesc;
     FramebufferDesc framebufferDesc;
-    std::vector<VkClearValue> clearValues;
 
     auto inferLoadOp = [](const ResourceMetadata &attachment) -> VkAttachmentLoadOp {
         if (attachment.clearValue.has_value()) {
@@ -503,21 +547,10 @@ void RenderGraph::Pass::ExecuteGraphics(CommandBuffer* commandBuffer) {
                 // input attachment does not need to be specified in the framebuffer creation
                 break;
         }
-        if (attachment.clearValue.has_value()) {
-            clearValues.push_back(attachment.clearValue.value());
-        } else {
-            clearValues.push_back(ClearValue(1.0, 1.0, 1.0, 1.0));
-        }
         attachmentIds.push_back(attachmentId);
     }
 
     // update render pass subpasses
-    std::vector<SmartPtr<Subpass>> renderSubpasses;
-    if (useDefaultSubpass) {
-        renderSubpasses.push_back(defaultSubpass);
-    } else {
-        renderSubpasses = subpasses;
-    }
     for (const auto& subpass : renderSubpasses) {
         SubpassDesc& subpassDesc = renderPassDesc.AddSubpass();
         for (uint32_t attachment : subpass->usedAsColorAttachment) {
@@ -579,39 +612,16 @@ void RenderGraph::Pass::ExecuteGraphics(CommandBuffer* commandBuffer) {
     RenderFrame* renderFrame = graph->GetRenderFrame();
     RenderPass* renderPass = renderFrame->RequestRenderPass(renderPassDesc);
     Framebuffer* framebuffer = renderFrame->RequestFramebuffer(framebufferDesc.SetRenderPass(renderPass));
-    Device* device = renderFrame->GetDevice();
-
-    // update render pass
-    graph->renderPass.reset(renderPass);
-
-    // begin render pass
-    VkRenderPassBeginInfo beginInfo = {};
-    beginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    beginInfo.framebuffer = *framebuffer;
-    beginInfo.renderPass = *renderPass;
-    beginInfo.renderArea.offset = { 0, 0 };
-    beginInfo.renderArea.extent = extent;
-    beginInfo.clearValueCount = clearValues.size();
-    beginInfo.pClearValues = clearValues.data();
-    beginInfo.pNext = nullptr;
-    commandBuffer->BeginRenderPass(beginInfo);
-
-    RenderInfo info;
-    info.renderGraph = graph;
-    info.renderFrame = renderFrame;
-    info.renderPass = renderPass;
-    info.commandBuffer = commandBuffer;
 
-    // execute draw callback
-    for (uint32_t i = 0; i < renderSubpasses.size(); i++) {
-        renderSubpasses[i]->callback(info);
-        if (i != renderSubpasses.size() - 1) {
-            commandBuffer->NextSubpass();
-        }
+    // keep resolved objects and attachment layouts after this pass
+    compiledPass.renderPass.reset(renderPass);
+    compiledPass.framebuffer.reset(framebuffer);
+    compiledPass.extent = extent;
+    compiledPass.layouts.clear();
+    for (const auto& attachment : attachments) {
+        compiledPass.layouts.push_back(std::make_pair(attachment.resource->index, attachment.resource->currentLayout));
     }
-
-    // end render pass
-    commandBuffer->EndRenderPass();
+    compiledPass.resolved = true;
 }
 
 RenderGraph::RenderGraph(RenderFrame *frame)
@@ -637,26 +647,31 @@ CommandBuffer* RenderGraph::GetCommandBuffer() const {
 
 RenderGraph::Pass* RenderGraph::CreateRenderPass(const std::string& name) {
     passes.push_back(SlimPtr<Pass>(name, this, false));
+    passes.back()->index = passes.size() - 1;
     return passes.back().get();
 }
 
 RenderGraph::Pass* RenderGraph::CreateComputePass(const std::string& name) {
     passes.push_back(SlimPtr<Pass>(name, this, true));
+    passes.back()->index = passes.size() - 1;
     return passes.back().get();
 }
 
 RenderGraph::Resource* RenderGraph::CreateResource(Buffer* buffer) {
     resources.push_back(SlimPtr<Resource>(buffer));
+    resources.back()->index = resources.size() - 1;
     return resources.back().get();
 }
 
 RenderGraph::Resource* RenderGraph::CreateResource(GPUImage* image) {
     resources.push_back(SlimPtr<Resource>(image));
+    resources.back()->index = resources.size() - 1;
     return resources.back().get();
 }
 
 RenderGraph::Resource* RenderGraph::CreateResource(VkExtent2D extent, VkFormat format, VkSampleCountFlagBits samples) {
     resources.push_back(SlimPtr<Resource>(format, extent, samples));
+    resources.back()->index = resources.size() - 1;
     return resources.back().get();
 }
 
@@ -672,6 +687,27 @@ void RenderGraph::Compile() {
         pass->visited = false;
     }
 
+    // reuse the compiled graph from a previous frame with identical structure
+    std::string key;
+    if (useCompilationCache) {
+        key = ComputeStructureKey();
+        compiledGraph.reset(renderFrame->FindCompiledRenderGraph(key));
+    }
+    if (compiledGraph) {
+        for (auto& pass : passes) {
+            pass->retained = compiledGraph->passes[pass->index].retained;
+        }
+        for (auto& resource : resources) {
+            if (GPUImage* image = compiledGraph->images[resource->index]) {
+                resource->image = Transient<GPUImage>(image);
+                resource->aliased = compiledGraph->aliased[resource->index];
+            }
+        }
+        transientMemoryStats = compiledGraph->transientMemoryStats;
+        compiled = true;
+        return;
+    }
+
     // for each retained resource, find a path back
     // there must be at least 1 resource that is retained (for back buffer)
     for (auto& resource : resources) {
@@ -680,10 +716,152 @@ void RenderGraph::Compile() {
         }
     }
 
+    // render passes and framebuffers are filled in on first execution
+    compiledGraph = SlimPtr<CompiledRenderGraph>();
+    compiledGraph->passes.resize(passes.size());
+    for (auto& pass : passes) {
+        compiledGraph->passes[pass->index].retained = pass->retained;
+    }
+
+    // order retained passes and assign them to queues
+    SchedulePasses();
+
+    // place transient images into shared memory
+    CompileTransientResources();
+
+    compiledGraph->images.resize(resources.size(), nullptr);
+    compiledGraph->aliased.resize(resources.size(), false);
+    for (auto& resource : resources) {
+        if (!resource->retained && resource->image.get()) {
+            compiledGraph->images[resource->index] = resource->image.get();
+            compiledGraph->aliased[resource->index] = resource->aliased;
+        }
+    }
+    compiledGraph->transientMemoryStats = transientMemoryStats;
+    if (useCompilationCache) {
+        renderFrame->AddCompiledRenderGraph(key, compiledGraph);
+    }
+
     // mark compilation completion
     compiled = true;
 }
 
+std::string RenderGraph::ComputeStructureKey() const {
+    StructuralKey key;
+    auto addIndices = [&key](const std::vector<uint32_t>& indices) {
+        key.Add(indices.size());
+        for (uint32_t index : indices) key.Add(index);
+    };
+    auto addPasses = [&key](const std::vector<Pass*>& list) {
+        key.Add(list.size());
+        for (const Pass* pass : list) key.Add(pass->index);
+    };
+
+    key.Add(resources.size(), passes.size(), useAsyncCompute);
+
+    // resources, retained images are part of the key (e.g. back buffer)
+    for (const auto& resource : resources) {
+        key.Add(resource->retained, resource->buffer, resource->image.get(),
+                resource->format, resource->extent.width, resource->extent.height,
+                resource->samples, resource->mipLevels, resource->usages);
+        addPasses(resource->readers);
+        addPasses(resource->writers);
+    }
+
+    // passes and how they use resources
+    for (const auto& pass : passes) {
+        key.Add(pass->name);
+        key.Add(pass->compute, pass->useDefaultSubpass);
+        key.Add(pass->attachments.size());
+        for (const auto& attachment : pass->attachments) {
+            key.Add(attachment.resource->index, attachment.type, attachment.clearValue.has_value());
+        }
+        key.Add(pass->textures.size());
+        for (const Resource* texture : pass->textures) key.Add(texture->index);
+        key.Add(pass->storages.size());
+        for (const Resource* storage : pass->storages) key.Add(storage->index);
+
+        std::vector<Subpass*> passSubpasses;
+        if (pass->useDefaultSubpass) {
+            passSubpasses.push_back(pass->defaultSubpass.get());
+        } else {
+            for (const auto& subpass : pass->subpasses) passSubpasses.push_back(subpass.get());
+        }
+        key.Add(passSubpasses.size());
+        for (const Subpass* subpass : passSubpasses) {
+            addIndices(subpass->usedAsColorAttachment);
+            addIndices(subpass->usedAsColorResolveAttachment);
+            addIndices(subpass->usedAsDepthAttachment);
+            addIndices(subpass->usedAsStencilAttachment);
+            addIndices(subpass->usedAsDepthStencilAttachment);
+            addIndices(subpass->usedAsPreserveAttachment);
+            addIndices(subpass->usedAsInputAttachment);
+            addIndices(subpass->usedAsTexture);
+            addIndices(subpass->usedAsStorageImage);
+            addIndices(subpass->usedAsStorageBuffer);
+        }
+    }
+    return key.Get();
+}
+
+void RenderGraph::CompileTransientResources() {
+    // live range of each transient image, in the order retained passes are executed
+    std::unordered_map<Resource*, std::pair<uint32_t, uint32_t>> lifetimes;
+    std::unordered_set<Resource*> asyncResources;
+    uint32_t order = 0;
+    for (const auto& batch : compiledGraph->batches) {
+        for (uint32_t index : batch.passes) {
+            Pass* pass = passes[index];
+            auto use = [&](Resource* resource) {
+                if (resource->retained || resource->buffer) return;
+                if (batch.async) asyncResources.insert(resource);
+                auto it = lifetimes.find(resource);
+                if (it == lifetimes.end()) {
+                    lifetimes.insert(std::make_pair(resource, std::make_pair(order, order)));
+                } else {
+                    it->second.second = order;
+                }
+            };
+            for (auto& attachment : pass->attachments) use(attachment.resource);
+            for (auto& texture : pass->textures) use(texture);
+            for (auto& storage : pass->storages) use(storage);
+            order++;
+        }
+    }
+
+    // passes on the compute queue overlap graphics passes in time,
+    // images they use live through the whole graph and never share memory
+    for (Resource* resource : asyncResources) {
+        lifetimes[resource] = std::make_pair(0u, order);
+    }
+
+    std::vector<Resource*> transients;
+    std::vector<TransientImageDesc> descs;
+    for (auto& resource : resources) {
+        auto it = lifetimes.find(resource.get());
+        if (it == lifetimes.end()) continue;
+        transients.push_back(resource.get());
+        descs.push_back(TransientImageDesc {
+            resource->format, resource->extent,
+            resource->mipLevels, 1,
+            resource->samples, resource->usages,
+            it->second.first, it->second.second
+        });
+    }
+
+    transientMemoryStats = TransientMemoryStats { };
+    if (descs.empty()) return;
+
+    // images with disjoint lifetimes are placed in the same memory
+    AliasedImages* aliasedImages = renderFrame->RequestAliasedImages(descs);
+    for (size_t i = 0; i < transients.size(); i++) {
+        transients[i]->image = Transient<GPUImage>(aliasedImages->images[i].get());
+        transients[i]->aliased = aliasedImages->aliased[i];
+    }
+    transientMemoryStats = aliasedImages->stats;
+    compiledGraph->aliasedImages = aliasedImages;
+}
+
 void RenderGraph::CompileResource(Resource* resource) {
     // passes that write to this resource must be retained
     for (Pass* pass : resource->writers) {
@@ -706,68 +884,202 @@ void RenderGraph::CompilePass(Pass* pass) {
 std::unordered_set<RenderGraph::Pass*> RenderGraph::FindPassDependencies(Pass* pass) {
     std::unordered_set<RenderGraph::Pass*> dependencies;
 
-    // textures
-    for (const auto& texture : pass->textures)
-        for (const auto& writerPass : texture->writers)
-            dependencies.insert(writerPass);
-
-    // storages
-    for (const auto& storage : pass->storages)
-        for (const auto& writerPass : storage->writers)
-            dependencies.insert(writerPass);
+    auto accesses = [](const std::vector<Pass*>& passes, Pass* pass) {
+        return std::find(passes.begin(), passes.end(), pass) != passes.end();
+    };
 
-    // remove self dependency
-    dependencies.erase(pass);
+    // resources used by this pass
+    std::unordered_set<Resource*> used;
+    for (const auto& attachment : pass->attachments) used.insert(attachment.resource);
+    for (const auto& texture : pass->textures) used.insert(texture);
+    for (const auto& storage : pass->storages) used.insert(storage);
+
+    // earlier retained passes in declaration order are dependencies when
+    // they write what this pass uses (read/write after write), or
+    // they read what this pass writes (write after read)
+    for (Resource* resource : used) {
+        bool writes = accesses(resource->writers, pass);
+        for (const auto& other : passes) {
+            if (other.get() == pass) break;
+            if (!other->retained) continue;
+            if (accesses(resource->writers, other) || (writes && accesses(resource->readers, other))) {
+                dependencies.insert(other.get());
+            }
+        }
+    }
 
     return dependencies;
 }
 
-void RenderGraph::Execute() {
-    if (!compiled) Compile();
+void RenderGraph::SchedulePasses() {
+    Device* device = renderFrame->GetDevice();
+    bool asyncCompute = useAsyncCompute && device->SupportsAsyncCompute();
 
-    // NOTE: Technically we will need a compute buffer for each compute pass.
-    // For dependency synchronization, any draw pass that needs input from compute pass
-    // would require separate command buffer;
+    // dependencies always point to earlier passes, so declaration order is a valid topological order
+    std::vector<std::vector<uint32_t>> dependencies(passes.size());
+    std::vector<std::vector<uint32_t>> dependents(passes.size());
+    std::vector<uint32_t> indegrees(passes.size(), 0);
+    std::vector<bool> async(passes.size(), false);
+    for (auto& pass : passes) {
+        if (!pass->retained) continue;
+        for (Pass* dependency : FindPassDependencies(pass)) {
+            dependencies[pass->index].push_back(dependency->index);
+            dependents[dependency->index].push_back(pass->index);
+        }
+        indegrees[pass->index] = dependencies[pass->index].size();
 
-    CommandBuffer* commandBuffer = renderFrame->RequestCommandBuffer(VK_QUEUE_GRAPHICS_BIT);
-    commandBuffer->Begin();
-    commandBuffer->BeginRegion("RenderGraph");
+        // compute passes only depending on other async compute passes could run on the compute queue,
+        // back buffer must stay on the graphics queue for presentation
+        bool independent = asyncCompute && pass->compute;
+        for (uint32_t dependency : dependencies[pass->index]) {
+            independent &= async[dependency];
+        }
+        for (const auto& storage : pass->storages) {
+            if (storage->image.get() && storage->image.get() == renderFrame->GetBackBuffer()) independent = false;
+        }
+        async[pass->index] = independent;
+    }
 
-    // execute
+    // topological sort, async compute passes are issued as early as possible
+    // so that their work could overlap graphics passes
+    std::vector<uint32_t> ready;
     for (auto& pass : passes) {
-        // don't execute culled passes
-        if (!pass->retained) return;
-
-        // execute the pass
-        pass->Execute(commandBuffer);
-        pass->visited = true;
+        if (pass->retained && indegrees[pass->index] == 0) ready.push_back(pass->index);
+    }
+    std::vector<uint32_t> order;
+    while (!ready.empty()) {
+        auto next = ready.begin();
+        for (auto it = ready.begin(); it != ready.end(); it++) {
+            bool earlier = (async[*it] != async[*next]) ? async[*it] : (*it < *next);
+            if (earlier) next = it;
+        }
+        uint32_t index = *next;
+        ready.erase(next);
+        order.push_back(index);
+        for (uint32_t dependent : dependents[index]) {
+            if (--indegrees[dependent] == 0) ready.push_back(dependent);
+        }
     }
 
-    // present src layout transition
-    GPUImage* backBuffer = renderFrame->GetBackBuffer();
-    if (backBuffer) {
-        VkImageLayout layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-        for (const auto& resource : resources) {
-            if (resource->image.get() == backBuffer) {
-                layout = resource->currentLayout;
-                break;
+    // split passes into batches whenever the queue changes
+    auto& batches = compiledGraph->batches;
+    std::vector<uint32_t> passBatch(passes.size(), 0);
+    batches.clear();
+    for (uint32_t index : order) {
+        if (batches.empty() || batches.back().async != async[index]) {
+            batches.push_back(CompiledRenderGraph::Batch { async[index] });
+        }
+        uint32_t batch = batches.size() - 1;
+        batches.back().passes.push_back(index);
+        passBatch[index] = batch;
+
+        // wait for dependencies on the other queue
+        auto& waits = batches.back().waits;
+        for (uint32_t dependency : dependencies[index]) {
+            uint32_t other = passBatch[dependency];
+            if (batches[other].async != batches[batch].async &&
+                std::find(waits.begin(), waits.end(), other) == waits.end()) {
+                waits.push_back(other);
             }
         }
-        backBuffer->layouts[0][0] = layout;
-        if (renderFrame->Presentable()) {
-            commandBuffer->PrepareForPresentSrc(backBuffer);
+    }
+
+    // graphics queue finishes the frame (present / fence), it waits for the last compute batch
+    int lastAsync = -1;
+    for (uint32_t i = 0; i < batches.size(); i++) {
+        if (batches[i].async) lastAsync = i;
+    }
+    if (batches.empty() || batches.back().async) {
+        batches.push_back(CompiledRenderGraph::Batch { false });
+    }
+    auto& waits = batches.back().waits;
+    if (lastAsync >= 0 && std::find(waits.begin(), waits.end(), uint32_t(lastAsync)) == waits.end()) {
+        waits.push_back(lastAsync);
+    }
+}
+
+void RenderGraph::Execute() {
+    if (!compiled) Compile();
+
+    const auto& batches = compiledGraph->batches;
+
+    // every batch is submitted to its queue as soon as it is recorded,
+    // semaphores between batches on different queues are known up front
+    std::vector<CommandBuffer*> commandBuffers;
+    for (const auto& batch : batches) {
+        commandBuffers.push_back(renderFrame->RequestCommandBuffer(batch.async ? VK_QUEUE_COMPUTE_BIT : VK_QUEUE_GRAPHICS_BIT));
+    }
+    for (uint32_t i = 0; i < batches.size(); i++) {
+        for (uint32_t wait : batches[i].waits) {
+            Semaphore* semaphore = renderFrame->RequestSemaphore();
+            commandBuffers[wait]->Signal(semaphore);
+            commandBuffers[i]->Wait(semaphore, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
         }
     }
 
-    // stop command buffer recording
-    commandBuffer->EndRegion();
-    commandBuffer->End();
+    // compute queue work must not start before graphics work from earlier frames is done,
+    // pending uploads are acquired by the first graphics submission, this one or the first batch
+    Device* device = renderFrame->GetDevice();
+    auto firstAsync = std::find_if(batches.begin(), batches.end(), [](const auto& batch) { return batch.async; });
+    if (firstAsync != batches.end()) {
+        Semaphore* semaphore = renderFrame->RequestSemaphore();
+        CommandBuffer* commandBuffer = renderFrame->RequestCommandBuffer(VK_QUEUE_GRAPHICS_BIT);
+        commandBuffer->Begin();
+        device->AcquireUploads(commandBuffer);
+        commandBuffer->End();
+        commandBuffer->Signal(semaphore);
+        commandBuffer->Submit();
+        commandBuffers[std::distance(batches.begin(), firstAsync)]->Wait(semaphore, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+    }
 
-    // submit the last graphics command buffer for presentation
-    if (renderFrame->Presentable()) {
-        renderFrame->Present(commandBuffer);
-    } else {
-        renderFrame->Draw(commandBuffer);
+    for (uint32_t i = 0; i < batches.size(); i++) {
+        CommandBuffer* commandBuffer = commandBuffers[i];
+        commandBuffer->Begin();
+        if (i == 0 && firstAsync == batches.end()) {
+            device->AcquireUploads(commandBuffer);
+        }
+        commandBuffer->BeginRegion("RenderGraph");
+
+        // execute, culled passes are never scheduled
+        for (uint32_t index : batches[i].passes) {
+            passes[index]->Execute(commandBuffer);
+            passes[index]->visited = true;
+        }
+
+        // intermediate batches
+        if (i != batches.size() - 1) {
+            commandBuffer->EndRegion();
+            commandBuffer->End();
+            commandBuffer->Submit();
+            continue;
+        }
+
+        // present src layout transition
+        GPUImage* backBuffer = renderFrame->GetBackBuffer();
+        if (backBuffer) {
+            VkImageLayout layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            for (const auto& resource : resources) {
+                if (resource->image.get() == backBuffer) {
+                    layout = resource->currentLayout;
+                    break;
+                }
+            }
+            backBuffer->layouts[0][0] = layout;
+            if (renderFrame->Presentable()) {
+                commandBuffer->PrepareForPresentSrc(backBuffer);
+            }
+        }
+
+        // stop command buffer recording
+        commandBuffer->EndRegion();
+        commandBuffer->End();
+
+        // submit the last graphics command buffer for presentation
+        if (renderFrame->Presentable()) {
+            renderFrame->Present(commandBuffer);
+        } else {
+            renderFrame->Draw(commandBuffer);
+        }
     }
 }
 
@@ -24,6 +24,45 @@ namespace slim {
         RenderFrame* renderFrame;
         RenderPass* renderPass;
         CommandBuffer* commandBuffer;
+
+        // for secondary command buffers inheriting the current subpass,
+        // with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS nothing is recorded inline
+        Framebuffer* framebuffer = nullptr;
+        uint32_t subpass = 0;
+        VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE;
+    };
+
+    // CompiledRenderGraph keeps everything a graph resolves during compilation and its first execution.
+    // Graphs with the same structure built later on the same frame reuse it and only re-run callbacks.
+    class CompiledRenderGraph final : public NotCopyable, public NotMovable, public ReferenceCountable {
+        friend class RenderGraph;
+    public:
+        struct Pass {
+            bool retained = false;
+            bool resolved = false;
+            SmartPtr<RenderPass> renderPass;
+            SmartPtr<Framebuffer> framebuffer;
+            VkExtent2D extent = {};
+            std::vector<std::pair<uint32_t, VkImageLayout>> layouts = {};   // attachment layouts after the pass
+        };
+
+        // consecutive passes submitted together to one queue
+        struct Batch {
+            bool async = false;                 // submitted to the compute queue
+            std::vector<uint32_t> passes = {};  // pass indices in execution order
+            std::vector<uint32_t> waits = {};   // earlier batches on the other queue to wait for
+        };
+
+        explicit CompiledRenderGraph() = default;
+        virtual ~CompiledRenderGraph() = default;
+
+    private:
+        std::vector<Pass> passes = {};
+        std::vector<Batch> batches = {};
+        std::vector<GPUImage*> images = {};     // transient image of each resource
+        std::vector<bool> aliased = {};
+        SmartPtr<AliasedImages> aliasedImages = nullptr;   // keeps the transient images and their memory alive
+        TransientMemoryStats transientMemoryStats = {};
     };
 
     class RenderGraph final : public NotCopyable, public NotMovable, public ReferenceCountable {
@@ -88,10 +127,10 @@ namespace slim {
             void Allocate(RenderFrame* renderFrame);
             void Deallocate();
 
-            void ShaderReadBarrier(CommandBuffer* commandBuffer, Pass* nextPass);
-            void StorageBarrier(CommandBuffer* commandBuffer, Pass* nextPass);
-            void StorageImageBarrier(CommandBuffer* commandBuffer, Pass* nextPass);
-            void StorageBufferBarrier(CommandBuffer* commandBuffer, Pass* nextPass);
+            void ShaderReadBarrier(BarrierBatch& barriers, Pass* nextPass);
+            void StorageBarrier(BarrierBatch& barriers, Pass* nextPass);
+            void StorageImageBarrier(BarrierBatch& barriers, Pass* nextPass);
+            void StorageBufferBarrier(BarrierBatch& barriers, Pass* nextPass);
 
         private:
             // image information
@@ -113,6 +152,12 @@ namespace slim {
             Pass* currentPass = nullptr;
             VkImageLayout currentLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
+            // index in graph
+            uint32_t index = 0;
+
+            // memory is shared with an image used by earlier passes
+            bool aliased = false;
+
             // counter information
             bool retained = false;
             int rdCount = 0;
@@ -157,9 +202,13 @@ namespace slim {
 
             void Execute(std::function<void(const RenderInfo &renderInfo)> callback);
 
+            // callback records into secondary command buffers only (e.g. parallel MeshRenderer)
+            void UseSecondaryCommandBuffers() { contents = VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS; }
+
         private:
             Pass* parent;
             std::function<void(const RenderInfo &renderTools)> callback;
+            VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE;
 
             // attachments
             std::vector<uint32_t> usedAsColorAttachment = {};
@@ -215,12 +264,16 @@ namespace slim {
 
             void Execute(std::function<void(const RenderInfo& renderInfo)> callback);
 
+            // callback records into secondary command buffers only (e.g. parallel MeshRenderer)
+            void UseSecondaryCommandBuffers();
+
             bool IsCompute() const { return compute; }
 
         private:
             void Execute(CommandBuffer* commandBuffer);
             void ExecuteGraphics(CommandBuffer* commandBuffer);
             void ExecuteCompute(CommandBuffer* commandBuffer);
+            void Resolve(CompiledRenderGraph::Pass& compiledPass, const std::vector<SmartPtr<Subpass>>& renderSubpasses);
 
             uint32_t AddAttachment(const RenderGraph::ResourceMetadata& metadata);
             uint32_t AddTexture(Resource* resource);
@@ -229,6 +282,7 @@ namespace slim {
         private:
             std::string name;
             RenderGraph* graph;
+            uint32_t index = 0;
 
             bool compute = false;
             SmartPtr<Semaphore> signalSemaphore = nullptr;
@@ -274,9 +328,21 @@ namespace slim {
         RenderFrame*           GetRenderFrame() const;
         CommandBuffer*         GetCommandBuffer() const;
 
+        // peak transient image memory with and without aliasing, available after compilation
+        const TransientMemoryStats& GetTransientMemoryStats() const { return transientMemoryStats; }
+
+        // always compile from scratch instead of reusing the frame's compiled graph
+        void                   DisableCompilationCache() { useCompilationCache = false; }
+
+        // run compute passes on the graphics queue even when the device has a separate compute queue
+        void                   DisableAsyncCompute() { useAsyncCompute = false; }
+
     private:
         void                   CompilePass(Pass* pass);
         void                   CompileResource(Resource* resource);
+        void                   CompileTransientResources();
+        void                   SchedulePasses();
+        std::string            ComputeStructureKey() const;
         std::unordered_set<Pass*> FindPassDependencies(Pass* pass);
 
     private:
@@ -285,6 +351,10 @@ namespace slim {
         mutable SmartPtr<CommandBuffer> commandBuffer;
         std::vector<SmartPtr<RenderGraph::Pass>> passes = {};
         std::vector<SmartPtr<RenderGraph::Resource>> resources = {};
+        TransientMemoryStats transientMemoryStats = {};
+        SmartPtr<CompiledRenderGraph> compiledGraph = nullptr;
+        bool useCompilationCache = true;
+        bool useAsyncCompute = true;
         bool compiled = false;
     };
 
@@ -23,6 +23,7 @@ namespace slim {
         FrontToback,
         BackToFront,
         Unordered,
+        ByState,        // group drawables sharing pipeline, material and mesh, front to back within a group
         // --- name alias
         Opaque       = FrontToback,
         Transparent  = BackToFront,
@@ -1,8 +1,119 @@
-#include <deque>
+#include <map>
+#include <tuple>
+#include <cstddef>
+#include <stdexcept>
+#include <algorithm>
 #include "utility/scenegraph.h"
 
 using namespace slim;
 
+namespace {
+
+    // every node starts with a header, which finds its pool and slot when it is deleted
+    struct alignas(std::max_align_t) NodeHeader {
+        scene::NodePool* pool;
+        uint32_t handle;
+        uint32_t live;
+    };
+
+    constexpr size_t NODE_SLOT_SIZE = sizeof(NodeHeader)
+                                    + (sizeof(scene::Node) + alignof(std::max_align_t) - 1)
+                                    / alignof(std::max_align_t) * alignof(std::max_align_t);
+
+    NodeHeader* GetHeader(void* memory) {
+        return reinterpret_cast<NodeHeader*>(memory) - 1;
+    }
+
+} // end of anonymous namespace
+
+void* scene::NodePool::Allocate(size_t size) {
+    if (size > NODE_SLOT_SIZE - sizeof(NodeHeader)) {
+        throw std::runtime_error("[NodePool] allocation is larger than a node slot");
+    }
+
+    NodeHeader* header;
+    if (!freeSlots.empty()) {
+        // a freed slot keeps its handle, with the generation advanced by Free
+        header = reinterpret_cast<NodeHeader*>(Slot(freeSlots.back()));
+        freeSlots.pop_back();
+    } else {
+        // the last slot is never used, so that no handle equals INVALID_HANDLE
+        if (slotCount == SLOT_MASK) {
+            throw std::runtime_error("[NodePool] too many nodes");
+        }
+        if (slotCount % CHUNK_SIZE == 0) {
+            chunks.emplace_back(new uint8_t[CHUNK_SIZE * NODE_SLOT_SIZE]);
+        }
+        header = reinterpret_cast<NodeHeader*>(Slot(slotCount));
+        header->handle = slotCount++;
+    }
+
+    header->pool = this;
+    header->live = 1;
+    RefCount().Increment();
+    return header + 1;
+}
+
+void scene::NodePool::Free(void* memory) {
+    NodeHeader* header = GetHeader(memory);
+    uint32_t slot = header->handle & SLOT_MASK;
+    uint32_t generation = (header->handle >> SLOT_BITS) + 1;
+    header->handle = (generation << SLOT_BITS) | slot;
+    header->live = 0;
+    freeSlots.push_back(slot);
+
+    // the last node of a pool without a builder takes the pool with it
+    if (RefCount().Decrement() == 0) {
+        delete this;
+    }
+}
+
+scene::Node* scene::NodePool::Get(uint32_t handle) const {
+    uint32_t slot = handle & SLOT_MASK;
+    if (slot >= slotCount) {
+        return nullptr;
+    }
+    NodeHeader* header = reinterpret_cast<NodeHeader*>(Slot(slot));
+    return header->live && header->handle == handle ? reinterpret_cast<Node*>(header + 1) : nullptr;
+}
+
+uint32_t scene::NodePool::GetHandle(const Node* node) {
+    const NodeHeader* header = reinterpret_cast<const NodeHeader*>(node) - 1;
+    return header->pool ? header->handle : INVALID_HANDLE;
+}
+
+uint8_t* scene::NodePool::Slot(uint32_t slot) const {
+    return chunks[slot / CHUNK_SIZE].get() + (slot % CHUNK_SIZE) * NODE_SLOT_SIZE;
+}
+
+void* scene::Node::operator new(size_t size) {
+    NodeHeader* header = reinterpret_cast<NodeHeader*>(::operator new(sizeof(NodeHeader) + size));
+    header->pool = nullptr;
+    header->handle = NodePool::INVALID_HANDLE;
+    header->live = 1;
+    return header + 1;
+}
+
+void* scene::Node::operator new(size_t size, NodePool* pool) {
+    return pool ? pool->Allocate(size) : operator new(size);
+}
+
+void scene::Node::operator delete(void* memory) {
+    if (!memory) {
+        return;
+    }
+    NodeHeader* header = GetHeader(memory);
+    if (header->pool) {
+        header->pool->Free(memory);
+    } else {
+        ::operator delete(header);
+    }
+}
+
+void scene::Node::operator delete(void* memory, NodePool*) {
+    operator delete(memory);
+}
+
 scene::Node::Node(Node* parent) : name(), parent(parent) {
     MoveTo(parent);
 }
@@ -12,6 +123,20 @@ scene::Node::Node(const std::string& name, Node* parent)
     MoveTo(parent);
 }
 
+scene::Node::~Node() {
+    if (hierarchy) {
+        hierarchy->Remove(this);
+    }
+    MoveTo(nullptr);
+    for (Node* child = firstChild; child; ) {
+        Node* next = child->nextSibling;
+        child->parent = nullptr;
+        child->prevSibling = nullptr;
+        child->nextSibling = nullptr;
+        child = next;
+    }
+}
+
 void scene::Node::AddChild(Node* child) {
     child->MoveTo(this);
 }
@@ -24,14 +149,26 @@ void scene::Node::MoveTo(Node* parent) {
     }
 
     // check if this node has a parent
-    // remove this node from parent
+    // unlink this node from its siblings
     if (this->parent) {
-        this->parent->children.remove(this);
+        (prevSibling ? prevSibling->nextSibling : this->parent->firstChild) = nextSibling;
+        (nextSibling ? nextSibling->prevSibling : this->parent->lastChild) = prevSibling;
+        prevSibling = nullptr;
+        nextSibling = nullptr;
+        if (this->parent->hierarchy) this->parent->hierarchy->Invalidate();
     }
 
-    // add to parent
+    // append to parent
     this->parent = parent;
-    parent->children.push_back(this);
+    if (parent) {
+        prevSibling = parent->lastChild;
+        (prevSibling ? prevSibling->nextSibling : parent->firstChild) = this;
+        parent->lastChild = this;
+        if (parent->hierarchy) parent->hierarchy->Invalidate();
+    }
+    if (hierarchy) {
+        hierarchy->Invalidate();
+    }
 }
 
 void scene::Node::SetDraw(Mesh* mesh, Material* material) {
@@ -46,22 +183,27 @@ void scene::Node::AddDraw(Mesh* mesh, Material* material) {
 // transform
 void scene::Node::Scale(float x, float y, float z) {
     transform.Scale(x, y, z);
+    if (hierarchy) hierarchy->MarkDirty(this);
 }
 
 void scene::Node::Rotate(const glm::vec3& axis, float radians) {
     transform.Rotate(axis, radians);
+    if (hierarchy) hierarchy->MarkDirty(this);
 }
 
 void scene::Node::Rotate(float x, float y, float z, float w) {
     transform.Rotate(x, y, z, w);
+    if (hierarchy) hierarchy->MarkDirty(this);
 }
 
 void scene::Node::Translate(float x, float y, float z) {
     transform.Translate(x, y, z);
+    if (hierarchy) hierarchy->MarkDirty(this);
 }
 
 void scene::Node::SetTransform(const Transform& transform) {
     this->transform = transform;
+    if (hierarchy) hierarchy->MarkDirty(this);
 }
 
 VkTransformMatrixKHR scene::Node::GetVkTransformMatrix() const {
@@ -76,21 +218,13 @@ VkTransformMatrixKHR scene::Node::GetVkTransformMatrix() const {
     return matrix;
 }
 
-void scene::Node::ForEach(const std::function<bool(scene::Node*)> &callback) {
-    std::deque<scene::Node*> nodes = { this };
-    while (!nodes.empty()) {
-        scene::Node* node = nodes.front();
-        // check callback to determine if we need to continue traversal
-        if (callback(node)) {
-            for (scene::Node* child : node->children) {
-                nodes.push_back(child);
-            }
-        }
-        nodes.pop_front();
+void scene::Node::ApplyTransform() {
+    if (hierarchy) {
+        hierarchy->Update();
+        return;
     }
-}
 
-void scene::Node::ApplyTransform() {
+    // nodes outside of a hierarchy update their subtree on every call
     ForEach([](scene::Node* node) {
         if (node->parent) {
             node->transform.ApplyTransform(node->parent->transform);
@@ -102,6 +236,13 @@ void scene::Node::ApplyTransform() {
 }
 
 scene::Builder::Builder(Device* device) : device(device) {
+    nodePool = SlimPtr<NodePool>();
+    hierarchy = SlimPtr<TransformHierarchy>();
+}
+
+scene::Builder::~Builder() {
+    // nodes held elsewhere may outlive the builder
+    hierarchy->Clear();
 }
 
 void scene::Builder::Build() {
@@ -109,20 +250,41 @@ void scene::Builder::Build() {
     VkBufferUsageFlags bufferUsage = GetCommonBufferUsages();
     VmaMemoryUsage memoryUsage = GetCommonMemoryUsages();
 
-    // build mesh data
-    device->Execute([&](CommandBuffer* commandBuffer) {
-        for (auto& mesh : meshes) {
-            BuildVertexBuffer(commandBuffer, mesh, bufferUsage, memoryUsage);
-            BuildIndexBuffer(commandBuffer, mesh, bufferUsage, memoryUsage);
-            #ifndef NDEBUG
-            mesh->built = true;
-            #endif
+    // all meshes share a few large vertex and index buffers
+    if (!vertexArena) {
+        vertexArena = SlimPtr<GeometryArena>(device, bufferUsage | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, memoryUsage, "Scene Vertex Arena");
+        indexArena = SlimPtr<GeometryArena>(device, bufferUsage | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, memoryUsage, "Scene Index Arena");
+    }
+
+    // build mesh data, copies are batched on the transfer queue,
+    // meshes uploaded by a previous build are kept where they are
+    if (!uploader) {
+        uploader = SlimPtr<UploadManager>(device);
+    }
+    for (auto& mesh : meshes) {
+        if (mesh->vertexAllocation.Valid()) continue;
+        if (optimizeMeshes) {
+            optimizerStats += MeshOptimizer::Optimize(mesh, overdrawThreshold);
         }
-        BuildAabbsBuffer(commandBuffer, bufferUsage, memoryUsage);
-    });
+        if (buildMeshlets) {
+            MeshletBuilder::Build(mesh, maxMeshletVertices, maxMeshletTriangles);
+        }
+        if (generateLods) {
+            MeshSimplifier::GenerateLods(mesh, maxLods, MeshSimplifier::REDUCTION, maxLodError);
+        }
+        BuildVertexBuffer(uploader, mesh);
+        BuildIndexBuffer(uploader, mesh);
+        #ifndef NDEBUG
+        mesh->built = true;
+        #endif
+    }
+    BuildAabbsBuffer(uploader, bufferUsage, memoryUsage);
+    BuildInstanceBuffer(uploader);
+    uploadTicket = uploader->Submit();
 
     // build acceleration structure if needed to
     if (accelBuilder.get()) {
+        uploader->Flush();
         aabbsIndex = 0;
 
         // add mesh-based blas
@@ -150,15 +312,88 @@ void scene::Builder::Build() {
     }
 }
 
+void scene::Builder::Wait() const {
+    if (uploader) {
+        uploader->Wait(uploadTicket);
+    }
+}
+
 void scene::Builder::Clear() {
+    hierarchy->Clear();
     nodes.clear();
     meshes.clear();
+    vertexArena.reset(nullptr);
+    indexArena.reset(nullptr);
+    instanceNodes.clear();
+    instances.clear();
+    instanceBatches.clear();
+    instanceBuffer.reset(nullptr);
+    batchBuffer.reset(nullptr);
+    meshletBuffer.reset(nullptr);
+    clusterBuffer.reset(nullptr);
+    clusterCount = 0;
+    optimizerStats = {};
+}
+
+void scene::Builder::RemoveMesh(Mesh* mesh) {
+    auto it = std::find_if(meshes.begin(), meshes.end(), [=](const SmartPtr<Mesh>& m) { return m.get() == mesh; });
+    if (it == meshes.end()) return;
+
+    // return the mesh storage to the arenas, so that meshes built later can reuse it
+    if (vertexArena) {
+        vertexArena->Free(mesh->vertexAllocation);
+        indexArena->Free(mesh->indexAllocation);
+    }
+    mesh->vertexAllocation = {};
+    mesh->indexAllocation = {};
+    mesh->vertexBuffer.reset(nullptr);
+    mesh->indexBuffer.reset(nullptr);
+    mesh->vertexBuffers.clear();
+    mesh->vertexOffsets.clear();
+    mesh->bindOffsets.clear();
+    #ifndef NDEBUG
+    mesh->built = false;
+    #endif
+    meshes.erase(it);
+}
+
+void scene::Builder::UpdateInstances(CommandBuffer* commandBuffer) {
+    if (instances.empty()) return;
+
+    for (size_t i = 0; i < instances.size(); i++) {
+        instances[i].model = instanceNodes[i]->GetTransform().LocalToWorld();
+    }
+
+    // the instance buffer is shared by all frames in flight,
+    // culling and draws of earlier frames must be done reading it before it is overwritten
+    commandBuffer->PrepareForBuffer(instanceBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                                    VK_PIPELINE_STAGE_TRANSFER_BIT);
+    commandBuffer->CopyDataToBuffer(instances, instanceBuffer);
+    commandBuffer->PrepareForBuffer(instanceBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
 }
 
 void scene::Builder::EnableRayTracing() {
     accelBuilder = SlimPtr<accel::Builder>(device);
 }
 
+void scene::Builder::EnableMeshOptimization(float overdrawThreshold) {
+    this->optimizeMeshes = true;
+    this->overdrawThreshold = overdrawThreshold;
+}
+
+void scene::Builder::EnableLodGeneration(uint32_t maxLods, float maxError) {
+    this->generateLods = true;
+    this->maxLods = maxLods;
+    this->maxLodError = maxError;
+}
+
+void scene::Builder::EnableMeshlets(uint32_t maxVertices, uint32_t maxTriangles) {
+    this->buildMeshlets = true;
+    this->maxMeshletVertices = maxVertices;
+    this->maxMeshletTriangles = maxTriangles;
+}
+
 void scene::Builder::AddAABB(const BoundingBox& aaBox) {
     AddAABBs(aaBox, 1);
 }
@@ -205,37 +440,47 @@ VmaMemoryUsage scene::Builder::GetCommonMemoryUsages() const {
     return VMA_MEMORY_USAGE_GPU_ONLY;
 }
 
-void scene::Builder::BuildIndexBuffer(CommandBuffer* commandBuffer, Mesh* mesh, VkBufferUsageFlags bufferUsage, VmaMemoryUsage memoryUsage) {
-    // create and update index buffer
-    if (mesh->indexCount > 0) {
-        mesh->indexOffset = 0;
-        mesh->indexBuffer = SlimPtr<Buffer>(device, mesh->indexData.size(),
-                                            bufferUsage | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-                                            memoryUsage);
-        mesh->indexBuffer->SetName("Scene Mesh Index Buffer");
-        commandBuffer->CopyDataToBuffer(mesh->indexData, mesh->indexBuffer, mesh->indexOffset);
-    }
+void scene::Builder::BuildIndexBuffer(UploadManager* uploader, Mesh* mesh) {
+    if (mesh->indexCount == 0) return;
+
+    // sub-allocate index data, draws address it with first index from the start of the chunk
+    uint64_t indexSize = mesh->indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+    mesh->indexAllocation = indexArena->Allocate(mesh->indexData.size(), sizeof(uint32_t));
+    mesh->indexBuffer = mesh->indexAllocation.buffer;
+    mesh->indexOffset = mesh->indexAllocation.offset;
+    mesh->firstIndex = static_cast<uint32_t>(mesh->indexOffset / indexSize);
+    uploader->Upload(mesh->indexBuffer, mesh->indexData, mesh->indexOffset);
 }
 
-void scene::Builder::BuildVertexBuffer(CommandBuffer* commandBuffer, Mesh* mesh, VkBufferUsageFlags bufferUsage, VmaMemoryUsage memoryUsage) {
-    // create and update vertex buffer
+void scene::Builder::BuildVertexBuffer(UploadManager* uploader, Mesh* mesh) {
     uint64_t vertexBufferSize = 0;
-    uint64_t vertexBufferOffset = 0;
     for (const auto& attrib : mesh->vertexData) {
         vertexBufferSize += attrib.size();
     }
-    mesh->vertexBuffer = SlimPtr<Buffer>(device, vertexBufferSize,
-                                         bufferUsage | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                                         memoryUsage);
-    mesh->vertexBuffer->SetName("Scene Mesh Vertex Buffer");
+    if (vertexBufferSize == 0) return;
+
+    // a single vertex stream is aligned to its stride, so that it can be drawn with a base vertex
+    // from the start of the chunk, multiple streams are bound at their own offsets instead
+    bool shared = mesh->vertexData.size() == 1 && mesh->vertexStride > 0;
+    uint64_t alignment = shared ? mesh->vertexStride : 16;
+    mesh->vertexAllocation = vertexArena->Allocate(vertexBufferSize, alignment);
+    mesh->vertexBuffer = mesh->vertexAllocation.buffer;
+    mesh->baseVertex = shared ? static_cast<int32_t>(mesh->vertexAllocation.offset / mesh->vertexStride) : 0;
+
+    mesh->vertexBuffers.clear();
+    mesh->vertexOffsets.clear();
+    mesh->bindOffsets.clear();
+    uint64_t vertexBufferOffset = mesh->vertexAllocation.offset;
     for (const auto& attrib : mesh->vertexData) {
         mesh->vertexBuffers.push_back(*mesh->vertexBuffer);
         mesh->vertexOffsets.push_back(vertexBufferOffset);
-        commandBuffer->CopyDataToBuffer(attrib, mesh->vertexBuffer, vertexBufferOffset);
+        mesh->bindOffsets.push_back(shared ? 0 : vertexBufferOffset);
+        uploader->Upload(mesh->vertexBuffer, attrib, vertexBufferOffset);
+        vertexBufferOffset += attrib.size();
     }
 }
 
-void scene::Builder::BuildAabbsBuffer(CommandBuffer* commandBuffer,
+void scene::Builder::BuildAabbsBuffer(UploadManager* uploader,
                                       VkBufferUsageFlags bufferUsage,
                                       VmaMemoryUsage memoryUsage) {
     // prepare aabbs buffer
@@ -254,5 +499,113 @@ void scene::Builder::BuildAabbsBuffer(CommandBuffer* commandBuffer,
 
     // copy bounding boxes to dest type
     std::vector<VkAabbPositionsKHR> data(aabbs.size());
-    commandBuffer->CopyDataToBuffer(aabbs, aabbsBuffer);
+    uploader->Upload(aabbsBuffer, aabbs);
+}
+
+void scene::Builder::BuildInstanceBuffer(UploadManager* uploader) {
+    instanceNodes.clear();
+    instances.clear();
+    instanceBatches.clear();
+    clusterCount = 0;
+
+    // group instances by material and geometry buffers, batches are kept in order of first appearance,
+    // meshes with a single vertex stream in the same arena chunks share a batch, others get their own
+    using BatchKey = std::tuple<Material*, Mesh*, Buffer*, Buffer*, VkIndexType>;
+    std::vector<std::vector<std::pair<Node*, Mesh*>>> batchNodes;
+    std::map<BatchKey, uint32_t> batchIndices;
+    for (auto& node : nodes) {
+        for (auto& [mesh, material] : *node) {
+            if (mesh == nullptr || material == nullptr) continue;
+            bool shared = mesh->bindOffsets.size() == 1 && mesh->bindOffsets[0] == 0;
+            auto key = BatchKey { material, shared ? nullptr : mesh, mesh->vertexBuffer, mesh->indexBuffer,
+                                  mesh->indexCount > 0 ? mesh->indexType : VK_INDEX_TYPE_NONE_KHR };
+            auto it = batchIndices.find(key);
+            if (it == batchIndices.end()) {
+                it = batchIndices.insert(std::make_pair(key, static_cast<uint32_t>(instanceBatches.size()))).first;
+                instanceBatches.push_back(InstanceBatch { mesh, material, 0, 0, 0, 0 });
+                batchNodes.push_back({ });
+            }
+            batchNodes[it->second].push_back(std::make_pair(node, mesh));
+        }
+    }
+    if (instanceBatches.empty()) return;
+
+    // meshlets of each mesh are added once, meshes without meshlets are a single meshlet that is never culled
+    std::vector<MeshletData> meshlets;
+    std::map<Mesh*, std::pair<uint32_t, uint32_t>> meshletRanges;
+    auto addMeshlets = [&](Mesh* mesh) {
+        auto it = meshletRanges.find(mesh);
+        if (it != meshletRanges.end()) {
+            return it->second;
+        }
+        uint32_t first = static_cast<uint32_t>(meshlets.size());
+        if (mesh->indexCount == 0) {
+            meshlets.push_back(MeshletData { glm::vec4(0.0f, 0.0f, 0.0f, -1.0f), glm::vec4(0.0f, 0.0f, 0.0f, 1.0f),
+                                             static_cast<uint32_t>(mesh->baseVertex), static_cast<uint32_t>(mesh->vertexCount), 0, 0 });
+        } else if (mesh->meshlets.empty()) {
+            meshlets.push_back(MeshletData { glm::vec4(0.0f, 0.0f, 0.0f, -1.0f), glm::vec4(0.0f, 0.0f, 0.0f, 1.0f),
+                                             mesh->firstIndex, static_cast<uint32_t>(mesh->indexCount), mesh->baseVertex, 0 });
+        } else {
+            for (const Meshlet& meshlet : mesh->meshlets) {
+                meshlets.push_back(MeshletData { meshlet.sphere, meshlet.cone,
+                                                 mesh->firstIndex + meshlet.firstIndex, meshlet.indexCount, mesh->baseVertex, 0 });
+            }
+        }
+        auto range = std::make_pair(first, static_cast<uint32_t>(meshlets.size()) - first);
+        meshletRanges.insert(std::make_pair(mesh, range));
+        return range;
+    };
+
+    // lay out instances batch by batch, and the clusters of their meshlets in the same order
+    std::vector<DrawBatch> batches;
+    std::vector<ClusterData> clusters;
+    for (uint32_t b = 0; b < instanceBatches.size(); b++) {
+        InstanceBatch& batch = instanceBatches[b];
+        batch.firstInstance = static_cast<uint32_t>(instances.size());
+        batch.instanceCount = static_cast<uint32_t>(batchNodes[b].size());
+        batch.firstCluster = static_cast<uint32_t>(clusters.size());
+
+        bool indexed = batch.mesh->indexCount > 0;
+        for (auto& [node, mesh] : batchNodes[b]) {
+            InstanceData instance = {};
+            instance.model = node->GetTransform().LocalToWorld();
+            instance.boundsMin = glm::vec4(mesh->aabb.Min(), 0.0f);
+            instance.boundsMax = glm::vec4(mesh->aabb.Max(), 0.0f);
+            instance.batch = b;
+            instance.count = static_cast<uint32_t>(indexed ? mesh->indexCount : mesh->vertexCount);
+            instance.first = indexed ? mesh->firstIndex : static_cast<uint32_t>(mesh->baseVertex);
+            instance.vertexOffset = indexed ? mesh->baseVertex : 0;
+
+            auto [firstMeshlet, meshletCount] = addMeshlets(mesh);
+            for (uint32_t m = 0; m < meshletCount; m++) {
+                clusters.push_back(ClusterData { static_cast<uint32_t>(instances.size()), firstMeshlet + m });
+            }
+
+            instances.push_back(instance);
+            instanceNodes.push_back(node);
+        }
+        batch.clusterCount = static_cast<uint32_t>(clusters.size()) - batch.firstCluster;
+        batches.push_back(DrawBatch { batch.firstInstance, batch.instanceCount, indexed ? 1u : 0u, batch.firstCluster });
+    }
+    clusterCount = static_cast<uint32_t>(clusters.size());
+
+    instanceBuffer = SlimPtr<Buffer>(device, instances.size() * sizeof(InstanceData),
+                                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+    instanceBuffer->SetName("Scene Instance Buffer");
+    uploader->Upload(instanceBuffer, instances);
+
+    batchBuffer = SlimPtr<Buffer>(device, batches.size() * sizeof(DrawBatch),
+                                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+    batchBuffer->SetName("Scene Batch Buffer");
+    uploader->Upload(batchBuffer, batches);
+
+    meshletBuffer = SlimPtr<Buffer>(device, meshlets.size() * sizeof(MeshletData),
+                                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+    meshletBuffer->SetName("Scene Meshlet Buffer");
+    uploader->Upload(meshletBuffer, meshlets);
+
+    clusterBuffer = SlimPtr<Buffer>(device, clusters.size() * sizeof(ClusterData),
+                                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+    clusterBuffer->SetName("Scene Cluster Buffer");
+    uploader->Upload(clusterBuffer, clusters);
 }
@@ -1,27 +1,94 @@
 #ifndef SLIM_UTILITY_SCENEGRAPH_H
 #define SLIM_UTILITY_SCENEGRAPH_H
 
-#include <list>
+#include <memory>
 #include <vector>
+#include "core/upload.h"
 #include "core/commands.h"
 #include "utility/mesh.h"
+#include "utility/meshopt.h"
+#include "utility/simplify.h"
+#include "utility/meshlet.h"
 #include "utility/material.h"
 #include "utility/interface.h"
 #include "utility/transform.h"
+#include "utility/hierarchy.h"
 #include "utility/boundingbox.h"
 #include "utility/rtbuilder.h"
 
 namespace slim::scene {
 
+    class Node;
+
+    // NodePool allocates nodes in chunks, so that nodes created together are close in memory and never move.
+    // Handles are slot indices, stable for the lifetime of a node. Every live node holds a reference on its
+    // pool, so the pool outlives its builder while nodes are still referenced elsewhere.
+    class NodePool : public NotCopyable, public NotMovable, public ReferenceCountable {
+    public:
+        constexpr static uint32_t CHUNK_SIZE = 1024;
+        constexpr static uint32_t INVALID_HANDLE = ~0u;
+
+        // handles keep the slot in the low bits and the generation of the slot in the high bits,
+        // so that handles of destroyed nodes do not find the nodes later allocated in the same slot
+        constexpr static uint32_t SLOT_BITS = 24;
+        constexpr static uint32_t SLOT_MASK = (1u << SLOT_BITS) - 1;
+
+        explicit NodePool() = default;
+        virtual ~NodePool() = default;
+
+        void* Allocate(size_t size);
+        void Free(void* memory);
+
+        // nullptr for handles of destroyed nodes, even once their slot is reused
+        Node* Get(uint32_t handle) const;
+
+        // slot and generation of a node, INVALID_HANDLE for nodes allocated on the heap
+        static uint32_t GetHandle(const Node* node);
+
+        size_t GetChunkCount() const { return chunks.size(); }
+
+    private:
+        uint8_t* Slot(uint32_t slot) const;
+
+        std::vector<std::unique_ptr<uint8_t[]>> chunks = {};
+        std::vector<uint32_t> freeSlots = {};
+        uint32_t slotCount = 0;
+    };
+
     // node
     // manages one or multiple instances with hierarchy
     class Node : public NotCopyable, public NotMovable, public ReferenceCountable {
         friend class Builder;
+        friend class NodePool;
+        friend class TransformHierarchy;
 
     public:
+        // children are linked through their siblings
+        class Children {
+        public:
+            struct Iterator {
+                Node* node;
+                Node* operator*() const { return node; }
+                Iterator& operator++() { node = node->nextSibling; return *this; }
+                bool operator!=(const Iterator& other) const { return node != other.node; }
+            };
+            explicit Children(Node* first) : first(first) { }
+            Iterator begin() const { return Iterator { first }; }
+            Iterator end() const { return Iterator { nullptr }; }
+            bool empty() const { return first == nullptr; }
+        private:
+            Node* first;
+        };
 
         explicit Node(Node* parent = nullptr);
         explicit Node(const std::string& name, Node* parent = nullptr);
+        virtual ~Node();
+
+        // nodes created by scene::Builder live in its NodePool, others on the heap
+        static void* operator new(size_t size);
+        static void* operator new(size_t size, NodePool* pool);
+        static void operator delete(void* memory);
+        static void operator delete(void* memory, NodePool* pool);
 
         void AddChild(Node* child);
         void MoveTo(Node* parent);
@@ -33,9 +100,12 @@ namespace slim::scene {
         size_t NumDraws() const { return drawables.size(); }
 
         // getters
-        const std::string& GetName() const    { return name; }
-        const Transform& GetTransform() const { return transform; }
-        bool IsVisible() const                { return visible; }
+        const std::string& GetName() const          { return name; }
+        const Transform& GetTransform() const       { return transform; }
+        bool IsVisible() const                      { return visible; }
+        Node* GetParent() const                     { return parent; }
+        Children GetChildren() const                { return Children(firstChild); }
+        uint32_t GetHandle() const                  { return handle; }
 
         // transform
         void Scale(float x, float y, float z);
@@ -43,11 +113,16 @@ namespace slim::scene {
         void Rotate(float x, float y, float z, float w);
         void Translate(float x, float y, float z);
         void SetTransform(const Transform& transform);
+
+        // update world transforms, of the whole scene for nodes created by scene::Builder,
+        // where only subtrees with changed local transforms are recomputed
         void ApplyTransform();
         VkTransformMatrixKHR GetVkTransformMatrix() const;
 
-        // traversal-based operations
-        void ForEach(const std::function<bool(scene::Node*)> &callback);
+        // depth-first traversal of this subtree, the visitor returns false to skip the children of a node,
+        // and must not change the hierarchy while it runs
+        template <typename Visitor>
+        void ForEach(Visitor&& visitor);
 
         // geometry traversal
         auto begin()       { return drawables.begin(); }
@@ -62,16 +137,99 @@ namespace slim::scene {
 
         // hierarchy
         Node* parent = nullptr;
-        std::list<Node*> children = {};
+        Node* firstChild = nullptr;
+        Node* lastChild = nullptr;
+        Node* prevSibling = nullptr;
+        Node* nextSibling = nullptr;
+        uint32_t handle = NodePool::INVALID_HANDLE;
 
         // transform data
         Transform transform = glm::mat4(1.0);
+        TransformHierarchy* hierarchy = nullptr;
+        uint32_t hierarchyIndex = TransformHierarchy::INVALID_INDEX;
 
         // drawables
         std::vector<std::tuple<Mesh*, Material*>> drawables = {};
         bool visible = true;
     };
 
+    template <typename Visitor>
+    void Node::ForEach(Visitor&& visitor) {
+        // nodes of a hierarchy are visited in its flat order, skipped subtrees are jumped over
+        if (hierarchy) {
+            hierarchy->Linearize();
+        }
+        if (hierarchyIndex != TransformHierarchy::INVALID_INDEX) {
+            const std::vector<Node*>& nodes = hierarchy->GetNodes();
+            const std::vector<uint32_t>& ends = hierarchy->GetEnds();
+            for (uint32_t i = hierarchyIndex, end = ends[hierarchyIndex]; i < end; ) {
+                i = visitor(nodes[i]) ? i + 1 : ends[i];
+            }
+            return;
+        }
+
+        // other nodes follow their links, which needs no stack
+        Node* node = this;
+        while (node) {
+            if (visitor(node) && node->firstChild) {
+                node = node->firstChild;
+                continue;
+            }
+            while (node != this && !node->nextSibling) {
+                node = node->parent;
+            }
+            node = node == this ? nullptr : node->nextSibling;
+        }
+    }
+
+
+    // per instance data for GPU-driven rendering, matches InstanceData in shaderlib/indirect.h
+    struct InstanceData {
+        glm::mat4 model;
+        glm::vec4 boundsMin;
+        glm::vec4 boundsMax;
+        uint32_t  batch;
+        uint32_t  count;
+        uint32_t  first;
+        int32_t   vertexOffset;
+    };
+
+    // batch description for shaders, matches DrawBatch in shaderlib/indirect.h
+    struct DrawBatch {
+        uint32_t first;
+        uint32_t count;
+        uint32_t indexed;
+        uint32_t firstCluster;
+    };
+
+    // meshlet of a mesh for shaders, matches MeshletData in shaderlib/indirect.h,
+    // meshes without meshlets are a single meshlet that is never culled
+    struct MeshletData {
+        glm::vec4 sphere;
+        glm::vec4 cone;
+        uint32_t  first;
+        uint32_t  count;
+        int32_t   vertexOffset;
+        uint32_t  padding;
+    };
+
+    // meshlet of an instance for shaders, matches ClusterData in shaderlib/indirect.h
+    struct ClusterData {
+        uint32_t instance;
+        uint32_t meshlet;
+    };
+
+    // instances sharing material and geometry buffers, they are contiguous in the instance buffer,
+    // and so are their clusters in the cluster buffer,
+    // mesh is the first mesh of the batch and binding it binds the buffers of all of them
+    struct InstanceBatch {
+        Mesh*     mesh;
+        Material* material;
+        uint32_t  firstInstance;
+        uint32_t  instanceCount;
+        uint32_t  firstCluster;
+        uint32_t  clusterCount;
+    };
 
     // builder:
     // source of data
@@ -79,12 +237,15 @@ namespace slim::scene {
     public:
 
         explicit Builder(Device* device);
+        virtual ~Builder();
 
         // create scene node
         template <typename...Args>
         Node* CreateNode(Args...args) {
-            Node* node = new Node(args...);
+            Node* node = new (nodePool.get()) Node(args...);
+            node->handle = NodePool::GetHandle(node);
             nodes.push_back(node);
+            hierarchy->Add(node);
             return node;
         }
 
@@ -110,13 +271,61 @@ namespace slim::scene {
 
         void EnableRayTracing();
 
+        // weld and reorder meshes with MeshOptimizer before they are uploaded
+        void EnableMeshOptimization(float overdrawThreshold = MeshOptimizer::OVERDRAW_THRESHOLD);
+
+        // append simplified levels of detail to meshes with MeshSimplifier before they are uploaded
+        void EnableLodGeneration(uint32_t maxLods = MeshSimplifier::MAX_LODS, float maxError = MeshSimplifier::MAX_ERROR);
+
+        // split meshes into meshlets with MeshletBuilder before they are uploaded
+        void EnableMeshlets(uint32_t maxVertices = MeshletBuilder::MAX_VERTICES, uint32_t maxTriangles = MeshletBuilder::MAX_TRIANGLES);
+
+        // uploads are submitted without waiting, they are acquired by the next frame or Device::Execute(),
+        // only scenes with ray tracing wait for them, because their acceleration structures are built from them
         void Build();
         void Clear();
 
+        // uploads of the last Build(), Wait() blocks until they are complete
+        const UploadTicket& GetUploadTicket() const { return uploadTicket; }
+        void Wait() const;
+
+        // release the geometry of a mesh back to the arenas, the caller makes sure it is no longer
+        // referenced by nodes or in use by the GPU, new meshes are uploaded by the next Build()
+        void RemoveMesh(Mesh* mesh);
+
         Device*         GetDevice()       const { return device;       }
         accel::Builder* GetAccelBuilder() const { return accelBuilder; }
         Buffer*         GetAABBsBuffer()  const { return aabbsBuffer;  }
         uint32_t        GetAABBsIndex()   const { return aabbsIndex;   }
+        GeometryArena*  GetVertexArena()  const { return vertexArena;  }
+        GeometryArena*  GetIndexArena()   const { return indexArena;   }
+
+        // flat transforms of all created nodes, in depth-first order
+        TransformHierarchy* GetTransformHierarchy() const { return hierarchy; }
+
+        // created nodes by their handle, nullptr once destroyed
+        Node*     GetNode(uint32_t handle) const { return nodePool->Get(handle); }
+        NodePool* GetNodePool()            const { return nodePool; }
+
+        // accumulated over all meshes optimized by Build()
+        const MeshOptimizerStats& GetOptimizerStats() const { return optimizerStats; }
+
+        // instance buffer (InstanceData) and batch buffer (DrawBatch) for GPU-driven rendering,
+        // instances are ordered by batch, so instance ids differ from ForEachInstance()
+        Buffer*                           GetInstanceBuffer()  const { return instanceBuffer;   }
+        Buffer*                           GetBatchBuffer()     const { return batchBuffer;      }
+        uint32_t                          GetInstanceCount()   const { return static_cast<uint32_t>(instances.size()); }
+        const std::vector<InstanceBatch>& GetInstanceBatches() const { return instanceBatches;  }
+        Node*                             GetInstanceNode(uint32_t instance) const { return instanceNodes[instance]; }
+
+        // meshlet buffer (MeshletData) and cluster buffer (ClusterData) for per meshlet culling on the GPU,
+        // there is one cluster per meshlet of every instance
+        Buffer*                           GetMeshletBuffer()   const { return meshletBuffer;    }
+        Buffer*                           GetClusterBuffer()   const { return clusterBuffer;    }
+        uint32_t                          GetClusterCount()    const { return clusterCount;     }
+
+        // upload the current world transforms of all instances
+        void UpdateInstances(CommandBuffer* commandBuffer);
 
         template <typename T>
         void ForEachNode(std::vector<T>& data, std::function<void(T&, Node*)> callback) {
@@ -167,28 +376,65 @@ namespace slim::scene {
         VkBufferUsageFlags GetCommonBufferUsages() const;
         VmaMemoryUsage GetCommonMemoryUsages() const;
 
-        void BuildVertexBuffer(CommandBuffer* commandBuffer, Mesh* mesh,
-                               VkBufferUsageFlags bufferUsage,
-                               VmaMemoryUsage memoryUsage);
+        void BuildVertexBuffer(UploadManager* uploader, Mesh* mesh);
 
-        void BuildIndexBuffer(CommandBuffer* commandBuffer, Mesh* mesh,
-                              VkBufferUsageFlags bufferUsage,
-                              VmaMemoryUsage memoryUsage);
+        void BuildIndexBuffer(UploadManager* uploader, Mesh* mesh);
 
-        void BuildAabbsBuffer(CommandBuffer* commandBuffer,
+        void BuildAabbsBuffer(UploadManager* uploader,
                               VkBufferUsageFlags bufferUsage,
                               VmaMemoryUsage memoryUsage);
 
+        void BuildInstanceBuffer(UploadManager* uploader);
+
     private:
         SmartPtr<Device>         device;
         SmartPtr<accel::Builder> accelBuilder;
 
+        // kept across builds, so staging memory is reused and uploads overlap with rendering
+        SmartPtr<UploadManager>  uploader;
+        UploadTicket             uploadTicket = {};
+
+        // storage and transforms of all created nodes
+        SmartPtr<NodePool>           nodePool;
+        SmartPtr<TransformHierarchy> hierarchy;
+
+        // shared geometry storage of all meshes
+        SmartPtr<GeometryArena>  vertexArena;
+        SmartPtr<GeometryArena>  indexArena;
+
+        // optional mesh optimization before upload
+        bool                     optimizeMeshes = false;
+        float                    overdrawThreshold = MeshOptimizer::OVERDRAW_THRESHOLD;
+        MeshOptimizerStats       optimizerStats = {};
+
+        // optional level of detail generation before upload
+        bool                     generateLods = false;
+        uint32_t                 maxLods = MeshSimplifier::MAX_LODS;
+        float                    maxLodError = MeshSimplifier::MAX_ERROR;
+
+        // optional meshlet generation before upload
+        bool                     buildMeshlets = false;
+        uint32_t                 maxMeshletVertices = MeshletBuilder::MAX_VERTICES;
+        uint32_t                 maxMeshletTriangles = MeshletBuilder::MAX_TRIANGLES;
+
         // Experimental: adding bounding box support for procedural generation
         uint32_t                        aabbsIndex;
         SmartPtr<Node>                  aabbsNode;
         SmartPtr<Buffer>                aabbsBuffer;
         SmartPtr<Mesh>                  aabbsMesh;
         std::vector<VkAabbPositionsKHR> aabbs;
+
+        // instances for GPU-driven rendering
+        SmartPtr<Buffer>                instanceBuffer;
+        SmartPtr<Buffer>                batchBuffer;
+        std::vector<Node*>              instanceNodes;
+        std::vector<InstanceData>       instances;
+        std::vector<InstanceBatch>      instanceBatches;
+
+        // meshlets for GPU-driven rendering
+        SmartPtr<Buffer>                meshletBuffer;
+        SmartPtr<Buffer>                clusterBuffer;
+        uint32_t                        clusterCount = 0;
     };
 
 } // end of slim namespace
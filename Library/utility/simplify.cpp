@@ -0,0 +1,366 @@
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <algorithm>
+#include <unordered_map>
+#include <glm/glm.hpp>
+#include "utility/meshopt.h"
+#include "utility/simplify.h"
+
+using namespace slim;
+using namespace slim::scene;
+
+namespace {
+
+    constexpr uint32_t INVALID_INDEX = ~0u;
+
+    // sum of squared distances to a set of planes, weighted by triangle area
+    struct Quadric {
+        double a00 = 0.0, a11 = 0.0, a22 = 0.0, a01 = 0.0, a02 = 0.0, a12 = 0.0;
+        double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+        double c = 0.0;
+        double w = 0.0;
+
+        void AddPlane(const glm::vec3& normal, float distance, float weight) {
+            double x = normal.x, y = normal.y, z = normal.z, d = distance;
+            a00 += weight * x * x; a11 += weight * y * y; a22 += weight * z * z;
+            a01 += weight * x * y; a02 += weight * x * z; a12 += weight * y * z;
+            b0 += weight * x * d; b1 += weight * y * d; b2 += weight * z * d;
+            c += weight * d * d;
+            w += weight;
+        }
+
+        Quadric& operator+=(const Quadric& q) {
+            a00 += q.a00; a11 += q.a11; a22 += q.a22;
+            a01 += q.a01; a02 += q.a02; a12 += q.a12;
+            b0 += q.b0; b1 += q.b1; b2 += q.b2;
+            c += q.c;
+            w += q.w;
+            return *this;
+        }
+
+        // mean squared distance of p to the planes
+        float Error(const glm::vec3& p) const {
+            double x = p.x, y = p.y, z = p.z;
+            double e = a00 * x * x + a11 * y * y + a22 * z * z
+                     + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+                     + 2.0 * (b0 * x + b1 * y + b2 * z)
+                     + c;
+            return w > 0.0 ? static_cast<float>(std::max(e, 0.0) / w) : 0.0f;
+        }
+    };
+
+    struct PositionHasher {
+        const uint8_t* positions;
+        size_t stride;
+
+        size_t operator()(uint32_t vertex) const {
+            // FNV-1a
+            const uint8_t* data = positions + vertex * stride;
+            uint64_t hash = 14695981039346656037ull;
+            for (size_t i = 0; i < sizeof(glm::vec3); i++) {
+                hash = (hash ^ data[i]) * 1099511628211ull;
+            }
+            return static_cast<size_t>(hash);
+        }
+    };
+
+    struct PositionEqual {
+        const uint8_t* positions;
+        size_t stride;
+
+        bool operator()(uint32_t a, uint32_t b) const {
+            return std::memcmp(positions + a * stride, positions + b * stride, sizeof(glm::vec3)) == 0;
+        }
+    };
+
+    struct Collapse {
+        uint32_t from;
+        uint32_t to;
+        float    error;
+    };
+
+    glm::vec3 ReadPosition(const uint8_t* positions, size_t stride, uint32_t vertex) {
+        glm::vec3 position;
+        std::memcpy(&position, positions + vertex * stride, sizeof(glm::vec3));
+        return position;
+    }
+
+} // end of anonymous namespace
+
+uint32_t MeshSimplifier::GenerateLods(Mesh* mesh, uint32_t maxLods, float reduction, float maxError) {
+    // levels from a previous call are regenerated
+    size_t indexSize = mesh->indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+    mesh->indexData.resize(mesh->indexCount * indexSize);
+    mesh->lods.clear();
+
+    if (maxLods <= 1 || mesh->indexCount == 0 || mesh->indexCount % 3 != 0 || mesh->vertexCount == 0 ||
+        mesh->vertexData.empty() || mesh->vertexData[0].size() / mesh->vertexCount < sizeof(glm::vec3)) {
+        return 1;
+    }
+
+    std::vector<uint32_t> indices(mesh->indexCount);
+    if (mesh->indexType == VK_INDEX_TYPE_UINT16) {
+        const uint16_t* src = reinterpret_cast<const uint16_t*>(mesh->indexData.data());
+        std::copy(src, src + mesh->indexCount, indices.begin());
+    } else {
+        std::memcpy(indices.data(), mesh->indexData.data(), indices.size() * sizeof(uint32_t));
+    }
+
+    size_t vertexCount = mesh->vertexCount;
+    const uint8_t* positions = mesh->vertexData[0].data();
+    size_t stride = mesh->vertexData[0].size() / vertexCount;
+
+    // errors are kept relative to the mesh size, so that they can be scaled by world space bounds
+    glm::vec3 minimum = ReadPosition(positions, stride, indices[0]);
+    glm::vec3 maximum = minimum;
+    for (uint32_t index : indices) {
+        glm::vec3 p = ReadPosition(positions, stride, index);
+        minimum = glm::min(minimum, p);
+        maximum = glm::max(maximum, p);
+    }
+    float radius = 0.5f * glm::length(maximum - minimum);
+    if (!(radius > 0.0f)) {
+        return 1;
+    }
+
+    std::vector<uint32_t> levels = indices;
+    mesh->lods.push_back(MeshLod { 0, static_cast<uint32_t>(indices.size()), 0.0f });
+    for (uint32_t level = 1; level < maxLods; level++) {
+        const MeshLod& previous = mesh->lods.back();
+        size_t target = static_cast<size_t>(previous.indexCount * reduction) / 3 * 3;
+
+        // every level is simplified from the full mesh, errors do not compound through the chain
+        float error = 0.0f;
+        std::vector<uint32_t> lod = Simplify(indices, positions, stride, vertexCount, target, maxError * radius, &error);
+
+        // a level that hardly reduces the previous one is not worth switching to
+        if (lod.empty() || lod.size() > (previous.indexCount + target) / 2) {
+            break;
+        }
+
+        lod = MeshOptimizer::OptimizeVertexCache(lod, vertexCount);
+        float relativeError = std::max(error / radius, previous.error);
+        mesh->lods.push_back(MeshLod { static_cast<uint32_t>(levels.size()), static_cast<uint32_t>(lod.size()), relativeError });
+        levels.insert(levels.end(), lod.begin(), lod.end());
+    }
+
+    if (mesh->lods.size() == 1) {
+        mesh->lods.clear();
+        return 1;
+    }
+
+    // levels only reference existing vertices, so 16 bit indices stay valid
+    mesh->indexData.resize(levels.size() * indexSize);
+    if (mesh->indexType == VK_INDEX_TYPE_UINT16) {
+        uint16_t* dst = reinterpret_cast<uint16_t*>(mesh->indexData.data());
+        for (size_t i = 0; i < levels.size(); i++) {
+            dst[i] = static_cast<uint16_t>(levels[i]);
+        }
+    } else {
+        std::memcpy(mesh->indexData.data(), levels.data(), levels.size() * sizeof(uint32_t));
+    }
+    return static_cast<uint32_t>(mesh->lods.size());
+}
+
+std::vector<uint32_t> MeshSimplifier::Simplify(const std::vector<uint32_t>& indices,
+                                               const uint8_t* positions,
+                                               size_t stride,
+                                               size_t vertexCount,
+                                               size_t targetIndexCount,
+                                               float targetError,
+                                               float* resultError) {
+    float maxError = 0.0f;
+    if (resultError) {
+        *resultError = 0.0f;
+    }
+
+    // topology is tracked on welded positions, wedges of the same position are told apart by attributes
+    std::vector<uint32_t> position(vertexCount);
+    std::unordered_map<uint32_t, uint32_t, PositionHasher, PositionEqual> positionMap(
+        vertexCount, PositionHasher { positions, stride }, PositionEqual { positions, stride });
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        position[v] = positionMap.insert(std::make_pair(v, v)).first->second;
+    }
+
+    // degenerate triangles are dropped right away
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        uint32_t a = indices[i + 0], b = indices[i + 1], c = indices[i + 2];
+        if (position[a] == position[b] || position[b] == position[c] || position[c] == position[a]) continue;
+        result.insert(result.end(), { a, b, c });
+    }
+    if (result.size() <= targetIndexCount) {
+        return result;
+    }
+
+    // vertices on attribute seams, open borders and non-manifold edges are locked in place
+    std::vector<uint8_t> locked(vertexCount, 0);
+    std::vector<uint32_t> wedges(vertexCount, INVALID_INDEX);
+    for (uint32_t index : result) {
+        uint32_t p = position[index];
+        if (wedges[p] == INVALID_INDEX) {
+            wedges[p] = index;
+        } else if (wedges[p] != index) {
+            locked[p] = 1;
+        }
+    }
+    std::unordered_map<uint64_t, uint32_t> edges(result.size());
+    auto edgeKey = [](uint32_t a, uint32_t b) { return (static_cast<uint64_t>(a) << 32) | b; };
+    for (size_t i = 0; i < result.size(); i += 3) {
+        for (uint32_t k = 0; k < 3; k++) {
+            edges[edgeKey(position[result[i + k]], position[result[i + (k + 1) % 3]])]++;
+        }
+    }
+    for (const auto& [key, count] : edges) {
+        uint32_t a = static_cast<uint32_t>(key >> 32), b = static_cast<uint32_t>(key);
+        auto twin = edges.find(edgeKey(b, a));
+        if (count != 1 || twin == edges.end() || twin->second != 1) {
+            locked[a] = 1;
+            locked[b] = 1;
+        }
+    }
+
+    // one quadric per position, from the planes of its triangles
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i < result.size(); i += 3) {
+        glm::vec3 p0 = ReadPosition(positions, stride, result[i + 0]);
+        glm::vec3 p1 = ReadPosition(positions, stride, result[i + 1]);
+        glm::vec3 p2 = ReadPosition(positions, stride, result[i + 2]);
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float area = glm::length(normal);
+        if (area == 0.0f) continue;
+        normal /= area;
+        float distance = -glm::dot(normal, p0);
+        for (uint32_t k = 0; k < 3; k++) {
+            quadrics[position[result[i + k]]].AddPlane(normal, distance, 0.5f * area);
+        }
+    }
+
+    // collapses are done in passes, cheapest first, each vertex is collapsed at most once per pass
+    // and neighbourhoods of collapsed vertices are left alone until the next pass rebuilds adjacency
+    float errorLimit = targetError * targetError;
+    std::vector<uint32_t> remap(vertexCount);
+    std::iota(remap.begin(), remap.end(), 0);
+    std::vector<uint32_t> adjacencyOffsets;
+    std::vector<uint32_t> adjacency;
+    std::vector<Collapse> collapses;
+    std::vector<uint8_t> touched;
+    std::vector<uint32_t> marks(vertexCount, 0);
+    uint32_t mark = 0;
+    while (result.size() > targetIndexCount) {
+        // triangles around each position
+        adjacencyOffsets.assign(vertexCount + 1, 0);
+        for (uint32_t index : result) {
+            adjacencyOffsets[position[index] + 1]++;
+        }
+        for (size_t v = 0; v < vertexCount; v++) {
+            adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+        }
+        adjacency.resize(result.size());
+        std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < result.size(); i++) {
+            adjacency[fill[position[result[i]]]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        // candidates, an unlocked vertex moves onto a neighbour, keeping the wedge of that neighbour
+        collapses.clear();
+        for (size_t i = 0; i < result.size(); i += 3) {
+            for (uint32_t k = 0; k < 3; k++) {
+                uint32_t from = result[i + k], to = result[i + (k + 1) % 3];
+                uint32_t pf = position[from], pt = position[to];
+                // unlocked vertices only have interior edges, which are seen once from either side
+                if (pf > pt || (locked[pf] && locked[pt])) continue;
+                Quadric q = quadrics[pf];
+                q += quadrics[pt];
+                if (!locked[pf]) {
+                    collapses.push_back(Collapse { from, to, q.Error(ReadPosition(positions, stride, to)) });
+                }
+                if (!locked[pt]) {
+                    collapses.push_back(Collapse { to, from, q.Error(ReadPosition(positions, stride, from)) });
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& c1, const Collapse& c2) {
+            return c1.error < c2.error;
+        });
+
+        size_t trianglesToRemove = (result.size() - targetIndexCount + 2) / 3;
+        size_t trianglesRemoved = 0;
+        touched.assign(vertexCount, 0);
+        for (const Collapse& collapse : collapses) {
+            if (collapse.error > errorLimit || trianglesRemoved >= trianglesToRemove) break;
+
+            uint32_t pf = position[collapse.from], pt = position[collapse.to];
+            if (touched[pf] || touched[pt]) continue;
+
+            // link condition, an interior edge has exactly two vertices opposite to it
+            mark += 2;
+            uint32_t shared = 0;
+            for (uint32_t a = adjacencyOffsets[pf]; a < adjacencyOffsets[pf + 1]; a++) {
+                for (uint32_t k = 0; k < 3; k++) {
+                    marks[position[result[adjacency[a] * 3 + k]]] = mark;
+                }
+            }
+            for (uint32_t a = adjacencyOffsets[pt]; a < adjacencyOffsets[pt + 1]; a++) {
+                for (uint32_t k = 0; k < 3; k++) {
+                    uint32_t p = position[result[adjacency[a] * 3 + k]];
+                    if (p != pf && p != pt && marks[p] == mark) {
+                        marks[p] = mark + 1;
+                        shared++;
+                    }
+                }
+            }
+            if (shared != 2) continue;
+
+            // triangles that survive the collapse must not flip, or fold over their neighbours
+            bool valid = true;
+            glm::vec3 target = ReadPosition(positions, stride, collapse.to);
+            for (uint32_t a = adjacencyOffsets[pf]; a < adjacencyOffsets[pf + 1] && valid; a++) {
+                const uint32_t* triangle = &result[adjacency[a] * 3];
+                glm::vec3 p[3], q[3];
+                bool removed = false;
+                for (uint32_t k = 0; k < 3; k++) {
+                    removed |= position[triangle[k]] == pt;
+                    p[k] = ReadPosition(positions, stride, triangle[k]);
+                    q[k] = position[triangle[k]] == pf ? target : p[k];
+                }
+                if (removed) continue;
+                glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+                valid = glm::dot(before, after) > 0.25f * glm::length(before) * glm::length(after);
+            }
+            if (!valid) continue;
+
+            remap[collapse.from] = collapse.to;
+            quadrics[pt] += quadrics[pf];
+            maxError = std::max(maxError, collapse.error);
+            for (uint32_t a = adjacencyOffsets[pf]; a < adjacencyOffsets[pf + 1]; a++) {
+                for (uint32_t k = 0; k < 3; k++) {
+                    touched[position[result[adjacency[a] * 3 + k]]] = 1;
+                }
+            }
+            trianglesRemoved += 2;
+        }
+        if (trianglesRemoved == 0) {
+            break;
+        }
+
+        // collapsed edges leave degenerate triangles behind
+        size_t count = 0;
+        for (size_t i = 0; i < result.size(); i += 3) {
+            uint32_t a = remap[result[i + 0]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+            if (position[a] == position[b] || position[b] == position[c] || position[c] == position[a]) continue;
+            result[count++] = a;
+            result[count++] = b;
+            result[count++] = c;
+        }
+        result.resize(count);
+    }
+
+    if (resultError) {
+        *resultError = std::sqrt(maxError);
+    }
+    return result;
+}
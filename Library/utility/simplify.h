@@ -0,0 +1,41 @@
+#ifndef SLIM_UTILITY_SIMPLIFY_H
+#define SLIM_UTILITY_SIMPLIFY_H
+
+#include <vector>
+#include <cstdint>
+#include "utility/mesh.h"
+
+namespace slim::scene {
+
+    // MeshSimplifier reduces indexed triangle meshes with quadric error metrics (Garland and Heckbert),
+    // collapsing edges onto existing vertices, so that all levels of detail share the vertex data.
+    // Vertices on open borders, on attribute seams and on non-manifold edges are never moved.
+    // Positions are expected as float3 at offset 0 of the first vertex stream.
+    class MeshSimplifier {
+    public:
+        constexpr static uint32_t MAX_LODS = 4;
+        constexpr static float REDUCTION = 0.5f;     // index count of each level relative to the previous one
+        constexpr static float MAX_ERROR = 0.05f;    // relative to the radius of the mesh bounds
+
+        // append up to maxLods - 1 simplified index ranges to the index data of a mesh, returns the level count,
+        // stops early once a level cannot be reduced further without exceeding the error bound
+        static uint32_t GenerateLods(Mesh* mesh,
+                                     uint32_t maxLods = MAX_LODS,
+                                     float reduction = REDUCTION,
+                                     float maxError = MAX_ERROR);
+
+        // building block, on 32 bit triangle lists
+        // simplify towards targetIndexCount while the error stays within targetError (a distance in mesh units),
+        // resultError receives the largest error of all applied collapses
+        static std::vector<uint32_t> Simplify(const std::vector<uint32_t>& indices,
+                                              const uint8_t* positions,
+                                              size_t stride,
+                                              size_t vertexCount,
+                                              size_t targetIndexCount,
+                                              float targetError,
+                                              float* resultError = nullptr);
+    };
+
+} // end of namespace slim::scene
+
+#endif // SLIM_UTILITY_SIMPLIFY_H
@@ -16,14 +16,21 @@ void Technique::AddPass(RenderQueue queue, const GraphicsPipelineDesc &desc) {
 }
 
 void Technique::Bind(uint32_t index, RenderFrame *renderFrame, RenderPass *renderPass, CommandBuffer *commandBuffer) {
+    // bind pipeline
+    commandBuffer->BindPipeline(Prepare(index, renderFrame, renderPass));
+}
+
+Pipeline* Technique::Prepare(uint32_t index, RenderFrame *renderFrame, RenderPass *renderPass) {
     // build pipeline
     Pass& pass = passes[index];
     pass.desc.SetRenderPass(renderPass);
     pass.desc.SetViewport(renderFrame->GetExtent());
     pass.pipeline = renderFrame->RequestPipeline(pass.desc);
+    return pass.pipeline;
+}
 
-    // bind pipeline
-    commandBuffer->BindPipeline(pass.pipeline);
+Pipeline* Technique::GetPipeline(uint32_t index) const {
+    return passes[index].pipeline;
 }
 
 uint32_t Technique::QueueIndex(RenderQueue queue) const {
@@ -31,6 +31,13 @@ namespace slim {
                   RenderPass *renderPass,
                   CommandBuffer *commandBuffer);
 
+        // resolve pipeline without binding it, GetPipeline() returns it afterwards
+        Pipeline* Prepare(uint32_t index,
+                          RenderFrame *renderFrame,
+                          RenderPass *renderPass);
+
+        Pipeline* GetPipeline(uint32_t index) const;
+
         PipelineLayout* Layout(uint32_t index) const;
 
         uint32_t QueueIndex(RenderQueue queue) const;
@@ -1,3 +1,7 @@
+#include <memory>
+#include <chrono>
+#include <cctype>
+#include "core/jobs.h"
 #include "core/debug.h"
 #include "core/commands.h"
 #include "core/vkutils.h"
@@ -5,37 +9,264 @@
 
 using namespace slim;
 
+namespace {
+
+    bool HasKTX2Extension(const std::string& filename) {
+        if (filename.size() < 5) return false;
+        std::string extension = filename.substr(filename.size() - 5);
+        for (char& c : extension) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        return extension == ".ktx2";
+    }
+
+    bool IsSampled(VkPhysicalDevice physicalDevice, VkFormat format) {
+        VkFormatProperties properties = {};
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+        return (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+    }
+
+} // end of anonymous namespace
+
 void TextureLoader::FlipVerticallyOnLoad(bool value) {
     stbi_set_flip_vertically_on_load(value);
 }
 
 GPUImage* TextureLoader::Load2D(CommandBuffer *commandBuffer, const std::string &filename, VkFilter filter) {
-    GPUImage *image = nullptr;
-    bool isHDR = stbi_is_hdr(filename.c_str());
+    Source source = {};
+    source.filename = filename;
+    return Load2D(commandBuffer, std::vector<Source> { source }, filter).front();
+}
+
+GPUImage* TextureLoader::Load2D(CommandBuffer *commandBuffer, const uint8_t *encoded, size_t size, VkFilter filter) {
+    Source source = {};
+    source.encoded = encoded;
+    source.size = size;
+    return Load2D(commandBuffer, std::vector<Source> { source }, filter).front();
+}
+
+std::vector<GPUImage*> TextureLoader::Load2D(CommandBuffer *commandBuffer,
+                                             const std::vector<Source> &sources,
+                                             VkFilter filter,
+                                             std::vector<double> *decodeTimes) {
+    std::vector<GPUImage*> images;
+    images.reserve(sources.size());
+    if (decodeTimes) decodeTimes->assign(sources.size(), 0.0);
+
+    // images become shader readable together, with one barrier after all of them are uploaded
+    BarrierBatch barriers;
+    DecodeInOrder(sources, commandBuffer->GetDevice(), [&](uint32_t index, Decoded& decoded) {
+        images.push_back(Upload2D(commandBuffer, decoded, filter, barriers));
+        if (decodeTimes) (*decodeTimes)[index] = decoded.decodeTime;
+    });
+    barriers.Flush(commandBuffer);
+    return images;
+}
+
+bool TextureLoader::IsFormatSupported(Device *device, VkFormat format) {
+    return IsSampled(device->GetContext()->GetPhysicalDevice(), format);
+}
+
+TextureLoader::Decoded TextureLoader::Decode(const Source &source, VkPhysicalDevice physicalDevice) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    Decoded decoded = {};
+
+    // KTX2 containers are parsed in place, their data is only touched again when uploading
+    if (source.encoded ? KTX2::IsKTX2(source.encoded, source.size) : HasKTX2Extension(source.filename)) {
+        if (source.encoded) {
+            DecodeKTX2(decoded, source.encoded, source.size, physicalDevice);
+        } else {
+            decoded.file = SlimPtr<MappedFile>(source.filename);
+            DecodeKTX2(decoded, decoded.file->GetData(), decoded.file->GetSize(), physicalDevice);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        decoded.decodeTime = std::chrono::duration<double, std::milli>(end - start).count();
+        return decoded;
+    }
 
     int width = 0;
     int height = 0;
     int channels = 0;
     int requestChannels = 4;
 
-    if (isHDR) {
-        float *dataHDR;
-        dataHDR = stbi_loadf(filename.c_str(), &width, &height, &channels, requestChannels);
-        image = TextureLoader::Load2DHDR(commandBuffer, dataHDR, width, height, requestChannels, filter);
-        stbi_image_free(dataHDR);
+    if (source.encoded) {
+        int length = static_cast<int>(source.size);
+        decoded.hdr = stbi_is_hdr_from_memory(source.encoded, length);
+        decoded.pixels = decoded.hdr
+            ? static_cast<void*>(stbi_loadf_from_memory(source.encoded, length, &width, &height, &channels, requestChannels))
+            : static_cast<void*>(stbi_load_from_memory(source.encoded, length, &width, &height, &channels, requestChannels));
     } else {
-        uint8_t *dataLDR;
-        dataLDR = stbi_load(filename.c_str(), &width, &height, &channels, requestChannels);
-        image = TextureLoader::Load2DLDR(commandBuffer, dataLDR, width, height, requestChannels, filter);
-        stbi_image_free(dataLDR);
+        decoded.hdr = stbi_is_hdr(source.filename.c_str());
+        decoded.pixels = decoded.hdr
+            ? static_cast<void*>(stbi_loadf(source.filename.c_str(), &width, &height, &channels, requestChannels))
+            : static_cast<void*>(stbi_load(source.filename.c_str(), &width, &height, &channels, requestChannels));
+    }
+
+    if (!decoded.pixels) {
+        std::string name = source.encoded ? "<memory>" : source.filename;
+        throw std::runtime_error("[TextureLoader] failed to decode image: " + name);
+    }
+
+    decoded.width = width;
+    decoded.height = height;
+    decoded.channels = requestChannels;
+
+    auto end = std::chrono::high_resolution_clock::now();
+    decoded.decodeTime = std::chrono::duration<double, std::milli>(end - start).count();
+    return decoded;
+}
+
+void TextureLoader::DecodeKTX2(Decoded &decoded, const uint8_t *data, size_t size, VkPhysicalDevice physicalDevice) {
+    KTX2Image image = KTX2::Parse(data, size);
+    decoded.format = image.format;
+    decoded.width = image.width;
+    decoded.height = image.height;
+    decoded.layers = image.layers * image.faces;
+    decoded.faces = image.faces;
+    decoded.levels = image.levels;
+    if (IsSampled(physicalDevice, image.format)) {
+        return;
+    }
+
+    // fall back to decoding blocks into RGBA8, every level in turn
+    VkFormat format = KTX2::GetDecodedFormat(image.format);
+    if (format == VK_FORMAT_UNDEFINED || !IsSampled(physicalDevice, format)) {
+        throw std::runtime_error("[TextureLoader] KTX2 format is not supported by the device: " + std::to_string(image.format));
+    }
+
+    size_t total = 0;
+    for (const KTX2Level& level : image.levels) {
+        total += size_t(level.width) * level.height * 4 * decoded.layers;
+    }
+    decoded.storage.resize(total);
+    decoded.format = format;
+
+    size_t offset = 0;
+    for (KTX2Level& level : decoded.levels) {
+        size_t layerSize = KTX2::GetLevelSize(image.format, level.width, level.height);
+        size_t decodedSize = size_t(level.width) * level.height * 4;
+        for (uint32_t layer = 0; layer < decoded.layers; layer++) {
+            KTX2::Decode(image.format, level.data + layer * layerSize, level.width, level.height,
+                         decoded.storage.data() + offset + layer * decodedSize);
+        }
+        level.data = decoded.storage.data() + offset;
+        level.size = decodedSize * decoded.layers;
+        offset += level.size;
+    }
+}
+
+void TextureLoader::Release(Decoded &decoded) {
+    if (decoded.pixels) stbi_image_free(decoded.pixels);
+    decoded.pixels = nullptr;
+    decoded.levels.clear();
+    decoded.storage = std::vector<uint8_t>();
+    decoded.file.reset(nullptr);
+}
+
+void TextureLoader::DecodeInOrder(const std::vector<Source> &sources, Device *device,
+                                  const std::function<void(uint32_t, Decoded&)> &consume) {
+    uint32_t count = static_cast<uint32_t>(sources.size());
+    VkPhysicalDevice physicalDevice = device->GetContext()->GetPhysicalDevice();
+    JobSystem* jobs = device->GetJobSystem();
+
+    // serial decoding, nothing to overlap with
+    if (count <= 1 || jobs->GetThreadCount() <= 1) {
+        for (uint32_t i = 0; i < count; i++) {
+            Decoded decoded = Decode(sources[i], physicalDevice);
+            try {
+                consume(i, decoded);
+            } catch (...) {
+                Release(decoded);
+                throw;
+            }
+            Release(decoded);
+        }
+        return;
+    }
+
+    // jobs decode ahead of the consumer, but not by more than a few images,
+    // otherwise a scene full of large textures would be fully decoded in memory at once
+    const uint32_t window = jobs->GetThreadCount() * 2;
+
+    std::vector<Decoded> decoded(count);
+    std::unique_ptr<JobCounter[]> counters(new JobCounter[count]);
+    uint32_t submitted = 0;
+    auto submit = [&](uint32_t last) {
+        for (; submitted < std::min(last, count); submitted++) {
+            uint32_t index = submitted;
+            jobs->Run(counters[index], [&, index]() {
+                decoded[index] = Decode(sources[index], physicalDevice);
+            });
+        }
+    };
+    submit(window);
+
+    // consume in order on the calling thread, which owns the command buffer,
+    // waiting runs other decode jobs meanwhile
+    std::exception_ptr failure = nullptr;
+    for (uint32_t i = 0; i < count && !failure; i++) {
+        try {
+            jobs->Wait(counters[i]);
+            consume(i, decoded[i]);
+        } catch (...) {
+            failure = std::current_exception();
+        }
+        Release(decoded[i]);
+        if (!failure) submit(i + 1 + window);
+    }
+
+    // jobs still in flight reference decoded and sources, their errors are superseded by the first failure
+    for (uint32_t i = 0; i < submitted; i++) {
+        try {
+            jobs->Wait(counters[i]);
+        } catch (...) {
+        }
+    }
+
+    // images decoded ahead of a failure are never consumed
+    for (auto& image : decoded) {
+        Release(image);
+    }
+
+    if (failure) {
+        std::rethrow_exception(failure);
+    }
+}
+
+GPUImage* TextureLoader::Upload2D(CommandBuffer *commandBuffer, const Decoded &decoded, VkFilter filter, BarrierBatch &barriers) {
+    if (decoded.format != VK_FORMAT_UNDEFINED) {
+        return UploadLevels(commandBuffer, decoded, barriers);
+    }
+    if (decoded.hdr) {
+        return TextureLoader::Load2DHDR(commandBuffer, static_cast<float*>(decoded.pixels), decoded.width, decoded.height, decoded.channels, filter, barriers);
+    }
+    return TextureLoader::Load2DLDR(commandBuffer, static_cast<uint8_t*>(decoded.pixels), decoded.width, decoded.height, decoded.channels, filter, barriers);
+}
+
+GPUImage* TextureLoader::UploadLevels(CommandBuffer *commandBuffer, const Decoded &decoded, BarrierBatch &barriers) {
+    // images are created cube compatible when they are 2D with exactly 6 layers (see Image::MakeCreateInfo),
+    // cubemaps that would not be are rejected instead of being loaded as plain layers
+    if (decoded.faces == 6) {
+        if (decoded.layers != 6) {
+            throw std::runtime_error("[TextureLoader] KTX2 cubemap arrays are not supported");
+        }
+        if (decoded.width != decoded.height || decoded.height == 1) {
+            throw std::runtime_error("[TextureLoader] KTX2 cubemap faces must be square and larger than 1x1");
+        }
     }
 
+    uint32_t mipLevels = static_cast<uint32_t>(decoded.levels.size());
+    GPUImage* image = new GPUImage(commandBuffer->GetDevice(), decoded.format, VkExtent2D { decoded.width, decoded.height }, mipLevels, decoded.layers, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_USAGE_SAMPLED_BIT);
+    for (uint32_t mip = 0; mip < mipLevels; mip++) {
+        const KTX2Level& level = decoded.levels[mip];
+        commandBuffer->CopyDataToImage(const_cast<uint8_t*>(level.data), level.size, image, {0, 0, 0}, {level.width, level.height, 1}, 0, decoded.layers, mip, VK_IMAGE_ASPECT_COLOR_BIT);
+    }
+    commandBuffer->PrepareForShaderRead(barriers, image);
     return image;
 }
 
 GPUImage* TextureLoader::Load2DLDR(CommandBuffer *commandBuffer,
                                 uint8_t *data, uint32_t width, uint32_t height,
-                                uint32_t numChannels, VkFilter filter) {
+                                uint32_t numChannels, VkFilter filter, BarrierBatch &barriers) {
 
     uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
     size_t size = width * height * numChannels * sizeof(uint8_t);
@@ -53,13 +284,13 @@ GPUImage* TextureLoader::Load2DLDR(CommandBuffer *commandBuffer,
     GPUImage* image = new GPUImage(commandBuffer->GetDevice(), format, VkExtent2D { width, height }, mipLevels, arrayLayers, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_USAGE_SAMPLED_BIT);
     commandBuffer->CopyDataToImage(data, size, image, {0, 0, 0}, {width, height, 1}, 0, 1, 0, VK_IMAGE_ASPECT_COLOR_BIT);
     commandBuffer->GenerateMipmaps(image, filter);
-    commandBuffer->PrepareForShaderRead(image);
+    commandBuffer->PrepareForShaderRead(barriers, image);
     return image;
 }
 
 GPUImage* TextureLoader::Load2DHDR(CommandBuffer *commandBuffer,
                                      float *data, uint32_t width, uint32_t height,
-                                     uint32_t numChannels, VkFilter filter) {
+                                     uint32_t numChannels, VkFilter filter, BarrierBatch &barriers) {
 
     uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
     size_t size = width * height * numChannels * sizeof(float);
@@ -77,7 +308,7 @@ GPUImage* TextureLoader::Load2DHDR(CommandBuffer *commandBuffer,
     GPUImage* image = new GPUImage(commandBuffer->GetDevice(), format, VkExtent2D { width, height }, mipLevels, arrayLayers, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_USAGE_SAMPLED_BIT);
     commandBuffer->CopyDataToImage(data, size, image, {0, 0, 0}, {width, height, 1}, 0, 1, 0, VK_IMAGE_ASPECT_COLOR_BIT);
     commandBuffer->GenerateMipmaps(image, filter);
-    commandBuffer->PrepareForShaderRead(image);
+    commandBuffer->PrepareForShaderRead(barriers, image);
     return image;
 }
 
@@ -89,125 +320,44 @@ GPUImage* TextureLoader::LoadCubemap(CommandBuffer* commandBuffer,
                                      const std::string& zpos,
                                      const std::string& zneg,
                                      VkFilter filter) {
-
-    // assume all 6 images have the same dimension
-
+    std::vector<Source> faces(6);
+    faces[0].filename = xpos;
+    faces[1].filename = xneg;
+    faces[2].filename = ypos;
+    faces[3].filename = yneg;
+    faces[4].filename = zpos;
+    faces[5].filename = zneg;
+
+    // assume all 6 images have the same dimension and format as the first one,
+    // faces are decoded in parallel and copied into their layer in order
     GPUImage *image = nullptr;
-    bool isHDR = stbi_is_hdr(xpos.c_str());
-
-    if (isHDR) {
-        image = TextureLoader::LoadCubemapHDR(commandBuffer, xpos, xneg, ypos, yneg, zpos, zneg, filter);
-    } else {
-        image = TextureLoader::LoadCubemapHDR(commandBuffer, xpos, xneg, ypos, yneg, zpos, zneg, filter);
-    }
-
-    return image;
-}
-
-GPUImage* TextureLoader::LoadCubemapLDR(CommandBuffer* commandBuffer,
-                                        const std::string& xpos,
-                                        const std::string& xneg,
-                                        const std::string& ypos,
-                                        const std::string& yneg,
-                                        const std::string& zpos,
-                                        const std::string& zneg,
-                                        VkFilter filter) {
-    std::array<std::string, 6> images = {
-        xpos, xneg,
-        ypos, yneg,
-        zpos, zneg,
-    };
-
-    int width = 0;
-    int height = 0;
-    int channels = 0;
-    int numChannels = 4;
-
-    uint8_t *data;
-    data = stbi_load(images[0].c_str(), &width, &height, &channels, numChannels);
-
-    uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
-    VkExtent2D extent = { static_cast<uint32_t>(width), static_cast<uint32_t>(height) };
-    size_t size = width * height * numChannels * sizeof(uint8_t);
-    uint32_t arrayLayers = 6;
-
-    VkFormat format;
-    switch (numChannels) {
-        case 1: format = VK_FORMAT_R8_SRGB;       break;
-        case 2: format = VK_FORMAT_R8G8_SRGB;     break;
-        case 3: format = VK_FORMAT_R8G8B8_SRGB;   break;
-        case 4: format = VK_FORMAT_R8G8B8A8_SRGB; break;
-        default: throw std::runtime_error("invalid number of channels while loading texture image");
-    }
-
-    VkOffset3D offset1 = { 0, 0, 0 };
-    VkExtent3D offset2 = { static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1 };
-
-    GPUImage* image = new GPUImage(commandBuffer->GetDevice(), format, extent, mipLevels, arrayLayers, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_USAGE_SAMPLED_BIT);
-    commandBuffer->CopyDataToImage(data, size, image, offset1, offset2, 0, 1, 0, VK_IMAGE_ASPECT_COLOR_BIT);
-    stbi_image_free(data);
-
-    for (uint32_t i = 1; i < 6; i++) {
-        const std::string& filename = images[i];
-        data = stbi_load(filename.c_str(), &width, &height, &channels, numChannels);
-        commandBuffer->CopyDataToImage(data, size, image, offset1, offset2, i, 1, 0, VK_IMAGE_ASPECT_COLOR_BIT);
-        stbi_image_free(data);
-    }
-
-    commandBuffer->GenerateMipmaps(image, filter);
-    commandBuffer->PrepareForShaderRead(image);
-    return image;
-}
-
-GPUImage* TextureLoader::LoadCubemapHDR(CommandBuffer* commandBuffer,
-                                        const std::string& xpos,
-                                        const std::string& xneg,
-                                        const std::string& ypos,
-                                        const std::string& yneg,
-                                        const std::string& zpos,
-                                        const std::string& zneg,
-                                        VkFilter filter) {
-    std::array<std::string, 6> images = {
-        xpos, xneg,
-        ypos, yneg,
-        zpos, zneg,
-    };
-
-    int width = 0;
-    int height = 0;
-    int channels = 0;
-    int numChannels = 4;
-
-    float *data;
-    data = stbi_loadf(images[0].c_str(), &width, &height, &channels, numChannels);
-
-    uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
-    VkExtent2D extent = { static_cast<uint32_t>(width), static_cast<uint32_t>(height) };
-    size_t size = width * height * numChannels * sizeof(float);
-    uint32_t arrayLayers = 6;
-
-    VkFormat format;
-    switch (numChannels) {
-        case 1: format = VK_FORMAT_R32_SFLOAT;          break;
-        case 2: format = VK_FORMAT_R32G32_SFLOAT;       break;
-        case 3: format = VK_FORMAT_R32G32B32_SFLOAT;    break;
-        case 4: format = VK_FORMAT_R32G32B32A32_SFLOAT; break;
-        default: throw std::runtime_error("invalid number of channels while loading texture image");
-    }
-
-    VkOffset3D offset1 = { 0, 0, 0 };
-    VkExtent3D offset2 = { static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1 };
-
-    GPUImage* image = new GPUImage(commandBuffer->GetDevice(), format, extent, mipLevels, arrayLayers, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_USAGE_SAMPLED_BIT);
-    commandBuffer->CopyDataToImage(data, size, image, offset1, offset2, 0, 1, 0, VK_IMAGE_ASPECT_COLOR_BIT);
-    stbi_image_free(data);
-
-    for (uint32_t i = 1; i < 6; i++) {
-        const std::string& filename = images[i];
-        data = stbi_loadf(filename.c_str(), &width, &height, &channels, numChannels);
-        commandBuffer->CopyDataToImage(data, size, image, offset1, offset2, i, 1, 0, VK_IMAGE_ASPECT_COLOR_BIT);
-        stbi_image_free(data);
-    }
+    DecodeInOrder(faces, commandBuffer->GetDevice(), [&](uint32_t face, Decoded& decoded) {
+        if (decoded.format != VK_FORMAT_UNDEFINED) {
+            throw std::runtime_error("[TextureLoader] KTX2 cubemaps are loaded as a whole with Load2D");
+        }
+
+        VkOffset3D offset = { 0, 0, 0 };
+        VkExtent3D extent = { decoded.width, decoded.height, 1 };
+        size_t texelSize = decoded.hdr ? sizeof(float) : sizeof(uint8_t);
+        size_t size = decoded.width * decoded.height * decoded.channels * texelSize;
+
+        if (face == 0) {
+            VkFormat format;
+            switch (decoded.channels) {
+                case 1: format = decoded.hdr ? VK_FORMAT_R32_SFLOAT          : VK_FORMAT_R8_SRGB;       break;
+                case 2: format = decoded.hdr ? VK_FORMAT_R32G32_SFLOAT       : VK_FORMAT_R8G8_SRGB;     break;
+                case 3: format = decoded.hdr ? VK_FORMAT_R32G32B32_SFLOAT    : VK_FORMAT_R8G8B8_SRGB;   break;
+                case 4: format = decoded.hdr ? VK_FORMAT_R32G32B32A32_SFLOAT : VK_FORMAT_R8G8B8A8_SRGB; break;
+                default: throw std::runtime_error("invalid number of channels while loading texture image");
+            }
+
+            uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(decoded.width, decoded.height)))) + 1;
+            uint32_t arrayLayers = 6;
+            image = new GPUImage(commandBuffer->GetDevice(), format, VkExtent2D { decoded.width, decoded.height }, mipLevels, arrayLayers, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_USAGE_SAMPLED_BIT);
+        }
+
+        commandBuffer->CopyDataToImage(decoded.pixels, size, image, offset, extent, face, 1, 0, VK_IMAGE_ASPECT_COLOR_BIT);
+    });
 
     commandBuffer->GenerateMipmaps(image, filter);
     commandBuffer->PrepareForShaderRead(image);
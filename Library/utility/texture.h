@@ -2,6 +2,7 @@
 #define SLIM_UTILITY_TEXTURE_H
 
 #include <list>
+#include <functional>
 #include <array>
 #include <vector>
 #include <string>
@@ -12,17 +13,45 @@
 #include "core/context.h"
 #include "core/commands.h"
 #include "utility/stb.h"
+#include "utility/ktx2.h"
+#include "utility/smartptr.h"
+#include "utility/mappedfile.h"
 
 namespace slim {
 
+    // TextureLoader decodes images with stb and builds their mip chain on the GPU.
+    // KTX2 containers (.ktx2 files, or blobs starting with the KTX2 identifier) are uploaded as they are,
+    // one copy per pre-baked mip level, and are not flipped. BC1 to BC5 images are decoded on the CPU
+    // when the device cannot sample them, other formats the device cannot sample fail to load.
     class TextureLoader {
     public:
+        // an encoded image, either a file on disk or a blob in memory
+        struct Source {
+            std::string    filename = "";
+            const uint8_t* encoded  = nullptr;
+            size_t         size     = 0;
+        };
+
         static void FlipVerticallyOnLoad(bool value = true);
 
         static GPUImage* Load2D(CommandBuffer* commandBuffer,
                                 const std::string& filename,
                                 VkFilter filter = VK_FILTER_LINEAR);
 
+        // decode an encoded image (png, jpg, hdr, ...) held in memory, e.g. embedded in a .glb file
+        static GPUImage* Load2D(CommandBuffer* commandBuffer,
+                                const uint8_t* encoded, size_t size,
+                                VkFilter filter = VK_FILTER_LINEAR);
+
+        // images are decoded by jobs of the device JobSystem and uploaded as soon as they are ready,
+        // GPU images are still created in the order of sources, decode time in ms is optionally reported per image
+        static std::vector<GPUImage*> Load2D(CommandBuffer* commandBuffer,
+                                             const std::vector<Source>& sources,
+                                             VkFilter filter = VK_FILTER_LINEAR,
+                                             std::vector<double>* decodeTimes = nullptr);
+
+        static bool IsFormatSupported(Device* device, VkFormat format);
+
         static GPUImage* LoadCubemap(CommandBuffer* commandBuffer,
                                      const std::string& xpos,
                                      const std::string& xneg,
@@ -33,25 +62,35 @@ namespace slim {
                                      VkFilter filter = VK_FILTER_LINEAR);
 
     private:
-        static GPUImage* Load2DLDR(CommandBuffer* commandBuffer, uint8_t* data, uint32_t width, uint32_t height, uint32_t numChannels, VkFilter filter);
-        static GPUImage* Load2DHDR(CommandBuffer*commandBuffer, float* data, uint32_t width, uint32_t height, uint32_t numChannels, VkFilter filter);
-
-        static GPUImage* LoadCubemapLDR(CommandBuffer* commandBuffer,
-                                        const std::string& xpos,
-                                        const std::string& xneg,
-                                        const std::string& ypos,
-                                        const std::string& yneg,
-                                        const std::string& zpos,
-                                        const std::string& zneg,
-                                        VkFilter filter = VK_FILTER_LINEAR);
-        static GPUImage* LoadCubemapHDR(CommandBuffer* commandBuffer,
-                                        const std::string& xpos,
-                                        const std::string& xneg,
-                                        const std::string& ypos,
-                                        const std::string& yneg,
-                                        const std::string& zpos,
-                                        const std::string& zneg,
-                                        VkFilter filter = VK_FILTER_LINEAR);
+        // decoded pixels, owned by stb until released,
+        // or the mip chain of a KTX2 container, in the mapped file or decoded on the CPU
+        struct Decoded {
+            void*    pixels     = nullptr;
+            uint32_t width      = 0;
+            uint32_t height     = 0;
+            uint32_t channels   = 0;
+            bool     hdr        = false;
+            double   decodeTime = 0.0;
+
+            VkFormat               format  = VK_FORMAT_UNDEFINED;
+            uint32_t               layers  = 1;   // array layers times faces
+            uint32_t               faces   = 1;   // 6 for cubemaps
+            std::vector<KTX2Level> levels  = {};
+            SmartPtr<MappedFile>   file    = nullptr;
+            std::vector<uint8_t>   storage = {};  // levels point into it, so decoded images are moved, never copied
+        };
+
+        static Decoded Decode(const Source& source, VkPhysicalDevice physicalDevice);
+        static void DecodeKTX2(Decoded& decoded, const uint8_t* data, size_t size, VkPhysicalDevice physicalDevice);
+        static void Release(Decoded& decoded);
+        static void DecodeInOrder(const std::vector<Source>& sources, Device* device,
+                                  const std::function<void(uint32_t, Decoded&)>& consume);
+        // shader read transitions of uploaded images are added to the batch, the caller flushes it
+        static GPUImage* Upload2D(CommandBuffer* commandBuffer, const Decoded& decoded, VkFilter filter, BarrierBatch& barriers);
+        static GPUImage* UploadLevels(CommandBuffer* commandBuffer, const Decoded& decoded, BarrierBatch& barriers);
+
+        static GPUImage* Load2DLDR(CommandBuffer* commandBuffer, uint8_t* data, uint32_t width, uint32_t height, uint32_t numChannels, VkFilter filter, BarrierBatch& barriers);
+        static GPUImage* Load2DHDR(CommandBuffer*commandBuffer, float* data, uint32_t width, uint32_t height, uint32_t numChannels, VkFilter filter, BarrierBatch& barriers);
     };
 
 } // end of namespace slim
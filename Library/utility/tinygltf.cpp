@@ -2,5 +2,6 @@
 #include "utility/tinygltf.h"
 
 #define TINYGLTF_IMPLEMENTATION
+#define TINYGLTF_NO_EXTERNAL_IMAGE  // external images are read and decoded by gltf::LoadImages
 // #define TINYGLTF_NOEXCEPTION // optional. disable exception handling.
 #include "tiny_gltf.h"
@@ -5,9 +5,8 @@
 using namespace slim;
 
 Transform::Transform(const glm::mat4 &xform) : localXform(xform) {
-    // compute localToWorld and worldToLocal
     localToWorld = localXform;
-    worldToLocal = glm::inverse(localToWorld);
+    inverseDirty = true;
 }
 
 Transform::Transform(const glm::vec3 &translation,
@@ -17,19 +16,22 @@ Transform::Transform(const glm::vec3 &translation,
     localXform = glm::scale(localXform, scaling);
     localXform = glm::translate(localXform, translation);
 
-    // compute localToWorld and worldToLocal
     localToWorld = localXform;
-    worldToLocal = glm::inverse(localToWorld);
+    inverseDirty = true;
 }
 
 void Transform::ApplyTransform() {
     localToWorld = localXform;
-    worldToLocal = glm::inverse(localToWorld);
+    inverseDirty = true;
 }
 
 void Transform::ApplyTransform(const Transform &parent) {
     localToWorld = parent.localToWorld * localXform;
-    worldToLocal = worldToLocal * parent.worldToLocal;
+    inverseDirty = true;
+}
+
+const glm::mat4& Transform::Local() const {
+    return localXform;
 }
 
 const glm::mat4& Transform::LocalToWorld() const {
@@ -37,6 +39,10 @@ const glm::mat4& Transform::LocalToWorld() const {
 }
 
 const glm::mat4& Transform::WorldToLocal() const {
+    if (inverseDirty) {
+        worldToLocal = glm::inverse(localToWorld);
+        inverseDirty = false;
+    }
     return worldToLocal;
 }
 
@@ -8,10 +8,12 @@
 
 namespace slim {
 
-    class SceneNode;
+    namespace scene {
+        class TransformHierarchy;
+    }
 
     class Transform {
-        friend class SceneNode;
+        friend class scene::TransformHierarchy;
     public:
         // identity transform
         explicit Transform() = default;
@@ -26,7 +28,10 @@ namespace slim {
 
         virtual ~Transform() = default;
 
+        const glm::mat4& Local() const;
         const glm::mat4& LocalToWorld() const;
+
+        // computed on first use after the world transform changed
         const glm::mat4& WorldToLocal() const;
 
         void ApplyTransform();
@@ -39,7 +44,7 @@ namespace slim {
 
         friend std::ostream& operator<<(std::ostream& out, const Transform& transform) {
             out << "localToWorld: " << glm::to_string(transform.localToWorld) << std::endl;
-            out << "worldToLocal: " << glm::to_string(transform.worldToLocal) << std::endl;
+            out << "worldToLocal: " << glm::to_string(transform.WorldToLocal()) << std::endl;
             return out;
         }
 
@@ -49,7 +54,8 @@ namespace slim {
 
         // local/world transform (hierarchical)
         glm::mat4 localToWorld = glm::identity<glm::mat4>();
-        glm::mat4 worldToLocal = glm::identity<glm::mat4>();
+        mutable glm::mat4 worldToLocal = glm::identity<glm::mat4>();
+        mutable bool inverseDirty = false;
     };
 
 } // end of namespace slim
@@ -0,0 +1,380 @@
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <random>
+#include "common.h"
+
+// Measure how many operations can be done per second
+template <typename Func>
+double Throughput(uint32_t count, Func&& func) {
+    auto start = std::chrono::high_resolution_clock::now();
+    func();
+    auto end = std::chrono::high_resolution_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+    return static_cast<double>(count) / std::max(seconds, 1e-9);
+}
+
+// Compare per-request uniform buffer creation against linear sub-allocation
+TEST(SlimBenchmark, UniformBufferAllocation) {
+    auto contextDesc = ContextDesc();
+    auto context= SlimPtr<Context>(contextDesc);
+    auto device = SlimPtr<Device>(context);
+
+    constexpr uint32_t frames = 16;
+    constexpr uint32_t requests = 2048;
+    constexpr size_t size = sizeof(glm::mat4) * 2;
+    size_t alignment = context->GetPhysicalDeviceProperties().limits.minUniformBufferOffsetAlignment;
+
+    auto pool = SlimPtr<BufferPool<UniformBuffer>>(device);
+    double poolRate = Throughput(frames * requests, [&]() {
+        for (uint32_t frame = 0; frame < frames; frame++) {
+            for (uint32_t i = 0; i < requests; i++) {
+                pool->Request(size);
+            }
+            pool->Reset();
+        }
+    });
+
+    auto allocator = SlimPtr<BufferAllocator<UniformBuffer>>(device, alignment);
+    double allocatorRate = Throughput(frames * requests, [&]() {
+        for (uint32_t frame = 0; frame < frames; frame++) {
+            for (uint32_t i = 0; i < requests; i++) {
+                BufferAlloc alloc = allocator->Request(size);
+                EXPECT_EQ(alloc.offset % alignment, size_t(0));
+            }
+            allocator->Reset();
+        }
+    });
+
+    // chunks should be reused across frames
+    EXPECT_EQ(allocator->GetChunkCount(), size_t(1));
+
+    std::cout << "[BufferPool]      " << poolRate      << " allocs/sec" << std::endl;
+    std::cout << "[BufferAllocator] " << allocatorRate << " allocs/sec" << std::endl;
+}
+
+// Compare scalar frustum test against the SIMD batched frustum test
+TEST(SlimBenchmark, FrustumCulling) {
+    constexpr uint32_t count = 100000;
+    constexpr uint32_t rounds = 100;
+
+    glm::mat4 proj = glm::perspective(1.05f, 16.0f / 9.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0, 0.0, 0.0), glm::vec3(0.0, 0.0, -1.0), glm::vec3(0.0, 1.0, 0.0));
+    Frustum frustum(proj * view);
+
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> extent(0.1f, 2.0f);
+
+    std::vector<BoundingBox> boxes;
+    BoundingBoxes batch;
+    for (uint32_t i = 0; i < count; i++) {
+        glm::vec3 p = glm::vec3(position(rng), position(rng), position(rng));
+        glm::vec3 e = glm::vec3(extent(rng), extent(rng), extent(rng));
+        boxes.push_back(BoundingBox(p - e, p + e));
+        batch.Add(boxes.back());
+    }
+
+    std::vector<uint8_t> expected(count);
+    double scalarRate = Throughput(count * rounds, [&]() {
+        for (uint32_t r = 0; r < rounds; r++) {
+            for (uint32_t i = 0; i < count; i++) {
+                expected[i] = frustum.Intersect(boxes[i]);
+            }
+        }
+    });
+
+    std::vector<uint8_t> actual;
+    double batchRate = Throughput(count * rounds, [&]() {
+        for (uint32_t r = 0; r < rounds; r++) {
+            frustum.Intersect(batch, actual);
+        }
+    });
+
+    CompareSequence(expected.data(), actual.data(), count);
+
+    std::cout << "[Frustum::Intersect (scalar)] " << scalarRate << " boxes/sec" << std::endl;
+    std::cout << "[Frustum::Intersect (batch)]  " << batchRate  << " boxes/sec" << std::endl;
+}
+
+// Compare compiling the render graph every frame against reusing the compiled graph
+TEST(SlimBenchmark, RenderGraphSetup) {
+    auto contextDesc = ContextDesc()
+        .EnableGraphics();
+    auto context= SlimPtr<Context>(contextDesc);
+    auto device = SlimPtr<Device>(context);
+
+    constexpr uint32_t frames = 256;
+    auto extent = VkExtent2D { 64, 64 };
+    auto format = VK_FORMAT_R8G8B8A8_UNORM;
+    auto image = SlimPtr<GPUImage>(device, format, extent, 1, 1, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT);
+    auto frame = SlimPtr<RenderFrame>(device, image);
+
+    // a deferred-like graph: gbuffer -> lighting -> bloom -> composite
+    auto build = [&](RenderGraph& graph) {
+        auto backBuffer = graph.CreateResource(frame->GetBackBuffer());
+        auto albedo = graph.CreateResource(extent, format, VK_SAMPLE_COUNT_1_BIT);
+        auto normal = graph.CreateResource(extent, format, VK_SAMPLE_COUNT_1_BIT);
+        auto depth = graph.CreateResource(extent, VK_FORMAT_D32_SFLOAT, VK_SAMPLE_COUNT_1_BIT);
+        auto lighting = graph.CreateResource(extent, format, VK_SAMPLE_COUNT_1_BIT);
+        auto bloom = graph.CreateResource(extent, format, VK_SAMPLE_COUNT_1_BIT);
+
+        auto gbufferPass = graph.CreateRenderPass("gbuffer");
+        gbufferPass->SetColor(albedo, ClearValue(0.0f, 0.0f, 0.0f, 1.0f));
+        gbufferPass->SetColor(normal, ClearValue(0.0f, 0.0f, 0.0f, 1.0f));
+        gbufferPass->SetDepth(depth, ClearValue(1.0f, 0));
+        gbufferPass->Execute([](const RenderInfo &) { });
+
+        auto lightingPass = graph.CreateRenderPass("lighting");
+        lightingPass->SetColor(lighting, ClearValue(0.0f, 0.0f, 0.0f, 1.0f));
+        lightingPass->SetTexture(albedo);
+        lightingPass->SetTexture(normal);
+        lightingPass->Execute([](const RenderInfo &) { });
+
+        auto bloomPass = graph.CreateRenderPass("bloom");
+        bloomPass->SetColor(bloom, ClearValue(0.0f, 0.0f, 0.0f, 1.0f));
+        bloomPass->SetTexture(lighting);
+        bloomPass->Execute([](const RenderInfo &) { });
+
+        auto compositePass = graph.CreateRenderPass("composite");
+        compositePass->SetColor(backBuffer, ClearValue(0.0f, 0.0f, 0.0f, 1.0f));
+        compositePass->SetTexture(lighting);
+        compositePass->SetTexture(bloom);
+        compositePass->Execute([](const RenderInfo &) { });
+    };
+
+    // only graph construction, compilation and recording are timed
+    auto measure = [&](bool cached) {
+        double seconds = 0.0;
+        for (uint32_t i = 0; i < frames; i++) {
+            double rate = Throughput(1, [&]() {
+                RenderGraph graph(frame);
+                if (!cached) graph.DisableCompilationCache();
+                build(graph);
+                graph.Execute();
+            });
+            seconds += 1.0 / rate;
+            device->WaitIdle();
+            frame->Reset();
+        }
+        return static_cast<double>(frames) / seconds;
+    };
+
+    double uncachedRate = measure(false);
+    double cachedRate = measure(true);
+
+    std::cout << "[RenderGraph (compile every frame)] " << uncachedRate << " frames/sec" << std::endl;
+    std::cout << "[RenderGraph (compilation cache)]   " << cachedRate   << " frames/sec" << std::endl;
+}
+
+// Measure texture decoding on the device JobSystem while loading the Sponza sample scene
+TEST(SlimBenchmark, TextureDecoding) {
+    std::string path = GetUserAsset("Scenes/Sponza/glTF/Sponza.gltf");
+    if (!filesystem::exists(path)) {
+        GTEST_SKIP() << "sample scene not found: " << path;
+    }
+
+    auto contextDesc = ContextDesc()
+        .EnableGraphics();
+    auto context= SlimPtr<Context>(contextDesc);
+    auto device = SlimPtr<Device>(context);
+
+    auto load = [&](size_t& images) {
+        auto builder = SlimPtr<scene::Builder>(device);
+        auto model = gltf::Model { };
+        auto start = std::chrono::high_resolution_clock::now();
+        model.Load(builder, path);
+        auto end = std::chrono::high_resolution_clock::now();
+        images = model.images.size();
+        return std::chrono::duration<double>(end - start).count();
+    };
+
+    // the first load also starts the job system
+    size_t coldImages = 0;
+    size_t warmImages = 0;
+    double cold = load(coldImages);
+    double warm = load(warmImages);
+
+    EXPECT_EQ(coldImages, warmImages);
+
+    uint32_t threads = device->GetJobSystem()->GetThreadCount();
+    std::cout << "[gltf::Model::Load (cold)] " << cold << " sec, " << coldImages << " images, " << threads << " threads" << std::endl;
+    std::cout << "[gltf::Model::Load (warm)] " << warm << " sec, " << warmImages << " images, " << threads << " threads" << std::endl;
+}
+
+// Measure mesh optimization speed and the vertex cache efficiency it gains on a shuffled, unwelded mesh
+TEST(SlimBenchmark, MeshOptimization) {
+    using Vertex = GeometryData::Vertex;
+
+    GeometryData sphere = Sphere { 1.0f, 256, 256 }.Create();
+    std::vector<uint32_t> triangles(sphere.indices.size() / 3);
+    std::iota(triangles.begin(), triangles.end(), 0);
+    std::shuffle(triangles.begin(), triangles.end(), std::mt19937(0));
+    std::vector<Vertex> vertices;
+    for (uint32_t t : triangles) {
+        for (uint32_t k = 0; k < 3; k++) {
+            vertices.push_back(sphere.vertices[sphere.indices[t * 3 + k]]);
+        }
+    }
+
+    auto mesh = SlimPtr<scene::Mesh>();
+    mesh->SetVertexBuffer(vertices);
+    mesh->SetIndexBuffer(GenerateSequence<uint32_t>(vertices.size()));
+
+    scene::MeshOptimizerStats stats;
+    double rate = Throughput(triangles.size(), [&]() {
+        stats = scene::MeshOptimizer::Optimize(mesh.get());
+    });
+    EXPECT_LT(stats.after.acmr, stats.before.acmr);
+
+    std::cout << "[MeshOptimizer]       " << rate << " triangles/sec" << std::endl;
+    std::cout << "[MeshOptimizer ACMR]  " << stats.before.acmr << " -> " << stats.after.acmr << std::endl;
+    std::cout << "[MeshOptimizer ATVR]  " << stats.before.atvr << " -> " << stats.after.atvr << std::endl;
+    std::cout << "[MeshOptimizer Verts] " << stats.verticesBefore << " -> " << stats.verticesAfter << std::endl;
+}
+
+// Measure level of detail generation speed and the triangle counts it produces
+TEST(SlimBenchmark, LodGeneration) {
+    GeometryData sphere = Sphere { 1.0f, 256, 256 }.Create();
+    auto mesh = SlimPtr<scene::Mesh>();
+    mesh->SetVertexBuffer(sphere.vertices);
+    mesh->SetIndexBuffer(sphere.indices);
+
+    uint32_t levels = 0;
+    double rate = Throughput(sphere.indices.size() / 3, [&]() {
+        levels = scene::MeshSimplifier::GenerateLods(mesh.get());
+    });
+    EXPECT_GT(levels, 1u);
+
+    std::cout << "[MeshSimplifier] " << rate << " triangles/sec" << std::endl;
+    for (uint32_t level = 0; level < levels; level++) {
+        scene::MeshLod lod = mesh->GetLod(level);
+        std::cout << "[MeshSimplifier LOD " << level << "] " << lod.indexCount / 3 << " triangles, error " << lod.error << std::endl;
+    }
+}
+
+// Measure world transform updates of a large, mostly static hierarchy
+TEST(SlimBenchmark, TransformUpdate) {
+    auto contextDesc = ContextDesc();
+    auto context = SlimPtr<Context>(contextDesc);
+    auto device = SlimPtr<Device>(context);
+    auto builder = SlimPtr<scene::Builder>(device);
+
+    constexpr uint32_t count = 200000;
+    constexpr uint32_t rounds = 100;
+
+    // a wide and shallow tree, like the node hierarchy of a large glTF scene
+    std::mt19937 rng(0);
+    auto root = builder->CreateNode("root");
+    std::vector<scene::Node*> nodes = { root };
+    for (uint32_t i = 1; i < count; i++) {
+        auto node = builder->CreateNode(nodes[rng() % std::min<size_t>(nodes.size(), 1024)]);
+        node->Translate(1.0f, 0.0f, 0.0f);
+        nodes.push_back(node);
+    }
+
+    double buildRate = Throughput(count, [&]() {
+        root->ApplyTransform();
+    });
+    double staticRate = Throughput(count * rounds, [&]() {
+        for (uint32_t r = 0; r < rounds; r++) {
+            root->ApplyTransform();
+        }
+    });
+    double movingRate = Throughput(count * rounds, [&]() {
+        for (uint32_t r = 0; r < rounds; r++) {
+            nodes[count - 1 - r]->Translate(0.0f, 1.0f, 0.0f);
+            root->ApplyTransform();
+        }
+    });
+    EXPECT_EQ(nodes[count - 1]->GetTransform().LocalToWorld()[3].y, 1.0f);
+
+    std::cout << "[TransformHierarchy (rebuild)] " << buildRate  << " nodes/sec" << std::endl;
+    std::cout << "[TransformHierarchy (static)]  " << staticRate << " nodes/sec" << std::endl;
+    std::cout << "[TransformHierarchy (moving)]  " << movingRate << " nodes/sec" << std::endl;
+}
+
+// Measure depth-first traversal of a large pooled scene graph
+TEST(SlimBenchmark, NodeTraversal) {
+    auto contextDesc = ContextDesc();
+    auto context = SlimPtr<Context>(contextDesc);
+    auto device = SlimPtr<Device>(context);
+    auto builder = SlimPtr<scene::Builder>(device);
+
+    constexpr uint32_t count = 200000;
+    constexpr uint32_t rounds = 100;
+
+    std::mt19937 rng(0);
+    auto root = builder->CreateNode("root");
+    std::vector<scene::Node*> nodes = { root };
+    for (uint32_t i = 1; i < count; i++) {
+        nodes.push_back(builder->CreateNode(nodes[rng() % std::min<size_t>(nodes.size(), 1024)]));
+    }
+
+    uint32_t visited = 0;
+    double rate = Throughput(count * rounds, [&]() {
+        for (uint32_t r = 0; r < rounds; r++) {
+            root->ForEach([&](scene::Node* node) {
+                visited += node->IsVisible();
+                return true;
+            });
+        }
+    });
+    EXPECT_EQ(visited, count * rounds);
+
+    std::cout << "[Node::ForEach] " << rate << " nodes/sec" << std::endl;
+}
+
+// Measure how frustum culling of many boxes scales with the number of job system threads
+TEST(SlimBenchmark, JobScaling) {
+    constexpr uint32_t count = 1000000;
+    constexpr uint32_t rounds = 20;
+    constexpr uint32_t grain = 4096;
+
+    glm::mat4 proj = glm::perspective(1.05f, 16.0f / 9.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0, 0.0, 0.0), glm::vec3(0.0, 0.0, -1.0), glm::vec3(0.0, 1.0, 0.0));
+    Frustum frustum(proj * view);
+
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> extent(0.1f, 2.0f);
+
+    std::vector<BoundingBox> boxes;
+    for (uint32_t i = 0; i < count; i++) {
+        glm::vec3 p = glm::vec3(position(rng), position(rng), position(rng));
+        glm::vec3 e = glm::vec3(extent(rng), extent(rng), extent(rng));
+        boxes.push_back(BoundingBox(p - e, p + e));
+    }
+
+    std::vector<uint8_t> expected(count);
+    for (uint32_t i = 0; i < count; i++) {
+        expected[i] = frustum.Intersect(boxes[i]);
+    }
+
+    uint32_t maxThreads = JobSystem::GetDefaultWorkerCount() + 1;
+    for (uint32_t threads = 1; threads <= maxThreads; threads++) {
+        auto jobs = SlimPtr<JobSystem>(threads - 1);
+        std::vector<uint8_t> visible(count);
+        double rate = Throughput(count * rounds, [&]() {
+            for (uint32_t r = 0; r < rounds; r++) {
+                jobs->ParallelFor(0, count, grain, [&](uint32_t first, uint32_t last) {
+                    for (uint32_t i = first; i < last; i++) {
+                        visible[i] = frustum.Intersect(boxes[i]);
+                    }
+                });
+            }
+        });
+        EXPECT_EQ(visible, expected);
+
+        std::cout << "[JobSystem (" << threads << " threads)] " << rate << " boxes/sec" << std::endl;
+    }
+}
+
+int main(int argc, char **argv) {
+    // prepare for slim environment
+    slim::Initialize();
+
+    // run selected tests
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -1,3 +1,11 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <set>
+#include <tuple>
+#include <unordered_set>
 #include "common.h"
 
 // Test compute shader
@@ -42,6 +50,964 @@ TEST(SlimCore, ComputeShader) {
     }
 }
 
+// Test upload manager with a ring smaller than the uploaded data
+TEST(SlimCore, UploadManager) {
+    auto contextDesc = ContextDesc()
+        .EnableCompute();
+    auto context= SlimPtr<Context>(contextDesc);
+    auto device = SlimPtr<Device>(context);
+    auto data = GenerateSequence<uint32_t>(4096);
+    auto dstBuffer = SlimPtr<Buffer>(device, BufferSize(data), VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+    auto readback = SlimPtr<Buffer>(device, BufferSize(data), VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+
+    // upload in chunks, forcing the staging ring to wrap around
+    auto uploader = SlimPtr<UploadManager>(device, 4096);
+    constexpr uint32_t chunk = 256;
+    for (uint32_t i = 0; i < data.size(); i += chunk) {
+        uploader->Upload(dstBuffer, i * sizeof(uint32_t), data.data() + i, chunk * sizeof(uint32_t));
+    }
+    uploader->Flush();
+    EXPECT_EQ(uploader->GetPendingCopies(), size_t(0));
+
+    device->Execute([&](CommandBuffer* commandBuffer) {
+        commandBuffer->CopyBufferToBuffer(dstBuffer, 0, readback, 0, BufferSize(data));
+    }, VK_QUEUE_COMPUTE_BIT);
+
+    CompareSequence(data.data(), readback->GetData<uint32_t>(), data.size());
+}
+
+// Test uploads submitted without waiting are acquired by the next submission of the device
+TEST(SlimCore, UploadManagerAcquirePending) {
+    auto contextDesc = ContextDesc()
+        .EnableCompute();
+    auto context= SlimPtr<Context>(contextDesc);
+    auto device = SlimPtr<Device>(context);
+    auto data = GenerateSequence<uint32_t>(4096);
+    auto dstBuffer = SlimPtr<Buffer>(device, BufferSize(data), VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+    auto readback = SlimPtr<Buffer>(device, BufferSize(data), VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+
+    auto uploader = SlimPtr<UploadManager>(device);
+    uploader->Upload(dstBuffer, data);
+    UploadTicket ticket = uploader->Submit();
+
+    device->Execute([&](CommandBuffer* commandBuffer) {
+        commandBuffer->CopyBufferToBuffer(dstBuffer, 0, readback, 0, BufferSize(data));
+    }, VK_QUEUE_COMPUTE_BIT);
+
+    EXPECT_TRUE(uploader->IsComplete(ticket));
+    CompareSequence(data.data(), readback->GetData<uint32_t>(), data.size());
+}
+
+// Test descriptors are cached per frame by layout and bound resources
+TEST(SlimCore, DescriptorCache) {
+    auto contextDesc = ContextDesc()
+        .EnableCompute();
+    auto context= SlimPtr<Context>(contextDesc);
+    auto device = SlimPtr<Device>(context);
+    auto shader = SlimPtr<spirv::ComputeShader>(device, "shaders/simple.comp.spv");
+    auto pipeline = SlimPtr<Pipeline>(
+        device,
+        ComputePipelineDesc()
+            .SetComputeShader(shader)
+            .SetPipelineLayout(PipelineLayoutDesc()
+                .AddBinding("InputBuffer",  SetBinding { 0, 0 }, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                .AddBinding("OutputBuffer", SetBinding { 0, 1 }, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            )
+    );
+    auto renderFrame = SlimPtr<RenderFrame>(device);
+    auto buffer = SlimPtr<Buffer>(device, 1024, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+    std::vector<BufferAlloc> resources0 = { BufferAlloc(buffer, 0, 512), BufferAlloc(buffer, 512, 512) };
+    std::vector<BufferAlloc> resources1 = { BufferAlloc(buffer, 512, 512), BufferAlloc(buffer, 0, 512) };
+
+    bool created = false;
+    Descriptor* descriptor0 = renderFrame->RequestDescriptor(pipeline->Layout(), resources0, created);
+    EXPECT_TRUE(created);
+    Descriptor* descriptor1 = renderFrame->RequestDescriptor(pipeline->Layout(), resources0, created);
+    EXPECT_FALSE(created);
+    Descriptor* descriptor2 = renderFrame->RequestDescriptor(pipeline->Layout(), resources1, created);
+    EXPECT_TRUE(created);
+    Descriptor* descriptor3 = renderFrame->RequestDescriptor(pipeline->Layout(), resources0, created, 1);
+    EXPECT_TRUE(created);
+
+    // same resources share a descriptor, different resources or slots do not
+    EXPECT_EQ(descriptor0, descriptor1);
+    EXPECT_NE(descriptor0, descriptor2);
+    EXPECT_NE(descriptor0, descriptor3);
+
+    // descriptor sets do not outlive the frame
+    renderFrame->Reset();
+    renderFrame->RequestDescriptor(pipeline->Layout(), resources0, created);
+    EXPECT_TRUE(created);
+}
+
+// Test compute culling generates one indirect draw per visible instance
+TEST(SlimCore, GPUCulling) {
+    auto contextDesc = ContextDesc()
+        .EnableCompute()
+        .EnableMultiDraw()
+        .EnableDrawIndirectCount();
+    auto context= SlimPtr<Context>(contextDesc);
+    auto device = SlimPtr<Device>(context);
+
+    // a row of triangles with alternating materials, some of them outside of the view
+    auto builder = SlimPtr<scene::Builder>(device);
+    auto mesh = builder->CreateMesh();
+    mesh->SetVertexBuffer(std::vector<glm::vec3> { glm::vec3(-1.0, -1.0, 0.0), glm::vec3(1.0, -1.0, 0.0), glm::vec3(0.0, 1.0, 0.0) });
+    mesh->SetIndexBuffer(std::vector<uint32_t> { 0, 1, 2 });
+    mesh->SetBoundingBox(BoundingBox(glm::vec3(-1.0, -1.0, 0.0), glm::vec3(1.0, 1.0, 0.0)));
+    Material* materials[2] = { builder->CreateMaterial(), builder->CreateMaterial() };
+
+    constexpr uint32_t count = 16;
+    auto root = builder->CreateNode("root");
+    std::vector<scene::Node*> nodes;
+    for (uint32_t i = 0; i < count; i++) {
+        auto node = builder->CreateNode(root);
+        node->Translate(-40.0f + 5.0f * i, 0.0f, -20.0f);
+        node->SetDraw(mesh, materials[i % 2]);
+        nodes.push_back(node);
+    }
+    root->ApplyTransform();
+    builder->Build();
+
+    glm::mat4 proj = glm::perspective(1.05f, 1.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0, 0.0, 0.0), glm::vec3(0.0, 0.0, -1.0), glm::vec3(0.0, 1.0, 0.0));
+    Frustum frustum(proj * view);
+
+    // expected visible instances per batch
+    const auto &batches = builder->GetInstanceBatches();
+    ASSERT_EQ(batches.size(), size_t(2));
+    std::vector<uint32_t> expected(batches.size(), 0);
+    for (uint32_t i = 0; i < count; i++) {
+        if (frustum.Intersect(mesh->GetBoundingBox(nodes[i]->GetTransform()))) {
+            expected[i % 2]++;
+        }
+    }
+    ASSERT_GT(expected[0] + expected[1], 0U);
+    ASSERT_LT(expected[0] + expected[1], count);
+
+    auto culling = SlimPtr<GPUCulling>(builder, SlimPtr<spirv::ComputeShader>(device, "shaders/culling.comp.spv"));
+    ASSERT_TRUE(culling->IsCompacted());
+
+    size_t commandSize = count * GPUCulling::COMMAND_STRIDE;
+    size_t countSize = batches.size() * sizeof(uint32_t);
+    size_t instanceSize = count * sizeof(scene::InstanceData);
+    auto commandReadback = SlimPtr<Buffer>(device, commandSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+    auto countReadback = SlimPtr<Buffer>(device, countSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+    auto instanceReadback = SlimPtr<Buffer>(device, instanceSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+
+    device->Execute([&](RenderFrame *renderFrame, CommandBuffer *commandBuffer) {
+        culling->Cull(renderFrame, commandBuffer, proj * view);
+        commandBuffer->PrepareForBuffer(culling->GetDrawBuffer(), VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+        commandBuffer->PrepareForBuffer(culling->GetCountBuffer(), VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+        commandBuffer->CopyBufferToBuffer(culling->GetDrawBuffer(), 0, commandReadback, 0, commandSize);
+        commandBuffer->CopyBufferToBuffer(culling->GetCountBuffer(), 0, countReadback, 0, countSize);
+        commandBuffer->CopyBufferToBuffer(builder->GetInstanceBuffer(), 0, instanceReadback, 0, instanceSize);
+    }, VK_QUEUE_COMPUTE_BIT);
+
+    // visible instances are compacted to the front of each batch
+    auto commands = commandReadback->GetData<VkDrawIndexedIndirectCommand>();
+    auto counts = countReadback->GetData<uint32_t>();
+    auto instances = instanceReadback->GetData<scene::InstanceData>();
+    for (uint32_t b = 0; b < batches.size(); b++) {
+        EXPECT_EQ(counts[b], expected[b]);
+        for (uint32_t k = 0; k < counts[b]; k++) {
+            const auto &command = commands[batches[b].firstInstance + k];
+            EXPECT_EQ(command.indexCount, 3U);
+            EXPECT_EQ(command.instanceCount, 1U);
+            ASSERT_GE(command.firstInstance, batches[b].firstInstance);
+            ASSERT_LT(command.firstInstance, batches[b].firstInstance + batches[b].instanceCount);
+
+            const auto &instance = instances[command.firstInstance];
+            BoundingBox box(glm::vec3(instance.boundsMin), glm::vec3(instance.boundsMax));
+            EXPECT_TRUE(frustum.Intersect(instance.model * box));
+        }
+    }
+}
+
+// Test two-phase occlusion culling draws instances in front of a wall and culls the ones behind it
+TEST(SlimCore, OcclusionCulling) {
+    VkExtent2D extent = OcclusionCulling::GetPyramidExtent(VkExtent2D { 1920, 1080 });
+    EXPECT_EQ(extent.width, 1024U);
+    EXPECT_EQ(extent.height, 512U);
+    EXPECT_EQ(OcclusionCulling::GetPyramidLevels(extent), 11U);
+
+    auto contextDesc = ContextDesc()
+        .EnableCompute()
+        .EnableMultiDraw()
+        .EnableDrawIndirectCount();
+    auto context= SlimPtr<Context>(contextDesc);
+    auto device = SlimPtr<Device>(context);
+
+    // a row of triangles, alternating between the front and the back of the wall
+    auto builder = SlimPtr<scene::Builder>(device);
+    auto mesh = builder->CreateMesh();
+    mesh->SetVertexBuffer(std::vector<glm::vec3> { glm::vec3(-1.0, -1.0, 0.0), glm::vec3(1.0, -1.0, 0.0), glm::vec3(0.0, 1.0, 0.0) });
+    mesh->SetIndexBuffer(std::vector<uint32_t> { 0, 1, 2 });
+    mesh->SetBoundingBox(BoundingBox(glm::vec3(-1.0, -1.0, 0.0), glm::vec3(1.0, 1.0, 0.0)));
+    Material* material = builder->CreateMaterial();
+
+    constexpr uint32_t count = 8;
+    auto root = builder->CreateNode("root");
+    std::vector<scene::Node*> nodes;
+    for (uint32_t i = 0; i < count; i++) {
+        auto node = builder->CreateNode(root);
+        node->Translate(-2.0f + 0.5f * i, 0.0f, i % 2 == 0 ? -5.0f : -20.0f);
+        node->SetDraw(mesh, material);
+        nodes.push_back(node);
+    }
+    root->ApplyTransform();
+    builder->Build();
+
+    glm::mat4 proj = glm::perspective(1.05f, 1.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0, 0.0, 0.0), glm::vec3(0.0, 0.0, -1.0), glm::vec3(0.0, 1.0, 0.0));
+
+    // depth of a wall at a distance of 10, filling the whole view
+    glm::vec4 wall = proj * glm::vec4(0.0f, 0.0f, -10.0f, 1.0f);
+    VkClearColorValue clear = {};
+    clear.float32[0] = wall.z / wall.w;
+    auto depth = SlimPtr<GPUImage>(device, VK_FORMAT_R32_SFLOAT, VkExtent2D { 200, 150 }, 1, 1, VK_SAMPLE_COUNT_1_BIT,
+                                   VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+
+    auto occlusion = SlimPtr<OcclusionCulling>(builder,
+        SlimPtr<spirv::ComputeShader>(device, "shaders/occlusion.comp.spv"),
+        SlimPtr<spirv::ComputeShader>(device, "shaders/pyramid.comp.spv"));
+    occlusion->SetReadback(true);
+    occlusion->Prepare(VkExtent2D { 200, 150 });
+    EXPECT_EQ(occlusion->GetDepthPyramid()->Width(), 128U);
+    EXPECT_EQ(occlusion->GetDepthPyramid()->Height(), 128U);
+    EXPECT_EQ(occlusion->GetDepthPyramid()->MipLevels(), 8U);
+
+    auto readback = SlimPtr<Buffer>(device, 2 * sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+    auto frame = [&]() {
+        device->Execute([&](RenderFrame *renderFrame, CommandBuffer *commandBuffer) {
+            occlusion->Cull(renderFrame, commandBuffer, proj * view, OcclusionCulling::Phase::Early);
+            commandBuffer->ClearColor(depth, clear);
+            occlusion->BuildPyramid(renderFrame, commandBuffer, depth);
+            occlusion->Cull(renderFrame, commandBuffer, proj * view, OcclusionCulling::Phase::Late);
+            for (auto phase : { OcclusionCulling::Phase::Early, OcclusionCulling::Phase::Late }) {
+                Buffer* counts = occlusion->GetCulling(phase)->GetCountBuffer();
+                commandBuffer->PrepareForBuffer(counts, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+                commandBuffer->CopyBufferToBuffer(counts, 0, readback, static_cast<uint32_t>(phase) * sizeof(uint32_t), sizeof(uint32_t));
+            }
+        }, VK_QUEUE_COMPUTE_BIT);
+        return std::make_pair(readback->GetData<uint32_t>()[0], readback->GetData<uint32_t>()[1]);
+    };
+
+    // nothing was visible before the first frame, so its late phase draws what is in front of the wall
+    auto [early, late] = frame();
+    EXPECT_EQ(early, 0U);
+    EXPECT_EQ(late, count / 2);
+
+    // after that the early phase draws them, and nothing became visible
+    std::tie(early, late) = frame();
+    EXPECT_EQ(early, count / 2);
+    EXPECT_EQ(late, 0U);
+
+    std::unordered_set<const scene::Node*> occluded;
+    occlusion->GetOccludedNodes(occluded);
+    EXPECT_EQ(occluded.size(), size_t(count / 2));
+    for (uint32_t i = 0; i < count; i++) {
+        EXPECT_EQ(occluded.count(nodes[i]), i % 2 == 0 ? 0U : 1U);
+    }
+}
+
+// Test meshes are sub-allocated from shared buffers and freed ranges are reused
+TEST(SlimCore, GeometryArena) {
+    auto contextDesc = ContextDesc()
+        .EnableCompute();
+    auto context= SlimPtr<Context>(contextDesc);
+    auto device = SlimPtr<Device>(context);
+
+    // freed neighbours coalesce back into a single range
+    constexpr uint64_t chunkSize = 4096;
+    auto arena = SlimPtr<scene::GeometryArena>(device, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY, "Test Arena", chunkSize);
+    auto a = arena->Allocate(1000, 12);
+    auto b = arena->Allocate(1000, 12);
+    auto c = arena->Allocate(1000, 12);
+    EXPECT_EQ(arena->GetChunkCount(), size_t(1));
+    EXPECT_EQ(b.offset % 12, uint64_t(0));
+    EXPECT_EQ(c.offset % 12, uint64_t(0));
+    arena->Free(a);
+    arena->Free(c);
+    arena->Free(b);
+    EXPECT_EQ(arena->GetAllocatedBytes(), uint64_t(0));
+    auto full = arena->Allocate(chunkSize, 1);
+    EXPECT_EQ(full.offset, uint64_t(0));
+    EXPECT_EQ(arena->GetChunkCount(), size_t(1));
+
+    // oversized requests get a chunk of their own
+    arena->Allocate(chunkSize * 2, 1);
+    EXPECT_EQ(arena->GetChunkCount(), size_t(2));
+
+    // meshes of a scene share one vertex and one index buffer
+    auto builder = SlimPtr<scene::Builder>(device);
+    auto createMesh = [&]() {
+        auto mesh = builder->CreateMesh();
+        mesh->SetVertexBuffer(std::vector<glm::vec3>(64, glm::vec3(0.0f)));
+        mesh->SetIndexBuffer(GenerateSequence<uint16_t>(96));
+        return mesh;
+    };
+    std::vector<scene::Mesh*> meshes = { createMesh(), createMesh(), createMesh() };
+    builder->Build();
+    EXPECT_EQ(builder->GetVertexArena()->GetChunkCount(), size_t(1));
+    EXPECT_EQ(builder->GetIndexArena()->GetChunkCount(), size_t(1));
+    for (uint32_t i = 1; i < meshes.size(); i++) {
+        EXPECT_EQ(std::get<0>(meshes[i]->GetVertexBuffer(0)), std::get<0>(meshes[0]->GetVertexBuffer(0)));
+        EXPECT_EQ(std::get<0>(meshes[i]->GetIndexBuffer()), std::get<0>(meshes[0]->GetIndexBuffer()));
+        EXPECT_EQ(meshes[i]->GetBaseVertex(), meshes[i - 1]->GetBaseVertex() + 64);
+        EXPECT_EQ(meshes[i]->GetFirstIndex(), meshes[i - 1]->GetFirstIndex() + 96);
+    }
+
+    // a removed mesh leaves a hole, which is filled by the next mesh of the same size
+    int32_t baseVertex = meshes[1]->GetBaseVertex();
+    uint32_t firstIndex = meshes[1]->GetFirstIndex();
+    builder->RemoveMesh(meshes[1]);
+    auto mesh = createMesh();
+    builder->Build();
+    EXPECT_EQ(mesh->GetBaseVertex(), baseVertex);
+    EXPECT_EQ(mesh->GetFirstIndex(), firstIndex);
+    EXPECT_EQ(builder->GetVertexArena()->GetAllocatedBytes(), uint64_t(3 * 64 * sizeof(glm::vec3)));
+}
+
+TEST(SlimCore, BinaryGLTF) {
+    auto contextDesc = ContextDesc()
+        .EnableCompute();
+    auto context= SlimPtr<Context>(contextDesc);
+    auto device = SlimPtr<Device>(context);
+
+    // a single triangle with 16 bit indices
+    std::vector<float> positions = { 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 2.0f, -1.0f };
+    std::vector<uint16_t> indices = { 0, 1, 2 };
+    std::string json = R"({
+        "asset": { "version": "2.0" },
+        "buffers": [ { "byteLength": 42 } ],
+        "bufferViews": [ { "buffer": 0, "byteOffset": 0, "byteLength": 36 },
+                         { "buffer": 0, "byteOffset": 36, "byteLength": 6 } ],
+        "accessors": [ { "bufferView": 0, "componentType": 5126, "count": 3, "type": "VEC3" },
+                       { "bufferView": 1, "componentType": 5123, "count": 3, "type": "SCALAR" } ],
+        "materials": [ { } ],
+        "meshes": [ { "primitives": [ { "attributes": { "POSITION": 0 }, "indices": 1, "material": 0 } ] } ],
+        "nodes": [ { "mesh": 0 } ],
+        "scenes": [ { "nodes": [ 0 ] } ]
+    })";
+    std::vector<uint8_t> bin(44, 0);
+    std::memcpy(bin.data(), positions.data(), 36);
+    std::memcpy(bin.data() + 36, indices.data(), 6);
+
+    // header and chunks of the binary container, returns the file length
+    auto writeGLB = [&](const std::string& path, std::string json) {
+        json.resize((json.size() + 3) & ~size_t(3), ' ');
+        uint32_t jsonSize = static_cast<uint32_t>(json.size());
+        uint32_t binSize = static_cast<uint32_t>(bin.size());
+        std::vector<uint32_t> header = { 0x46546C67, 2, 12 + 8 + jsonSize + 8 + binSize };
+        std::vector<uint32_t> jsonChunk = { jsonSize, 0x4E4F534A };
+        std::vector<uint32_t> binChunk = { binSize, 0x004E4942 };
+        std::ofstream out(path, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(header.data()), 12);
+        out.write(reinterpret_cast<const char*>(jsonChunk.data()), 8);
+        out.write(json.data(), jsonSize);
+        out.write(reinterpret_cast<const char*>(binChunk.data()), 8);
+        out.write(reinterpret_cast<const char*>(bin.data()), binSize);
+        return size_t(header[2]);
+    };
+    size_t length = writeGLB("triangle.glb", json);
+
+    // vertices and indices are read in place from the mapped file
+    auto file = SlimPtr<MappedFile>(std::string("triangle.glb"));
+    EXPECT_EQ(file->GetSize(), length);
+
+    auto builder = SlimPtr<scene::Builder>(device);
+    auto model = gltf::Model { };
+    model.Load(builder, "triangle.glb");
+    ASSERT_EQ(model.meshes.size(), size_t(1));
+    ASSERT_EQ(model.meshes[0].primitives.size(), size_t(1));
+    const auto& primitive = model.meshes[0].primitives[0];
+    EXPECT_EQ(primitive.mesh->GetVertexCount(), uint64_t(3));
+    EXPECT_EQ(primitive.mesh->GetIndexCount(), uint64_t(3));
+    EXPECT_EQ(primitive.boundingBox.Min(), glm::vec3(0.0f, 0.0f, -1.0f));
+    EXPECT_EQ(primitive.boundingBox.Max(), glm::vec3(1.0f, 2.0f, 0.0f));
+    EXPECT_NE(model.GetScene(0), nullptr);
+    EXPECT_EQ(primitive.mesh->GetVertexStride(), uint32_t(sizeof(gltf::Vertex)));
+    EXPECT_EQ(primitive.mesh->GetIndexType(), VK_INDEX_TYPE_UINT32);
+
+    // compact layout: float position, octahedral normal, half uv0 and 16 bit indices
+    auto layout = gltf::VertexLayout::Compact();
+    auto attribs = layout.GetVertexAttribs();
+    ASSERT_EQ(attribs.size(), size_t(3));
+    EXPECT_EQ(attribs[1].location, uint32_t(1));
+    EXPECT_EQ(attribs[1].format, VK_FORMAT_R16G16_SNORM);
+    EXPECT_EQ(attribs[2].offset, uint32_t(16));
+    EXPECT_EQ(layout.GetStride(), uint32_t(20));
+
+    // views and accessors reaching past the BIN chunk are rejected before they are read
+    std::string overrunView = json;
+    overrunView.replace(overrunView.find(R"("byteOffset": 36, "byteLength": 6)"), 33, R"("byteOffset": 36, "byteLength": 60)");
+    writeGLB("overrun_view.glb", overrunView);
+    auto invalid = gltf::Model { };
+    EXPECT_THROW(invalid.Load(builder, "overrun_view.glb"), std::runtime_error);
+
+    std::string overrunAccessor = json;
+    overrunAccessor.replace(overrunAccessor.find(R"("count": 3, "type": "SCALAR")"), 28, R"("count": 4, "type": "SCALAR")");
+    writeGLB("overrun_accessor.glb", overrunAccessor);
+    EXPECT_THROW(invalid.Load(builder, "overrun_accessor.glb"), std::runtime_error);
+
+    auto compact = gltf::Model { };
+    compact.Load(builder, "triangle.glb", layout);
+    const auto& packed = compact.meshes[0].primitives[0];
+    EXPECT_EQ(packed.mesh->GetVertexStride(), uint32_t(20));
+    EXPECT_EQ(packed.mesh->GetIndexType(), VK_INDEX_TYPE_UINT16);
+    EXPECT_EQ(packed.boundingBox.Max(), primitive.boundingBox.Max());
+
+    // positions stay exact, the packed normal of +z decodes to the first octant
+    std::vector<uint8_t> encoded(layout.GetStride());
+    gltf::Vertex vertex = { };
+    vertex.position = glm::vec3(1.0f, 2.0f, 3.0f);
+    vertex.normal = glm::vec3(0.0f, 0.0f, 1.0f);
+    vertex.uv0 = glm::vec2(0.5f, 2.0f);
+    layout.Encode(vertex, encoded.data());
+    glm::vec3 position;
+    int16_t normal[2];
+    std::memcpy(&position, encoded.data(), sizeof(position));
+    std::memcpy(normal, encoded.data() + 12, sizeof(normal));
+    EXPECT_EQ(position, vertex.position);
+    EXPECT_EQ(normal[0], 0);
+    EXPECT_EQ(normal[1], 0);
+}
+
+// Test mesh optimization keeps the triangles while improving vertex cache locality
+TEST(SlimCore, MeshOptimizer) {
+    using Vertex = GeometryData::Vertex;
+
+    // unwelded and shuffled triangles, the worst case for the vertex cache
+    GeometryData sphere = Sphere { }.Create();
+    std::vector<uint32_t> triangles(sphere.indices.size() / 3);
+    std::iota(triangles.begin(), triangles.end(), 0);
+    std::shuffle(triangles.begin(), triangles.end(), std::mt19937(0));
+    std::vector<Vertex> vertices;
+    for (uint32_t t : triangles) {
+        for (uint32_t k = 0; k < 3; k++) {
+            vertices.push_back(sphere.vertices[sphere.indices[t * 3 + k]]);
+        }
+    }
+
+    auto mesh = SlimPtr<scene::Mesh>();
+    mesh->SetVertexBuffer(vertices);
+    mesh->SetIndexBuffer(GenerateSequence<uint32_t>(vertices.size()));
+
+    auto stats = scene::MeshOptimizer::Optimize(mesh.get());
+    EXPECT_EQ(stats.triangles, uint64_t(triangles.size()));
+    EXPECT_EQ(stats.verticesBefore, uint64_t(vertices.size()));
+    EXPECT_LT(stats.verticesAfter, stats.verticesBefore);
+    EXPECT_EQ(mesh->GetVertexCount(), stats.verticesAfter);
+    EXPECT_EQ(mesh->GetIndexCount(), uint64_t(vertices.size()));
+    EXPECT_FLOAT_EQ(stats.before.acmr, 3.0f);
+    EXPECT_LT(stats.after.acmr, 1.0f);
+    EXPECT_LT(stats.after.atvr, stats.before.atvr);
+
+    // every triangle is still there, possibly rotated but with the same winding
+    auto key = [](const Vertex& a, const Vertex& b, const Vertex& c) {
+        std::vector<float> k;
+        for (const Vertex* v : { &a, &b, &c }) {
+            k.insert(k.end(), { v->position.x, v->position.y, v->position.z });
+        }
+        return k;
+    };
+    auto canonical = [&](const Vertex& a, const Vertex& b, const Vertex& c) {
+        return std::min({ key(a, b, c), key(b, c, a), key(c, a, b) });
+    };
+    std::multiset<std::vector<float>> expected, actual;
+    for (size_t i = 0; i < vertices.size(); i += 3) {
+        expected.insert(canonical(vertices[i], vertices[i + 1], vertices[i + 2]));
+    }
+    const uint32_t* indices = mesh->GetIndexData<uint32_t>();
+    const Vertex* optimized = mesh->GetVertexData<Vertex>(0);
+    for (size_t i = 0; i < mesh->GetIndexCount(); i += 3) {
+        EXPECT_LT(indices[i + 0], mesh->GetVertexCount());
+        EXPECT_LT(indices[i + 1], mesh->GetVertexCount());
+        EXPECT_LT(indices[i + 2], mesh->GetVertexCount());
+        actual.insert(canonical(optimized[indices[i]], optimized[indices[i + 1]], optimized[indices[i + 2]]));
+    }
+    EXPECT_EQ(expected, actual);
+
+    // 16 bit indices stay 16 bit
+    auto small = SlimPtr<scene::Mesh>();
+    small->SetVertexBuffer(std::vector<glm::vec3>(6, glm::vec3(0.0f)));
+    small->SetIndexBuffer(GenerateSequence<uint16_t>(6));
+    scene::MeshOptimizer::Optimize(small.get());
+    EXPECT_EQ(small->GetIndexType(), VK_INDEX_TYPE_UINT16);
+    EXPECT_EQ(small->GetVertexCount(), uint64_t(1));
+}
+
+// Test levels of detail are reduced within their error bound, and selected by projected size
+TEST(SlimCore, MeshSimplifier) {
+    using Vertex = GeometryData::Vertex;
+
+    GeometryData sphere = Sphere { 1.0f, 64, 64 }.Create();
+    auto mesh = SlimPtr<scene::Mesh>();
+    mesh->SetVertexBuffer(sphere.vertices);
+    mesh->SetIndexBuffer(sphere.indices);
+    mesh->SetBoundingBox(BoundingBox(glm::vec3(-1.0f), glm::vec3(1.0f)));
+
+    uint32_t levels = scene::MeshSimplifier::GenerateLods(mesh.get());
+    EXPECT_GT(levels, 1u);
+    EXPECT_LE(levels, scene::MeshSimplifier::MAX_LODS);
+    EXPECT_EQ(mesh->GetLodCount(), levels);
+    EXPECT_EQ(mesh->GetLod(0).indexCount, uint32_t(sphere.indices.size()));
+    EXPECT_EQ(mesh->GetLod(0).error, 0.0f);
+
+    // levels are laid out one after another, referencing the vertices of the full mesh
+    const uint32_t* indices = mesh->GetIndexData<uint32_t>();
+    for (uint32_t level = 1; level < levels; level++) {
+        scene::MeshLod previous = mesh->GetLod(level - 1);
+        scene::MeshLod lod = mesh->GetLod(level);
+        EXPECT_EQ(lod.firstIndex, previous.firstIndex + previous.indexCount);
+        EXPECT_EQ(lod.indexCount % 3, 0u);
+        EXPECT_LT(lod.indexCount, previous.indexCount);
+        EXPECT_GE(lod.error, previous.error);
+        EXPECT_LE(lod.error, scene::MeshSimplifier::MAX_ERROR);
+        for (uint32_t i = lod.firstIndex; i < lod.firstIndex + lod.indexCount; i++) {
+            EXPECT_LT(indices[i], mesh->GetVertexCount());
+        }
+    }
+
+    // the sphere keeps facing outwards, slivers at its poles and equator may end up edge-on
+    scene::MeshLod coarsest = mesh->GetLod(levels - 1);
+    const Vertex* vertices = mesh->GetVertexData<Vertex>(0);
+    for (uint32_t i = coarsest.firstIndex; i < coarsest.firstIndex + coarsest.indexCount; i += 3) {
+        glm::vec3 p0 = vertices[indices[i + 0]].position;
+        glm::vec3 p1 = vertices[indices[i + 1]].position;
+        glm::vec3 p2 = vertices[indices[i + 2]].position;
+        EXPECT_GT(glm::dot(glm::cross(p1 - p0, p2 - p0), p0 + p1 + p2), -1e-6f);
+    }
+
+    // levels get coarser with distance
+    auto culling = SlimPtr<CPUCulling>();
+    glm::mat4 proj = glm::perspective(1.05f, 16.0f / 9.0f, 0.1f, 1000.0f);
+    BoundingBox bounds = BoundingBox(glm::vec3(-1.0f), glm::vec3(1.0f));
+    auto select = [&](float distance, uint32_t previous) {
+        return culling->SelectLod(mesh, bounds, glm::vec3(0.0f, 0.0f, distance), proj, previous);
+    };
+    EXPECT_EQ(select(0.5f, levels - 1), 0u);
+    EXPECT_EQ(select(1e5f, 0), levels - 1);
+    uint32_t lod = 0;
+    uint32_t switchLod = 0;
+    float switchDistance = 0.0f;
+    for (float distance = 2.0f; distance < 1e5f; distance *= 1.01f) {
+        uint32_t next = select(distance, lod);
+        EXPECT_GE(next, lod);
+        if (next > lod && switchDistance == 0.0f) {
+            switchLod = next;
+            switchDistance = distance;
+        }
+        lod = next;
+    }
+    EXPECT_GT(switchDistance, 0.0f);
+
+    // hysteresis, moving back a little does not return to the finer level
+    EXPECT_EQ(select(switchDistance, 0), switchLod);
+    EXPECT_EQ(select(switchDistance * 0.9f, switchLod), switchLod);
+    EXPECT_EQ(select(switchDistance * 0.9f, 0), 0u);
+    EXPECT_EQ(select(switchDistance * 0.5f, switchLod), 0u);
+
+    // a threshold of 0 always draws the full mesh
+    culling->SetLodThreshold(0.0f);
+    EXPECT_EQ(select(1e5f, 0), 0u);
+}
+
+TEST(SlimCore, MeshletBuilder) {
+    using Vertex = GeometryData::Vertex;
+
+    GeometryData sphere = Sphere { 1.0f, 64, 64 }.Create();
+    auto mesh = SlimPtr<scene::Mesh>();
+    mesh->SetVertexBuffer(sphere.vertices);
+    mesh->SetIndexBuffer(sphere.indices);
+
+    uint32_t count = scene::MeshletBuilder::Build(mesh.get());
+    const auto& meshlets = mesh->GetMeshlets();
+    EXPECT_GT(count, 1u);
+    EXPECT_EQ(meshlets.size(), count);
+
+    // meshlets cover the index data one after another, within the limits, with the same triangles as before
+    const uint32_t* indices = mesh->GetIndexData<uint32_t>();
+    const Vertex* vertices = mesh->GetVertexData<Vertex>(0);
+    std::multiset<std::tuple<uint32_t, uint32_t, uint32_t>> before, after;
+    for (size_t i = 0; i < sphere.indices.size(); i += 3) {
+        uint32_t a = sphere.indices[i + 0], b = sphere.indices[i + 1], c = sphere.indices[i + 2];
+        before.insert(std::min({ std::make_tuple(a, b, c), std::make_tuple(b, c, a), std::make_tuple(c, a, b) }));
+        a = indices[i + 0], b = indices[i + 1], c = indices[i + 2];
+        after.insert(std::min({ std::make_tuple(a, b, c), std::make_tuple(b, c, a), std::make_tuple(c, a, b) }));
+    }
+    EXPECT_EQ(before, after);
+
+    uint32_t firstIndex = 0;
+    for (const scene::Meshlet& meshlet : meshlets) {
+        EXPECT_EQ(meshlet.firstIndex, firstIndex);
+        EXPECT_EQ(meshlet.indexCount % 3, 0u);
+        EXPECT_LE(meshlet.indexCount / 3, scene::MeshletBuilder::MAX_TRIANGLES);
+        EXPECT_LE(meshlet.vertexCount, scene::MeshletBuilder::MAX_VERTICES);
+        firstIndex += meshlet.indexCount;
+
+        glm::vec3 center = glm::vec3(meshlet.sphere);
+        for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i++) {
+            EXPECT_LE(glm::length(vertices[indices[i]].position - center), meshlet.sphere.w + 1e-5f);
+        }
+    }
+    EXPECT_EQ(firstIndex, uint32_t(sphere.indices.size()));
+
+    // a meshlet rejected by its cone has no triangle facing the eye
+    const glm::vec3 eyes[] = { glm::vec3(3.0f, 0.0f, 0.0f), glm::vec3(0.0f, -3.0f, 0.0f), glm::vec3(1.0f, 2.0f, -2.0f) };
+    uint32_t rejected = 0;
+    for (const glm::vec3& eye : eyes) {
+        for (const scene::Meshlet& meshlet : meshlets) {
+            glm::vec3 direction = glm::vec3(meshlet.sphere) - eye;
+            if (glm::dot(direction, glm::vec3(meshlet.cone)) < meshlet.cone.w * glm::length(direction) + meshlet.sphere.w) {
+                continue;
+            }
+            rejected++;
+            for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i += 3) {
+                glm::vec3 p0 = vertices[indices[i + 0]].position;
+                glm::vec3 p1 = vertices[indices[i + 1]].position;
+                glm::vec3 p2 = vertices[indices[i + 2]].position;
+                EXPECT_GT(glm::dot(glm::cross(p1 - p0, p2 - p0), p0 - eye), -1e-6f);
+            }
+        }
+    }
+    EXPECT_GT(rejected, 0u);
+}
+
+TEST(SlimCore, KTX2) {
+    auto write32 = [](std::vector<uint8_t>& data, size_t offset, uint32_t value) { std::memcpy(&data[offset], &value, sizeof(value)); };
+    auto write64 = [](std::vector<uint8_t>& data, size_t offset, uint64_t value) { std::memcpy(&data[offset], &value, sizeof(value)); };
+
+    // a 6x5 BC1 image with 3 levels, stored smallest level first
+    const uint8_t identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+    const size_t sizes[3] = { 4 * 8, 8, 8 };
+    std::vector<uint8_t> file(80 + 3 * 24, 0);
+    std::memcpy(file.data(), identifier, sizeof(identifier));
+    write32(file, 12, VK_FORMAT_BC1_RGBA_UNORM_BLOCK);
+    write32(file, 16, 1);
+    write32(file, 20, 6);
+    write32(file, 24, 5);
+    write32(file, 36, 1);
+    write32(file, 40, 3);
+    size_t offsets[3];
+    for (int level = 2; level >= 0; level--) {
+        offsets[level] = file.size();
+        file.resize(file.size() + sizes[level], 0);
+        write64(file, 80 + level * 24 + 0, offsets[level]);
+        write64(file, 80 + level * 24 + 8, sizes[level]);
+        write64(file, 80 + level * 24 + 16, sizes[level]);
+    }
+
+    // level 0 blocks interpolate from red to blue, block k uses color k for all its texels
+    for (uint32_t k = 0; k < 4; k++) {
+        uint32_t selectors = 0;
+        for (uint32_t i = 0; i < 16; i++) selectors |= k << (2 * i);
+        write32(file, offsets[0] + k * 8, 0xF800 | (0x001F << 16));
+        write32(file, offsets[0] + k * 8 + 4, selectors);
+    }
+
+    EXPECT_TRUE(KTX2::IsKTX2(file.data(), file.size()));
+    KTX2Image image = KTX2::Parse(file.data(), file.size());
+    EXPECT_EQ(image.format, VK_FORMAT_BC1_RGBA_UNORM_BLOCK);
+    EXPECT_EQ(image.width, 6u);
+    EXPECT_EQ(image.height, 5u);
+    EXPECT_EQ(image.layers * image.faces, 1u);
+    ASSERT_EQ(image.levels.size(), 3u);
+    for (uint32_t level = 0; level < 3; level++) {
+        EXPECT_EQ(image.levels[level].data, file.data() + offsets[level]);
+        EXPECT_EQ(image.levels[level].size, sizes[level]);
+    }
+    EXPECT_EQ(image.levels[1].width, 3u);
+    EXPECT_EQ(image.levels[1].height, 2u);
+
+    // decoding clips the blocks at the edges of the level
+    EXPECT_EQ(KTX2::GetDecodedFormat(image.format), VK_FORMAT_R8G8B8A8_UNORM);
+    std::vector<uint8_t> rgba(6 * 5 * 4);
+    KTX2::Decode(image.format, image.levels[0].data, 6, 5, rgba.data());
+    auto texel = [&](uint32_t x, uint32_t y) { return glm::ivec4(rgba[(y * 6 + x) * 4 + 0], rgba[(y * 6 + x) * 4 + 1], rgba[(y * 6 + x) * 4 + 2], rgba[(y * 6 + x) * 4 + 3]); };
+    EXPECT_EQ(texel(0, 0), glm::ivec4(255, 0, 0, 255));
+    EXPECT_EQ(texel(5, 3), glm::ivec4(0, 0, 255, 255));
+    EXPECT_EQ(texel(3, 4), glm::ivec4(170, 0, 85, 255));
+    EXPECT_EQ(texel(4, 4), glm::ivec4(85, 0, 170, 255));
+
+    // supercompression and truncated levels are rejected
+    write32(file, 44, 2);
+    EXPECT_THROW(KTX2::Parse(file.data(), file.size()), std::runtime_error);
+    write32(file, 44, 0);
+    write64(file, 80 + 8, sizes[0] - 1);
+    EXPECT_THROW(KTX2::Parse(file.data(), file.size()), std::runtime_error);
+}
+
+TEST(SlimCore, TransformHierarchy) {
+    auto contextDesc = ContextDesc().EnableCompute();
+    auto context = SlimPtr<Context>(contextDesc);
+    auto device = SlimPtr<Device>(context);
+    auto builder = SlimPtr<scene::Builder>(device);
+
+    auto root = builder->CreateNode("root");
+    auto child = builder->CreateNode("child", root);
+    auto grandchild = builder->CreateNode("grandchild", child);
+    auto sibling = builder->CreateNode("sibling", root);
+    root->Scale(2.0f, 2.0f, 2.0f);
+    child->Translate(1.0f, 0.0f, 0.0f);
+    grandchild->Translate(0.0f, 1.0f, 0.0f);
+    sibling->Translate(0.0f, 0.0f, 1.0f);
+    root->ApplyTransform();
+
+    auto origin = [](scene::Node* node) { return glm::vec3(node->GetTransform().LocalToWorld() * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)); };
+    EXPECT_EQ(origin(grandchild), glm::vec3(2.0f, 2.0f, 0.0f));
+    EXPECT_EQ(origin(sibling), glm::vec3(0.0f, 0.0f, 2.0f));
+
+    // subtrees are contiguous in depth-first order, parents come first
+    scene::TransformHierarchy* hierarchy = builder->GetTransformHierarchy();
+    const auto& order = hierarchy->GetNodes();
+    ASSERT_EQ(order.size(), size_t(4));
+    EXPECT_EQ(order[0], root);
+    EXPECT_EQ(order[1], child);
+    EXPECT_EQ(order[2], grandchild);
+    EXPECT_EQ(order[3], sibling);
+    EXPECT_EQ(hierarchy->GetEnds()[0], 4u);
+    EXPECT_EQ(hierarchy->GetEnds()[1], 3u);
+
+    // only the moved subtree changes, and world to local stays the inverse through the hierarchy
+    glm::mat4 siblingWorld = sibling->GetTransform().LocalToWorld();
+    child->Translate(1.0f, 0.0f, 0.0f);
+    root->ApplyTransform();
+    EXPECT_EQ(origin(grandchild), glm::vec3(4.0f, 2.0f, 0.0f));
+    EXPECT_EQ(sibling->GetTransform().LocalToWorld(), siblingWorld);
+    glm::mat4 identity = grandchild->GetTransform().WorldToLocal() * grandchild->GetTransform().LocalToWorld();
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            EXPECT_NEAR(identity[i][j], i == j ? 1.0f : 0.0f, 1e-6f);
+        }
+    }
+
+    // reparenting rebuilds the order
+    grandchild->MoveTo(sibling);
+    root->ApplyTransform();
+    EXPECT_EQ(origin(grandchild), glm::vec3(0.0f, 2.0f, 2.0f));
+    EXPECT_EQ(order[3], grandchild);
+    EXPECT_EQ(hierarchy->GetParents()[3], 2u);
+}
+
+TEST(SlimCore, NodePool) {
+    auto contextDesc = ContextDesc().EnableCompute();
+    auto context = SlimPtr<Context>(contextDesc);
+    auto device = SlimPtr<Device>(context);
+    auto builder = SlimPtr<scene::Builder>(device);
+
+    auto root = builder->CreateNode("root");
+    auto a = builder->CreateNode("a", root);
+    auto b = builder->CreateNode("b", root);
+    auto a1 = builder->CreateNode("a1", a);
+    auto b1 = builder->CreateNode("b1", b);
+
+    // handles are stable slots in the pool
+    EXPECT_EQ(root->GetHandle(), 0u);
+    EXPECT_EQ(b1->GetHandle(), 4u);
+    EXPECT_EQ(builder->GetNode(a->GetHandle()), a);
+
+    std::vector<scene::Node*> children;
+    for (scene::Node* child : root->GetChildren()) {
+        children.push_back(child);
+    }
+    EXPECT_EQ(children, std::vector<scene::Node*>({ a, b }));
+
+    // depth-first, returning false skips the children of a node
+    std::vector<scene::Node*> visited;
+    root->ForEach([&](scene::Node* node) {
+        visited.push_back(node);
+        return node != a;
+    });
+    EXPECT_EQ(visited, std::vector<scene::Node*>({ root, a, b, b1 }));
+
+    // the same order after reparenting, and for nodes outside of a builder
+    a1->MoveTo(b);
+    visited.clear();
+    root->ForEach([&](scene::Node* node) {
+        visited.push_back(node);
+        return true;
+    });
+    EXPECT_EQ(visited, std::vector<scene::Node*>({ root, a, b, b1, a1 }));
+
+    auto standalone = SlimPtr<scene::Node>("standalone");
+    auto standaloneChild = SlimPtr<scene::Node>("child", standalone.get());
+    EXPECT_EQ(standalone->GetHandle(), scene::NodePool::INVALID_HANDLE);
+    visited.clear();
+    standalone->ForEach([&](scene::Node* node) {
+        visited.push_back(node);
+        return true;
+    });
+    EXPECT_EQ(visited, std::vector<scene::Node*>({ standalone.get(), standaloneChild.get() }));
+
+    // nodes held elsewhere keep their pool after the builder is gone
+    SmartPtr<scene::Node> held = b1;
+    builder.reset(nullptr);
+    EXPECT_EQ(held->GetName(), "b1");
+    EXPECT_EQ(held->GetParent(), nullptr);
+
+    // a reused slot does not resolve handles of the node destroyed before
+    auto pool = SlimPtr<scene::NodePool>();
+    SmartPtr<scene::Node> first = new (pool.get()) scene::Node("first");
+    uint32_t firstHandle = scene::NodePool::GetHandle(first);
+    first.reset(nullptr);
+    EXPECT_EQ(pool->Get(firstHandle), nullptr);
+    SmartPtr<scene::Node> second = new (pool.get()) scene::Node("second");
+    uint32_t secondHandle = scene::NodePool::GetHandle(second);
+    EXPECT_EQ(secondHandle & scene::NodePool::SLOT_MASK, firstHandle & scene::NodePool::SLOT_MASK);
+    EXPECT_NE(secondHandle, firstHandle);
+    EXPECT_EQ(pool->Get(firstHandle), nullptr);
+    EXPECT_EQ(pool->Get(secondHandle), second.get());
+}
+
+TEST(SlimCore, JobSystem) {
+    auto jobs = SlimPtr<JobSystem>(3);
+    EXPECT_EQ(jobs->GetThreadCount(), 4u);
+    EXPECT_EQ(jobs->GetThreadIndex(), 0u);
+
+    // every index is visited once, on a thread of the system
+    std::vector<uint32_t> values(10007, 0);
+    std::vector<uint32_t> threads(values.size(), ~0u);
+    jobs->ParallelFor(0, static_cast<uint32_t>(values.size()), 64, [&](uint32_t first, uint32_t last) {
+        for (uint32_t i = first; i < last; i++) {
+            values[i] += i;
+            threads[i] = jobs->GetThreadIndex();
+        }
+    });
+    for (uint32_t i = 0; i < values.size(); i++) {
+        EXPECT_EQ(values[i], i);
+        EXPECT_LT(threads[i], jobs->GetThreadCount());
+    }
+
+    // nested loops help instead of blocking the workers
+    std::atomic<uint64_t> sum = 0;
+    jobs->ParallelFor(0, 16, 1, [&](uint32_t, uint32_t) {
+        jobs->ParallelFor(0, 1000, 10, [&](uint32_t first, uint32_t last) {
+            uint64_t partial = 0;
+            for (uint32_t i = first; i < last; i++) partial += i;
+            sum += partial;
+        });
+    });
+    EXPECT_EQ(sum.load(), 16ull * 499500ull);
+
+    // dependent jobs only start once all jobs they depend on are done
+    JobCounter produced, consumed;
+    std::atomic<uint32_t> producers = 0;
+    std::atomic<uint32_t> early = 0;
+    for (uint32_t i = 0; i < 32; i++) {
+        jobs->Run(produced, [&]() { producers++; });
+    }
+    for (uint32_t i = 0; i < 32; i++) {
+        jobs->Run(consumed, produced, [&]() { early += producers.load() != 32; });
+    }
+    jobs->Wait(consumed);
+    EXPECT_TRUE(produced.IsDone());
+    EXPECT_EQ(early.load(), 0u);
+
+    // exceptions are rethrown by the waiting thread
+    EXPECT_THROW(jobs->ParallelFor(0, 100, 1, [](uint32_t first, uint32_t) {
+        if (first == 57) throw std::runtime_error("[JobSystem] test");
+    }), std::runtime_error);
+}
+
+TEST(SlimCore, BVH) {
+    // nearest box along rays against a brute force search, for both layouts and after a refit
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+    std::uniform_real_distribution<float> extent(0.1f, 3.0f);
+    std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+    std::vector<BoundingBox> boxes;
+    for (uint32_t i = 0; i < 2000; i++) {
+        glm::vec3 p = glm::vec3(position(rng), position(rng), position(rng));
+        glm::vec3 e = glm::vec3(extent(rng), extent(rng), extent(rng));
+        boxes.push_back(BoundingBox(p - e, p + e));
+    }
+
+    for (bool wide : { false, true }) {
+        BVH bvh;
+        bvh.Build(boxes, wide);
+        EXPECT_EQ(bvh.GetPrimitives().size(), boxes.size());
+        for (uint32_t refit = 0; refit < 2; refit++) {
+            if (refit) {
+                for (BoundingBox& box : boxes) {
+                    glm::vec3 offset = glm::vec3(direction(rng), direction(rng), direction(rng)) * 5.0f;
+                    box = BoundingBox(box.Min() + offset, box.Max() + offset);
+                }
+                bvh.Refit(boxes);
+            }
+            for (uint32_t q = 0; q < 200; q++) {
+                Ray ray;
+                ray.origin = glm::vec3(position(rng), position(rng), position(rng));
+                ray.direction = glm::vec3(direction(rng), direction(rng), direction(rng));
+                glm::vec3 invDirection = 1.0f / ray.direction;
+                auto intersect = [&](uint32_t box, float) { return BVH::Intersect(ray, invDirection, boxes[box].Min(), boxes[box].Max()); };
+
+                float expected = INF;
+                for (uint32_t i = 0; i < boxes.size(); i++) {
+                    expected = std::min(expected, intersect(i, INF));
+                }
+                float distance;
+                uint32_t hit = bvh.Raycast(ray, distance, intersect);
+                EXPECT_EQ(hit == BVH::INVALID_INDEX, expected == INF);
+                if (hit != BVH::INVALID_INDEX) {
+                    EXPECT_EQ(distance, expected);
+                }
+                EXPECT_EQ(bvh.Occluded(ray, [&](uint32_t box, float tmax) { return intersect(box, tmax) != INF; }), expected != INF);
+            }
+        }
+    }
+
+    // picking a row of spheres, exact hits need the triangles
+    GeometryData sphere = Sphere { 1.0f, 64, 64 }.Create();
+    auto mesh = SlimPtr<scene::Mesh>();
+    mesh->SetVertexBuffer(sphere.vertices);
+    mesh->SetIndexBuffer(sphere.indices);
+    mesh->SetBoundingBox(BoundingBox(glm::vec3(-1.0f), glm::vec3(1.0f)));
+
+    auto root = SlimPtr<scene::Node>("root");
+    std::vector<SmartPtr<scene::Node>> nodes;
+    for (int i = -1; i <= 1; i++) {
+        auto node = SlimPtr<scene::Node>("sphere", root.get());
+        node->Translate(3.0f * i, 0.0f, 0.0f);
+        node->SetDraw(mesh, nullptr);
+        nodes.push_back(node);
+    }
+    root->ApplyTransform();
+
+    auto sceneBVH = SlimPtr<scene::SceneBVH>();
+    sceneBVH->Build(root);
+    EXPECT_EQ(sceneBVH->GetEntryCount(), size_t(3));
+
+    scene::SceneBVH::Hit hit;
+    Ray ray;
+    ray.origin = glm::vec3(3.0f, 0.0f, 10.0f);
+    ASSERT_TRUE(sceneBVH->Raycast(ray, hit));
+    EXPECT_EQ(hit.entry.node, nodes[2].get());
+    EXPECT_NEAR(hit.distance, 9.0f, 1e-2f);
+    EXPECT_NE(hit.triangle, BVH::INVALID_INDEX);
+
+    // through the corner of the bounds, but past the sphere
+    ray.origin = glm::vec3(3.95f, 0.95f, 10.0f);
+    EXPECT_TRUE(sceneBVH->Raycast(ray, hit, false));
+    EXPECT_FALSE(sceneBVH->Raycast(ray, hit, true));
+    EXPECT_FALSE(sceneBVH->Occluded(ray));
+
+    // moved nodes are found after a refit
+    nodes[0]->Translate(0.0f, 10.0f, 0.0f);
+    root->ApplyTransform();
+    sceneBVH->Refit();
+    std::vector<scene::SceneBVH::Entry> entries;
+    sceneBVH->Query(BoundingBox(glm::vec3(-4.5f, 8.0f, -1.0f), glm::vec3(-1.5f, 12.0f, 1.0f)), entries);
+    ASSERT_EQ(entries.size(), size_t(1));
+    EXPECT_EQ(entries[0].node, nodes[0].get());
+
+    glm::mat4 proj = glm::perspective(0.5f, 1.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 20.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    sceneBVH->Query(Frustum(proj * view), entries);
+    EXPECT_EQ(entries.size(), size_t(2));
+}
+
 int main(int argc, char **argv) {
     // prepare for slim environment
     slim::Initialize();
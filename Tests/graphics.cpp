@@ -1,3 +1,4 @@
+#include <thread>
 #include "common.h"
 
 // Test rasterization
@@ -78,6 +79,306 @@ TEST(SlimCore, Rasterization) {
     CompareSequence(reference.data(), data, reference.size());
 }
 
+// Test pipeline pool keys pipelines by structural hash instead of name
+TEST(SlimCore, PipelinePool) {
+    auto contextDesc = ContextDesc()
+        .EnableGraphics();
+    auto context= SlimPtr<Context>(contextDesc);
+    auto device = SlimPtr<Device>(context);
+    auto vShader = SlimPtr<spirv::VertexShader>(device, "shaders/simple.vert.spv");
+    auto fShader = SlimPtr<spirv::FragmentShader>(device, "shaders/simple.frag.spv");
+
+    // two compatible render passes, pipelines should be shared between them
+    auto renderPassDesc = RenderPassDesc().SetName("color");
+    renderPassDesc.AddColorAttachment(VK_FORMAT_R8G8B8A8_UNORM, VK_SAMPLE_COUNT_1_BIT,
+                                      VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE);
+    renderPassDesc.AddSubpass().AddColorAttachment(0, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    auto renderPass0 = SlimPtr<RenderPass>(device, renderPassDesc);
+    auto renderPass1 = SlimPtr<RenderPass>(device, renderPassDesc);
+    EXPECT_EQ(renderPass0->GetCompatibilityHash(), renderPass1->GetCompatibilityHash());
+    EXPECT_EQ(renderPass0->GetCompatibilityKey(), renderPass1->GetCompatibilityKey());
+
+    auto createDesc = [&](RenderPass* renderPass, uint32_t width) {
+        return GraphicsPipelineDesc()
+            .SetName("colorPass")
+            .AddVertexBinding(0, sizeof(glm::vec2) + sizeof(glm::vec2), VK_VERTEX_INPUT_RATE_VERTEX, {
+                { 0, VK_FORMAT_R32G32_SFLOAT, 0,                },
+                { 1, VK_FORMAT_R32G32_SFLOAT, sizeof(glm::vec2) },
+             })
+            .SetVertexShader(vShader)
+            .SetFragmentShader(fShader)
+            .SetViewport(VkExtent2D { width, 2 })
+            .SetRenderPass(renderPass)
+            .SetPipelineLayout(PipelineLayoutDesc()
+                .AddBinding("MainTex", SetBinding { 0, 0 }, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+            );
+    };
+
+    auto pool = SlimPtr<PipelinePool>(device);
+    Pipeline* pipeline0 = pool->Request(createDesc(renderPass0, 2));
+    Pipeline* pipeline1 = pool->Request(createDesc(renderPass1, 2));
+    Pipeline* pipeline2 = pool->Request(createDesc(renderPass0, 4));
+
+    // same states share a pipeline, different viewports with the same name do not collide
+    EXPECT_EQ(pipeline0, pipeline1);
+    EXPECT_NE(pipeline0, pipeline2);
+    EXPECT_EQ(pool->Size(), size_t(2));
+
+    // pipelines are looked up by the full key, equal hashes alone are not enough
+    EXPECT_EQ(PipelinePool::GetKey(createDesc(renderPass0, 2)), PipelinePool::GetKey(createDesc(renderPass1, 2)));
+    EXPECT_NE(PipelinePool::GetKey(createDesc(renderPass0, 2)), PipelinePool::GetKey(createDesc(renderPass0, 4)));
+
+    // the name only labels the pipeline, identically configured descs share one
+    EXPECT_EQ(pool->Request(createDesc(renderPass0, 2).SetName("other")), pipeline0);
+
+    // the key is cached on the desc, setting the same state again keeps it, changing state rebuilds it
+    auto desc = createDesc(renderPass0, 2);
+    PipelineKey key = PipelinePool::GetKey(desc);
+    const char* cached = PipelinePool::GetKey(desc).state.data();
+    desc.SetRenderPass(renderPass0).SetViewport(VkExtent2D { 2, 2 });
+    EXPECT_EQ(PipelinePool::GetKey(desc).state.data(), cached);
+    desc.SetCullMode(VK_CULL_MODE_NONE);
+    EXPECT_NE(PipelinePool::GetKey(desc), key);
+}
+
+// Test transient images with disjoint lifetimes share memory
+TEST(SlimCore, AliasingImagePool) {
+    auto contextDesc = ContextDesc()
+        .EnableGraphics();
+    auto context= SlimPtr<Context>(contextDesc);
+    auto device = SlimPtr<Device>(context);
+
+    VkExtent2D extent = { 256, 256 };
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    std::vector<TransientImageDesc> descs = {
+        { VK_FORMAT_R8G8B8A8_UNORM, extent, 1, 1, VK_SAMPLE_COUNT_1_BIT, usage, 0, 1 },  // pass 0 -> 1
+        { VK_FORMAT_R8G8B8A8_UNORM, extent, 1, 1, VK_SAMPLE_COUNT_1_BIT, usage, 2, 3 },  // pass 2 -> 3, reuses the first
+        { VK_FORMAT_R8G8B8A8_UNORM, extent, 1, 1, VK_SAMPLE_COUNT_1_BIT, usage, 1, 2 },  // overlaps with both
+    };
+
+    auto pool = SlimPtr<AliasingImagePool>(device);
+    AliasedImages* images = pool->Request(descs);
+    EXPECT_EQ(images->images.size(), size_t(3));
+    EXPECT_EQ(images->stats.imageCount, 3u);
+    EXPECT_FALSE(images->aliased[0]);
+    EXPECT_TRUE(images->aliased[1]);
+    EXPECT_FALSE(images->aliased[2]);
+    EXPECT_LT(images->stats.aliasedSize, images->stats.unaliasedSize);
+
+    // same descs are placed only once
+    AliasedImages* cached = pool->Request(descs);
+    EXPECT_EQ(images, cached);
+    EXPECT_EQ(pool->Size(), size_t(1));
+
+    // placements still referenced outlive Clear() and Reset(), their memory is freed with the last reference
+    SmartPtr<AliasedImages> used = images;
+    pool->Clear();
+    pool->Reset();
+    EXPECT_EQ(pool->Size(), size_t(0));
+    EXPECT_EQ(used->images.size(), size_t(3));
+    EXPECT_NE(pool->Request(descs), used.get());
+}
+
+// Test render graph runs retained passes in dependency order and skips culled ones
+TEST(SlimCore, RenderGraphScheduling) {
+    auto contextDesc = ContextDesc()
+        .EnableCompute()
+        .EnableGraphics();
+    auto context= SlimPtr<Context>(contextDesc);
+    auto device = SlimPtr<Device>(context);
+
+    auto extent = VkExtent2D { 2, 2 };
+    auto format = VK_FORMAT_R8G8B8A8_UNORM;
+    auto image = SlimPtr<GPUImage>(device, format, extent, 1, 1, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT);
+    auto buffer = SlimPtr<DeviceStorageBuffer>(device, 64);
+    auto frame = SlimPtr<RenderFrame>(device, image);
+
+    std::vector<std::string> executed;
+    RenderGraph graph(frame);
+
+    auto backBuffer = graph.CreateResource(frame->GetBackBuffer());
+    auto storage = graph.CreateResource(buffer);
+    auto unused = graph.CreateResource(extent, format, VK_SAMPLE_COUNT_1_BIT);
+
+    auto computePass = graph.CreateComputePass("compute");
+    computePass->SetStorage(storage, RenderGraph::STORAGE_WRITE_ONLY);
+    computePass->Execute([&](const RenderInfo &) { executed.push_back("compute"); });
+
+    // nothing reads its output, this pass is culled
+    auto unusedPass = graph.CreateRenderPass("unused");
+    unusedPass->SetColor(unused, ClearValue(0.0f, 0.0f, 0.0f, 1.0f));
+    unusedPass->Execute([&](const RenderInfo &) { executed.push_back("unused"); });
+
+    // passes after a culled pass still run
+    auto colorPass = graph.CreateRenderPass("color");
+    colorPass->SetColor(backBuffer, ClearValue(0.0f, 0.0f, 0.0f, 1.0f));
+    colorPass->SetStorage(storage, RenderGraph::STORAGE_READ_ONLY);
+    colorPass->Execute([&](const RenderInfo &) { executed.push_back("color"); });
+
+    graph.Execute();
+    device->WaitIdle();
+
+    std::vector<std::string> expected = { "compute", "color" };
+    EXPECT_EQ(executed, expected);
+}
+
+// Test barriers on the same resources are merged into one pipeline barrier
+TEST(SlimCore, BarrierBatch) {
+    auto contextDesc = ContextDesc()
+        .EnableGraphics();
+    auto context= SlimPtr<Context>(contextDesc);
+    auto device = SlimPtr<Device>(context);
+
+    auto extent = VkExtent2D { 4, 4 };
+    auto format = VK_FORMAT_R8G8B8A8_UNORM;
+    auto usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    auto image0 = SlimPtr<GPUImage>(device, format, extent, 1, 1, VK_SAMPLE_COUNT_1_BIT, usage);
+    auto image1 = SlimPtr<GPUImage>(device, format, extent, 1, 1, VK_SAMPLE_COUNT_1_BIT, usage);
+    auto buffer = SlimPtr<DeviceStorageBuffer>(device, 256);
+
+    device->Execute([&](CommandBuffer* commandBuffer) {
+        BarrierBatch barriers;
+        EXPECT_TRUE(barriers.Empty());
+
+        // two transitions of the same image become one
+        barriers.AddImageBarrier(image0, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+        barriers.AddImageBarrier(image0, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+        barriers.AddImageBarrier(image1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        // ranges of the same buffer are merged
+        barriers.AddBufferBarrier(buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 64);
+        barriers.AddBufferBarrier(buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 128, 64);
+
+        EXPECT_EQ(barriers.GetImageBarrierCount(), size_t(2));
+        EXPECT_EQ(barriers.GetBufferBarrierCount(), size_t(1));
+        barriers.Flush(commandBuffer);
+        EXPECT_TRUE(barriers.Empty());
+    }, VK_QUEUE_GRAPHICS_BIT);
+
+    // layouts are tracked when barriers are added
+    EXPECT_EQ(image0->layouts[0][0], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    EXPECT_EQ(image1->layouts[0][0], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+}
+
+// Test command buffer skips binding states that are already bound
+TEST(SlimCore, RedundantBindElision) {
+    auto contextDesc = ContextDesc()
+        .EnableGraphics();
+    auto context= SlimPtr<Context>(contextDesc);
+    auto device = SlimPtr<Device>(context);
+    auto vertexBuffer0 = SlimPtr<VertexBuffer>(device, 256);
+    auto vertexBuffer1 = SlimPtr<VertexBuffer>(device, 256);
+    auto indexBuffer = SlimPtr<IndexBuffer>(device, 256);
+
+    device->Execute([&](CommandBuffer* commandBuffer) {
+        commandBuffer->BindVertexBuffer(0, vertexBuffer0, 0);
+        commandBuffer->BindVertexBuffer(0, vertexBuffer0, 0);   // elided
+        commandBuffer->BindVertexBuffer(0, vertexBuffer0, 64);
+        commandBuffer->BindVertexBuffer(0, vertexBuffer1, 64);
+        commandBuffer->BindIndexBuffer(indexBuffer);
+        commandBuffer->BindIndexBuffer(indexBuffer);            // elided
+        EXPECT_EQ(commandBuffer->GetElidedBindCount(), uint32_t(2));
+
+        // bindings recorded elsewhere are unknown after invalidation
+        commandBuffer->InvalidateBindings();
+        commandBuffer->BindIndexBuffer(indexBuffer);
+        EXPECT_EQ(commandBuffer->GetElidedBindCount(), uint32_t(2));
+    }, VK_QUEUE_GRAPHICS_BIT);
+}
+
+// Test secondary command buffers recorded on several threads inside one render pass
+TEST(SlimCore, SecondaryCommandBuffers) {
+    auto contextDesc = ContextDesc()
+        .EnableGraphics();
+    auto context= SlimPtr<Context>(contextDesc);
+    auto device = SlimPtr<Device>(context);
+    auto vShader = SlimPtr<spirv::VertexShader>(device, "shaders/simple.vert.spv");
+    auto fShader = SlimPtr<spirv::FragmentShader>(device, "shaders/simple.frag.spv");
+
+    auto extent = VkExtent2D { 2, 2 };
+    auto vBuffer = GenerateQuadVertices(device);
+    auto iBuffer = GenerateQuadIndices(device);
+    auto texture = GenerateCheckerboard(device, extent.width, extent.height);
+    auto sampler = SlimPtr<Sampler>(device, SamplerDesc {});
+
+    auto format = VK_FORMAT_R8G8B8A8_UNORM;
+    auto image = SlimPtr<GPUImage>(device, format, extent, 1, 1, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT);
+    auto frame = SlimPtr<RenderFrame>(device, image);
+
+    RenderGraph graph(frame);
+    auto backBuffer = graph.CreateResource(frame->GetBackBuffer());
+    auto colorPass = graph.CreateRenderPass("color");
+    colorPass->SetColor(backBuffer, ClearValue(0.0f, 0.0f, 0.0f, 1.0f));
+    colorPass->UseSecondaryCommandBuffers();
+    colorPass->Execute([&](const RenderInfo &info) {
+        EXPECT_EQ(info.contents, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+        // shared state is prepared on this thread
+        auto pipeline = info.renderFrame->RequestPipeline(
+            GraphicsPipelineDesc()
+                .SetName("colorPass")
+                .AddVertexBinding(0, sizeof(glm::vec2) + sizeof(glm::vec2), VK_VERTEX_INPUT_RATE_VERTEX, {
+                    { 0, VK_FORMAT_R32G32_SFLOAT, 0,                },
+                    { 1, VK_FORMAT_R32G32_SFLOAT, sizeof(glm::vec2) },
+                 })
+                .SetVertexShader(vShader)
+                .SetFragmentShader(fShader)
+                .SetViewport(frame->GetExtent())
+                .SetCullMode(VK_CULL_MODE_BACK_BIT)
+                .SetFrontFace(VK_FRONT_FACE_COUNTER_CLOCKWISE)
+                .SetRenderPass(info.renderPass)
+                .SetDepthTest(VK_COMPARE_OP_LESS)
+                .SetPipelineLayout(PipelineLayoutDesc()
+                    .AddBinding("MainTex", SetBinding { 0, 0 }, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+                )
+        );
+        auto descriptor = SlimPtr<Descriptor>(info.renderFrame->GetDescriptorPool(), pipeline->Layout());
+        descriptor->SetTexture("MainTex", texture, sampler);
+        descriptor->Update();
+
+        // one triangle of the quad per thread
+        constexpr uint32_t threads = 2;
+        std::vector<CommandBuffer*> commandBuffers(threads);
+        for (uint32_t t = 0; t < threads; t++) {
+            commandBuffers[t] = info.renderFrame->RequestThreadCommandPool(t)->Request(VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+        }
+        std::vector<std::thread> workers;
+        for (uint32_t t = 0; t < threads; t++) {
+            workers.emplace_back([&, t]() {
+                CommandBuffer* commandBuffer = commandBuffers[t];
+                commandBuffer->Begin(info.renderPass, info.subpass, info.framebuffer);
+                commandBuffer->BindPipeline(pipeline);
+                commandBuffer->BindDescriptor(descriptor, VK_PIPELINE_BIND_POINT_GRAPHICS);
+                commandBuffer->BindVertexBuffer(0, vBuffer, 0);
+                commandBuffer->BindIndexBuffer(iBuffer);
+                commandBuffer->DrawIndexed(3, 1, t * 3, 0, 0);
+                commandBuffer->End();
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        info.commandBuffer->ExecuteCommands(commandBuffers);
+    });
+
+    graph.Execute();
+    device->WaitIdle();
+
+    // copy back
+    auto reference = GenerateCheckerboard(extent.width, extent.height);
+    auto buffer = SlimPtr<StagingBuffer>(device, extent.width * extent.height * 4);
+    device->Execute([&](auto cmd) {
+        VkOffset3D off = VkOffset3D { 0, 0, 0 };
+        VkExtent3D ext = VkExtent3D { extent.width, extent.height, 1 };
+        cmd->CopyImageToBuffer(image, off, ext, 0, 1, 0, VK_IMAGE_ASPECT_COLOR_BIT, buffer, 0, 0, 0);
+    });
+
+    uint32_t *data = buffer->GetData<uint32_t>();
+    CompareSequence(reference.data(), data, reference.size());
+}
+
 int main(int argc, char **argv) {
     // prepare for slim environment
     slim::Initialize();